@@ -0,0 +1,147 @@
+/**
+ * @desc:   synthetic inputs for the microbenchmarks: detection sets with a controllable share of
+ *          overlapping boxes, a raw YOLO output tensor with a given number of surviving anchors,
+ *          and a moving scene that feeds SORT frame after frame with noise, misses and births.
+ *          Everything is seeded, so runs are comparable across builds and machines.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "model.h"
+#include "sort.h"
+
+namespace bench {
+
+struct SceneConfig {
+    int boxes = 100;            // detections per frame
+    float overlap = 0.f;        // share of boxes placed as jittered copies of another box (0..1)
+    int width = 1280;
+    int height = 720;
+    uint32_t seed = 1;
+};
+
+/**
+ * @brief one frame of detections. Independent boxes are spread uniformly; with probability overlap a
+ *        box instead duplicates an earlier one shifted by up to 15% of its size (IoU mostly > 0.5),
+ *        the way one object shows up as a cluster of candidates before NMS.
+ */
+inline std::vector<DetectRes> makeDetections(const SceneConfig &config)
+{
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<DetectRes> detections;
+    detections.reserve(config.boxes);
+    for (int i = 0; i < config.boxes; i++) {
+        DetectRes det;
+        det.classes = 0;
+        det.prob = 0.25f + 0.75f * unit(rng);
+        if (i > 0 && unit(rng) < config.overlap) {
+            const DetectRes &base = detections[std::uniform_int_distribution<int>(0, i - 1)(rng)];
+            det.w = base.w * (0.9f + 0.2f * unit(rng));
+            det.h = base.h * (0.9f + 0.2f * unit(rng));
+            det.x = base.x + base.w * 0.15f * (2.f * unit(rng) - 1.f);
+            det.y = base.y + base.h * 0.15f * (2.f * unit(rng) - 1.f);
+        } else {
+            det.w = 16.f + 112.f * unit(rng);
+            det.h = 16.f + 80.f * unit(rng);
+            det.x = det.w / 2 + (config.width - det.w) * unit(rng);
+            det.y = det.h / 2 + (config.height - det.h) * unit(rng);
+        }
+        detections.push_back(det);
+    }
+    return detections;
+}
+
+/**
+ * @brief channel-first YOLOv11 output of one image, [num_classes + 4, num_anchors]; survivors anchors
+ *        score above 0.5, the rest below 0.1
+ */
+inline std::vector<float> makeYoloOutput(int num_anchors, int num_classes, int survivors, uint32_t seed = 1)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<float> out(size_t(num_classes + 4) * num_anchors);
+    for (int i = 0; i < num_anchors; i++) {
+        out[i] = 640.f * unit(rng);
+        out[num_anchors + i] = 640.f * unit(rng);
+        out[2 * num_anchors + i] = 8.f + 120.f * unit(rng);
+        out[3 * num_anchors + i] = 8.f + 120.f * unit(rng);
+        for (int c = 0; c < num_classes; c++)
+            out[(4 + c) * num_anchors + i] = 0.1f * unit(rng);
+    }
+    std::vector<int> anchors(num_anchors);
+    for (int i = 0; i < num_anchors; i++)
+        anchors[i] = i;
+    std::shuffle(anchors.begin(), anchors.end(), rng);
+    for (int k = 0; k < std::min(survivors, num_anchors); k++) {
+        int c = std::uniform_int_distribution<int>(0, num_classes - 1)(rng);
+        out[(4 + c) * num_anchors + anchors[k]] = 0.5f + 0.5f * unit(rng);
+    }
+    return out;
+}
+
+/**
+ * @brief objects moving at constant velocity with detection noise. Each frame an object is missed with
+ *        probability miss, objects leaving the frame respawn elsewhere, and with overlap > 0 objects
+ *        start in tight clusters so the gated IoU graph has large components.
+ */
+class MovingScene {
+public:
+    explicit MovingScene(const SceneConfig &config, float miss = 0.05f)
+        : config(config), miss(miss), rng(config.seed)
+    {
+        objects.resize(config.boxes);
+        for (size_t i = 0; i < objects.size(); i++)
+            spawn(objects[i], i > 0 && unit(rng) < config.overlap ? &objects[i - 1] : nullptr);
+    }
+
+    // advances one frame and returns its detections
+    const std::vector<sort::Detection> &next()
+    {
+        std::normal_distribution<float> noise(0.f, 1.f);
+        detections.clear();
+        for (Object &o : objects) {
+            o.xc += o.dx;
+            o.yc += o.dy;
+            if (o.xc < 0 || o.yc < 0 || o.xc > config.width || o.yc > config.height)
+                spawn(o, nullptr);
+            if (unit(rng) < miss)
+                continue;
+            detections.push_back({o.xc + noise(rng), o.yc + noise(rng), o.w * (1.f + 0.02f * noise(rng)),
+                                  o.h * (1.f + 0.02f * noise(rng)), 0.5f + 0.5f * unit(rng), 0});
+        }
+        return detections;
+    }
+
+private:
+    struct Object {
+        float xc, yc, w, h, dx, dy;
+    };
+
+    void spawn(Object &o, const Object *near)
+    {
+        o.w = 24.f + 96.f * unit(rng);
+        o.h = 24.f + 64.f * unit(rng);
+        if (near) {
+            o.xc = near->xc + near->w * (unit(rng) - 0.5f);
+            o.yc = near->yc + near->h * (unit(rng) - 0.5f);
+        } else {
+            o.xc = config.width * unit(rng);
+            o.yc = config.height * unit(rng);
+        }
+        o.dx = 6.f * (unit(rng) - 0.5f);
+        o.dy = 2.f + 4.f * unit(rng);   // road surface streams towards the bottom of the frame
+    }
+
+    SceneConfig config;
+    float miss;
+    std::mt19937 rng;
+    std::uniform_real_distribution<float> unit{0.f, 1.f};
+    std::vector<Object> objects;
+    std::vector<sort::Detection> detections;
+};
+
+} // namespace bench
@@ -0,0 +1,259 @@
+/**
+ * @desc:   microbenchmarks of the CPU hot paths, no GPU or engine needed:
+ *          NMS, host decode and letterbox, SORT update, both assignment solvers, the batched Kalman
+ *          filter and the ground distance lookups. Arguments are box counts and overlap density in
+ *          percent, e.g.
+ *              ./yolo_bench --benchmark_filter=Nms --benchmark_counters_tabular=true
+ */
+#include <benchmark/benchmark.h>
+#include <random>
+#include "synthetic.h"
+#include "nms.h"
+#include "host_decode.h"
+#include "sort.h"
+#include "kuhn_munkres.h"
+#include "lapjv.h"
+#include "kalman_box_tracker.h"
+#include "DistanceEstimator.hpp"
+
+namespace {
+
+bench::SceneConfig scene(const benchmark::State &state)
+{
+    bench::SceneConfig config;
+    config.boxes = int(state.range(0));
+    config.overlap = state.range(1) / 100.f;
+    return config;
+}
+
+// boxes x overlap percent
+void sceneArgs(benchmark::internal::Benchmark *b)
+{
+    for (int boxes : {64, 256, 1000, 4000})
+        for (int overlap : {0, 50, 90})
+            b->Args({boxes, overlap});
+}
+
+std::vector<float> randomCost(int rows, int cols, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<float> cost(size_t(rows) * cols);
+    for (float &c : cost)
+        c = unit(rng);
+    return cost;
+}
+
+/**********************************************
+* NMS (YOLO::NmsDetect runs NmsEngine::run)
+**********************************************/
+void runNms(benchmark::State &state, NmsMethod method)
+{
+    std::vector<DetectRes> input = bench::makeDetections(scene(state));
+    NmsConfig config;
+    config.method = method;
+    config.topK = 0;
+    NmsEngine nms(config);
+    std::vector<DetectRes> detections;
+    size_t kept = 0;
+    for (auto _ : state) {
+        detections = input;
+        nms.run(detections);
+        kept = detections.size();
+        benchmark::DoNotOptimize(detections.data());
+    }
+    state.SetItemsProcessed(state.iterations() * input.size());
+    state.counters["kept"] = double(kept);
+}
+
+void BM_NmsGrid(benchmark::State &state) { runNms(state, NmsMethod::kGrid); }
+void BM_NmsGreedy(benchmark::State &state) { runNms(state, NmsMethod::kGreedy); }
+BENCHMARK(BM_NmsGrid)->Apply(sceneArgs);
+BENCHMARK(BM_NmsGreedy)->Apply(sceneArgs);
+
+/**********************************************
+* host decode and letterbox (CPU postprocess / preprocess)
+**********************************************/
+void BM_HostDecode(benchmark::State &state)
+{
+    const int anchors = 8400, classes = int(state.range(0)), survivors = int(state.range(1));
+    std::vector<float> output = bench::makeYoloOutput(anchors, classes, survivors);
+    std::vector<DetectRes> results(anchors);
+    int count = 0;
+    for (auto _ : state) {
+        count = decodeYoloOutputHost(output.data(), anchors, classes, 0.25f, 1.f, results.data(), anchors);
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetItemsProcessed(state.iterations() * anchors);
+    state.counters["decoded"] = count;
+}
+BENCHMARK(BM_HostDecode)->Args({1, 0})->Args({1, 100})->Args({1, 2000})->Args({80, 100});
+
+void BM_HostLetterbox(benchmark::State &state)
+{
+    cv::Mat frame(int(state.range(1)), int(state.range(0)), CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    std::vector<float> tensor(3 * 640 * 640);
+    for (auto _ : state) {
+        letterboxBgrToTensorHost(frame, tensor.data(), 640, 640);
+        benchmark::DoNotOptimize(tensor.data());
+    }
+    state.SetBytesProcessed(state.iterations() * frame.total() * frame.elemSize());
+}
+BENCHMARK(BM_HostLetterbox)->Args({640, 480})->Args({1280, 720})->Args({1920, 1080})->Unit(benchmark::kMicrosecond);
+
+/**********************************************
+* SORT (update covers the gated IoU matrix, components and the solver)
+**********************************************/
+void runSort(benchmark::State &state, sort::AssignMethod method)
+{
+    bench::SceneConfig config = scene(state);
+    bench::MovingScene moving(config);
+    sort::Sort tracker(30, 3, 0.3f, std::max(256, 2 * config.boxes), method);
+    std::vector<sort::TrackedBox> out(tracker.getCapacity());
+    for (int i = 0; i < 10; i++)
+        tracker.update(moving.next(), out);     // past the tentative phase
+    int tracked = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        const std::vector<sort::Detection> &detections = moving.next();
+        state.ResumeTiming();
+        tracked = tracker.update(detections, out);
+        benchmark::DoNotOptimize(tracked);
+    }
+    state.SetItemsProcessed(state.iterations() * config.boxes);
+    state.counters["tracked"] = tracked;
+}
+
+void sortArgs(benchmark::internal::Benchmark *b)
+{
+    for (int boxes : {16, 64, 256})
+        for (int overlap : {0, 50})
+            b->Args({boxes, overlap});
+}
+
+void BM_SortUpdateLapjv(benchmark::State &state) { runSort(state, sort::AssignMethod::kLapjv); }
+void BM_SortUpdateHungarian(benchmark::State &state) { runSort(state, sort::AssignMethod::kHungarian); }
+BENCHMARK(BM_SortUpdateLapjv)->Apply(sortArgs);
+BENCHMARK(BM_SortUpdateHungarian)->Apply(sortArgs);
+
+void BM_SortCoast(benchmark::State &state)
+{
+    bench::SceneConfig config = scene(state);
+    bench::MovingScene moving(config);
+    sort::Sort tracker(30, 3, 0.3f, std::max(256, 2 * config.boxes));
+    std::vector<sort::TrackedBox> out(tracker.getCapacity());
+    for (int i = 0; i < 10; i++)
+        tracker.update(moving.next(), out);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(tracker.coast(out));
+}
+BENCHMARK(BM_SortCoast)->Args({64, 0})->Args({256, 0});
+
+/**********************************************
+* assignment solvers on dense square problems
+**********************************************/
+void BM_KuhnMunkres(benchmark::State &state)
+{
+    const int n = int(state.range(0));
+    std::vector<float> cost = randomCost(n, n, 7);
+    kuhn_munkres::KuhnMunkres km;
+    std::vector<std::pair<int, int>> result;
+    for (auto _ : state) {
+        km.compute(cost.data(), n, n, result);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+BENCHMARK(BM_KuhnMunkres)->Arg(8)->Arg(32)->Arg(128);
+
+void BM_LapJV(benchmark::State &state)
+{
+    const int n = int(state.range(0));
+    std::vector<float> cost = randomCost(n, n, 7);
+    lapjv::LapJV lap;
+    std::vector<std::pair<int, int>> result;
+    for (auto _ : state) {
+        lap.compute(cost.data(), n, n, result);
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+BENCHMARK(BM_LapJV)->Arg(8)->Arg(32)->Arg(128)->Arg(512);
+
+/**********************************************
+* batched Kalman filter
+**********************************************/
+void BM_KalmanPredictCorrect(benchmark::State &state)
+{
+    const int n = int(state.range(0));
+    sort::KalmanBoxTracker kf(n);
+    std::vector<uint8_t> mask(n, 1);
+    for (int i = 0; i < n; i++) {
+        float box[4] = {float(i % 64) * 20.f, float(i / 64) * 20.f, 40.f, 30.f};
+        kf.init(i, box);
+    }
+    for (auto _ : state) {
+        kf.predictAll(n);
+        for (int i = 0; i < n; i++) {
+            float box[4];
+            kf.getBox(i, box);
+            box[0] += 0.5f;
+            kf.setMeasurement(i, box);
+        }
+        kf.correctAll(mask.data(), n);
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+BENCHMARK(BM_KalmanPredictCorrect)->Arg(16)->Arg(256)->Arg(1024);
+
+/**********************************************
+* ground distance
+**********************************************/
+const CamIntrinsics kIntrinsics{1000.f, 1000.f, 640.f, 360.f};
+
+std::vector<cv::Point2f> groundPoints(int n)
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> x(0.f, 1279.f), y(400.f, 719.f);
+    std::vector<cv::Point2f> points(n);
+    for (cv::Point2f &p : points)
+        p = {x(rng), y(rng)};
+    return points;
+}
+
+void BM_GroundDistancePixel(benchmark::State &state)
+{
+    std::vector<cv::Point2f> points = groundPoints(int(state.range(0)));
+    GroundDistance gdist(kIntrinsics, 1.5f, cv::Size(1280, 720));
+    double theta = 0.2;
+    for (auto _ : state) {
+        gdist.update_theta_cache(theta);
+        theta = theta == 0.2 ? 0.21 : 0.2;     // a new pitch every frame, as in the tracker
+        float D, X;
+        for (const cv::Point2f &p : points) {
+            gdist.distance_from_pixel(p, D, X);
+            benchmark::DoNotOptimize(D);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_GroundDistancePixel)->Arg(16)->Arg(256)->Arg(4096);
+
+void BM_GroundDistanceBatch(benchmark::State &state)
+{
+    std::vector<cv::Point2f> points = groundPoints(int(state.range(0)));
+    std::vector<GroundPoint> out(points.size());
+    GroundDistance gdist(kIntrinsics, 1.5f, cv::Size(1280, 720));
+    double theta = 0.2;
+    for (auto _ : state) {
+        gdist.update_theta_cache(theta);
+        theta = theta == 0.2 ? 0.21 : 0.2;
+        gdist.distances(points, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_GroundDistanceBatch)->Arg(16)->Arg(256)->Arg(4096);
+
+} // namespace
+
+BENCHMARK_MAIN();
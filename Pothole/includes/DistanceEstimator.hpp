@@ -2,6 +2,8 @@
 #include <opencv2/opencv.hpp>
 #include <cmath>
 #include <deque>
+#include <vector>
+#include "span.h"
 
 struct CamIntrinsics {
     float fx, fy, cx, cy;
@@ -15,7 +17,7 @@ struct PitchEstimate {
 class ThetaFuser {
 public:
     // Configure complementary filter
-    ThetaFuser(double alpha=0.98) : alpha_(alpha), initialized_(false),
+    explicit ThetaFuser(double alpha=0.985) : alpha_(alpha), initialized_(false),
                                     theta_(0.0), bias_(0.0) {}
 
     // Call at startup when vehicle is stationary for 2–5 s using averaged gravity tilt
@@ -40,13 +42,15 @@ public:
 
     // Vision correction (from horizon/FOE/homography), conf in [0,1]
     void vision_update(double theta_vis_rad, double confidence) {
+        double c = clamp01(confidence);
+        if (c <= 0.0) return;   // no estimate
         if (!initialized_) { initialize_from_imu(theta_vis_rad); return; }
-        double a = std::pow(alpha_, (1.0 - clamp01(confidence))); // lower alpha when confidence high
+        double a = std::pow(alpha_, c); // lower alpha when confidence high, 1 (no change) at zero
         theta_ = a*theta_ + (1.0 - a)*theta_vis_rad;
     }
 
     // Optional: adapt gyro bias slowly when stationary (accel variance low)
-    void stationary_bias_learn(double gyro_pitch_rate_rad_s, double learn_rate=0.001) {
+    void stationary_bias_learn(double gyro_pitch_rate_rad_s, double learn_rate=0.002) {
         bias_ = (1.0 - learn_rate)*bias_ + learn_rate*gyro_pitch_rate_rad_s;
     }
 
@@ -68,63 +72,113 @@ inline cv::Point2f bbox_contact_point(const cv::Rect& box, int img_h, int extra_
     return {x, y};
 }
 
+// Distance and lateral offset of one ground contact point
+struct GroundPoint {
+    float d = 0.f;      // forward distance, m
+    float x = 0.f;      // lateral offset, m
+    bool ok = false;    // false above the horizon or for degenerate geometry
+};
+
 class GroundDistance {
 public:
-    GroundDistance(const CamIntrinsics& K, float cam_height_m)
-    : K_(K), H_(cam_height_m), cached_theta_(0.0), 
-      cached_sin_(0.0), cached_cos_(1.0), cached_H_cos_(cam_height_m) {}
+    // image_size enables the per-row distance and per-column lateral tables; without it
+    // every query takes the direct formula
+    GroundDistance(const CamIntrinsics& K, float cam_height_m, cv::Size image_size = cv::Size(),
+                   float minD=0.5f, float maxD=200.0f)
+    : K_(K), H_(cam_height_m), minD_(minD), maxD_(maxD), cached_theta_(0.0),
+      cached_sin_(0.0), cached_cos_(1.0), cached_H_cos_(cam_height_m),
+      row_D_(std::max(image_size.height, 0)), col_xn_(std::max(image_size.width, 0)), rows_valid_(false)
+    {
+        for (size_t c = 0; c < col_xn_.size(); ++c)
+            col_xn_[c] = (float(c) - K_.cx) / K_.fx;     // lateral scale doesn't depend on theta
+    }
 
-    // Call this ONCE per frame to precompute trig values
+    // Call this ONCE per frame to precompute trig values; the row table follows lazily
     void update_theta_cache(double theta_rad) {
         if (std::abs(theta_rad - cached_theta_) > 1e-6) {
             cached_theta_ = theta_rad;
             cached_sin_ = std::sin(theta_rad);
             cached_cos_ = std::cos(theta_rad);
             cached_H_cos_ = H_ * cached_cos_;  // Precompute this too
+            rows_valid_ = false;
         }
     }
 
-    // Optimized: No atan/tan calls, uses cached sin/cos values
-    // Formula: D = H*cos(θ) / (sin(θ) + yn*cos(θ))
-    // This is mathematically equivalent to D = H / tan(θ + atan(yn))
-    // but ~10-15x faster!
-    bool distance_from_pixel(const cv::Point2f& px,
-                             float& out_D_m, float& out_X_m,
-                             float minD=0.5f, float maxD=200.0f) const
+    // image row of the ground point at forward distance D, the inverse of distance_from_pixel;
+    // rows above the one for maxD can't hold road
+    float row_at_distance(float D) const {
+        return static_cast<float>(K_.cy + K_.fy * (H_ / D - cached_sin_ / cached_cos_));
+    }
+
+    // Formula: D = H*cos(θ) / (sin(θ) + yn*cos(θ)), equivalent to D = H / tan(θ + atan(yn)).
+    // For a fixed theta D only depends on the row, so integer pixels are a table lookup.
+    bool distance_from_pixel(const cv::Point2f& px, float& out_D_m, float& out_X_m) const
     {
-        // Normalize pixel coordinates
-        double yn = (px.y - K_.cy) / K_.fy;
-        double xn = (px.x - K_.cx) / K_.fx;
+        GroundPoint g = lookup(px);
+        out_D_m = g.d;
+        out_X_m = g.x;
+        return g.ok;
+    }
 
-        // Optimized denominator using cached values
-        double denom = cached_sin_ + yn * cached_cos_;
-        
-        if (denom <= 1e-4) return false; // invalid geometry
+    // Batch form for all contact points of a frame, out must hold px.size() entries
+    void distances(Span<const cv::Point2f> px, Span<GroundPoint> out) const
+    {
+        for (size_t i = 0; i < px.size() && i < out.size(); ++i)
+            out[i] = lookup(px[i]);
+    }
+
+private:
+    GroundPoint lookup(const cv::Point2f& px) const
+    {
+        int r = static_cast<int>(px.y);
+        int c = static_cast<int>(px.x);
+        if (r == px.y && c == px.x && r >= 0 && r < (int)row_D_.size() && c >= 0 && c < (int)col_xn_.size()) {
+            if (!rows_valid_)
+                rebuild_rows();
+            return finish(row_D_[r], col_xn_[c]);
+        }
+        return finish(raw_distance(px.y), (px.x - K_.cx) / K_.fx);
+    }
 
-        // Use precomputed H*cos(theta)
+    // unclamped D of a row, negative when the row is at or above the horizon
+    double raw_distance(float y) const
+    {
+        double yn = (y - K_.cy) / K_.fy;
+        double denom = cached_sin_ + yn * cached_cos_;
+        if (denom <= 1e-4) return -1.0; // invalid geometry
         double D = cached_H_cos_ / denom;
-        
-        if (!std::isfinite(D) || D < 0) return false;
+        return std::isfinite(D) ? D : -1.0;
+    }
 
-        // Lateral offset
+    GroundPoint finish(double D, double xn) const
+    {
+        GroundPoint g;
+        if (D < 0) return g;
+        // Lateral offset from the unclamped distance, then clamp to reasonable ranges
         double X = D * xn;
+        g.d = static_cast<float>(std::max<double>(minD_, std::min<double>(maxD_, D)));
+        g.x = static_cast<float>(std::max<double>(-50.0, std::min<double>(50.0, X)));
+        g.ok = true;
+        return g;
+    }
 
-        // Clamp to reasonable ranges
-        D = std::max<double>(minD, std::min<double>(maxD, D));
-        X = std::max<double>(-50.0, std::min<double>(50.0, X));
-
-        out_D_m = static_cast<float>(D);
-        out_X_m = static_cast<float>(X);
-        return true;
+    void rebuild_rows() const
+    {
+        for (size_t r = 0; r < row_D_.size(); ++r)
+            row_D_[r] = raw_distance(float(r));
+        rows_valid_ = true;
     }
 
-private:
     CamIntrinsics K_;
     float H_;
+    float minD_, maxD_;
     
     // Cached values for performance (updated once per frame)
-    mutable double cached_theta_;
-    mutable double cached_sin_;
-    mutable double cached_cos_;
-    mutable double cached_H_cos_;  // H * cos(theta)
-};
\ No newline at end of file
+    double cached_theta_;
+    double cached_sin_;
+    double cached_cos_;
+    double cached_H_cos_;  // H * cos(theta)
+    mutable std::vector<double> row_D_;    // raw_distance of each row at cached_theta_
+    std::vector<double> col_xn_;           // normalized x of each column
+    mutable bool rows_valid_;
+};
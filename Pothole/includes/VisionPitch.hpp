@@ -1,17 +1,106 @@
+/**
+ * @desc:   camera pitch from the focus of expansion. Corners are tracked with pyramidal LK on a
+ *          downscaled grayscale copy of the frame; under forward motion every flow vector points
+ *          away from the FOE, which sits on the horizon, so its row gives the pitch. Runs on its
+ *          own thread at a fraction of the frame rate and publishes the latest estimate through a
+ *          seqlock snapshot; the frame path only pays for the downscale of the frames it hands over.
+ */
 #pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/cuda.hpp>
+#include "DistanceEstimator.hpp"
+#include "bounded_queue.h"
 
 struct VisionPitchOut {
-    double theta_vis_rad;
-    double confidence; // 0..1
+    double theta_vis_rad = 0.0;
+    double confidence = 0.0;    // 0..1, 0 when there is no estimate (vehicle stopped, too few tracks)
+    double cpu_ms = 0.0;        // thread CPU time spent on this estimate
+    uint64_t id = 0;            // increases with every published estimate, 0 before the first
+};
+
+struct VisionPitchStats {
+    uint64_t estimates = 0;     // frames estimated
+    uint64_t confident = 0;     // estimates with a non-zero confidence
+    uint64_t skipped = 0;       // frames dropped because the worker was still busy
+    double mean_cpu_ms = 0.0;
+    double max_cpu_ms = 0.0;
 };
 
 class VisionPitch {
 public:
-    VisionPitch() {}
+    /**
+     * @param K         intrinsics of the full-resolution frames passed to offer()
+     * @param rate_hz   estimates per second at most, frames offered in between are ignored
+     * @param width     width of the downscaled grayscale frames the flow is computed on
+     */
+    explicit VisionPitch(const CamIntrinsics &K, double rate_hz = 5.0, int width = 320);
+    ~VisionPitch();
+    VisionPitch(const VisionPitch&) = delete;
+    VisionPitch& operator=(const VisionPitch&) = delete;
+
+    /**
+     * @brief hand a frame to the worker if the rate allows; never blocks. Only accepted frames are
+     *        downscaled here, device frames on the GPU when OpenCV has cudawarping.
+     * @return true if the frame was accepted
+     */
+    bool offer(const cv::Mat &bgr, std::chrono::steady_clock::time_point t);
+    bool offer(const cv::cuda::GpuMat &bgr, std::chrono::steady_clock::time_point t);
+
+    /**
+     * @brief latest published estimate, lock-free; compare id to detect a new one
+     */
+    VisionPitchOut latest() const;
+
+    VisionPitchStats stats() const;
+
+    /**
+     * @brief synchronous estimate against the previously estimated frame, for offline use without
+     *        the worker. Frames are full-resolution BGR or gray.
+     */
+    VisionPitchOut estimate(const cv::Mat &frame);
 
-    // TODO: implement FOE/vanishing/homography. Placeholder returns no update.
-    VisionPitchOut estimate(const cv::Mat& undistorted_bgr) {
-        return {0.0, 0.0}; // confidence 0 -> ignored by fuser
-    }
-};
\ No newline at end of file
+private:
+    struct Job {
+        cv::Mat gray;
+        double scale;           // gray width over the full-resolution width
+        std::chrono::steady_clock::time_point t;
+    };
+
+    bool due(std::chrono::steady_clock::time_point t);
+    void submit(cv::Mat &&small, double scale, std::chrono::steady_clock::time_point t);
+    VisionPitchOut estimateGray(const cv::Mat &gray, double scale);
+    void run();
+    void publish(const VisionPitchOut &out);
+    bool solveFoe(const std::vector<cv::Point2f> &p, const std::vector<cv::Point2f> &v,
+                  cv::Point2f &foe, int &inliers);
+
+    CamIntrinsics K;
+    int width;
+    std::chrono::nanoseconds period;
+    std::chrono::steady_clock::time_point next_due{};
+    BoundedQueue<Job> jobs;
+    std::thread worker;
+
+    // worker state
+    cv::Mat prev_gray;
+    std::vector<cv::Point2f> prev_pts, next_pts;
+    std::vector<cv::Point2f> flow_pts, flow_vec;    // midpoints and displacements of moving tracks
+    std::vector<uchar> status;
+    std::vector<float> err;
+    cv::RNG rng;
+    uint64_t seq = 0;
+
+    // seqlock snapshot, odd version while the worker writes
+    std::atomic<uint64_t> version{0};
+    std::atomic<double> snap_theta{0.0}, snap_conf{0.0}, snap_cpu{0.0};
+    std::atomic<uint64_t> snap_id{0};
+
+    std::atomic<uint64_t> estimates{0}, confident{0};
+    std::atomic<double> cpu_total{0.0}, cpu_max{0.0};
+};
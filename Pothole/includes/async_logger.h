@@ -0,0 +1,156 @@
+/**
+ * @desc:   process-wide asynchronous logger. A message is formatted on the calling thread into a
+ *          fixed thread-local line, then copied into that thread's lock-free ring; one background
+ *          thread drains the rings, stamps and writes the lines to stdout (info, verbose) or stderr
+ *          (warnings, errors). Logging never takes a lock or waits on the console: a full ring
+ *          drops the line and counts it. Lines below the threshold cost one atomic load and are
+ *          never formatted, and PLOG_EVERY limits a call site to a number of lines per second.
+ *
+ *          PLOG(Severity::kWARNING) << "NVDEC: pool exhausted";
+ *          PLOG_EVERY(Severity::kERROR, 1) << "Collect: unknown ticket " << ticket;
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+#include "NvInferRuntimeCommon.h"
+#include "lockfree_ring.h"
+
+class AsyncLogger
+{
+public:
+    using Severity = nvinfer1::ILogger::Severity;
+
+    static constexpr size_t kLineBytes = 496;      // longer lines are truncated
+    static constexpr size_t kRingLines = 256;      // per thread
+
+    static AsyncLogger &instance();
+    ~AsyncLogger();
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    bool enabled(Severity severity) const
+    {
+        return int(severity) <= threshold.load(std::memory_order_relaxed);
+    }
+    void setThreshold(Severity severity) { threshold.store(int(severity), std::memory_order_relaxed); }
+
+    /**
+     * @brief queue one line (a trailing newline is dropped) on the calling thread's ring; never
+     *        blocks, drops the line if the ring is full. Does not check the threshold.
+     */
+    void write(Severity severity, const char *text, size_t length);
+
+    /**
+     * @brief wait until every line queued before the call is written, e.g. before a summary printed
+     *        with std::cout
+     */
+    void flush();
+
+    uint64_t written() const { return writtenCount.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+    uint64_t suppressed() const { return suppressedCount.load(std::memory_order_relaxed); }
+    void addSuppressed(uint32_t lines) { suppressedCount.fetch_add(lines, std::memory_order_relaxed); }
+
+private:
+    struct Record {
+        int64_t t_ns;           // system clock
+        Severity severity;
+        uint16_t length;
+        char text[kLineBytes];
+    };
+    struct ThreadRing {
+        LockFreeRing<Record> ring{kRingLines};
+        std::atomic<bool> retired{false};   // its thread exited, removed once drained
+    };
+
+    AsyncLogger();
+    ThreadRing &localRing();
+    void run();
+    size_t drain(std::vector<std::shared_ptr<ThreadRing>> &rings);
+    static void emit(const Record &record);
+
+    std::atomic<int> threshold;
+    std::mutex ringsMutex;                  // a thread's first line registers its ring
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    std::mutex wakeMutex;
+    std::condition_variable wake, drained;
+    std::atomic<uint64_t> queuedCount{0}, handledCount{0};
+    std::atomic<uint64_t> writtenCount{0}, droppedCount{0}, suppressedCount{0};
+    std::atomic<bool> stop{false};
+    std::thread writer;
+};
+
+/**
+ * @brief per call site rate limit, a static of the PLOG_EVERY expansion. The first line of a
+ *        second that gets through reports how many the site suppressed before it.
+ */
+class LogSite
+{
+public:
+    explicit LogSite(uint32_t per_second) : perSecond(per_second == 0 ? 1 : per_second) {}
+
+    /**
+     * @return 0 if the line is suppressed, else 1 + the lines suppressed since the last admitted one
+     */
+    uint32_t admit();
+
+private:
+    const uint32_t perSecond;
+    std::atomic<int64_t> window{-1};        // current second on the steady clock
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> suppressed{0};
+};
+
+/**
+ * @brief formats one line into the calling thread's fixed buffer, queued on destruction. Not
+ *        reentrant: don't log from an operator<< of a logged value.
+ */
+class LogLine
+{
+public:
+    // suppressed_before > 0 prefixes the line with the count
+    explicit LogLine(AsyncLogger::Severity severity, uint32_t suppressed_before = 0);
+    ~LogLine();
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    std::ostream &stream() { return out; }
+
+private:
+    class Buffer : public std::streambuf {
+    public:
+        void reset() { setp(data, data + sizeof(data)); }
+        const char *begin() const { return pbase(); }
+        size_t size() const { return size_t(pptr() - pbase()); }
+    protected:
+        int sync() override { return 0; }   // std::endl must not reach the console from here
+    private:
+        char data[AsyncLogger::kLineBytes];
+    };
+    struct LocalStream {
+        Buffer buffer;
+        std::ostream stream{&buffer};
+    };
+    static LocalStream &local();
+
+    AsyncLogger::Severity severity;
+    std::ostream &out;
+};
+
+// the operands are only evaluated when the line is logged
+#define PLOG(severity) \
+    if (!AsyncLogger::instance().enabled(severity)) ; else LogLine(severity).stream()
+
+#define PLOG_EVERY(severity, per_second) \
+    if (!AsyncLogger::instance().enabled(severity)) ; else \
+    if (static LogSite plog_site_(per_second); false) ; else \
+    if (uint32_t plog_admit_ = plog_site_.admit(); plog_admit_ == 0) ; else LogLine(severity, plog_admit_ - 1).stream()
@@ -0,0 +1,220 @@
+/**
+ * @desc:   gathers the frames of several camera streams into inference batches. Every stream has its
+ *          own bounded FIFO with the BoundedQueue overflow policies (one producer thread per stream);
+ *          the consumer takes the oldest frames across streams, up to the engine's batch, as soon as
+ *          the batch is full, every open stream has a frame waiting, or the oldest frame has waited
+ *          the latency deadline. Frames that skip the detector travel in order with the others but
+ *          take no batch slot. Each stream's frames leave in the order they were pushed. A stream
+ *          can be detached (the batch stops waiting for it, e.g. while it runs on another scheduler)
+ *          and attached again; the consumer ends once every stream has finished.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "bounded_queue.h"
+
+template<typename T>
+class BatchScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @param streams       producers, numbered 0..streams-1
+     * @param capacity      frames buffered per stream
+     * @param max_batch     batch slots per inference
+     * @param deadline      longest a frame waits for others to share its batch
+     */
+    BatchScheduler(int streams, size_t capacity, QueuePolicy policy, int max_batch, Clock::duration deadline)
+        : capacity(capacity == 0 ? 1 : capacity), policy(policy), maxBatch(std::max(1, max_batch)),
+          deadline(deadline), lanes(std::max(1, streams)) {}
+    BatchScheduler(const BatchScheduler&) = delete;
+    BatchScheduler& operator=(const BatchScheduler&) = delete;
+
+    /**
+     * @brief enqueue a frame of a stream, applying the overflow policy to that stream's FIFO.
+     * @param needs_slot    false for frames that don't go through the detector
+     * @return false if the scheduler has been closed and the frame was discarded.
+     */
+    bool push(int stream, T &&item, bool needs_slot = true)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        Lane &lane = lanes[stream];
+        if (policy == QueuePolicy::kBlock)
+            notFull.wait(lock, [&] { return closed || lane.items.size() < capacity; });
+        if (closed)
+            return false;
+        while (lane.items.size() >= capacity) {
+            pendingSlots -= lane.items.front().needsSlot ? 1 : 0;
+            lane.items.pop_front();
+            --pending;
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        lane.items.push_back({std::move(item), Clock::now(), needs_slot});
+        ++pending;
+        pendingSlots += needs_slot ? 1 : 0;
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief a stream has no more frames; the others no longer wait for it.
+     */
+    void finish(int stream)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (lanes[stream].finished)
+                return;
+            lanes[stream].finished = true;
+            lanes[stream].attached = false;
+            ++finishedStreams;
+        }
+        notEmpty.notify_all();
+    }
+
+    /**
+     * @brief stop or start waiting for a stream's frames when forming a batch; streams start attached.
+     *        Frames already pushed are still delivered.
+     */
+    void detach(int stream)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            lanes[stream].attached = false;
+        }
+        notEmpty.notify_all();
+    }
+
+    void attach(int stream)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lanes[stream].attached = !lanes[stream].finished;
+    }
+
+    /**
+     * @brief wait for the next batch: at most max_batch frames needing a slot, plus the slot-free
+     *        frames queued between them.
+     * @return false once every stream has finished (or the scheduler is closed) and all are drained.
+     */
+    bool popBatch(std::vector<T> &batch)
+    {
+        batch.clear();
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || pending > 0 || finishedStreams == lanes.size(); });
+        if (pending == 0)
+            return false;
+        if (!closed && !ready()) {
+            Clock::time_point due = oldest()->items.front().arrived + deadline;
+            notEmpty.wait_until(lock, due, [this] { return closed || ready(); });
+        }
+
+        int slots = 0;
+        while (pending > 0) {
+            Lane *lane = oldest();
+            if (lane->items.front().needsSlot) {
+                if (slots == maxBatch)
+                    break;
+                ++slots;
+                --pendingSlots;
+            }
+            batch.push_back(std::move(lane->items.front().value));
+            lane->items.pop_front();
+            --pending;
+        }
+        lock.unlock();
+        notFull.notify_all();
+        if (slots > 0) {
+            batchCount.fetch_add(1, std::memory_order_relaxed);
+            slotCount.fetch_add(uint64_t(slots), std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    /**
+     * @brief wake up every producer and the consumer; pending frames can still be popped.
+     */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending;
+    }
+
+    uint64_t dropped() const
+    {
+        return droppedCount.load(std::memory_order_relaxed);
+    }
+
+    // detector frames per batch that had any, 0 before the first
+    double meanBatch() const
+    {
+        uint64_t batches = batchCount.load(std::memory_order_relaxed);
+        return batches ? double(slotCount.load(std::memory_order_relaxed)) / batches : 0.0;
+    }
+
+private:
+    struct Entry {
+        T value;
+        Clock::time_point arrived;
+        bool needsSlot;
+    };
+    struct Lane {
+        std::deque<Entry> items;
+        bool attached = true;   // batches wait for this stream
+        bool finished = false;
+    };
+
+    // dispatch now: waiting can't grow the batch, or nothing waiting needs the detector
+    bool ready() const
+    {
+        if (pendingSlots == 0 || pendingSlots >= size_t(maxBatch))
+            return true;
+        for (const Lane &lane : lanes)
+            if (lane.attached && lane.items.empty())
+                return false;
+        return true;
+    }
+
+    // the stream whose next frame arrived first, pending must be > 0
+    Lane *oldest()
+    {
+        Lane *best = nullptr;
+        for (Lane &lane : lanes)
+            if (!lane.items.empty() && (!best || lane.items.front().arrived < best->items.front().arrived))
+                best = &lane;
+        return best;
+    }
+
+    const size_t capacity;
+    const QueuePolicy policy;
+    const int maxBatch;
+    const Clock::duration deadline;
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+    std::vector<Lane> lanes;
+    size_t pending = 0;         // frames over all lanes
+    size_t pendingSlots = 0;    // of which need the detector
+    size_t finishedStreams = 0;
+    bool closed = false;
+    std::atomic<uint64_t> droppedCount{0};
+    std::atomic<uint64_t> batchCount{0}, slotCount{0};
+};
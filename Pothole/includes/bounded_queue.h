@@ -0,0 +1,115 @@
+/**
+ * @desc:   bounded FIFO connecting two pipeline stages (one producer thread, one consumer thread).
+ *          When full, push() either waits for the consumer (offline files, every frame counts)
+ *          or evicts the oldest element (live cameras, latency matters more than completeness).
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+enum class QueuePolicy {
+    kBlock,         // producer waits while the queue is full
+    kDropOldest     // producer evicts the oldest element while the queue is full
+};
+
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity, QueuePolicy policy = QueuePolicy::kBlock)
+        : capacity(capacity == 0 ? 1 : capacity), policy(policy) {}
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief enqueue an element, applying the overflow policy.
+     * @return false if the queue has been closed and the element was discarded.
+     */
+    bool push(T &&item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (policy == QueuePolicy::kBlock)
+            notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        while (items.size() >= capacity) {
+            items.pop_front();
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        items.push_back(std::move(item));
+        lock.unlock();
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief dequeue the oldest element, waiting until one is available.
+     * @return false once the queue is closed and drained.
+     */
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief dequeue the oldest element if there is one, never waits.
+     * @return false if the queue is empty.
+     */
+    bool tryPop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief wake up both sides; pending elements can still be popped.
+     */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+    uint64_t dropped() const
+    {
+        return droppedCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    const size_t capacity;
+    const QueuePolicy policy;
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty, notFull;
+    std::deque<T> items;
+    bool closed = false;
+    std::atomic<uint64_t> droppedCount{0};
+};
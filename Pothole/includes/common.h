@@ -22,13 +22,14 @@ constexpr long long int operator"" _KiB(long long unsigned int val) {
     return val * (1 << 10);
 }
 
-// Global loggers
-static Logger gLogger{Logger::Severity::kINFO};
-static LogStreamConsumer gLogVerbose{LOG_VERBOSE(gLogger)};
-static LogStreamConsumer gLogInfo{LOG_INFO(gLogger)};
-static LogStreamConsumer gLogWarning{LOG_WARN(gLogger)};
-static LogStreamConsumer gLogError{LOG_ERROR(gLogger)};
-static LogStreamConsumer gLogFatal{LOG_FATAL(gLogger)};
+// Global loggers (defined in common.cpp), they all write through the AsyncLogger. The streams are
+// per thread so no two threads share a message buffer; its threshold decides what gets logged.
+extern Logger gLogger;
+extern thread_local LogStreamConsumer gLogVerbose;
+extern thread_local LogStreamConsumer gLogInfo;
+extern thread_local LogStreamConsumer gLogWarning;
+extern thread_local LogStreamConsumer gLogError;
+extern thread_local LogStreamConsumer gLogFatal;
 
 // TensorRT utility functions
 inline unsigned int getElementSize(nvinfer1::DataType t)
@@ -0,0 +1,54 @@
+/**
+ * @desc:   adaptive detection cadence. On smooth stretches the detector only runs on keyframes and
+ *          SORT coasts the tracks on their Kalman predictions in between; the keyframe rate goes back
+ *          up as soon as tracks get uncertain, move fast across the image or new objects show up.
+ */
+#pragma once
+
+#include <atomic>
+#include "sort.h"
+
+class DetectionCadence {
+public:
+    /**
+     * @param max_interval  largest number of frames per keyframe, 1 runs the detector on every frame
+     * @param sigma_limit   a confirmed track's centre standard deviation, in box widths, that forces
+     *                      the next keyframe
+     * @param flow_budget   box widths a confirmed track may move between keyframes, caps the interval
+     *                      for fast image motion (the ego speed as the camera sees it)
+     */
+    explicit DetectionCadence(int max_interval = 1, float sigma_limit = 0.15f, float flow_budget = 1.0f);
+
+    /**
+     * @brief capture side: whether the next frame goes through the detector, called once per frame in order
+     */
+    bool nextIsKeyframe();
+
+    /**
+     * @brief tracking side: a keyframe went through Sort::update(); new, tentative or missed tracks
+     *        drop back to detecting every frame, otherwise the interval grows by one up to the flow cap
+     */
+    void onKeyframe(const sort::TrackStats &stats);
+
+    /**
+     * @brief tracking side: a frame went through Sort::coast(); a track past sigma_limit
+     *        requests a keyframe right away
+     */
+    void onCoast(const sort::TrackStats &stats);
+
+    /**
+     * @brief back to detecting every frame, e.g. when the tracker is reset
+     */
+    void reset();
+
+    int interval() const { return current.load(std::memory_order_relaxed); }
+    bool enabled() const { return max_interval > 1; }
+
+private:
+    int max_interval;
+    float sigma_limit;
+    float flow_budget;
+    std::atomic<int> current{1};
+    std::atomic<bool> force{false};
+    int since_keyframe = 0;     // capture side only
+};
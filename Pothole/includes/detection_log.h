@@ -0,0 +1,97 @@
+/**
+ * @desc:   compact binary log of the detector output, for replaying the post-inference pipeline
+ *          (SORT, ground distance, publishing) without video or TensorRT. The file is a fixed header
+ *          followed by one record per frame: a 32-byte frame record and its boxes, 24 bytes each.
+ *          Everything is little-endian and 8-byte aligned, so a reader maps the file and walks it in
+ *          place. A log cut short by a crash ends at its last complete frame.
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "model.h"
+#include "span.h"
+
+struct DetectionLogHeader {
+    char magic[4] = {'P', 'D', 'E', 'T'};
+    uint32_t version = 1;
+    int32_t width = 0;          // frame size the boxes refer to
+    int32_t height = 0;
+    float fx = 0.f, fy = 0.f, cx = 0.f, cy = 0.f;   // intrinsics at that size
+    float camera_height = 0.f;  // m
+    uint32_t reserved[7] = {};
+};
+static_assert(sizeof(DetectionLogHeader) == 64, "log header layout");
+
+struct DetectionLogFrame {
+    static constexpr uint32_t kKeyframe = 1;    // the detector ran, otherwise SORT coasted
+
+    int64_t t_ns = 0;           // capture time since the first logged frame
+    double theta = 0.0;         // fused pitch the distances were computed with, rad
+    int32_t epoch = 0;          // bumped when the video looped (tracker reset)
+    int32_t frame_num = 0;
+    uint32_t flags = 0;
+    uint32_t count = 0;         // boxes following the record
+};
+static_assert(sizeof(DetectionLogFrame) == 32, "log frame layout");
+
+struct DetectionLogBox {
+    int32_t classes;
+    float prob;
+    float x, y, w, h;           // centre and size, frame pixels
+};
+static_assert(sizeof(DetectionLogBox) == 24, "log box layout");
+
+/**
+ * @brief appends frames through a large stdio buffer; one fwrite pair per frame
+ */
+class DetectionLogWriter {
+public:
+    DetectionLogWriter(const std::string &path, const DetectionLogHeader &header);
+    ~DetectionLogWriter();
+    DetectionLogWriter(const DetectionLogWriter&) = delete;
+    DetectionLogWriter& operator=(const DetectionLogWriter&) = delete;
+
+    bool isOpened() const { return file != nullptr; }
+    // after the first short write (disk full) the rest of the run is not logged
+    void append(const DetectionLogFrame &frame, Span<const DetectRes> detections);
+    bool failed() const { return write_failed; }
+    uint64_t frames() const { return frame_count; }
+
+private:
+    std::string path;
+    std::FILE *file = nullptr;
+    bool write_failed = false;
+    std::vector<char> buffer;
+    std::vector<DetectionLogBox> boxes;
+    uint64_t frame_count = 0;
+};
+
+/**
+ * @brief read-only memory map of a log, walked frame by frame without copies
+ */
+class DetectionLogReader {
+public:
+    explicit DetectionLogReader(const std::string &path);
+    ~DetectionLogReader();
+    DetectionLogReader(const DetectionLogReader&) = delete;
+    DetectionLogReader& operator=(const DetectionLogReader&) = delete;
+
+    bool isOpened() const { return data != nullptr; }
+    const DetectionLogHeader &header() const { return *reinterpret_cast<const DetectionLogHeader *>(data); }
+    size_t bytes() const { return size; }
+
+    /**
+     * @brief the next frame and its boxes, which point into the mapping
+     * @return false at the end of the log
+     */
+    bool next(const DetectionLogFrame *&frame, Span<const DetectionLogBox> &boxes);
+    void rewind() { offset = sizeof(DetectionLogHeader); }
+
+private:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    size_t offset = 0;
+};
@@ -0,0 +1,83 @@
+/**
+ * @desc:   real-time publisher of per-frame pothole distances to the notification server.
+ *          Producers only copy a fixed-size frame record into a lock-free ring; one background
+ *          thread drains it, coalesces several frames per POST and drives a small pool of
+ *          keep-alive connections through a curl_multi handle. Nothing on the producer side
+ *          blocks, allocates or touches the network.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <curl/curl.h>  // apt install libcurl4-openssl-dev
+#include "lockfree_ring.h"
+#include "span.h"
+#include "wire_format.h"
+
+struct StreamerStats {
+    uint64_t sent = 0;      // frames acknowledged with a 2xx
+    uint64_t failed = 0;    // frames of requests that timed out, failed or got a non-2xx
+    uint64_t dropped = 0;   // frames evicted from the full queue before being sent
+    uint64_t inFlight = 0;  // frames of requests currently on the wire
+    uint64_t queued = 0;    // frames waiting in the queue
+};
+
+class RealtimeDistanceStreamer {
+public:
+    /**
+     * @param endpoint_url          POST target
+     * @param queue_frames          frames buffered while the server is slow, the oldest are dropped beyond
+     * @param frames_per_request    maximal frames coalesced into one POST
+     * @param requests_in_flight    concurrent requests, each on its own persistent connection
+     * @param format                request body encoding, announced in the Content-Type header
+     */
+    explicit RealtimeDistanceStreamer(const std::string& endpoint_url = "http://localhost:5000/webhook",
+                                      size_t queue_frames = 256, int frames_per_request = 16,
+                                      int requests_in_flight = 2, WireFormat format = WireFormat::kJson);
+    ~RealtimeDistanceStreamer();
+    RealtimeDistanceStreamer(const RealtimeDistanceStreamer&) = delete;
+    RealtimeDistanceStreamer& operator=(const RealtimeDistanceStreamer&) = delete;
+
+    /**
+     * @brief queue one frame of tracked distances for publishing, never blocks.
+     * @param detections    (track id, (distance m, lateral m))
+     * @param sizes         (track id, (size m^2, unused)), matched to detections by index
+     */
+    void send_batch(const std::vector<std::pair<int, std::pair<float, float>>>& detections, int frame_num,
+                    double theta_deg, const std::vector<std::pair<int, std::pair<float, float>>>& sizes = {});
+
+    /**
+     * @brief queue track events for publishing, each as its own single-track frame so the server
+     *        sees one pothole per message; never blocks.
+     */
+    void send_events(Span<const StreamedTrack> events, int frame_num, double theta_deg);
+
+    StreamerStats stats() const;
+
+private:
+    struct Request {
+        CURL* easy = nullptr;
+        std::string body;       // reused between POSTs
+        uint64_t frames = 0;
+        bool busy = false;
+    };
+
+    void enqueue(const StreamedFrame& frame);
+    void run();
+    int fillRequest(Request& request);
+
+    std::string endpoint_;
+    int framesPerRequest_;
+    BatchEncoder encoder_;
+    LockFreeRing<StreamedFrame> ring_;
+    CURLM* multi_ = nullptr;
+    curl_slist* headers_ = nullptr;
+    std::vector<Request> requests_;
+    std::atomic<bool> stop_{false};
+    std::atomic<uint64_t> sent_{0}, failed_{0}, dropped_{0}, inFlight_{0}, queued_{0};
+    std::thread worker_;
+};
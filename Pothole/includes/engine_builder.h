@@ -0,0 +1,96 @@
+/**
+ * @desc:   in-process TensorRT engine builder and plan cache. Builds reuse a persisted timing cache
+ *          and get one optimization profile over the dynamic axes of the input. Plans are written
+ *          behind a small header holding the key they were built for (GPU, compute capability,
+ *          TensorRT version, ONNX and build option hashes), so a node never loads a plan built for
+ *          other hardware, and nodes with the same GPU and TensorRT share cached plans by key.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "NvInfer.h"
+
+struct EngineBuildOptions {
+    std::string onnx_file;
+    uint64_t onnx_hash = 0;         // hashFile(onnx_file) when the caller already has it, 0 to hash here
+    std::string timing_cache;       // read before and written after every build, empty for none
+    size_t workspace = 1ULL << 30;  // bytes
+    bool fp16 = true;
+    // post-training INT8 (with FP16 fallback), calibrated on frames sampled from a video or image
+    // directory; a calibration cache from an earlier build replaces the frames
+    bool int8 = false;
+    std::string calibration_source;
+    std::string calibration_cache;
+    int calibration_frames = 500;
+    // optimization profile of the input; only axes the ONNX leaves dynamic use these; 0 heights
+    // default to max_height / 4 (min) and max_height / 2 (opt), on the 32-row stride
+    int min_batch = 1, opt_batch = 1, max_batch = 1;
+    int min_height = 0, opt_height = 0, max_height = 640;
+    int width = 640;
+    int channels = 3;
+};
+
+struct EngineKey {
+    std::string gpu;        // device name
+    int sm = 0;             // compute capability, major * 10 + minor
+    int32_t trt = 0;        // getInferLibVersion() of the runtime
+    uint64_t onnx = 0;      // content hash of the ONNX, 0 when unknown
+    uint64_t options = 0;   // hash of the build options that change the plan
+
+    // gpu, sm and trt of this process and device, no model part
+    static EngineKey current(int device = 0);
+
+    /**
+     * @brief why a plan built for this key can't be used where expected was computed, empty if it can
+     * @param match_model   also require the same ONNX and build options
+     */
+    std::string mismatch(const EngineKey &expected, bool match_model) const;
+
+    // file-name safe, e.g. nvidia_geforce_rtx_4050-sm89-trt100300-1f2e...-9a0b...
+    std::string str() const;
+};
+
+uint64_t hashFile(const std::string &path);     // 0 when unreadable
+uint64_t hashOptions(const EngineBuildOptions &options);
+EngineKey engineKey(const EngineBuildOptions &options, int device = 0);
+
+// <dir>/<onnx stem>-<key>.plan
+std::string cachedEnginePath(const std::string &dir, const EngineBuildOptions &options, const EngineKey &key);
+
+/**
+ * @brief parse, configure and build; logs and returns null on failure
+ */
+std::unique_ptr<nvinfer1::IHostMemory> buildSerializedEngine(const EngineBuildOptions &options);
+
+/**
+ * @brief write key header + plan to a temporary file and rename it over path, so readers on
+ *        other processes or nodes never see a partial plan
+ */
+bool writeEnginePlan(const std::string &path, const EngineKey &key, const void *plan, size_t size);
+
+/**
+ * @brief read-only mapping of a plan file, either written by writeEnginePlan or a bare plan
+ *        (e.g. from trtexec) without a key
+ */
+class EnginePlanFile {
+public:
+    explicit EnginePlanFile(const std::string &path);
+    ~EnginePlanFile();
+    EnginePlanFile(const EnginePlanFile&) = delete;
+    EnginePlanFile& operator=(const EnginePlanFile&) = delete;
+
+    bool isOpened() const { return data != nullptr; }
+    bool tagged() const { return has_key; }
+    const EngineKey &key() const { return plan_key; }
+    const void *plan() const { return data + plan_offset; }
+    size_t planSize() const { return size - plan_offset; }
+
+private:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    size_t plan_offset = 0;
+    bool has_key = false;
+    EngineKey plan_key;
+};
@@ -0,0 +1,32 @@
+#ifndef TRACKER_HOST_DECODE_H
+#define TRACKER_HOST_DECODE_H
+
+#include "model.h"
+
+/**
+ * @brief Vectorized host decode of one image of a YOLOv11 output tensor [num_classes + 4, num_anchors].
+ *        Compares the per-anchor maximum class score 8 lanes at a time (AVX2 when the CPU has it,
+ *        NEON on aarch64, scalar otherwise) and only gathers, argmaxes and scales the anchors that
+ *        pass obj_threshold.
+ * @param output        channel-first output of one image
+ * @param num_anchors   anchors per image, from the engine's output shape
+ * @param num_classes   class channels following the 4 box channels
+ * @param obj_threshold minimal class score
+ * @param ratio         network-to-frame scale applied to x, y, w, h
+ * @param results       preallocated result buffer
+ * @param capacity      size of results, anchors beyond it are dropped
+ * @return number of detections written to results
+ */
+int decodeYoloOutputHost(const float *output, int num_anchors, int num_classes, float obj_threshold,
+                         float ratio, DetectRes *results, int capacity);
+
+/**
+ * @brief Host counterpart of letterboxBgrToTensor (the CPU preprocess path): resize one BGR frame by
+ *        min(width / cols, height / rows), anchor it top-left, pad with zeros, scale by 1/255 and write
+ *        it as a planar R, G, B tensor.
+ * @param src       8-bit BGR frame
+ * @param chw       3 * width * height floats
+ */
+void letterboxBgrToTensorHost(const cv::Mat &src, float *chw, int width, int height);
+
+#endif //TRACKER_HOST_DECODE_H
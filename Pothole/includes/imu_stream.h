@@ -0,0 +1,95 @@
+/**
+ * @desc:   background IMU ingestion for the pitch fuser. A reader thread parses 200-1000 Hz
+ *          gyro/accel samples from a device, FIFO or recorded file, stamps them on the host's
+ *          steady clock and pushes them into a lock-free ring. The track stage then integrates
+ *          exactly the samples between two frame timestamps and reads a stationary flag from
+ *          the recent accel/gyro variance, without ever touching the IMU itself.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lockfree_ring.h"
+
+/**
+ * @brief one IMU sample in camera axes: x right, y down, z forward
+ */
+struct ImuSample {
+    int64_t t_ns = 0;           // host steady_clock time
+    float gx = 0.f, gy = 0.f, gz = 0.f;     // angular rate, rad/s
+    float ax = 0.f, ay = 0.f, az = 0.f;     // specific force, m/s^2 (reads +g upwards at rest)
+};
+
+/**
+ * @brief IMU motion between two frames, the input of one ThetaFuser step
+ */
+struct ImuInterval {
+    double dt = 0.0;            // covered time, s
+    double pitch_rate = 0.0;    // mean pitch rate, rad/s, positive pitching down
+    int samples = 0;            // samples consumed
+    bool stationary = false;    // gyro and accel quiet over the trailing window
+    bool accel_reliable = false;    // window mean accel magnitude close to g
+    double gravity_pitch = 0.0; // pitch from the trailing window's mean accel, rad
+};
+
+struct ImuStats {
+    uint64_t received = 0;      // samples parsed
+    uint64_t dropped = 0;       // samples evicted from the full ring
+    uint64_t malformed = 0;     // lines that didn't parse
+};
+
+class ImuStream {
+public:
+    /**
+     * @param path      character device, FIFO or file with one sample per line:
+     *                  "t_s,gx,gy,gz,ax,ay,az" (device clock) or "gx,gy,gz,ax,ay,az" (stamped on arrival).
+     *                  Device timestamps are mapped to the host clock by the smallest arrival offset seen.
+     *                  Regular files are replayed in real time from their first sample, with
+     *                  back-pressure instead of dropping samples.
+     * @param ring_samples  samples buffered between the reader and the track stage
+     * @param window        trailing samples of the stationary detector
+     */
+    explicit ImuStream(const std::string &path, size_t ring_samples = 4096, int window = 200);
+    ~ImuStream();
+    ImuStream(const ImuStream&) = delete;
+    ImuStream& operator=(const ImuStream&) = delete;
+
+    bool isOpened() const { return fd >= 0; }
+
+    /**
+     * @brief consume the samples up to t and integrate the pitch rate over (previous t, t],
+     *        linearly between samples and holding the newest one past it. Single consumer.
+     */
+    ImuInterval advance(std::chrono::steady_clock::time_point t);
+
+    ImuStats stats() const;
+
+private:
+    void run();
+    bool parseLine(const char *line, ImuSample &sample);
+    void observe(const ImuSample &sample);
+    static double pitchRate(const ImuSample &s) { return -s.gx; }  // rotation about x, z (forward) turning down
+
+    int fd = -1;
+    bool replay = false;        // regular file, paced and pushed with back-pressure
+    LockFreeRing<ImuSample> ring;
+    std::thread reader;
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> received{0}, dropped{0}, malformed{0};
+    int64_t clock_offset_ns = INT64_MAX;    // host minus device time, reader side
+
+    // consumer side
+    bool have_cursor = false;
+    int64_t cursor_ns = 0;      // end of the last integrated interval
+    bool have_last = false;
+    ImuSample last;            // newest consumed sample
+    bool have_pending = false;
+    ImuSample pending;          // popped, but newer than the frame being integrated
+    std::vector<ImuSample> window_samples;  // circular, stationary detector
+    size_t window_next = 0;
+    size_t window_full = 0;
+};
@@ -0,0 +1,50 @@
+/**
+ * @desc:   INT8 post-training calibration from real footage. Frames are sampled evenly across a video
+ *          or an image directory, letterboxed exactly like the CPU preprocess path and handed to
+ *          TensorRT's entropy calibrator in batches. The computed scales are persisted in a
+ *          calibration cache, so rebuilding (e.g. on another node of the same GPU) skips calibration.
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "NvInfer.h"
+
+class FrameCalibrator : public nvinfer1::IInt8EntropyCalibrator2 {
+public:
+    /**
+     * @param source        video file or image directory, empty to calibrate from the cache only
+     * @param cache_file    calibration cache, read when present and written after calibration
+     * @param batch         images per calibration batch, the calibration profile's batch
+     * @param width         network input size
+     * @param max_frames    frames sampled evenly from the source
+     */
+    FrameCalibrator(const std::string &source, const std::string &cache_file, int batch, int width, int height,
+                    int max_frames = 500);
+    ~FrameCalibrator() override;
+    FrameCalibrator(const FrameCalibrator&) = delete;
+    FrameCalibrator& operator=(const FrameCalibrator&) = delete;
+
+    int32_t getBatchSize() const noexcept override { return batch; }
+    bool getBatch(void *bindings[], const char *names[], int32_t nbBindings) noexcept override;
+    const void *readCalibrationCache(size_t &length) noexcept override;
+    void writeCalibrationCache(const void *cache, size_t length) noexcept override;
+
+    int framesUsed() const { return frames_used; }
+
+private:
+    bool nextFrame(cv::Mat &frame);
+
+    std::string cache_file;
+    int batch, width, height;
+    std::vector<std::string> images;    // image directory source
+    cv::VideoCapture video;             // video source
+    int video_stride = 1;
+    int remaining = 0;                  // frames still to sample
+    size_t next_image = 0;
+    int frames_used = 0;
+    std::vector<float> host;            // one batch, CHW
+    void *device = nullptr;
+    std::vector<char> cache;
+};
@@ -1,6 +1,6 @@
 /**
- * @desc:   kalmanfilter for boundary box tracking.
- *          opencv kalmanfilter documents:
+ * @desc:   kalmanfilter for boundary box tracking, batched over all tracks.
+ *          same model and update equations as opencv kalmanfilter:
  *              https://docs.opencv.org/4.x/dd/d6a/classcv_1_1KalmanFilter.html
  * 
  * @author: lst
@@ -8,112 +8,99 @@
  */
 #pragma once
 
-#include <opencv2/video/tracking.hpp>
-#include <opencv2/highgui/highgui.hpp>
 #include <assert.h>
 #include <math.h>
-#include <memory>
+#include <stdint.h>
+#include "kalman_filter.h"
 
 #define KF_DIM_X 7      // xc, yc, s, r, dxc/dt, dyc/dt, ds/dt
 #define KF_DIM_Z 4      // xc, yc, s, r
 
 namespace sort
 {
+    /**
+     * @brief Kalman filters of all bounding box tracks, one slot per track, advanced together.
+     */
     class KalmanBoxTracker
     {
     // variables
-    public:
-        using Ptr = std::shared_ptr<KalmanBoxTracker>;
     private:
-        static int count;
-        int id;
-        int timeSinceUpdate = 0;
-        int hitStreak = 0;
-        std::shared_ptr<cv::KalmanFilter> kf = nullptr;
-        cv::Mat xPost;
+        ConstantVelocityKalman<KF_DIM_X, KF_DIM_Z> kf;
     
     // methods
     public:
-        /**
-         * @brief Kalman filter for bbox tracking
-         * @param bbox bounding box, Mat(1, 4+) [xc, yc, w, h, ...]
-         */
-        explicit KalmanBoxTracker(const cv::Mat &bbox);
+        explicit KalmanBoxTracker(int capacity);
 
         virtual ~KalmanBoxTracker();
         KalmanBoxTracker(const KalmanBoxTracker&) = delete;
         void operator=(const KalmanBoxTracker&) = delete;
 
         /**
-         * @brief updates the state vector with observed bbox. 
-         * @param bbox  boundary box, Mat(1, 4+) [xc, yc, w, h, ...]
-         * @return corrected bounding box estimate, Mat(1, 4)
+         * @brief restart the filter of slot at a new bounding box with zero velocity.
+         * @param bbox bounding box, [xc, yc, w, h]
          */
-        cv::Mat update(const cv::Mat &bbox);
+        void init(int slot, const float *bbox);
 
         /**
-         * @brief advances the state vector and returns the predicted bounding box estimate. 
-         * @return predicted bounding box, Mat(1, 4)
+         * @brief advances the state vectors of slots [0, count); read the predictions with getBox().
          */
-        cv::Mat predict();
+        void predictAll(int count);
 
-        static inline int getFilterCount()
-        {
-            return KalmanBoxTracker::count;
-        }
-
-        inline int getFilterId()
-        {
-            return id;
-        }
+        /**
+         * @brief observed bbox of slot for the next correctAll().
+         * @param bbox boundary box, [xc, yc, w, h]
+         */
+        void setMeasurement(int slot, const float *bbox);
 
-        inline int getTimeSinceUpdate()
-        {
-            return timeSinceUpdate;
-        }
+        /**
+         * @brief updates the state vectors of the slots in [0, count) with a non-zero mask entry;
+         *        read the corrected estimates with getBox().
+         */
+        void correctAll(const uint8_t *mask, int count);
 
-        inline int getHitStreak()
+        /**
+         * @brief current bounding box estimate of slot, [xc, yc, w, h]
+         */
+        inline void getBox(int slot, float *bbox) const
         {
-            return hitStreak;
+            float s = kf.state(2)[slot];
+            float w = sqrt(s * kf.state(3)[slot]);
+            bbox[0] = kf.state(0)[slot];
+            bbox[1] = kf.state(1)[slot];
+            bbox[2] = w;
+            bbox[3] = s / w;
         }
 
-        inline cv::Mat getState()
+        /**
+         * @brief standard deviation of the centre estimate of slot, pixels; grows with every
+         *        predictAll() and shrinks again with a matched correctAll().
+         */
+        inline float getCentreSigma(int slot) const
         {
-            return xPost.clone();
+            return sqrt(0.5f * (kf.covariance(0, 0, slot) + kf.covariance(1, 1, slot)));
         }
 
-    private:
         /**
-         * @brief convert boundary box to measurement.
-         * @param bbox boundary box (1, 4+) [x center, y center, width, height, ...]
-         * @return measurement vector (4, 1) [x center; y center; scale/area; aspect ratio]
+         * @brief centre velocity of slot, pixels per frame.
          */
-        static inline cv::Mat convertBBoxToZ(const cv::Mat &bbox)
+        inline void getVelocity(int slot, float &dx, float &dy) const
         {
-            assert(bbox.rows == 1 && bbox.cols >= 4);
-            float x = bbox.at<float>(0, 0);
-            float y = bbox.at<float>(0, 1);
-            float s = bbox.at<float>(0, 2) * bbox.at<float>(0, 3);
-            float r = bbox.at<float>(0, 2) / bbox.at<float>(0, 3);
-
-            return (cv::Mat_<float>(KF_DIM_Z, 1) << x, y, s, r);
+            dx = kf.state(4)[slot];
+            dy = kf.state(5)[slot];
         }
 
+    private:
         /**
-         * @brief convert state vector to boundary box.
-         * @param state state vector (7, 1) (x center; y center; scale/area; aspect ratio; ...)
-         * @return boundary box (1, 4) [x center, y center, width, height]
+         * @brief convert boundary box to measurement.
+         * @param bbox  boundary box [x center, y center, width, height]
+         * @param z     measurement vector [x center; y center; scale/area; aspect ratio]
          */
-        static inline cv::Mat convertXToBBox(const cv::Mat &state)
+        static inline void convertBBoxToZ(const float *bbox, float *z)
         {
-            assert(state.rows == KF_DIM_X && state.cols == 1);
-            float x = state.at<float>(0, 0);
-            float y = state.at<float>(1, 0);
-            float w = sqrt(state.at<float>(2, 0) * state.at<float>(3, 0));
-            float h = state.at<float>(2, 0) / w;
-
-            return (cv::Mat_<float>(1, 4) << x, y, w, h);
+            z[0] = bbox[0];
+            z[1] = bbox[1];
+            z[2] = bbox[2] * bbox[3];
+            z[3] = bbox[2] / bbox[3];
         }
     };
 }
-
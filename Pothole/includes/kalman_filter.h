@@ -0,0 +1,230 @@
+/**
+ * @desc:   batched constant-velocity Kalman filter with compile-time dimensions.
+ */
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace sort
+{
+    /**
+     * @brief DimZ measured values followed by DimV = DimX - DimZ velocities, velocity k drives value k:
+     *        A = I + E with E(k, DimZ + k) = 1, H = [I | 0], diagonal Q, R and initial P. A*P is a row add and
+     *        H*P a row select, so neither product is formed. The innovation covariance is inverted with an
+     *        unrolled DimZ x DimZ Cholesky.
+     *        Storage is structure-of-arrays over slots, element (i, slot) at i * capacity + slot, and every
+     *        step is an elementwise loop over slots [0, count) that the compiler vectorizes.
+     */
+    template<int DimX, int DimZ>
+    class ConstantVelocityKalman
+    {
+        static_assert(DimZ > 0 && DimX >= DimZ && DimX - DimZ <= DimZ, "velocities must pair with measured values");
+
+    public:
+        static constexpr int DimV = DimX - DimZ;
+
+        /**
+         * @param capacity  number of slots
+         * @param q         diagonal of the process noise covariance Q
+         * @param r         diagonal of the measurement noise covariance R
+         * @param p0        diagonal of the initial error covariance P(0)
+         */
+        ConstantVelocityKalman(int capacity, const std::array<float, DimX> &q, const std::array<float, DimZ> &r,
+                               const std::array<float, DimX> &p0)
+            : cap(capacity), q(q), r(r), p0(p0),
+              x(DimX * capacity, 0.f), p(DimX * DimX * capacity, 0.f), z(DimZ * capacity, 0.f),
+              hp(DimZ * DimX * capacity), kt(DimZ * DimX * capacity), lower(DimZ * DimZ * capacity),
+              innovation(DimZ * capacity)
+        {
+            for (int slot = 0; slot < capacity; ++slot)
+                init(slot, &z[0]);
+        }
+
+        /**
+         * @brief restart slot at measurement values0 (DimZ values) with zero velocity and covariance P(0).
+         */
+        void init(int slot, const float *values0)
+        {
+            for (int i = 0; i < DimX; ++i) {
+                x[i * cap + slot] = i < DimZ ? values0[i] : 0.f;
+                for (int j = 0; j < DimX; ++j)
+                    p[(i * DimX + j) * cap + slot] = i == j ? p0[i] : 0.f;
+            }
+        }
+
+        /**
+         * @brief x' = A x, P' = A P At + Q for slots [0, count).
+         */
+        void predictAll(int count)
+        {
+            for (int k = 0; k < DimV; ++k) {
+                float *__restrict xk = &x[k * cap];
+                const float *__restrict vk = &x[(DimZ + k) * cap];
+                for (int b = 0; b < count; ++b)
+                    xk[b] += vk[b];
+            }
+            // A P: row k += row DimZ + k
+            for (int k = 0; k < DimV; ++k)
+                for (int j = 0; j < DimX; ++j) {
+                    float *__restrict dst = cov(k, j);
+                    const float *__restrict src = cov(DimZ + k, j);
+                    for (int b = 0; b < count; ++b)
+                        dst[b] += src[b];
+                }
+            // (A P) At: column k += column DimZ + k
+            for (int k = 0; k < DimV; ++k)
+                for (int i = 0; i < DimX; ++i) {
+                    float *__restrict dst = cov(i, k);
+                    const float *__restrict src = cov(i, DimZ + k);
+                    for (int b = 0; b < count; ++b)
+                        dst[b] += src[b];
+                }
+            for (int i = 0; i < DimX; ++i) {
+                float *__restrict pii = cov(i, i);
+                for (int b = 0; b < count; ++b)
+                    pii[b] += q[i];
+            }
+        }
+
+        /**
+         * @brief store the measurement (DimZ values) consumed by the next correctAll() for slot.
+         */
+        void setMeasurement(int slot, const float *values)
+        {
+            for (int i = 0; i < DimZ; ++i)
+                z[i * cap + slot] = values[i];
+        }
+
+        /**
+         * @brief measurement update of the slots in [0, count) whose mask entry is non-zero:
+         *        K = P Ht (H P Ht + R)^-1, x = x' + K (z - H x'), P = P' - K H P'.
+         */
+        void correctAll(const uint8_t *mask, int count)
+        {
+            // H P, the first DimZ rows, and the innovation z - H x
+            for (int i = 0; i < DimZ; ++i) {
+                for (int j = 0; j < DimX; ++j) {
+                    const float *__restrict src = cov(i, j);
+                    float *__restrict dst = &hp[(i * DimX + j) * cap];
+                    for (int b = 0; b < count; ++b)
+                        dst[b] = src[b];
+                }
+                const float *__restrict zi = &z[i * cap];
+                const float *__restrict xi = &x[i * cap];
+                float *__restrict yi = &innovation[i * cap];
+                for (int b = 0; b < count; ++b)
+                    yi[b] = zi[b] - xi[b];
+            }
+
+            // Cholesky of S = H P Ht + R, lower triangle; diagonal entries hold 1 / L(j, j)
+            for (int j = 0; j < DimZ; ++j) {
+                float *__restrict ljj = &lower[(j * DimZ + j) * cap];
+                const float *__restrict sjj = &hp[(j * DimX + j) * cap];
+                for (int b = 0; b < count; ++b) {
+                    float acc = sjj[b] + r[j];
+                    for (int k = 0; k < j; ++k)
+                        acc -= lower[(j * DimZ + k) * cap + b] * lower[(j * DimZ + k) * cap + b];
+                    ljj[b] = 1.f / std::sqrt(acc);
+                }
+                for (int i = j + 1; i < DimZ; ++i) {
+                    const float *__restrict sij = &hp[(i * DimX + j) * cap];
+                    float *__restrict lij = &lower[(i * DimZ + j) * cap];
+                    for (int b = 0; b < count; ++b) {
+                        float acc = sij[b];
+                        for (int k = 0; k < j; ++k)
+                            acc -= lower[(i * DimZ + k) * cap + b] * lower[(j * DimZ + k) * cap + b];
+                        lij[b] = acc * ljj[b];
+                    }
+                }
+            }
+
+            // Kt = S^-1 H P: forward substitution with L, then backward with Lt, column by column of H P
+            for (int c = 0; c < DimX; ++c) {
+                for (int i = 0; i < DimZ; ++i) {
+                    float *__restrict dst = &kt[(i * DimX + c) * cap];
+                    const float *__restrict src = &hp[(i * DimX + c) * cap];
+                    const float *__restrict invLii = &lower[(i * DimZ + i) * cap];
+                    for (int b = 0; b < count; ++b) {
+                        float acc = src[b];
+                        for (int k = 0; k < i; ++k)
+                            acc -= lower[(i * DimZ + k) * cap + b] * kt[(k * DimX + c) * cap + b];
+                        dst[b] = acc * invLii[b];
+                    }
+                }
+                for (int i = DimZ - 1; i >= 0; --i) {
+                    float *__restrict dst = &kt[(i * DimX + c) * cap];
+                    const float *__restrict invLii = &lower[(i * DimZ + i) * cap];
+                    for (int b = 0; b < count; ++b) {
+                        float acc = dst[b];
+                        for (int k = i + 1; k < DimZ; ++k)
+                            acc -= lower[(k * DimZ + i) * cap + b] * kt[(k * DimX + c) * cap + b];
+                        dst[b] = acc * invLii[b];
+                    }
+                }
+            }
+
+            // x += K y, P -= K H P, only where mask is set
+            for (int i = 0; i < DimX; ++i) {
+                float *__restrict xi = &x[i * cap];
+                for (int b = 0; b < count; ++b) {
+                    float acc = 0.f;
+                    for (int k = 0; k < DimZ; ++k)
+                        acc += kt[(k * DimX + i) * cap + b] * innovation[k * cap + b];
+                    xi[b] = mask[b] ? xi[b] + acc : xi[b];
+                }
+                for (int j = 0; j < DimX; ++j) {
+                    float *__restrict pij = cov(i, j);
+                    for (int b = 0; b < count; ++b) {
+                        float acc = 0.f;
+                        for (int k = 0; k < DimZ; ++k)
+                            acc += kt[(k * DimX + i) * cap + b] * hp[(k * DimX + j) * cap + b];
+                        pij[b] = mask[b] ? pij[b] - acc : pij[b];
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief state row i, one value per slot.
+         */
+        inline float *state(int i)
+        {
+            return &x[i * cap];
+        }
+
+        inline const float *state(int i) const
+        {
+            return &x[i * cap];
+        }
+
+        /**
+         * @brief error covariance element P(i, j) of slot.
+         */
+        inline float covariance(int i, int j, int slot) const
+        {
+            return p[(i * DimX + j) * cap + slot];
+        }
+
+        inline int capacity() const
+        {
+            return cap;
+        }
+
+    private:
+        inline float *cov(int i, int j)
+        {
+            return &p[(i * DimX + j) * cap];
+        }
+
+        int cap;
+        std::array<float, DimX> q;
+        std::array<float, DimZ> r;
+        std::array<float, DimX> p0;
+        std::vector<float> x, p, z;
+        // correctAll scratch
+        std::vector<float> hp, kt, lower, innovation;
+    };
+}
@@ -58,6 +58,17 @@ public:
      */
     vector<pair<int, int> > compute(const Vec2f& costMatrix);
 
+    /**
+     * @brief Same as `compute(costMatrix)`, on a row-major `rows` x `cols` buffer.
+     *        The padded copy, the markings and `result` reuse their storage from
+     *        the previous call, so a steady problem size doesn't allocate.
+     * @param costMatrix    row-major cost buffer, `rows * cols` values
+     * @param rows          rows of the cost buffer
+     * @param cols          columns of the cost buffer
+     * @param result        cleared, then filled with the `(row, column)` pairs
+     */
+    void compute(const float *costMatrix, int rows, int cols, vector<pair<int, int> > &result);
+
     /**
      * @brief Create a cost matrix from a profit matrix by calling `inversion_function()`
      *        to invert each value. The inversion function must take one numeric argument
@@ -81,29 +92,15 @@ private:
     using StepFunc = int (KuhnMunkres::*)();
 
     // variables
-    Vec2f C;    // cost matrix
+    Vec1f C;        // padded cost matrix, n x n row-major
+    Vec1f input;    // flattened copy of a Vec2f argument
     Vec1b rowCovered, colCovered;
     int n = 0, originalLength = 0, originalWidth = 0;
     int Z0_r = 0, Z0_c = 0;
-    Vec2i marked, path;
+    Vec1i marked;   // n x n row-major, 1: starred, 2: primed
+    Vec1i path;     // (row, column) pairs of the step 5 series
 
     // methods
-    /**
-     * @brief Pad a possibly non-square matrix to make it square.
-     * @param matrix    matrix to pad
-     * @param padValue  value to use to pad the matrix
-     * @return a new, possibly padded, matrix
-     */
-    static Vec2f padMatrix(const Vec2f& matrix, const float padValue=0.0);
-
-    /**
-     * @brief Create an *n*x*n* matrix, populating it with the specific value.
-     * @param n     rows and columns
-     * @param val   value
-     * @return created matrix
-     */
-    static Vec2i makeMatrix(const int &n, const int &val);
-
     /**
      * @brief For each row of the matrix, find the smallest element and
      *        substract it from every element in its row. Go to Step 2.
@@ -197,7 +194,7 @@ private:
      */
     int findPrimeInRow(const int row) const;
 
-    void convertPath(const Vec2i& path, const int count);
+    void convertPath(const int count);
 
     /**
      * @brief Clear all covered matrix cells
@@ -0,0 +1,57 @@
+/**
+ * @desc:   Jonker-Volgenant shortest augmenting path assignment.
+ *          R. Jonker, A. Volgenant "A shortest augmenting path algorithm for dense and sparse
+ *          linear assignment problems", Computing 38, 1987.
+ *          D. F. Crouse "On implementing 2D rectangular assignment algorithms",
+ *          IEEE Transactions on Aerospace and Electronic Systems 52(4), 2016.
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace lapjv {
+
+using std::vector;
+using std::pair;
+
+class LapJV {
+public:
+    using Ptr = std::shared_ptr<LapJV>;
+
+    LapJV();
+    virtual ~LapJV();
+    LapJV(const LapJV&) = delete;
+    LapJV& operator=(const LapJV&) = delete;
+
+    /**
+     * @brief Minimal-cost assignment of a rectangular cost matrix: every row is
+     *        assigned when rows <= cols, every column otherwise. Rows are added
+     *        one at a time along a Dijkstra shortest augmenting path over reduced
+     *        costs, keeping the dual variables feasible; no padding to square.
+     *        Scratch storage and `result` are reused between calls.
+     * @param costMatrix    row-major `rows * cols` finite costs
+     * @param rows          rows of the cost buffer
+     * @param cols          columns of the cost buffer
+     * @param result        cleared, then filled with `(row, column)` pairs in row order
+     */
+    void compute(const float *costMatrix, int rows, int cols, vector<pair<int, int> > &result);
+
+private:
+    /**
+     * @brief cheapest path from free row `row` to an unassigned column.
+     * @return sink column, -1 if none is reachable
+     */
+    int augmentingPath(int row, double &minVal);
+
+    // variables
+    const float *cost = nullptr;
+    bool transposed = false;
+    int nr = 0, nc = 0;             // rows <= columns after transposition
+    vector<float> transposedCost;
+    vector<double> u, v, shortest;
+    vector<int> path, col4row, row4col, remaining;
+    vector<char> visitedRow, visitedCol;
+};
+
+} // namespace lapjv
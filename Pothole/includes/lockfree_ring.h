@@ -0,0 +1,112 @@
+/**
+ * @desc:   bounded lock-free ring buffer (D. Vyukov's bounded MPMC queue). Every cell carries a
+ *          sequence number telling producers and consumers whose turn it is, so any number of
+ *          threads can push and pop with one CAS each and no lock. Storage is allocated once.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+template<typename T>
+class LockFreeRing
+{
+public:
+    /**
+     * @param capacity rounded up to a power of two
+     */
+    explicit LockFreeRing(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    LockFreeRing(const LockFreeRing&) = delete;
+    LockFreeRing& operator=(const LockFreeRing&) = delete;
+
+    /**
+     * @return false if the ring is full
+     */
+    bool tryPush(const T &item)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @return false if the ring is empty
+     */
+    bool tryPop(T &item)
+    {
+        size_t pos = head.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->data;
+        cell->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief push, evicting the oldest elements while the ring is full.
+     * @param scratch receives the evicted elements
+     * @return number of elements evicted
+     */
+    size_t pushDropOldest(const T &item, T &scratch)
+    {
+        size_t evicted = 0;
+        while (!tryPush(item))
+            if (tryPop(scratch))
+                ++evicted;
+        return evicted;
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
@@ -18,6 +18,7 @@
 #define TENSORRT_LOGGING_H
 
 #include "NvInferRuntimeCommon.h"
+#include "async_logger.h"
 #include <cassert>
 #include <ctime>
 #include <iomanip>
@@ -28,36 +29,40 @@
 
 using Severity = nvinfer1::ILogger::Severity;
 
-class LogStreamConsumerBuffer : public std::stringbuf
+//!
+//! \class LogStreamConsumerBuffer
+//! \brief Collects a message in a fixed buffer and hands it to the AsyncLogger on sync (std::endl, std::flush) or
+//!  destruction; the writer thread stamps it and writes it to stdout or stderr, the caller never waits on the
+//!  console. Like a LogLine, a message longer than AsyncLogger::kLineBytes is truncated, and nothing allocates.
+//!  Not thread-safe: each thread needs its own stream (the gLog* streams are thread_local).
+//!
+class LogStreamConsumerBuffer : public std::streambuf
 {
 public:
-    LogStreamConsumerBuffer(std::ostream& stream, const std::string& prefix, bool shouldLog)
-        : mOutput(stream)
-        , mPrefix(prefix)
+    LogStreamConsumerBuffer(Severity severity, bool shouldLog)
+        : mSeverity(severity)
         , mShouldLog(shouldLog)
     {
+        setp(mData, mData + sizeof(mData));
     }
 
     LogStreamConsumerBuffer(LogStreamConsumerBuffer&& other)
-        : mOutput(other.mOutput)
+        : mSeverity(other.mSeverity)
+        , mShouldLog(other.mShouldLog)
     {
+        setp(mData, mData + sizeof(mData));
     }
 
     ~LogStreamConsumerBuffer()
     {
-        // std::streambuf::pbase() gives a pointer to the beginning of the buffered part of the output sequence
-        // std::streambuf::pptr() gives a pointer to the current position of the output sequence
-        // if the pointer to the beginning is not equal to the pointer to the current position,
-        // call putOutput() to log the output to the stream
+        // a message without a trailing std::endl is still logged
         if (pbase() != pptr())
         {
             putOutput();
         }
     }
 
-    // synchronizes the stream buffer and returns 0 on success
-    // synchronizing the stream buffer consists of inserting the buffer contents into the stream,
-    // resetting the buffer and flushing the stream
+    // synchronizing the stream buffer hands the message to the logger and empties the buffer
     virtual int sync()
     {
         putOutput();
@@ -66,26 +71,11 @@ public:
 
     void putOutput()
     {
-        if (mShouldLog)
-        {
-            // prepend timestamp
-            std::time_t timestamp = std::time(nullptr);
-            tm* tm_local = std::localtime(&timestamp);
-            std::cout << "[";
-            std::cout << std::setw(2) << std::setfill('0') << 1 + tm_local->tm_mon << "/";
-            std::cout << std::setw(2) << std::setfill('0') << tm_local->tm_mday << "/";
-            std::cout << std::setw(4) << std::setfill('0') << 1900 + tm_local->tm_year << "-";
-            std::cout << std::setw(2) << std::setfill('0') << tm_local->tm_hour << ":";
-            std::cout << std::setw(2) << std::setfill('0') << tm_local->tm_min << ":";
-            std::cout << std::setw(2) << std::setfill('0') << tm_local->tm_sec << "] ";
-            // std::stringbuf::str() gets the string contents of the buffer
-            // insert the buffer contents pre-appended by the appropriate prefix into the stream
-            mOutput << mPrefix << str();
-            // set the buffer to empty
-            str("");
-            // flush the stream
-            mOutput.flush();
-        }
+        // the writer thread prepends the timestamp and severity prefix
+        size_t length = size_t(pptr() - pbase());
+        if (mShouldLog && length > 0 && AsyncLogger::instance().enabled(mSeverity))
+            AsyncLogger::instance().write(mSeverity, pbase(), length);
+        setp(mData, mData + sizeof(mData));
     }
 
     void setShouldLog(bool shouldLog)
@@ -93,10 +83,17 @@ public:
         mShouldLog = shouldLog;
     }
 
+protected:
+    // the buffer is full: drop the rest of the message rather than failing the stream
+    virtual int_type overflow(int_type ch)
+    {
+        return traits_type::not_eof(ch);
+    }
+
 private:
-    std::ostream& mOutput;
-    std::string mPrefix;
+    Severity mSeverity;
     bool mShouldLog;
+    char mData[AsyncLogger::kLineBytes];
 };
 
 //!
@@ -106,8 +103,8 @@ private:
 class LogStreamConsumerBase
 {
 public:
-    LogStreamConsumerBase(std::ostream& stream, const std::string& prefix, bool shouldLog)
-        : mBuffer(stream, prefix, shouldLog)
+    LogStreamConsumerBase(Severity severity, bool shouldLog)
+        : mBuffer(severity, shouldLog)
     {
     }
 
@@ -130,7 +127,7 @@ public:
     //! \brief Creates a LogStreamConsumer which logs messages with level severity.
     //!  Reportable severity determines if the messages are severe enough to be logged.
     LogStreamConsumer(Severity reportableSeverity, Severity severity)
-        : LogStreamConsumerBase(severityOstream(severity), severityPrefix(severity), severity <= reportableSeverity)
+        : LogStreamConsumerBase(severity, severity <= reportableSeverity)
         , std::ostream(&mBuffer) // links the stream buffer with the stream
         , mShouldLog(severity <= reportableSeverity)
         , mSeverity(severity)
@@ -138,7 +135,7 @@ public:
     }
 
     LogStreamConsumer(LogStreamConsumer&& other)
-        : LogStreamConsumerBase(severityOstream(other.mSeverity), severityPrefix(other.mSeverity), other.mShouldLog)
+        : LogStreamConsumerBase(other.mSeverity, other.mShouldLog)
         , std::ostream(&mBuffer) // links the stream buffer with the stream
         , mShouldLog(other.mShouldLog)
         , mSeverity(other.mSeverity)
@@ -152,24 +149,6 @@ public:
     }
 
 private:
-    static std::ostream& severityOstream(Severity severity)
-    {
-        return severity >= Severity::kINFO ? std::cout : std::cerr;
-    }
-
-    static std::string severityPrefix(Severity severity)
-    {
-        switch (severity)
-        {
-        case Severity::kINTERNAL_ERROR: return "[F] ";
-        case Severity::kERROR: return "[E] ";
-        case Severity::kWARNING: return "[W] ";
-        case Severity::kINFO: return "[I] ";
-        case Severity::kVERBOSE: return "[V] ";
-        default: assert(0); return "";
-        }
-    }
-
     bool mShouldLog;
     Severity mSeverity;
 };
@@ -236,9 +215,14 @@ public:
     //! Note samples should not be calling this function directly; it will eventually go away once we eliminate the
     //! inheritance from nvinfer1::ILogger
     //!
+    //! Called on whatever thread TensorRT is running on, e.g. an inference thread: filtered before any
+    //! formatting and queued on the AsyncLogger without blocking.
+    //!
     void log(Severity severity, const char* msg) noexcept override
     {
-        LogStreamConsumer(mReportableSeverity, severity) << "[TRT] " << std::string(msg) << std::endl;
+        if (severity > mReportableSeverity)
+            return;
+        LogLine(severity).stream() << "[TRT] " << msg;
     }
 
     //!
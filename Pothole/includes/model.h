@@ -5,9 +5,14 @@
 #ifndef TENSORRT_INFERENCE_MODEL_H
 #define TENSORRT_INFERENCE_MODEL_H
 
+#include <chrono>
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/cuda.hpp>
 #include "NvInfer.h"
 #include "common.h"
+#include "postprocess.h"
+#include "engine_builder.h"
+#include "span.h"
 
 struct ClassRes{
     int classes;
@@ -21,32 +26,119 @@ struct DetectRes : ClassRes{
     float h;
 };
 
+// Detections of a batch in one arena: image i's boxes are boxes[offsets[i], offsets[i + 1]).
+// clear() keeps the capacity, so a caller reusing one batch stops allocating once the busiest
+// frame has been seen.
+struct DetectionBatch {
+    std::vector<DetectRes> boxes;
+    std::vector<size_t> offsets{0};
+
+    size_t size() const { return offsets.size() - 1; }     // images
+    Span<const DetectRes> operator[](size_t i) const {
+        return Span<const DetectRes>(boxes.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    void clear() { boxes.clear(); offsets.resize(1); }
+    void endImage() { offsets.push_back(boxes.size()); }   // the boxes added so far close an image
+    std::vector<std::vector<DetectRes>> toVectors() const {
+        std::vector<std::vector<DetectRes>> out(size());
+        for (size_t i = 0; i < size(); ++i)
+            out[i].assign((*this)[i].begin(), (*this)[i].end());
+        return out;
+    }
+};
+
+// One execution context with its own stream, device bindings and page-locked staging buffers,
+// so that several frames can be in flight at once (see YOLO::Submit / YOLO::Collect).
+struct InferSlot {
+    nvinfer1::IExecutionContext *context = nullptr;
+    cudaStream_t stream = nullptr;
+    cudaEvent_t done = nullptr;         // recorded after the D2H copy of the output
+    cudaEvent_t started = nullptr;      // timing events: before the input copy/letterbox,
+    cudaEvent_t inputReady = nullptr;   // before enqueueV3,
+    cudaEvent_t inferred = nullptr;     // and after it
+    bool stageEvents = false;           // inputReady/inferred were recorded (not a graph replay)
+    void *buffers[2] = {nullptr, nullptr};
+    float *hostInput = nullptr;         // pinned, bufferSize[0] bytes
+    float *hostOutput = nullptr;        // pinned, bufferSize[1] bytes
+    void *rawInput = nullptr;           // device copy of the 8-bit frames for the GPU preprocess
+    size_t rawInputSize = 0;
+    std::vector<cv::Rect> imageRegions; // frame regions of the submitted batch, needed to map boxes back
+    int inputHeight = 0;                // network input height of the submitted batch
+    int numBoxes = 0;                   // anchors per image of the output at that height
+    std::vector<cv::cuda::GpuMat> deviceImages; // decoder frames, held until Collect so they can't be recycled
+    uint8_t *hostRaw = nullptr;         // pinned staging copy of the frames for the GPU preprocess
+    size_t hostRawSize = 0;
+    cudaGraphExec_t graph = nullptr;    // captured preprocess + enqueue + D2H
+    bool graphUsable = true;            // cleared once capture fails on this context
+    bool graphDevicePreprocess = false;
+    std::vector<cv::Size> graphShapes;  // frame sizes the graph was captured for
+    int graphInputHeight = 0;
+    GpuDetections detections;           // device decode/NMS buffers (GPU postprocess)
+    uint64_t ticket = 0;                // 0 while the slot is free
+};
+
 class Model
 {
 public:
+    virtual ~Model();
     void LoadEngine();
+    // wall time of the last LoadEngine(): plan mapping, deserialization, contexts and buffers
+    std::chrono::steady_clock::duration LoadTime() const { return load_time; }
+    // one TensorRT runtime per device, shared by every model on it; it outlives their engines
+    static nvinfer1::IRuntime *SharedRuntime(int device = 0);
+    // CUDA device of the engine, contexts and buffers; every call into the model binds it to the
+    // calling thread first, so one thread per model (or per GPU) can drive several GPUs
+    int Device() const { return device; }
+    void BindDevice() const { cudaSetDevice(device); }
     virtual std::vector<float> prepareImage(std::vector<cv::Mat> &image) = 0;
 //    virtual float *InferenceImage(std::vector<float> image_data) = 0;
 //    virtual bool InferenceFolder(const std::string &folder_name) = 0;
 
 protected:
-    bool readTrtFile();
-    void onnxToTRTModel();
+    EngineBuildOptions buildOptions() const;
+    // maps and deserializes a plan, rejecting one keyed for other hardware (or another model)
+    // why: set to the reason when the plan is not loaded
+    bool readTrtFile(const std::string &path, const EngineKey &expected, bool match_model, std::string &why);
+    void onnxToTRTModel(const EngineBuildOptions &options, const EngineKey &key, const std::string &cache_path);
+    void createInferSlots();
+    InferSlot *acquireInferSlot();
+    InferSlot *findInferSlot(uint64_t ticket);
     virtual float *ModelInference(std::vector<float> image_data) = 0;
     std::string onnx_file;
+    uint64_t onnx_hash = 0;             // content hash of onnx_file when the caller has it, hashed on load otherwise
     std::string engine_file;
     std::string labels_file;
+    std::string engine_cache_dir;       // plans by GPU/TensorRT/ONNX key, shared by nodes with the same hardware
+    bool overwrite_engine = false;      // a plan rebuilt from the ONNX replaces an existing engine_file
+    std::string timing_cache_file;      // TensorRT tactic timings, reused across builds
+    size_t build_workspace = 0;         // bytes, 0 for the builder default
+    bool build_int8 = false;            // INT8 post-training quantization when building from the ONNX
+    std::string calibration_source;     // video or image directory sampled for calibration
+    std::string calibration_cache_file;
     int BATCH_SIZE;
     int INPUT_CHANNEL;
     int IMAGE_WIDTH;
-    int IMAGE_HEIGHT;
+    int IMAGE_HEIGHT;                   // the height of a fixed engine, the profile maximum of a dynamic one
     int CATEGORY;
+    bool dynamic_input = false;         // the engine takes any input height in [MIN_INPUT_HEIGHT, IMAGE_HEIGHT]
+    int MIN_INPUT_HEIGHT = 0;           // optimization profile of engines built from a dynamic ONNX
+    int OPT_INPUT_HEIGHT = 0;
+    int MIN_BATCH_SIZE = 0;             // batch profile of a dynamic-batch ONNX, 0 for BATCH_SIZE
+    int OPT_BATCH_SIZE = 0;
+    int MAX_BATCH_SIZE = 0;
     nvinfer1::ICudaEngine *engine = nullptr;
     nvinfer1::IExecutionContext *context = nullptr;
-    void *buffers[2];
+    void *buffers[2] = {nullptr, nullptr};
     std::vector<int64_t> bufferSize;
-    cudaStream_t stream;
+    float *hostInput = nullptr;         // pinned staging of the synchronous path, bufferSize[0] bytes
+    float *hostOutput = nullptr;        // pinned, bufferSize[1] bytes
+    cudaStream_t stream = nullptr;
     int outSize;
+    int NUM_CONTEXTS = 0;               // async execution contexts, 0 disables Submit/Collect
+    int device = 0;
+    std::vector<InferSlot> slots;
+    uint64_t nextTicket = 1;
+    std::chrono::steady_clock::duration load_time{};
     std::vector<float> img_mean;
     std::vector<float> img_std;
 };
@@ -0,0 +1,65 @@
+#ifndef TRACKER_NMS_H
+#define TRACKER_NMS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "model.h"
+
+enum class NmsMethod {
+    kGreedy,    // reference: every kept box against every lower-scored box
+    kGrid       // uniform grid over the frame, only boxes sharing a cell are compared
+};
+
+struct NmsConfig {
+    float threshold = 0.4f;             // DIoU above which the lower-scored box is suppressed
+    bool agnostic = false;              // suppress across classes
+    int topK = 1000;                    // highest-scored candidates considered, <= 0 keeps all
+    NmsMethod method = NmsMethod::kGrid;
+};
+
+NmsMethod parseNmsMethod(const std::string &name);
+
+/**
+ * @brief Greedy DIoU non-maximum suppression over a reusable structure-of-arrays box store.
+ *        Candidates are cut to the topK highest scores first, then bucketed into a grid whose
+ *        cell size follows the median box size, so a kept box is only compared with the boxes
+ *        it actually overlaps. Buffers are kept between calls.
+ */
+class NmsEngine
+{
+public:
+    explicit NmsEngine(const NmsConfig &config = NmsConfig()) : config(config) {}
+
+    /**
+     * @brief suppress overlapping detections in place; survivors are ordered by descending score.
+     */
+    void run(std::vector<DetectRes> &detections);
+
+    const NmsConfig &getConfig() const { return config; }
+
+private:
+    void loadBoxes(const std::vector<DetectRes> &detections);
+    void buildGrid();
+    float diou(int a, int b) const;
+    bool pairEligible(int a, int b) const;
+    void suppressGreedy();
+    void suppressGrid();
+
+    NmsConfig config;
+    int n = 0;
+    // candidates in descending score order, SoA
+    std::vector<int> order;
+    std::vector<float> x1, y1, x2, y2, cx, cy, area;
+    std::vector<int> cls;
+    std::vector<uint8_t> suppressed;
+    // grid index: boxes covering cell c are cellItems[cellStart[c] .. cellStart[c + 1])
+    float gridX0 = 0.f, gridY0 = 0.f, cellSize = 1.f;
+    int gridW = 0, gridH = 0;
+    std::vector<int> cellStart, cellItems, cellFill;
+    std::vector<int> visited;           // last kept box that tested each candidate
+    std::vector<float> sides;
+    std::vector<DetectRes> survivors;
+};
+
+#endif //TRACKER_NMS_H
@@ -0,0 +1,35 @@
+#ifndef TRACKER_OVERLAY_H
+#define TRACKER_OVERLAY_H
+
+#include <cuda_runtime_api.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief axis-aligned rectangle drawn into a frame by drawOverlayRects
+ */
+struct OverlayRect {
+    int x, y, w, h;
+    uint8_t b, g, r;
+    int thickness;      // outline width in pixels, 0 fills the rectangle
+};
+
+/**
+ * @brief Draw rectangles into a packed 8-bit BGR frame on the GPU, the device counterpart of
+ *        cv::rectangle for the recorder overlays. Rectangles are clipped to the frame.
+ * @param d_img     device pointer to the BGR frame, modified in place
+ * @param img_w     frame width in pixels
+ * @param img_h     frame height in pixels
+ * @param pitch     frame row pitch in bytes
+ * @param d_rects   device array of rectangles
+ * @param count     number of rectangles
+ * @param max_w     largest rectangle width, sizes the launch
+ * @param max_h     largest rectangle height, sizes the launch
+ * @param stream    CUDA stream the kernel is launched on
+ * @return launch status
+ */
+cudaError_t drawOverlayRects(uint8_t *d_img, int img_w, int img_h, size_t pitch,
+                             const OverlayRect *d_rects, int count, int max_w, int max_h,
+                             cudaStream_t stream);
+
+#endif //TRACKER_OVERLAY_H
@@ -0,0 +1,49 @@
+#ifndef TRACKER_POSTPROCESS_H
+#define TRACKER_POSTPROCESS_H
+
+#include <cuda_runtime_api.h>
+
+// Pre-NMS candidates kept per image; also the size of the on-chip sort in the NMS kernel.
+constexpr int kGpuMaxCandidates = 1024;
+
+// Same fields and order as DetectRes, without the OpenCV/TensorRT headers so nvcc stays lean.
+struct DeviceDetection {
+    int classes;
+    float prob;
+    float x;
+    float y;
+    float w;
+    float h;
+};
+
+// Device scratch and page-locked result buffers for one batch decoded on the GPU.
+struct GpuDetections {
+    DeviceDetection *candidates = nullptr;      // device, batch * kGpuMaxCandidates
+    int *candidateCount = nullptr;              // device, batch
+    DeviceDetection *detections = nullptr;      // device, batch * maxDetections
+    int *count = nullptr;                       // device, batch
+    DeviceDetection *hostDetections = nullptr;  // pinned copy of detections
+    int *hostCount = nullptr;                   // pinned copy of count
+    int *hostCandidateCount = nullptr;          // pinned copy of candidateCount, may exceed kGpuMaxCandidates
+    int batch = 0;
+    int maxDetections = 0;
+};
+
+bool allocGpuDetections(GpuDetections &det, int batch, int maxDetections);
+void freeGpuDetections(GpuDetections &det);
+
+/**
+ * @brief Decode a YOLOv11 output tensor [batch, num_classes + 4, num_anchors] on the device:
+ *        argmax over the class channels, threshold on obj_threshold, compact the survivors with
+ *        an atomic counter, sort them by score and run NMS (DIoU, class-aware unless agnostic).
+ *        Only hostCount, hostCandidateCount and the first maxDetections boxes per image are copied
+ *        back to the host; boxes stay in network input coordinates. An image whose hostCandidateCount
+ *        exceeds kGpuMaxCandidates lost candidates in arrival order rather than by score, so its
+ *        boxes should be decoded on the host instead.
+ * @return launch status, the results are valid once the stream has been synchronized
+ */
+cudaError_t decodeYoloOutput(const float *d_output, int num_anchors, int num_classes,
+                             float obj_threshold, float nms_threshold, bool agnostic,
+                             GpuDetections &det, cudaStream_t stream);
+
+#endif //TRACKER_POSTPROCESS_H
@@ -0,0 +1,26 @@
+#ifndef TRACKER_PREPROCESS_H
+#define TRACKER_PREPROCESS_H
+
+#include <cuda_runtime_api.h>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Letterbox a packed 8-bit BGR frame into a planar RGB float tensor on the GPU.
+ *        Matches the CPU path of YOLO::prepareImage: the frame is resized (bilinear) by
+ *        min(dst_w / src_w, dst_h / src_h), anchored at the top-left corner, padded with
+ *        zeros, scaled by 1/255 and written as CHW with channel order R, G, B.
+ * @param d_src     device pointer to the BGR frame
+ * @param src_w     frame width in pixels
+ * @param src_h     frame height in pixels
+ * @param src_pitch frame row pitch in bytes
+ * @param d_dst     device pointer to the CHW tensor, 3 * dst_w * dst_h floats
+ * @param dst_w     network input width
+ * @param dst_h     network input height
+ * @param stream    CUDA stream the kernel is launched on
+ * @return launch status
+ */
+cudaError_t letterboxBgrToTensor(const uint8_t *d_src, int src_w, int src_h, size_t src_pitch,
+                                 float *d_dst, int dst_w, int dst_h, cudaStream_t stream);
+
+#endif //TRACKER_PREPROCESS_H
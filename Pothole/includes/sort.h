@@ -9,24 +9,61 @@
 #pragma once
 
 #include <memory>
+#include "span.h"
+#include <cstdint>
+#include <string>
 #include "kuhn_munkres.h"
-#include "kalman_box_tracker.h"
+#include "lapjv.h"
+#include "track_pool.h"
 
 namespace sort{
     using std::shared_ptr;
     using std::vector;
     using std::pair;
-    using std::tuple;
-    using std::make_tuple;
     using std::make_shared;
     using kuhn_munkres::KuhnMunkres;
-    using kuhn_munkres::Vec2f;
-    using kuhn_munkres::Vec1f;
+    using lapjv::LapJV;
     
     using TypeMatchedPairs = vector<pair<int, int> >;   // first: detected id, second: predicted id
     using TypeLostDets = vector<int>;
     using TypeLostPreds = vector<int>;
-    using TypeAssociate = tuple<TypeMatchedPairs, TypeLostDets, TypeLostPreds>;
+
+    enum class AssignMethod
+    {
+        kHungarian,     // KuhnMunkres, step-based Munkres on the padded square matrix
+        kLapjv          // LapJV, shortest augmenting path on the rectangular matrix
+    };
+
+    AssignMethod parseAssignMethod(const std::string &name);
+
+    struct Detection
+    {
+        float xc, yc, w, h;
+        float score;
+        int classId;
+    };
+
+    struct TrackedBox
+    {
+        float xc, yc, w, h;     // corrected box
+        float score;            // score of the matched detection
+        int classId;
+        float dx, dy;           // centre velocity, pixels per frame
+        int trackerId;
+    };
+
+    /**
+     * @brief tracking health, read by the detection cadence scheduler
+     */
+    struct TrackStats
+    {
+        int confirmed;      // tracks with at least minHits consecutive matches
+        int tentative;      // live tracks not confirmed yet
+        int spawned;        // tracks started by the last update()
+        int missed;         // confirmed tracks the last update() found no detection for
+        float maxSigma;     // largest centre standard deviation of a confirmed track, in box widths
+        float maxFlow;      // largest centre speed of a confirmed track, box widths per frame
+    };
 
     class Sort
     {
@@ -37,12 +74,34 @@ namespace sort{
         int maxAge;         // tracker's maximal unmatch count
         int minHits;        // tracker's minimal match count
         float iouThresh;    // IoU threshold
-        vector<KalmanBoxTracker::Ptr> trackers;
+        AssignMethod assignMethod;
+        TrackPool pool;
         KuhnMunkres::Ptr km = nullptr;
+        LapJV::Ptr lap = nullptr;
+        // per-frame scratch, kept across frames
+        vector<int> predSlots;          // pool slot of each prediction column
+        vector<uint8_t> matchedMask;    // per pool slot, set for the slots corrected this frame
+        vector<float> iouMatrix;        // detections x predictions, row-major
+        vector<int> parent;             // union-find over detections then predictions, gated IoU edges
+        vector<int> compStart, compFill, compNodes; // nodes of component c: compNodes[compStart[c] .. compStart[c + 1])
+        vector<int> compRows, compCols;
+        vector<float> subCost;          // cost matrix of one component
+        TypeMatchedPairs subMatches;
+        vector<uint64_t> detMatched, predMatched;   // bitsets
+        TypeMatchedPairs matchedDetPred;
+        TypeLostDets lostDets;
+        TypeLostPreds lostPreds;
+        vector<int> deadIds;            // tracker ids removed by the last update or coast
+        int spawnedCount = 0;
+        int missedCount = 0;
 
     // methods
     public:
-        Sort(int maxAge=1, int minHits=8, float iouThresh=0.5);
+        /**
+         * @param capacity maximal number of simultaneous tracks, unmatched detections beyond it are not tracked
+         */
+        Sort(int maxAge=1, int minHits=8, float iouThresh=0.5, int capacity=256,
+             AssignMethod assignMethod=AssignMethod::kLapjv);
         virtual ~Sort();
         Sort(const Sort&) = delete;
         Sort& operator=(const Sort&) = delete;
@@ -50,39 +109,69 @@ namespace sort{
         /**
          * @brief bbox tracking in SORT, this method must be called once for each frame even with empty detections, 
          *        the number of objects retured may differ from the number of detections provided.
-         * @param bboxesDet detections, Mat(M, 6) with the format [[xc,yc,w,h,score,class_id];[...];...]
-         * @return matched bboxes, Mat(N, 9) with the format [[xc,yc,w,h,score,class_id,dx,dy,tracker_id];[...];...].
+         *        Doesn't allocate once the scratch buffers have grown to the scene's detection count.
+         * @param bboxesDet detections of this frame
+         * @param bboxesPost output, confirmed tracks matched in this frame; getCapacity() entries always suffice
+         * @return number of entries written to bboxesPost
          */
-        cv::Mat update(const cv::Mat &bboxesDet);
-    private:
-        /** 
-         * @brief check if NAN value in Mat
-         * @param mat input Matrix 
-         * @return any NAN value in Matrix or not.
+        int update(Span<const Detection> bboxesDet, Span<TrackedBox> bboxesPost);
+
+        /**
+         * @brief advance every track by one frame on its Kalman prediction alone, for the frames the
+         *        detector skips. Coasted frames don't count as misses: maxAge and minHits keep counting
+         *        update() calls, so with detections every k frames a track survives maxAge keyframes.
+         *        Callers bound k below maxAge and go back to every frame on a miss (DetectionCadence).
+         * @param bboxesPost output, predicted boxes of the confirmed tracks matched by the last update()
+         * @return number of entries written to bboxesPost
          */
-        template<typename _Tp>
-        static bool isAnyNan(const cv::Mat& mat)
+        int coast(Span<TrackedBox> bboxesPost);
+
+        /**
+         * @brief counts and uncertainty of the current tracks, one pass over the live slots
+         */
+        TrackStats getStats() const;
+
+        inline int getCapacity() const
+        {
+            return pool.capacity();
+        }
+
+        inline int getTrackCount() const
+        {
+            return pool.size();
+        }
+
+        /**
+         * @brief tracker ids removed by the last update() or coast(), after exceeding maxAge unmatched
+         *        frames or diverging, valid until the next call of either
+         */
+        inline Span<const int> getDeadIds() const
         {
-            for (auto it = mat.begin<_Tp>(); it != mat.end<_Tp>(); ++it)
-                if (*it != *it) return true;
-            return false;
+            return deadIds;
         }
+    private:
+        /**
+         * @brief Kalman predict of all tracks, refreshes the pool boxes and releases diverged tracks
+         */
+        void predictTracks();
 
         /**
-         * @brief data associate in SORT
-         * @param bboxesDet detected bboxes, Mat(M, 4+)
-         * @param bboxesPred predicted bboxes, Mat(N, 4+)
-         * @return associate tuple (matched pairs, lost detections, lost predictions)
+         * @brief data associate in SORT, fills matchedDetPred, lostDets and lostPreds. Pairs below iouThresh
+         *        are never matched, so the gated IoU graph splits into independent components. Components
+         *        with a single detection or prediction take the best IoU directly, the rest go to the solver.
+         * @param bboxesDet detected bboxes, predictions are the boxes of predSlots in the pool
          */
-        TypeAssociate dataAssociate(const cv::Mat& bboxesDet, const cv::Mat& bboxesPred);
+        void dataAssociate(Span<const Detection> bboxesDet);
 
         /**
-         * @brief IoU of bboxes
-         * @param bboxesA input bboxes A, Mat(M, 4+)
-         * @param bboxesB another input bboxes B, Mat(N, 4+)
-         * @return M x N matrix, value(i, j) means IoU of A(i) and B(j)
+         * @brief optimal assignment between compRows and compCols, appends the gated matches to matchedDetPred
+         * @param numPred row stride of iouMatrix
          */
-        static cv::Mat getIouMatrix(const cv::Mat& bboxesA, const cv::Mat& bboxesB);
+        void solveComponent(int numPred);
+
+        /**
+         * @brief IoU of two [xc, yc, w, h] bboxes
+         */
+        static float getIou(float xcA, float ycA, float wA, float hA, float xcB, float ycB, float wB, float hB);
     };
 }
-
@@ -0,0 +1,39 @@
+#ifndef TRACKER_SPAN_H
+#define TRACKER_SPAN_H
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Non-owning view over contiguous elements, the subset of C++20 std::span the tree needs
+ *        while it builds as C++17. Span<const T> binds to const and non-const vectors alike.
+ */
+template<typename T>
+class Span
+{
+public:
+    using value_type = std::remove_const_t<T>;
+
+    Span() = default;
+    Span(T *data, size_t size) : ptr(data), len(size) {}
+    Span(std::vector<value_type> &v) : ptr(v.data()), len(v.size()) {}
+    template<typename U = T, typename = std::enable_if_t<std::is_const<U>::value>>
+    Span(const std::vector<value_type> &v) : ptr(v.data()), len(v.size()) {}
+    template<typename U, typename = std::enable_if_t<std::is_same<const U, T>::value && !std::is_same<U, T>::value>>
+    Span(const Span<U> &other) : ptr(other.data()), len(other.size()) {}
+
+    T *data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    T &operator[](size_t i) const { return ptr[i]; }
+    T *begin() const { return ptr; }
+    T *end() const { return ptr + len; }
+    Span first(size_t count) const { return Span(ptr, count < len ? count : len); }
+
+private:
+    T *ptr = nullptr;
+    size_t len = 0;
+};
+
+#endif //TRACKER_SPAN_H
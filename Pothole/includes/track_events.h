@@ -0,0 +1,74 @@
+/**
+ * @desc:   per-track lifecycle aggregation on top of the SORT tracker ids. Instead of every tracked
+ *          box of every frame, a pothole is published once when its track is confirmed and once more
+ *          with a consolidated summary when SORT drops it, plus optional low-rate live updates.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "span.h"
+#include "wire_format.h"
+
+/**
+ * @brief one confirmed tracked box of the current frame with a valid ground distance
+ */
+struct TrackObservation {
+    int trackerId;
+    float d;        // forward distance, m
+    float x;        // lateral offset, m
+    float sizeM2;
+    float score;
+};
+
+class TrackEventAggregator {
+public:
+    /**
+     * @param live_interval frames between live updates of a confirmed track, 0 disables them
+     * @param capacity      expected simultaneous tracks, only sizes the initial tables
+     */
+    explicit TrackEventAggregator(int live_interval = 0, int capacity = 256);
+
+    void observe(const TrackObservation& obs, int frame);
+
+    /**
+     * @brief close the tracks SORT removed in this frame's update and collect the frame's events:
+     *        kConfirmed for tracks first observed, kLive when due, kEnded with the summary of dead ones
+     * @param deadIds   Sort::getDeadIds()
+     * @return events, valid until the next call
+     */
+    Span<const StreamedTrack> finishFrame(int frame, Span<const int> deadIds);
+
+    /**
+     * @brief end every open track, on a tracker reset or at shutdown
+     * @return kEnded events, valid until the next call
+     */
+    Span<const StreamedTrack> flush();
+
+    size_t openTracks() const
+    {
+        return tracks_.size();
+    }
+
+private:
+    struct Stats {
+        int firstFrame = 0;
+        int lastFrame = 0;
+        int lastReport = 0;     // frame of the last confirmed or live event
+        int hits = 0;
+        float closestD = 0.f;   // summaries use the closest approach, where the box has the most pixels
+        float closestX = 0.f;
+        float closestSize = 0.f;
+        float latestD = 0.f;
+        float latestX = 0.f;
+        float latestSize = 0.f;
+        float maxScore = 0.f;
+    };
+
+    void emit(TrackEventType type, int id, const Stats& stats);
+
+    int liveInterval_;
+    std::unordered_map<int, Stats> tracks_;
+    std::vector<int> confirmed_;        // ids first observed since the last finishFrame
+    std::vector<StreamedTrack> events_;
+};
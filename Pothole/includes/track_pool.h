@@ -0,0 +1,81 @@
+/**
+ * @desc:   fixed-capacity structure-of-arrays storage of the SORT tracks.
+ */
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "kalman_box_tracker.h"
+
+namespace sort
+{
+    /**
+     * @brief every per-track field lives in its own array indexed by slot, sized once at construction.
+     *        Slots of dead tracks go back to a free list and are reused by the next spawn, so a steady
+     *        scene tracks without touching the heap. Tracker IDs keep counting up across slot reuse.
+     */
+    class TrackPool
+    {
+    // variables
+    public:
+        std::vector<int> id;                // tracker id shown to the user
+        std::vector<int> timeSinceUpdate;   // frames since the last matched detection
+        std::vector<int> hitStreak;         // consecutive matched frames
+        std::vector<float> xc, yc, w, h;    // latest predicted or corrected box
+        std::vector<float> score;           // of the last matched detection
+        std::vector<int> classId;
+        KalmanBoxTracker filters;           // batched, one filter slot per track slot
+    private:
+        static std::atomic<int> count;      // shared by every tracker, so ids stay unique across cameras
+        std::vector<int> live;              // occupied slots, dense
+        std::vector<int> livePos;           // position of each occupied slot in live
+        std::vector<int> freeSlots;
+        int highWater = 0;                  // one past the highest occupied slot
+
+    // methods
+    public:
+        explicit TrackPool(int capacity = 256);
+        TrackPool(const TrackPool&) = delete;
+        TrackPool& operator=(const TrackPool&) = delete;
+
+        /**
+         * @brief claim a slot for a new track and start its filter at bbox.
+         * @param bbox bounding box, [xc, yc, w, h]
+         * @return slot index, -1 when the pool is full
+         */
+        int spawn(const float *bbox);
+
+        /**
+         * @brief free slot; the last live slot takes its place in liveSlots().
+         */
+        void release(int slot);
+
+        inline const std::vector<int> &liveSlots() const
+        {
+            return live;
+        }
+
+        inline int size() const
+        {
+            return (int)live.size();
+        }
+
+        /**
+         * @brief every occupied slot is below extent(), the range batched filter passes run over.
+         */
+        inline int extent() const
+        {
+            return highWater;
+        }
+
+        inline int capacity() const
+        {
+            return (int)id.size();
+        }
+
+        static inline int getTrackCount()
+        {
+            return TrackPool::count;
+        }
+    };
+}
@@ -0,0 +1,93 @@
+#ifndef TRACKER_VIDEO_RECORDER_H
+#define TRACKER_VIDEO_RECORDER_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/cuda.hpp>
+#include "bounded_queue.h"
+#include "overlay.h"
+
+/**
+ * @brief one box of the recorded overlay
+ */
+struct OverlayBox {
+    cv::Rect box;
+    cv::Scalar color;
+    std::string label;          // drawn on a filled band above the box
+    cv::Point contact;          // ground contact point, marked with a dot
+};
+
+struct RecordFrame {
+    cv::Mat host;
+    cv::cuda::GpuMat device;    // preferred when set, annotated and encoded without leaving the GPU
+    std::vector<OverlayBox> boxes;
+    bool annotated = false;     // already carries the overlays (frames rendered for the window)
+};
+
+/**
+ * @brief annotated video sink running on its own thread. Frames are queued with drop-oldest so a
+ *        slow encoder never stalls tracking. With OpenCV's cudacodec (4.7+) boxes are drawn into the
+ *        device frame and NVENC encodes it; labels are rasterised on the host as small strips and
+ *        uploaded into place. Without it, frames are annotated with OpenCV on the host and written
+ *        by cv::VideoWriter.
+ */
+class VideoRecorder {
+public:
+    /**
+     * @param path          output file; NVENC writes the codec's elementary stream (e.g. .h264)
+     * @param fps           frame rate stored in the output
+     * @param queue_frames  frames buffered while the encoder is busy, the oldest are dropped beyond
+     * @param device        CUDA device of the encoder and the overlay kernels, bound on the writer
+     *                      thread; submitted device frames must live on it
+     */
+    VideoRecorder(const std::string &path, double fps, size_t queue_frames = 8, int device = 0);
+    ~VideoRecorder();
+    VideoRecorder(const VideoRecorder&) = delete;
+    VideoRecorder& operator=(const VideoRecorder&) = delete;
+
+    /**
+     * @brief queue a frame, never blocks
+     */
+    void submit(RecordFrame &&frame);
+
+    /**
+     * @brief stop taking frames, write the queued ones and close the file; the destructor does
+     *        the same. The counters stay readable.
+     */
+    void finish();
+
+    uint64_t written() const { return written_count.load(); }
+    uint64_t dropped() const { return queue.dropped(); }
+    bool usesNvenc() const { return nvenc != nullptr; }
+    int device() const { return cuda_device; }
+
+private:
+    struct NvencWriter;
+
+    void run();
+    bool open(cv::Size size);
+    bool writeDevice(RecordFrame &frame);
+    void writeHost(RecordFrame &frame);
+    static void drawHost(cv::Mat &img, const std::vector<OverlayBox> &boxes);
+    static cv::Rect labelRect(const OverlayBox &box, cv::Size frame, int &baseline);
+
+    std::string path;
+    double fps;
+    int cuda_device;
+    BoundedQueue<RecordFrame> queue;
+    bool opened = false;
+    bool failed = false;
+    cv::VideoWriter writer;
+    std::unique_ptr<NvencWriter> nvenc;
+    std::vector<OverlayRect> rects;
+    OverlayRect *d_rects = nullptr;
+    size_t d_rects_capacity = 0;
+    std::atomic<uint64_t> written_count{0};
+    std::thread worker;
+};
+
+#endif //TRACKER_VIDEO_RECORDER_H
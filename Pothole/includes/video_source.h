@@ -0,0 +1,80 @@
+#ifndef TRACKER_VIDEO_SOURCE_H
+#define TRACKER_VIDEO_SOURCE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/cuda.hpp>
+
+enum class DecodeBackend {
+    kAuto,      // NVDEC when OpenCV has cudacodec and the source opens with it, else VideoCapture
+    kNvdec,     // cv::cudacodec::VideoReader, frames stay on the GPU
+    kCpu        // cv::VideoCapture, frames decoded into host memory
+};
+
+DecodeBackend parseDecodeBackend(const std::string &name);
+
+/**
+ * @brief one decoded frame, either on the GPU (NVDEC) or in host memory (VideoCapture)
+ */
+struct VideoFrame {
+    cv::Mat host;
+    cv::cuda::GpuMat device;    // packed 8-bit BGR
+
+    bool onDevice() const { return !device.empty(); }
+    cv::Size size() const { return onDevice() ? device.size() : host.size(); }
+};
+
+/**
+ * @brief files, RTSP and camera sources behind one reader. The NVDEC backend decodes on the GPU,
+ *        converts NV12 to BGR with the decoder's post-processing and optionally resizes in the same
+ *        pass, so frames never cross PCIe on the way to the GPU letterbox. Device frames come from
+ *        a small pool that is recycled once every downstream holder has released its reference.
+ *        GStreamer pipelines and sources cudacodec can't open go through cv::VideoCapture.
+ */
+class VideoSource {
+public:
+    /**
+     * @param decode_size  hardware resize target of the NVDEC backend, empty keeps the source size
+     * @param first_frame  frame of a file to start at, e.g. to resume a camera on another GPU; the
+     *                     NVDEC backend decodes on the calling thread's current device
+     */
+    VideoSource(const std::string &path, DecodeBackend backend = DecodeBackend::kAuto,
+                cv::Size decode_size = cv::Size(), int first_frame = 0);
+    ~VideoSource();
+    VideoSource(const VideoSource&) = delete;
+    VideoSource& operator=(const VideoSource&) = delete;
+
+    bool isOpened() const;
+    bool read(VideoFrame &frame);
+    /**
+     * @brief restart a file from its first frame
+     */
+    bool rewind();
+
+    bool usesNvdec() const { return nvdec != nullptr; }
+    cv::Size sourceSize() const { return source_size; }
+    cv::Size frameSize() const { return frame_size; }  // size of the frames read(), after the hardware resize
+    double fps() const { return frame_rate; }
+    int frameCount() const { return frame_count; }
+
+private:
+    struct NvdecReader;
+
+    bool openNvdec(int first_frame);
+    bool openCapture(int first_frame);
+    cv::cuda::GpuMat &acquireDeviceFrame();
+
+    std::string path;
+    cv::Size decode_size;
+    cv::Size source_size;
+    cv::Size frame_size;
+    double frame_rate = 0.0;
+    int frame_count = 0;
+    cv::VideoCapture cap;
+    std::unique_ptr<NvdecReader> nvdec;   // keeps cudacodec out of this header
+    std::vector<cv::cuda::GpuMat> pool;
+};
+
+#endif //TRACKER_VIDEO_SOURCE_H
@@ -0,0 +1,108 @@
+/**
+ * @desc:   encoders for the detection batches POSTed to the notification server.
+ *
+ *          JSON (`application/json`): an array of
+ *              {"frame", "theta_deg", "detections": [{"id", "d", "x", "size"}], "timestamp_ms"}
+ *          track events add "event" ("confirmed" | "live" | "ended"), "score", "first_frame",
+ *          "last_frame" and "hits" to their detection.
+ *
+ *          Binary (`application/x-pothole-batch`), little-endian, version 2:
+ *              header   'P' 'H' | u8 version | u16 frame count | u32 payload bytes after the header
+ *              frame    varint body bytes, then the body:
+ *                         svarint frame number      absolute in the first frame, else delta to the previous
+ *                         svarint timestamp ms      same
+ *                         svarint theta             0.01 deg
+ *                         varint  track count
+ *                         per track:
+ *                           varint  id << 1 | delta  delta = 1 if the id was in the previous frame
+ *                           svarint d, x             0.01 m
+ *                           svarint size             0.0001 m^2
+ *                           u8      event            TrackEventType
+ *                           with an event:
+ *                             varint  score          0.001
+ *                             svarint first frame    frame number minus it
+ *                             svarint last frame     frame number minus it
+ *                             varint  hits
+ *                         with delta set, d/x/size are differences to that track in the previous frame.
+ *          Version 1 had no event fields.
+ *          `svarint` is a zigzag-mapped LEB128 varint. Deltas only reach back within one batch, so
+ *          every request decodes on its own whatever was dropped or reordered before it.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum class TrackEventType : uint8_t {
+    kFrame = 0,     // plain per-frame observation
+    kConfirmed,     // track reached SORT's minHits
+    kLive,          // periodic update of a confirmed track
+    kEnded          // track removed after maxAge unmatched frames
+};
+
+struct StreamedTrack {
+    int id;
+    float d;        // forward distance, m
+    float x;        // lateral offset, m
+    float size;     // m^2
+    TrackEventType event = TrackEventType::kFrame;
+    // event summaries only
+    float score = 0.f;      // best detection confidence
+    int firstFrame = 0;
+    int lastFrame = 0;
+    int hits = 0;           // frames the track was observed in
+};
+
+struct StreamedFrame {
+    static constexpr int kMaxTracks = 32;   // tracks beyond are not published
+    int frame = 0;
+    double thetaDeg = 0.0;
+    long long timestampMs = 0;
+    int count = 0;
+    StreamedTrack tracks[kMaxTracks];
+};
+
+enum class WireFormat {
+    kJson,
+    kBinary
+};
+
+/**
+ * @brief "json" or "binary", anything else falls back to JSON with a warning
+ */
+WireFormat parseWireFormat(const std::string& name);
+
+/**
+ * @return the Content-Type header value announcing the format
+ */
+const char* wireContentType(WireFormat format);
+
+/**
+ * @brief appends frames of one request to a caller-owned buffer, which keeps its capacity
+ *        between requests; call begin(), append() per frame, then finish().
+ */
+class BatchEncoder {
+public:
+    explicit BatchEncoder(WireFormat format = WireFormat::kJson);
+
+    void begin(std::string& body);
+    void append(std::string& body, const StreamedFrame& frame);
+    void finish(std::string& body);
+
+    WireFormat format() const
+    {
+        return format_;
+    }
+
+    static constexpr uint8_t kVersion = 2;
+    static constexpr size_t kHeaderBytes = 9;
+
+private:
+    void appendJson(std::string& body, const StreamedFrame& frame);
+    void appendBinary(std::string& body, const StreamedFrame& frame);
+
+    WireFormat format_;
+    int frames_ = 0;
+    StreamedFrame previous_;    // delta reference, the last frame of this batch
+    std::string scratch_;       // one binary frame body, length-prefixed on append
+};
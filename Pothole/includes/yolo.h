@@ -1,9 +1,14 @@
 #ifndef TRACKER_YOLOV5_H
 #define TRACKER_YOLOV5_H
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/cuda.hpp>
 #include "NvInfer.h"
 #include "model.h"
+#include "nms.h"
 #include "yaml-cpp/yaml.h"
 
 class YOLO : public Model
@@ -12,12 +17,81 @@ public:
     explicit YOLO(const YAML::Node &yolov5_config);
     ~YOLO();
     std::vector<std::vector<DetectRes>> InferenceImages(std::vector<cv::Mat> &vec_img);
+    // Allocation-free form of InferenceImages for callers that keep out between frames: letterbox
+    // into the model's pinned input (or on the GPU), run, decode from the pinned output into out.
+    // At most BatchSize() images; regions as for PrepareImages, image_data as PrepareImages filled
+    // it for the same images and regions (letterboxed here when empty).
+    void Infer(Span<const cv::Mat> images, DetectionBatch &out, Span<const cv::Rect> regions = {},
+               Span<const float> image_data = {});
+    // Split form of InferenceImages for pipelined callers: PrepareImages only touches host memory
+    // and may run on another thread, Infer / Submit own the device buffers and stream.
+    // regions optionally limit each image to a crop (e.g. the road band below the horizon): only the
+    // crop is letterboxed and boxes come back in full-frame coordinates. A dynamic-height engine then
+    // runs at the crop's aspect instead of the full square. Pass the same regions to both calls.
+    // image_data is resized in place, so a tensor handed back by the caller is reused; it stays empty
+    // with the GPU preprocess.
+    void PrepareImages(Span<const cv::Mat> images, std::vector<float> &image_data, Span<const cv::Rect> regions = {});
+    std::vector<float> PrepareImages(std::vector<cv::Mat> &vec_img, const std::vector<cv::Rect> &regions = {});
+    std::vector<std::vector<DetectRes>> InferencePrepared(std::vector<cv::Mat> &vec_img, std::vector<float> &image_data,
+                                                          const std::vector<cv::Rect> &regions = {});
+    // Asynchronous form backed by num_contexts execution contexts: Submit enqueues the H2D copy,
+    // inference and D2H copy of a batch and returns a ticket (0 when every context is busy, collect
+    // the oldest ticket first); Collect waits on the batch's CUDA event and decodes it. Tickets
+    // complete in submission order. Must be driven from a single thread.
+    uint64_t Submit(Span<const cv::Mat> images, Span<const float> image_data = {}, Span<const cv::Rect> regions = {});
+    std::vector<std::vector<DetectRes>> Collect(uint64_t ticket);
+    void Collect(uint64_t ticket, DetectionBatch &out);     // into a reused arena, empty on an unknown ticket
+    int MaxInFlight() const { return NUM_CONTEXTS; }
+    int BatchSize() const { return BATCH_SIZE; }    // images per Submit / Inference* call at most
+    // Device-frame forms for NVDEC ingestion: packed 8-bit BGR frames already on the GPU are
+    // letterboxed in place, no host copy. With the CPU preprocess they are downloaded first.
+    // They must live on the model's Device().
+    uint64_t Submit(Span<const cv::cuda::GpuMat> frames, Span<const cv::Rect> regions = {});
+    void Infer(Span<const cv::cuda::GpuMat> frames, DetectionBatch &out, Span<const cv::Rect> regions = {});
+    std::vector<std::vector<DetectRes>> InferenceDevice(const std::vector<cv::cuda::GpuMat> &frames,
+                                                        const std::vector<cv::Rect> &regions = {});
+    // Runs the path the pipeline takes on a black frame of frame_size, runs times per execution
+    // context, so tactic warm-up, lazy allocations and CUDA graph capture are over before the first
+    // real frame. Returns the wall time.
+    std::chrono::steady_clock::duration Warmup(const cv::Size &frame_size, bool device_frames, int runs);
     void DrawResults(const std::vector<std::vector <DetectRes>> &detections, std::vector<cv::Mat> &vec_img);
 
 private:
     std::vector<float> prepareImage(std::vector<cv::Mat> &vec_img) override;
+    std::vector<float> prepareImage(const std::vector<cv::Mat> &vec_img, int input_h);
+    void prepareImage(Span<const cv::Mat> vec_img, float *data, int input_h);
+    // vec_img in pinned memory (stageFrames); the batch past it is cleared
+    bool prepareImageGpu(Span<const cv::Mat> vec_img, float *input,
+                         void *&raw, size_t &raw_size, cudaStream_t s, int input_h);
+    bool prepareImageDevice(Span<const cv::cuda::GpuMat> frames, float *input, cudaStream_t s, int input_h);
+    // network input height for a batch of regions: IMAGE_HEIGHT for a fixed engine, otherwise the
+    // smallest stride multiple that holds every region's letterbox
+    int inputHeightFor(Span<const cv::Rect> regions) const;
+    // sets the input shape of a dynamic engine on ctx, returns the anchors per image of the output
+    int bindInputHeight(nvinfer1::IExecutionContext *ctx, int input_h);
+    size_t inputBytes(int input_h) const;
+    size_t outputBytes(int boxes) const;
+    static void downloadFrames(Span<const cv::cuda::GpuMat> frames, std::vector<cv::Mat> &host);
+    // copies the frames into a pinned staging buffer, grown as needed, staged views them; false
+    // when it cannot be allocated
+    static bool stageFrames(Span<const cv::Mat> vec_img, uint8_t *&pinned, size_t &pinned_size,
+                            std::vector<cv::Mat> &staged);
+    void recordGpuTimes(const InferSlot &slot);     // stage histograms from the slot's events
+    void captureGraph(InferSlot &slot, bool device_preprocess, const std::vector<cv::Size> &shapes,
+                      const std::function<bool(bool)> &enqueue);
     float *ModelInference(std::vector<float> image_data) override;
-    std::vector<std::vector<DetectRes>> postProcess(const std::vector<cv::Mat> &vec_Mat, float *output);
+    // copies input (when not null, else buffers[0] is already filled) up, runs context on stream and
+    // brings the output (or the GPU postprocess's detections) back, synchronously
+    bool inferSync(const float *input, size_t input_bytes, float *output);
+    // binds input_h on context, runs inferSync and decodes infer_regions into out
+    void inferRegions(const float *input, size_t input_bytes, int input_h, DetectionBatch &out);
+    void postProcess(Span<const cv::Rect> regions, const float *output, int input_h, int boxes, DetectionBatch &out);
+    void postProcessImage(const cv::Rect &region, const float *image, int input_h, int boxes, DetectionBatch &out);
+    // an image that overflowed the device candidates is copied back from device_output to
+    // host_output on s and decoded on the host
+    void collectGpuDetections(Span<const cv::Rect> regions, const GpuDetections &det, int input_h, int boxes_per_image,
+                              const void *device_output, float *host_output, cudaStream_t s, DetectionBatch &out);
+    size_t imageOutputFloats(int boxes) const { return dynamic_input ? size_t(CATEGORY + 4) * boxes : size_t(outSize); }
     void NmsDetect(std::vector <DetectRes> &detections);
     static float IOUCalculate(const DetectRes &det_a, const DetectRes &det_b);
     std::map<int, std::string> class_labels;
@@ -30,6 +104,32 @@ private:
     std::vector<cv::Scalar> class_colors;
     std::vector<int> num_anchors;
     int num_rows = 0;
+    std::atomic<bool> gpu_preprocess{true};     // letterbox on the GPU straight into buffers[0]
+    void *raw_buffer = nullptr;         // device copy of the 8-bit BGR frame
+    size_t raw_buffer_size = 0;
+    uint8_t *host_raw = nullptr;        // pinned staging copy of the frames uploaded to raw_buffer
+    size_t host_raw_size = 0;
+    bool gpu_postprocess = true;        // threshold + compaction + NMS on the device
+    int gpu_max_detections = 100;       // boxes copied back per image by the GPU postprocess
+    GpuDetections sync_detections;      // GPU postprocess buffers of the synchronous path
+    int num_boxes = 0;                  // anchors per image in the output tensor, at the largest input height
+    int sync_input_height = 0;          // input height bound on context for the next inferSync
+    int sync_num_boxes = 0;
+    std::vector<DetectRes> decode_buffer;   // preallocated host decode output, num_boxes entries
+    std::vector<DetectRes> nms_buffer;      // one image's candidates through NMS, reused
+    // per-batch scratch of the inference thread (Infer, Submit), grown once; crops are views and
+    // dropped after each call so decoder frames go back to their pool
+    std::vector<cv::Rect> infer_regions;
+    std::vector<cv::Mat> infer_crops;
+    std::vector<cv::cuda::GpuMat> device_crops;
+    std::vector<cv::Mat> host_frames;       // downloaded device frames (CPU preprocess)
+    std::vector<cv::Mat> staged_frames;     // views of a pinned staging buffer (GPU preprocess)
+    std::vector<cv::Size> frame_shapes;     // what a captured graph is keyed on
+    std::vector<cv::Rect> prepare_regions;  // PrepareImages' own, it may run on the preprocess thread
+    std::vector<cv::Mat> prepare_crops;
+    DetectionBatch results;                 // arena of the vector-returning calls
+    bool use_cuda_graph = false;        // replay preprocess + enqueue + D2H per context as a CUDA graph
+    NmsEngine nms_engine;               // host NMS: top-K + grid-bucketed DIoU suppression
 
 };
 
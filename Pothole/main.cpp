@@ -5,105 +5,33 @@
 #include <chrono>
 #include <iomanip>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <csignal>
+#include <tuple>
 #include "yolo.h"
+#include "engine_builder.h"
 #include "sort.h"
 #include "logging.h"
+#include "bounded_queue.h"
+#include "batch_scheduler.h"
+#include "distance_streamer.h"
+#include "track_events.h"
+#include "video_source.h"
+#include "video_recorder.h"
+#include "detect_cadence.h"
+#include "imu_stream.h"
+#include "VisionPitch.hpp"
+#include "metrics.h"
+#include "detection_log.h"
+#include "DistanceEstimator.hpp"
 
 using namespace cv;
 using namespace std;
 using namespace sort;
 
 static Logger logger;
-#include <curl/curl.h>  // apt install libcurl4-openssl-dev
-
-/**********************************************
-* Real-time Distance Streamer
-**********************************************/
-class RealtimeDistanceStreamer {
-public:
-    RealtimeDistanceStreamer(const string& endpoint_url = "http://localhost:5000/webhook")
-        : endpoint_(endpoint_url) {
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-    }
-
-    ~RealtimeDistanceStreamer() {
-        curl_global_cleanup();
-    }
-
-    void send_detection(int trackerId, float distance_m, float lateral_m, int frame_num, double theta_deg) {
-        // Construct JSON payload
-        char json[512];
-        snprintf(json, sizeof(json),
-            "{"
-            "\"track_id\": %d, "
-            "\"distance_m\": %.2f, "
-            "\"lateral_m\": %.2f, "
-            "\"frame\": %d, "
-            "\"theta_deg\": %.2f, "
-            "\"timestamp_ms\": %lld"
-            "}",
-            trackerId, distance_m, lateral_m, frame_num, theta_deg,
-            chrono::duration_cast<chrono::milliseconds>(
-                chrono::high_resolution_clock::now().time_since_epoch()).count()
-        );
-
-        // Send via POST (non-blocking in separate thread)
-        std::thread(&RealtimeDistanceStreamer::_post_json, this, json).detach();
-    }
-
-    void send_batch(const vector<pair<int, pair<float, float>>>& detections, int frame_num, double theta_deg, 
-                    const vector<pair<int, pair<float, float>>>& sizes = {}) {
-        char json[4096];
-        int pos = snprintf(json, sizeof(json), "{"
-            "\"frame\": %d, "
-            "\"theta_deg\": %.2f, "
-            "\"detections\": [", frame_num, theta_deg);
-
-        for (size_t i = 0; i < detections.size(); ++i) {
-            int id = detections[i].first;
-            float D = detections[i].second.first;
-            float X = detections[i].second.second;
-            float size = 0.0f;
-            if (i < sizes.size()) {
-                size = sizes[i].second.first; // size in square meters
-            }
-            pos += snprintf(json + pos, sizeof(json) - pos,
-                "{\"id\": %d, \"d\": %.2f, \"x\": %.2f, \"size\": %.4f}%s",
-                id, D, X, size, i < detections.size()-1 ? ", " : "");
-        }
-        pos += snprintf(json + pos, sizeof(json) - pos, "], "
-            "\"timestamp_ms\": %lld}",
-            chrono::duration_cast<chrono::milliseconds>(
-                chrono::high_resolution_clock::now().time_since_epoch()).count());
-
-        std::thread(&RealtimeDistanceStreamer::_post_json, this, json).detach();
-    }
-
-private:
-    string endpoint_;
-
-    void _post_json(const string& json_str) {
-        CURL* curl = curl_easy_init();
-        if (!curl) return;
-
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-
-        curl_easy_setopt(curl, CURLOPT_URL, endpoint_.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_str.c_str());
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 1L);  // 1s timeout so it doesn't block
-
-        CURLcode res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            // Silent fail - don't spam console
-        }
-
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-    }
-};
-
+static std::atomic<bool> gInterrupted{false};  // SIGINT/SIGTERM, the only way out of --headless
 /**********************************************
 * Utilities
 **********************************************/
@@ -116,165 +44,64 @@ vector<Scalar> generateColors(int numColors) {
     return colors;
 }
 
-Mat convertDetectionsToSort(const vector<DetectRes>& detections) {
-    if (detections.empty()) {
-        return Mat(0, 5, CV_32F);
-    }
-    Mat sortInput(detections.size(), 5, CV_32F);
+void convertDetectionsToSort(Span<const DetectRes> detections, vector<Detection>& sortInput) {
+    sortInput.resize(detections.size());
     for (size_t i = 0; i < detections.size(); ++i) {
         const auto& det = detections[i];
-        float x1 = det.x - det.w / 2.0f;
-        float y1 = det.y - det.h / 2.0f;
-        float x2 = det.x + det.w / 2.0f;
-        float y2 = det.y + det.h / 2.0f;
-        sortInput.at<float>(i, 0) = x1;
-        sortInput.at<float>(i, 1) = y1;
-        sortInput.at<float>(i, 2) = x2;
-        sortInput.at<float>(i, 3) = y2;
-        sortInput.at<float>(i, 4) = det.prob;
+        sortInput[i] = {det.x, det.y, det.w, det.h, det.prob, det.classes};
     }
-    return sortInput;
 }
 
-/**********************************************
-* Distance + Pitch Fuser
-**********************************************/
-struct CamIntrinsics {
-    float fx, fy, cx, cy;
-};
-
-class ThetaFuser {
-public:
-    explicit ThetaFuser(double alpha=0.985)
-        : alpha_(alpha), initialized_(false), theta_(0.0), bias_(0.0) {}
-
-    void initialize_from_imu(double theta_imu_rad) {
-        theta_ = theta_imu_rad;
-        initialized_ = true;
-    }
-    void propagate(double gyro_pitch_rate_rad_s, double dt) {
-        if (!initialized_) return;
-        theta_ += (gyro_pitch_rate_rad_s - bias_) * dt;
-    }
-    void imu_absolute_update(double theta_abs_rad, double weight=0.2) {
-        if (!initialized_) { initialize_from_imu(theta_abs_rad); return; }
-        double a = clamp01(weight);
-        theta_ = a*theta_abs_rad + (1.0-a)*theta_;
-    }
-    void vision_update(double theta_vis_rad, double confidence) {
-        if (!initialized_) { initialize_from_imu(theta_vis_rad); return; }
-        double conf = clamp01(confidence);
-        double a = std::pow(alpha_, (1.0 - conf));
-        theta_ = a*theta_ + (1.0 - a)*theta_vis_rad;
-    }
-    void stationary_bias_learn(double gyro_pitch_rate_rad_s, double learn_rate=0.002) {
-        bias_ = (1.0 - learn_rate)*bias_ + learn_rate*gyro_pitch_rate_rad_s;
-    }
-    double theta() const { return theta_; }
-
-private:
-    double alpha_;
-    bool initialized_;
-    double theta_;
-    double bias_;
-    static double clamp01(double v) { return v < 0 ? 0 : (v > 1 ? 1 : v); }
-};
-
-inline Point2f bbox_contact_point(const Rect& box, int img_h, int extra_pixels=2) {
-    float x = box.x + box.width * 0.5f;
-    float y = std::min<float>(img_h - 1, box.y + box.height - 1 + extra_pixels);
-    return {x, y};
+// SORT reports centre/size boxes
+Rect trackedRect(const TrackedBox& t) {
+    int ix1 = cvRound(t.xc - t.w / 2.0f);
+    int iy1 = cvRound(t.yc - t.h / 2.0f);
+    int ix2 = cvRound(t.xc + t.w / 2.0f);
+    int iy2 = cvRound(t.yc + t.h / 2.0f);
+    return Rect(ix1, iy1, ix2 - ix1, iy2 - iy1);
 }
 
-class GroundDistance {
-public:
-    GroundDistance(const CamIntrinsics& K, float cam_height_m)
-    : K_(K), H_(cam_height_m), cached_theta_(0.0), 
-      cached_sin_(0.0), cached_cos_(1.0), cached_H_cos_(cam_height_m) {}
-
-    void update_theta_cache(double theta_rad) {
-        if (std::abs(theta_rad - cached_theta_) > 1e-6) {
-            cached_theta_ = theta_rad;
-            cached_sin_ = std::sin(theta_rad);
-            cached_cos_ = std::cos(theta_rad);
-            cached_H_cos_ = H_ * cached_cos_;
-        }
-    }
-
-    bool distance_from_pixel(const Point2f& px,
-                             float& out_D_m, float& out_X_m,
-                             float minD=0.5f, float maxD=200.0f) const
-    {
-        double yn = (px.y - K_.cy) / K_.fy;
-        double xn = (px.x - K_.cx) / K_.fx;
-        
-        double denom = cached_sin_ + yn * cached_cos_;
-        
-        if (denom <= 1e-4) return false;
-        
-        double D = cached_H_cos_ / denom;
-        
-        if (!std::isfinite(D) || D < 0) return false;
-        
-        double X = D * xn;
-        
-        D = std::max<double>(minD, std::min<double>(maxD, D));
-        X = std::max<double>(-50.0, std::min<double>(50.0, X));
-        
-        out_D_m = static_cast<float>(D);
-        out_X_m = static_cast<float>(X);
-        return true;
-    }
+// ground contact of a tracked box: bottom centre, just below the box edge
+Point contactPoint(const Rect& box, int img_h) {
+    return Point(box.x + box.width / 2, std::min(img_h - 1, box.y + box.height + 1));
+}
 
-private:
-    CamIntrinsics K_;
-    float H_;
-    mutable double cached_theta_;
-    mutable double cached_sin_;
-    mutable double cached_cos_;
-    mutable double cached_H_cos_;
-};
+// detector input for --roi: the rows that can hold road within maxD, with a margin for box tops
+// and pitch error; snapped to 16 rows so the crop (and a dynamic engine's shape) stays put
+Rect roadBand(const GroundDistance& gdist, Size frame, float maxD=200.0f, int margin=32) {
+    float top = gdist.row_at_distance(maxD) - margin;
+    if (!std::isfinite(top) || top <= 0.f)
+        return Rect(0, 0, frame.width, frame.height);
+    int y = int(top) / 16 * 16;
+    if (y >= frame.height - 64)
+        return Rect(0, 0, frame.width, frame.height);   // camera pitched up, keep the whole frame
+    return Rect(0, y, frame.width, frame.height - y);
+}
 
 /**********************************************
 * Drawing with Distance - OPTIMIZED
 **********************************************/
 void drawTrackedWithDistance(Mat& img,
-                             const Mat& trackedBboxes,
-                             const vector<Scalar>& colors,
-                             GroundDistance& gdist)
+                             const vector<TrackedBox>& trackedBboxes,
+                             const vector<GroundPoint>& ground,
+                             const vector<Scalar>& colors)
 {
     std::ostringstream oss;
     
-    for (int i = 0; i < trackedBboxes.rows; ++i) {
-        float x1 = trackedBboxes.at<float>(i, 0);
-        float y1 = trackedBboxes.at<float>(i, 1);
-        float x2 = trackedBboxes.at<float>(i, 2);
-        float y2 = trackedBboxes.at<float>(i, 3);
-        int trackerId = static_cast<int>(trackedBboxes.at<float>(i, 7));
-
-        int ix1 = cvRound(x1);
-        int iy1 = cvRound(y1);
-        int ix2 = cvRound(x2);
-        int iy2 = cvRound(y2);
-        
-        Rect box(ix1, iy1, ix2 - ix1, iy2 - iy1);
+    for (size_t i = 0; i < trackedBboxes.size(); ++i) {
+        const TrackedBox& tracked = trackedBboxes[i];
+        int trackerId = tracked.trackerId;
+        Rect box = trackedRect(tracked);
         Scalar color = colors[trackerId % colors.size()];
         
         rectangle(img, box, color, 2);
-
-        int contact_x = box.x + box.width / 2;
-        int contact_y = std::min(img.rows - 1, box.y + box.height + 1);
-        circle(img, Point(contact_x, contact_y), 3, Scalar(0, 255, 0), -1);
-
-        Point2f contact_f(contact_x, contact_y);
-        float D = 0.f, X = 0.f;
-        bool ok = gdist.distance_from_pixel(contact_f, D, X);
+        circle(img, contactPoint(box, img.rows), 3, Scalar(0, 255, 0), -1);
 
         oss.str("");
         oss.clear();
         oss << "ID:" << trackerId;
-        if (ok) {
-            oss << "|" << static_cast<int>(D + 0.5f) << "m";
+        if (i < ground.size() && ground[i].ok) {
+            oss << "|" << static_cast<int>(ground[i].d + 0.5f) << "m";
         }
         string label = oss.str();
 
@@ -293,6 +120,402 @@ void drawTrackedWithDistance(Mat& img,
     }
 }
 
+// the window overlay as recorder primitives, drawn off the render thread
+vector<OverlayBox> overlayBoxes(const vector<TrackedBox>& trackedBboxes,
+                                const vector<GroundPoint>& ground,
+                                const vector<Scalar>& colors, Size frameSize)
+{
+    vector<OverlayBox> boxes;
+    boxes.reserve(trackedBboxes.size());
+    for (size_t i = 0; i < trackedBboxes.size(); ++i) {
+        const TrackedBox& tracked = trackedBboxes[i];
+        OverlayBox b;
+        b.box = trackedRect(tracked);
+        b.color = colors[tracked.trackerId % colors.size()];
+        b.contact = contactPoint(b.box, frameSize.height);
+        b.label = "ID:" + to_string(tracked.trackerId);
+        if (i < ground.size() && ground[i].ok)
+            b.label += "|" + to_string(static_cast<int>(ground[i].d + 0.5f)) + "m";
+        boxes.push_back(std::move(b));
+    }
+    return boxes;
+}
+
+/**********************************************
+* Post-inference stage: SORT, ground distance and publishing
+**********************************************/
+// SORT's track lifetime and confirmation, in update() calls (detector frames)
+constexpr int kTrackMaxAge = 30;
+constexpr int kTrackMinHits = 3;
+
+// one loop of the video worth of tracks; the --run track stage and --replay drive the same code
+class FrameTracker {
+public:
+    FrameTracker(GroundDistance& gdist, RealtimeDistanceStreamer& streamer, AssignMethod assignMethod,
+                 int liveUpdateFrames, DetectionCadence* cadence = nullptr, bool announce = true)
+        : gdist(gdist), streamer(streamer), assignMethod(assignMethod), liveUpdateFrames(liveUpdateFrames),
+          cadence(cadence), announce(announce)
+    {
+        restart();
+    }
+
+    // close the open tracks and start over with a fresh tracker, e.g. when the video loops
+    void restart(int lastFrameNum = 0, double theta = 0.0) {
+        if (tracker)
+            finish(lastFrameNum, theta);
+        tracker = make_shared<Sort>(kTrackMaxAge, kTrackMinHits, 0.3f, 256, assignMethod);
+        trackEvents.reset(new TrackEventAggregator(liveUpdateFrames, tracker->getCapacity()));
+        sortOutput.resize(tracker->getCapacity());
+    }
+
+    /**
+     * @brief track one frame (detections are only used on keyframes, SORT coasts otherwise),
+     *        measure its tracks at pitch theta and publish the frame's track events
+     * @return tracks with a valid ground distance
+     */
+    size_t process(bool keyframe, Span<const DetectRes> detections, int frameNum, double theta,
+                   Size frameSize, vector<TrackedBox>& tracked, vector<GroundPoint>& ground) {
+        auto trackStart = chrono::steady_clock::now();
+        int numTracked;
+        if (keyframe) {
+            convertDetectionsToSort(detections, sortInput);
+            numTracked = tracker->update(sortInput, sortOutput);
+            if (cadence && cadence->enabled())
+                cadence->onKeyframe(tracker->getStats());
+        } else {
+            numTracked = tracker->coast(sortOutput);
+            if (cadence)
+                cadence->onCoast(tracker->getStats());
+        }
+        tracked.assign(sortOutput.begin(), sortOutput.begin() + numTracked);
+        auto distanceStart = chrono::steady_clock::now();
+        Metrics::instance().record(Stage::kTrack, distanceStart - trackStart);
+
+        gdist.update_theta_cache(theta);
+
+        // one distance per track and frame, the render stage draws these too
+        contacts.clear();
+        for (const TrackedBox& t : tracked)
+            contacts.push_back(contactPoint(trackedRect(t), frameSize.height));
+        ground.resize(contacts.size());
+        gdist.distances(contacts, ground);
+        auto publishStart = chrono::steady_clock::now();
+        Metrics::instance().record(Stage::kDistance, publishStart - distanceStart);
+
+        // Aggregate per track, only confirmed, live and ended events are published
+        size_t observed = 0;
+        for (size_t i = 0; i < tracked.size(); ++i) {
+            Rect box = trackedRect(tracked[i]);
+            float D = ground[i].d, X = ground[i].x;
+
+            if (ground[i].ok) {
+                // Calculate pothole size (bounding box area in real-world coordinates)
+                // Convert pixel dimensions to real-world size
+                // Approximate: use distance to estimate pixel-to-meter conversion
+                float pixel_width = box.width;
+                float pixel_height = box.height;
+                // Rough conversion: assume camera FOV and use distance
+                // More accurate would require camera calibration, but this is an approximation
+                float pixel_to_meter = D / (frameSize.height * 0.5f); // Approximate conversion
+                float size_m2 = (pixel_width * pixel_to_meter) * (pixel_height * pixel_to_meter);
+                trackEvents->observe({tracked[i].trackerId, D, X, size_m2, tracked[i].score}, frameNum);
+                ++observed;
+            }
+        }
+
+        // Stream events to server (non-blocking, queued for the publisher thread)
+        Span<const StreamedTrack> events = trackEvents->finishFrame(frameNum, tracker->getDeadIds());
+        streamer.send_events(events, frameNum, theta*180.0/M_PI);
+        for (const StreamedTrack& event : events) {
+            if (event.event != TrackEventType::kConfirmed)
+                continue;
+            ++confirmedCount;
+            if (announce) {
+                PLOG(Severity::kINFO) << "[DETECTED] Pothole #" << event.id << " confirmed at frame " << frameNum
+                                      << " (" << fixed << setprecision(2) << event.d << " m)";
+            }
+        }
+        Metrics::instance().record(Stage::kPublish, chrono::steady_clock::now() - publishStart);
+        return observed;
+    }
+
+    // end every open track, at a reset or shutdown
+    void finish(int lastFrameNum, double theta) {
+        streamer.send_events(trackEvents->flush(), lastFrameNum, theta*180.0/M_PI);
+    }
+
+    uint64_t confirmed() const { return confirmedCount; }
+
+private:
+    GroundDistance& gdist;
+    RealtimeDistanceStreamer& streamer;
+    AssignMethod assignMethod;
+    int liveUpdateFrames;
+    DetectionCadence* cadence;
+    bool announce;
+    Sort::Ptr tracker;
+    unique_ptr<TrackEventAggregator> trackEvents;
+    vector<Detection> sortInput;
+    vector<TrackedBox> sortOutput;
+    vector<Point2f> contacts;
+    uint64_t confirmedCount = 0;
+};
+
+/**********************************************
+* Pipelined frame executor
+**********************************************/
+// gives a frame's place in its camera's count back however the packet ends: tracked, or dropped by
+// a drop-oldest queue on the way
+struct InPipelineRelease {
+    void operator()(std::atomic<int>* count) const { --*count; }
+};
+
+struct FramePacket {
+    int camera = 0;             // index of the source stream
+    uint64_t seq = 0;           // capture order within the camera, strictly increasing
+    bool keyframe = true;       // goes through the detector, otherwise SORT coasts on its predictions
+    int epoch = 0;              // bumped every time the video loops (tracker reset)
+    int frameNum = 0;           // 1-based frame index within the epoch
+    int decodeDevice = 0;       // GPU the frame was decoded on
+    chrono::steady_clock::time_point captured;
+    Mat frame;                  // host frame, downloaded from gpuFrame for rendering when decoded by NVDEC
+    cuda::GpuMat gpuFrame;      // NVDEC frame, fed to the GPU letterbox without a host copy
+    Rect roi;                   // detector input region (--roi), empty for the full frame
+    // the keyframe's boxes stay in the arena of its batch, shared by the batch's packets and reused
+    // by the inference stage once none of them holds it any more
+    shared_ptr<const DetectionBatch> arena;
+    size_t arenaIndex = 0;
+    vector<TrackedBox> trackedBboxes;
+    vector<GroundPoint> ground;         // per tracked box, computed once by the track stage
+    double theta = 0.0;
+    size_t streamed = 0;
+    unique_ptr<std::atomic<int>, InPipelineRelease> inPipeline;    // held until the track stage pops it
+
+    Size frameSize() const { return frame.empty() ? gpuFrame.size() : frame.size(); }
+    Span<const DetectRes> detections() const {
+        return arena && arenaIndex < arena->size() ? (*arena)[arenaIndex] : Span<const DetectRes>();
+    }
+};
+using FrameQueue = BoundedQueue<FramePacket>;
+using FrameScheduler = BatchScheduler<FramePacket>;
+
+// the frames of one scheduler batch, the keyframes among them go through the engine in one call;
+// emptied batches go back to the preprocess stage so their vectors keep their capacity
+struct FrameBatch {
+    vector<FramePacket> packets;    // oldest first, any mix of cameras
+    vector<size_t> keyframes;       // indices into packets, in batch order
+    bool onDevice = false;          // keyframes are fed as GPU frames
+    vector<float> input;            // host tensor of the keyframes, only filled by the CPU preprocess path
+};
+using BatchQueue = BoundedQueue<FrameBatch>;
+
+// per-source state of --run; the detector and the publisher are shared
+struct CameraStream {
+    int index = 0;
+    string path;
+    CamIntrinsics K;
+    float H_m = 1.50f;
+    double theta0 = 0.0;                    // initial pitch, rad
+    bool live = false;
+    string window;
+    int shard = 0;                          // detector shard it is placed on, capture stage
+    int decodeDevice = 0;                   // GPU its decoder runs on, capture stage; packets carry their own
+    std::atomic<int> inPipeline{0};         // frames captured and neither tracked nor dropped yet
+    unique_ptr<VideoSource> cap;
+    int totalFrames = 0;
+    unique_ptr<DetectionCadence> cadence;   // capture and track stage
+    unique_ptr<GroundDistance> gdist;       // owned by the track stage
+    unique_ptr<GroundDistance> roiDist;     // owned by the batching stage, fed the latest fused pitch
+    ThetaFuser thetaFuser{0.985};           // track stage
+    std::atomic<double> latestTheta{0.0};
+    unique_ptr<VisionPitch> vision;
+    unique_ptr<DetectionLogWriter> detectionLog;
+    unique_ptr<FrameQueue> detectedQ;       // inference -> this camera's track stage
+    std::atomic<uint64_t> keyframes{0};
+    uint64_t frames = 0;                    // rendered, main thread only
+};
+
+// one detector per GPU, each with its own batching and inference stage; the cameras' track stages
+// are shared by all of them
+struct DetectorShard {
+    int device = 0;
+    string name;                            // GPU model
+    unique_ptr<YOLO> detector;
+    unique_ptr<FrameScheduler> capturedQ;   // a lane per camera, attached while the camera is placed here
+    unique_ptr<BatchQueue> preparedQ;
+    unique_ptr<BatchQueue> spareBatches;    // scattered batches back to the preprocess stage, for reuse
+    std::atomic<int> batchesInFlight{0};
+    std::atomic<int> cameras{0};
+    std::atomic<uint64_t> frames{0}, keyframes{0}, batches{0};
+    std::atomic<double> depth{0.0};         // load() averaged over the last batches, preprocess stage
+
+    // frames queued in front of the engine, what placement balances
+    size_t load() const {
+        return capturedQ->size() + (preparedQ->size() + size_t(batchesInFlight)) * size_t(detector->BatchSize());
+    }
+    double queueDepth() const { return depth.load(std::memory_order_relaxed); }
+};
+
+// frames between two checks of a file camera's placement against the measured queue depths
+constexpr int kPlacementCheckFrames = 150;
+
+// the shard with the shortest measured queues, the fewest cameras among equal ones
+int leastLoadedShard(const vector<unique_ptr<DetectorShard>>& shards) {
+    int best = 0;
+    for (int i = 1; i < int(shards.size()); ++i) {
+        const DetectorShard& s = *shards[i];
+        const DetectorShard& b = *shards[best];
+        if (make_pair(s.load(), s.cameras.load()) < make_pair(b.load(), b.cameras.load()))
+            best = i;
+    }
+    return best;
+}
+
+// "0,2" or "all"
+vector<int> parseDeviceList(const string& text) {
+    vector<int> devices;
+    int count = 0;
+    if (cudaGetDeviceCount(&count) != cudaSuccess)
+        count = 0;
+    if (text == "all") {
+        for (int d = 0; d < count; ++d)
+            devices.push_back(d);
+        return devices;
+    }
+    std::stringstream list(text);
+    string item;
+    while (getline(list, item, ',')) {
+        int d = atoi(item.c_str());
+        if (d < 0 || d >= count) {
+            cerr << "Error: no GPU " << item << " (" << count << " visible)" << endl;
+            return {};
+        }
+        if (find(devices.begin(), devices.end(), d) == devices.end())
+            devices.push_back(d);
+    }
+    return devices;
+}
+
+// "<path>[@fx,fy,cx,cy,h_m,theta_deg]": a camera whose calibration differs from --fx .. --theta_init_deg
+void parseCameraSpec(const string& spec, CameraStream& cam) {
+    size_t at = spec.rfind('@');
+    float fx, fy, cx, cy, h;
+    double thetaDeg;
+    char tail;
+    if (at != string::npos
+        && sscanf(spec.c_str() + at + 1, "%f,%f,%f,%f,%f,%lf%c", &fx, &fy, &cx, &cy, &h, &thetaDeg, &tail) == 6) {
+        cam.path = spec.substr(0, at);
+        cam.K = {fx, fy, cx, cy};
+        cam.H_m = h;
+        cam.theta0 = thetaDeg * M_PI / 180.0;
+    } else {
+        cam.path = spec;    // e.g. rtsp://user@host, the '@' is part of the path
+    }
+}
+
+// cameras and network streams can't be rewound and must not build up latency
+bool isLiveSource(const string& path) {
+    return path.rfind("rtsp://", 0) == 0 || path.rfind("http://", 0) == 0
+        || path.rfind("/dev/video", 0) == 0
+        || path.find('!') != string::npos;  // GStreamer pipeline
+}
+
+YAML::Node detectorConfig(const string& enginePath) {
+    YAML::Node config;
+    config["BATCH_SIZE"] = 1;
+    config["INPUT_CHANNEL"] = 3;
+    config["IMAGE_WIDTH"] = 640;
+    config["IMAGE_HEIGHT"] = 640;
+    config["INPUT_WIDTH"] = 640;
+    config["INPUT_HEIGHT"] = 640;
+    config["obj_threshold"] = 0.5;
+    config["nms_threshold"] = 0.4;
+    config["agnostic"] = false;
+    config["CATEGORY_NUM"] = 1;
+    config["onnx_file"] = "";
+    config["engine_file"] = enginePath;
+    config["labels_file"] = "";
+    config["strides"] = std::vector<int>{8, 16, 32};
+    std::vector<std::vector<int>> empty_anchors = {{}, {}, {}};
+    config["anchors"] = empty_anchors;
+    config["num_anchors"] = std::vector<int>{1, 1, 1};
+    return config;
+}
+
+/**********************************************
+* INT8 acceptance check
+**********************************************/
+struct DetectionAgreement {
+    int frames = 0;
+    size_t reference = 0;       // FP16 boxes
+    size_t candidate = 0;       // INT8 boxes
+    size_t matched = 0;
+    double iouSum = 0.0;
+    double scoreDiffSum = 0.0;
+
+    double recall() const { return reference ? double(matched) / reference : 1.0; }
+    double precision() const { return candidate ? double(matched) / candidate : 1.0; }
+};
+
+float boxIou(const DetectRes& a, const DetectRes& b) {
+    float w = std::min(a.x + a.w / 2, b.x + b.w / 2) - std::max(a.x - a.w / 2, b.x - b.w / 2);
+    float h = std::min(a.y + a.h / 2, b.y + b.h / 2) - std::max(a.y - a.h / 2, b.y - b.h / 2);
+    if (w <= 0.f || h <= 0.f)
+        return 0.f;
+    float inter = w * h;
+    return inter / (a.w * a.h + b.w * b.h - inter);
+}
+
+// one-to-one matches of the same class at IoU >= minIou, best pairs first
+void matchDetections(const vector<DetectRes>& reference, const vector<DetectRes>& candidate,
+                     DetectionAgreement& agreement, float minIou = 0.5f) {
+    vector<tuple<float, size_t, size_t>> pairs;
+    for (size_t i = 0; i < reference.size(); ++i)
+        for (size_t j = 0; j < candidate.size(); ++j) {
+            float iou = reference[i].classes == candidate[j].classes ? boxIou(reference[i], candidate[j]) : 0.f;
+            if (iou >= minIou)
+                pairs.emplace_back(iou, i, j);
+        }
+    std::sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return get<0>(a) > get<0>(b); });
+    vector<bool> usedRef(reference.size()), usedCand(candidate.size());
+    for (const auto& [iou, i, j] : pairs) {
+        if (usedRef[i] || usedCand[j])
+            continue;
+        usedRef[i] = usedCand[j] = true;
+        ++agreement.matched;
+        agreement.iouSum += iou;
+        agreement.scoreDiffSum += std::abs(reference[i].prob - candidate[j].prob);
+    }
+    agreement.reference += reference.size();
+    agreement.candidate += candidate.size();
+    ++agreement.frames;
+}
+
+// both engines on the same frames of a clip the calibration didn't see
+bool compareEngines(const string& referencePlan, const string& candidatePlan, const string& clipPath,
+                    int maxFrames, DetectionAgreement& agreement) {
+    try {
+        YOLO reference(detectorConfig(referencePlan));
+        YOLO candidate(detectorConfig(candidatePlan));
+        VideoCapture clip(clipPath);
+        if (!clip.isOpened()) {
+            cerr << "Error: Cannot open check clip: " << clipPath << endl;
+            return false;
+        }
+        Mat frame;
+        while (agreement.frames < maxFrames && clip.read(frame)) {
+            vector<Mat> frames = {frame};
+            vector<vector<DetectRes>> fp16 = reference.InferenceImages(frames);
+            vector<vector<DetectRes>> int8 = candidate.InferenceImages(frames);
+            matchDetections(fp16.empty() ? vector<DetectRes>() : fp16[0], int8.empty() ? vector<DetectRes>() : int8[0], agreement);
+        }
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return false;
+    }
+    return agreement.frames > 0;
+}
+
 /**********************************************
 * UI / CLI
 **********************************************/
@@ -305,48 +528,110 @@ void printUsage(const char* programName) {
     cout << "  " << programName << " --build-engine -o <onnx_path> -e <engine_output_path>" << endl;
     cout << "\n2. Run Inference:" << endl;
     cout << "  " << programName << " --run -v <video_path> -e <engine_path>" << endl;
+    cout << "\n3. Replay Recorded Detections (no video, no engine):" << endl;
+    cout << "  " << programName << " --replay <log_path>" << endl;
     cout << "\nOptions:" << endl;
     cout << "  --build-engine         Build TensorRT engine from ONNX" << endl;
     cout << "  --run                  Run inference on video" << endl;
-    cout << "  -v, --video <path>     Video file path (required for --run)" << endl;
-    cout << "  -o, --onnx <path>      ONNX model path (required for --build-engine)" << endl;
-    cout << "  -e, --engine <path>    TensorRT engine path (required)" << endl;
+    cout << "  --replay <path>        run tracking, distance and publishing on a detection log at full speed" << endl;
+    cout << "  -v, --video <path>     Video file path (required for --run); repeat for more cameras, a camera" << endl;
+    cout << "                         calibrated differently takes <path>@fx,fy,cx,cy,h_m,theta_deg" << endl;
+    cout << "  -o, --onnx <path>      ONNX model path (required for --build-engine; with --run, builds a missing or stale engine)" << endl;
+    cout << "  -e, --engine <path>    TensorRT engine path (required unless --onnx is given)" << endl;
     cout << "  --fx <val>             fx (pixels)" << endl;
     cout << "  --fy <val>             fy (pixels)" << endl;
     cout << "  --cx <val>             cx (pixels)" << endl;
     cout << "  --cy <val>             cy (pixels)" << endl;
     cout << "  --h_m <val>            camera height H in meters (default 1.50)" << endl;
     cout << "  --theta_init_deg <v>   initial pitch in degrees (IMU init, default 15)" << endl;
+    cout << "  --cpu-preprocess       letterbox frames on the CPU instead of the GPU" << endl;
+    cout << "  --live                 treat the source as a live camera (drop oldest frames)" << endl;
+    cout << "  --contexts <n>         async TensorRT execution contexts (default 2, 0 = synchronous)" << endl;
+    cout << "  --cpu-postprocess      decode and NMS on the CPU instead of the GPU" << endl;
+    cout << "  --cuda-graph           capture preprocess + inference per context as a CUDA graph" << endl;
+    cout << "  --assign <method>      SORT assignment solver: lapjv (default) or hungarian" << endl;
+    cout << "  --wire <format>        webhook body encoding: json (default) or binary" << endl;
+    cout << "  --live-updates <n>     also publish confirmed tracks every n frames (default 0 = off)" << endl;
+    cout << "  --decode <backend>     auto (default, NVDEC when available), nvdec or cpu (VideoCapture)" << endl;
+    cout << "  --decode-size <WxH>    resize in the NVDEC decoder (intrinsics are scaled to match)" << endl;
+    cout << "  --headless             no window, overlays or frame pacing; stop with Ctrl+C" << endl;
+    cout << "  --record <path>        write annotated video (NVENC H.264 when available) on a side thread" << endl;
+    cout << "  --detect-every <n>     detect on at most every n-th frame while tracks are stable (default 1, at most " << kTrackMaxAge - 1 << ");" << endl;
+    cout << "                         new, tentative or missed tracks go back to every frame, so a lost track lives" << endl;
+    cout << "                         under " << kTrackMaxAge << " + n frames and confirmation takes " << kTrackMinHits << " frames" << endl;
+    cout << "  --roi                  only feed the road band below the horizon to the detector" << endl;
+    cout << "  --dynamic-height <h>   build: height profile min(h,160):h:640 of a dynamic ONNX, optimized for h" << endl;
+    cout << "  --height-profile <p>   build: input height min:opt:max of a dynamic ONNX (default 160:320:640, H/4:H/2:H)" << endl;
+    cout << "  --batch-profile <p>    build: batch min:opt:max of a dynamic-batch ONNX (default: the --batch size," << endl;
+    cout << "                         1 for --build-engine, one per camera for --run)" << endl;
+    cout << "  --workspace <MiB>      build: TensorRT workspace limit (default 1024)" << endl;
+    cout << "  --timing-cache <path>  build: reuse and update this tactic timing cache" << endl;
+    cout << "  --engine-cache <dir>   plans keyed by GPU, TensorRT and ONNX hash; built once per key" << endl;
+    cout << "  --overwrite-engine     run: replace --engine when it is rebuilt from --onnx (default: cache only)" << endl;
+    cout << "  --int8                 build: INT8 post-training quantization (FP16 fallback)" << endl;
+    cout << "  --calib <path>         build: calibration frames, a video or an image directory" << endl;
+    cout << "  --calib-frames <n>     build: frames sampled for calibration (default 500)" << endl;
+    cout << "  --calib-cache <path>   build: calibration cache (default <engine>.calib)" << endl;
+    cout << "  --int8-check <clip>    build: accept the INT8 engine only if it agrees with FP16 on this clip" << endl;
+    cout << "  --int8-min-match <f>   build: required recall and precision against FP16 (default 0.9)" << endl;
+    cout << "  --imu <path>           gyro/accel samples (t,gx,gy,gz,ax,ay,az per line) for the pitch fuser" << endl;
+    cout << "  --vision-pitch <hz>    correct the pitch from the optical-flow FOE at this rate (default 0 = off)" << endl;
+    cout << "  --metrics-port <port>  serve per-stage latency percentiles at http://host:port/metrics" << endl;
+    cout << "  --metrics-every <s>    print the per-stage latency table every s seconds" << endl;
+    cout << "  --log-level <level>    verbose, info, warning or error (default info); also TensorRT's messages" << endl;
+    cout << "  --warmup <n>           run n inferences per context on a blank frame before the first real one" << endl;
+    cout << "  --record-detections <path>  run: log the detector output and pitch per frame for --replay" << endl;
+    cout << "  --batch <n>            run: frames per inference across cameras (default: one per camera); build: the batch" << endl;
+    cout << "                         a dynamic-batch ONNX is built for without --batch-profile (default 1)" << endl;
+    cout << "  --batch-wait <ms>      run: longest a frame waits for other cameras to fill its batch (default 5)" << endl;
+    cout << "  --gpus <list>          run: one detector per GPU, e.g. 0,1 or all (default 0)" << endl;
+    cout << "  --once                 run: stop at the end of a video file instead of looping" << endl;
     cout << "\nControls:" << endl;
     cout << "  SPACEBAR               Pause/Resume" << endl;
     cout << "  ESC                    Exit" << endl;
     cout << "==================================================" << endl;
 }
 
-bool buildEngine(const string& onnxPath, const string& enginePath) {
+// "min:opt:max" or a single value for all three
+bool parseProfile(const string& text, int& lo, int& opt, int& hi) {
+    int n = sscanf(text.c_str(), "%d:%d:%d", &lo, &opt, &hi);
+    if (n == 1)
+        opt = hi = lo;
+    return (n == 1 || n == 3) && lo > 0 && lo <= opt && opt <= hi;
+}
+
+bool buildEngine(const EngineBuildOptions& options, const EngineKey& key, const string& enginePath, const string& cacheDir) {
     cout << "\n==================================================" << endl;
     cout << "Building TensorRT Engine" << endl;
     cout << "==================================================" << endl;
-    cout << "ONNX file: " << onnxPath << endl;
-    cout << "Output engine: " << enginePath << endl;
+    cout << "ONNX file: " << options.onnx_file << endl;
+    cout << "Output engine: " << (enginePath.empty() ? "(cache only)" : enginePath) << endl;
+    string cachePath = cacheDir.empty() ? "" : cachedEnginePath(cacheDir, options, key);
+    cout << "Key: " << key.str() << endl;
+    if (!options.timing_cache.empty())
+        cout << "Timing cache: " << options.timing_cache << endl;
     cout << "==================================================" << endl;
 
-    string cmd = "/usr/src/tensorrt/bin/trtexec "
-                 "--onnx=" + onnxPath + " "
-                 "--saveEngine=" + enginePath + " "
-                 "--fp16 "
-                 "--useCudaGraph "
-                 "--useSpinWait "
-                 "--avgRuns=100 "
-                 "--verbose";
-    cout << "\nExecuting: " << cmd << endl;
-    cout << "\nBuilding engine (this may take a few minutes)...\n" << endl;
-
-    int result = system(cmd.c_str());
-    if (result == 0) {
+    // a node with the same GPU, TensorRT and model finds the plan in the shared cache
+    bool success = false;
+    EnginePlanFile cached(cachePath);
+    if (cached.isOpened() && cached.tagged() && cached.key().mismatch(key, true).empty()) {
+        cout << "\nCached plan " << cachePath << " matches, nothing to build" << endl;
+        success = enginePath.empty() || writeEnginePlan(enginePath, key, cached.plan(), cached.planSize());
+    } else {
+        cout << "\nBuilding engine (this may take a few minutes)...\n" << endl;
+        unique_ptr<nvinfer1::IHostMemory> plan = buildSerializedEngine(options);
+        success = plan != nullptr;
+        if (success && !enginePath.empty())
+            success = writeEnginePlan(enginePath, key, plan->data(), plan->size());
+        if (success && !cachePath.empty())
+            success = writeEnginePlan(cachePath, key, plan->data(), plan->size());
+    }
+
+    if (success) {
         cout << "\n==================================================" << endl;
         cout << "Engine built successfully!" << endl;
-        cout << "Engine saved to: " << enginePath << endl;
+        cout << "Engine saved to: " << (enginePath.empty() ? cachePath : enginePath) << endl;
         cout << "==================================================" << endl;
         return true;
     } else {
@@ -357,19 +642,57 @@ bool buildEngine(const string& onnxPath, const string& enginePath) {
     }
 }
 int main(int argc, char** argv) {
-    string mode, videoPath, onnxPath, enginePath;
+    string mode, onnxPath, enginePath;
+    vector<string> videoSpecs;
 
     CamIntrinsics K{600.f, 600.f, 640.f/2.f, 480.f/2.f};
     float H_m = 1.50f;
     double theta_init_deg = 15.0;
+    bool gpuPreprocess = true;
+    bool liveSource = false;
+    int numContexts = 2;
+    bool cudaGraph = false;
+    bool gpuPostprocess = true;
+    AssignMethod assignMethod = AssignMethod::kLapjv;
+    WireFormat wireFormat = WireFormat::kJson;
+    int liveUpdateFrames = 0;
+    DecodeBackend decodeBackend = DecodeBackend::kAuto;
+    Size decodeSize;
+    bool headless = false;
+    string recordPath;
+    int maxDetectInterval = 1;
+    bool roiCrop = false;
+    int dynamicHeight = 0;
+    int minHeight = 0, optHeight = 0, maxHeight = 0;
+    int minBatch = 0, optBatch = 0, maxBatch = 0;     // 0 until --batch-profile: the batch the engine runs at
+    int workspaceMiB = 0;
+    string timingCache, engineCacheDir;
+    bool overwriteEngine = false;
+    bool int8 = false;
+    string calibSource, calibCache, int8CheckClip;
+    int calibFrames = 500;
+    double int8MinMatch = 0.9;
+    string imuPath;
+    double visionPitchHz = 0.0;
+    int metricsPort = 0;
+    double metricsEvery = 0.0;
+    string logLevel = "info";
+    string detectionLogPath;
+    int warmupRuns = 0;
+    string replayPath;
+    int batchSize = 0;
+    double batchWaitMs = 5.0;
+    string gpuList = "0";
+    bool playOnce = false;
 
     for (int i = 1; i < argc; ++i) {
         string arg = argv[i];
         if (arg == "-h" || arg == "--help") { printUsage(argv[0]); return 0; }
         else if (arg == "--build-engine") { mode = "build"; }
         else if (arg == "--run") { mode = "run"; }
+        else if (arg == "--replay" && i+1 < argc) { mode = "replay"; replayPath = argv[++i]; }
         else if (arg == "-v" || arg == "--video") {
-            if (i + 1 < argc) videoPath = argv[++i]; else { cerr << "Error: --video needs path\n"; return -1; }
+            if (i + 1 < argc) videoSpecs.push_back(argv[++i]); else { cerr << "Error: --video needs path\n"; return -1; }
         }
         else if (arg == "-o" || arg == "--onnx") {
             if (i + 1 < argc) onnxPath = argv[++i]; else { cerr << "Error: --onnx needs path\n"; return -1; }
@@ -383,263 +706,1157 @@ int main(int argc, char** argv) {
         else if (arg == "--cy" && i+1 < argc) { K.cy = stof(argv[++i]); }
         else if (arg == "--h_m" && i+1 < argc) { H_m = stof(argv[++i]); }
         else if (arg == "--theta_init_deg" && i+1 < argc) { theta_init_deg = stod(argv[++i]); }
+        else if (arg == "--cpu-preprocess") { gpuPreprocess = false; }
+        else if (arg == "--live") { liveSource = true; }
+        else if (arg == "--contexts" && i+1 < argc) { numContexts = stoi(argv[++i]); }
+        else if (arg == "--cuda-graph") { cudaGraph = true; }
+        else if (arg == "--cpu-postprocess") { gpuPostprocess = false; }
+        else if (arg == "--assign" && i+1 < argc) { assignMethod = parseAssignMethod(argv[++i]); }
+        else if (arg == "--wire" && i+1 < argc) { wireFormat = parseWireFormat(argv[++i]); }
+        else if (arg == "--live-updates" && i+1 < argc) { liveUpdateFrames = stoi(argv[++i]); }
+        else if (arg == "--headless") { headless = true; }
+        else if (arg == "--record" && i+1 < argc) { recordPath = argv[++i]; }
+        else if (arg == "--detect-every" && i+1 < argc) { maxDetectInterval = stoi(argv[++i]); }
+        else if (arg == "--roi") { roiCrop = true; }
+        else if (arg == "--dynamic-height" && i+1 < argc) { dynamicHeight = stoi(argv[++i]); }
+        else if (arg == "--height-profile" && i+1 < argc) {
+            if (!parseProfile(argv[++i], minHeight, optHeight, maxHeight)) { cerr << "Error: --height-profile needs min:opt:max\n"; return -1; }
+        }
+        else if (arg == "--batch-profile" && i+1 < argc) {
+            if (!parseProfile(argv[++i], minBatch, optBatch, maxBatch)) { cerr << "Error: --batch-profile needs min:opt:max\n"; return -1; }
+        }
+        else if (arg == "--workspace" && i+1 < argc) { workspaceMiB = stoi(argv[++i]); }
+        else if (arg == "--timing-cache" && i+1 < argc) { timingCache = argv[++i]; }
+        else if (arg == "--engine-cache" && i+1 < argc) { engineCacheDir = argv[++i]; }
+        else if (arg == "--overwrite-engine") { overwriteEngine = true; }
+        else if (arg == "--int8") { int8 = true; }
+        else if (arg == "--calib" && i+1 < argc) { calibSource = argv[++i]; }
+        else if (arg == "--calib-frames" && i+1 < argc) { calibFrames = stoi(argv[++i]); }
+        else if (arg == "--calib-cache" && i+1 < argc) { calibCache = argv[++i]; }
+        else if (arg == "--int8-check" && i+1 < argc) { int8CheckClip = argv[++i]; }
+        else if (arg == "--int8-min-match" && i+1 < argc) { int8MinMatch = stod(argv[++i]); }
+        else if (arg == "--imu" && i+1 < argc) { imuPath = argv[++i]; }
+        else if (arg == "--vision-pitch" && i+1 < argc) { visionPitchHz = stod(argv[++i]); }
+        else if (arg == "--metrics-port" && i+1 < argc) { metricsPort = stoi(argv[++i]); }
+        else if (arg == "--metrics-every" && i+1 < argc) { metricsEvery = stod(argv[++i]); }
+        else if (arg == "--log-level" && i+1 < argc) { logLevel = argv[++i]; }
+        else if (arg == "--record-detections" && i+1 < argc) { detectionLogPath = argv[++i]; }
+        else if (arg == "--warmup" && i+1 < argc) { warmupRuns = stoi(argv[++i]); }
+        else if (arg == "--batch" && i+1 < argc) { batchSize = stoi(argv[++i]); }
+        else if (arg == "--batch-wait" && i+1 < argc) { batchWaitMs = stod(argv[++i]); }
+        else if (arg == "--gpus" && i+1 < argc) { gpuList = argv[++i]; }
+        else if (arg == "--once") { playOnce = true; }
+        else if (arg == "--decode" && i+1 < argc) { decodeBackend = parseDecodeBackend(argv[++i]); }
+        else if (arg == "--decode-size" && i+1 < argc) {
+            int w = 0, h = 0;
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) { cerr << "Error: --decode-size needs WxH\n"; return -1; }
+            decodeSize = Size(w, h);
+        }
         else if (arg == "--server" && i+1 < argc) { /* custom server URL support */ }
         else { cerr << "Error: Unknown argument: " << arg << endl; printUsage(argv[0]); return -1; }
     }
 
     if (mode.empty()) {
-        cerr << "Error: Must specify either --build-engine or --run" << endl;
+        cerr << "Error: Must specify one of --build-engine, --run or --replay" << endl;
         printUsage(argv[0]);
         return -1;
     }
 
+    static const map<string, Severity> logLevels = {
+        {"verbose", Severity::kVERBOSE}, {"info", Severity::kINFO},
+        {"warning", Severity::kWARNING}, {"error", Severity::kERROR}};
+    if (!logLevels.count(logLevel)) {
+        cerr << "Error: --log-level needs verbose, info, warning or error" << endl;
+        return -1;
+    }
+    setReportableSeverity(logLevels.at(logLevel));
+
+    // --dynamic-height h is short for a height profile of min(h, 160):h:640
+    if (dynamicHeight > 0 && maxHeight == 0) {
+        minHeight = std::min(dynamicHeight, 160);
+        optHeight = dynamicHeight;
+        maxHeight = 640;
+    }
+    // coasted frames don't age a track, only the first miss can be late: by at most one interval
+    if (maxDetectInterval >= kTrackMaxAge) {
+        cout << "Warning: --detect-every " << maxDetectInterval << " clamped to " << kTrackMaxAge - 1
+             << ", below SORT's max age" << endl;
+        maxDetectInterval = kTrackMaxAge - 1;
+    }
+    if (timingCache.empty() && !engineCacheDir.empty())
+        timingCache = engineCacheDir + "/timing.cache";
+    if (calibCache.empty() && int8)
+        calibCache = (!enginePath.empty() ? enginePath : !engineCacheDir.empty() ? engineCacheDir + "/int8" : onnxPath) + ".calib";
+
     if (mode == "build") {
-        if (onnxPath.empty() || enginePath.empty()) {
-            cerr << "Error: --onnx and --engine required for --build-engine" << endl;
+        if (onnxPath.empty() || (enginePath.empty() && engineCacheDir.empty())) {
+            cerr << "Error: --onnx and --engine (or --engine-cache) required for --build-engine" << endl;
             printUsage(argv[0]); return -1;
         }
-        bool success = buildEngine(onnxPath, enginePath);
-        return success ? 0 : -1;
+        EngineBuildOptions options;
+        options.onnx_file = onnxPath;
+        options.onnx_hash = hashFile(onnxPath);    // once: every key below reuses it
+        if (options.onnx_hash == 0) {
+            cerr << "Error: cannot read " << onnxPath << endl;
+            return -1;
+        }
+        options.timing_cache = timingCache;
+        if (workspaceMiB > 0)
+            options.workspace = size_t(workspaceMiB) << 20;
+        int buildBatch = batchSize > 0 ? batchSize : 1;
+        options.min_batch = minBatch > 0 ? minBatch : buildBatch;
+        options.opt_batch = optBatch > 0 ? optBatch : buildBatch;
+        options.max_batch = maxBatch > 0 ? maxBatch : buildBatch;
+        options.min_height = minHeight; options.opt_height = optHeight;
+        options.max_height = maxHeight > 0 ? maxHeight : 640;
+        options.int8 = int8;
+        options.calibration_source = calibSource;
+        options.calibration_cache = calibCache;
+        options.calibration_frames = calibFrames;
+        if (!int8 || int8CheckClip.empty()) {
+            bool success = buildEngine(options, engineKey(options), enginePath, engineCacheDir);
+            return success ? 0 : -1;
+        }
+
+        // INT8 candidate next to an FP16 reference; only an engine that agrees with it is kept
+        EngineBuildOptions fp16Options = options;
+        fp16Options.int8 = false;
+        const EngineKey int8Key = engineKey(options), fp16Key = engineKey(fp16Options);
+        string target = enginePath.empty() ? cachedEnginePath(engineCacheDir, options, int8Key) : enginePath;
+        string candidatePath = target + ".candidate";
+        string referencePath = engineCacheDir.empty() ? target + ".fp16"
+                                                      : cachedEnginePath(engineCacheDir, fp16Options, fp16Key);
+        if (!buildEngine(options, int8Key, candidatePath, "")
+            || !buildEngine(fp16Options, fp16Key, engineCacheDir.empty() ? referencePath : "", engineCacheDir))
+            return -1;
+
+        cout << "\nComparing INT8 against FP16 on " << int8CheckClip << "..." << endl;
+        DetectionAgreement agreement;
+        if (!compareEngines(referencePath, candidatePath, int8CheckClip, 300, agreement)) {
+            std::remove(candidatePath.c_str());
+            return -1;
+        }
+        bool accepted = agreement.recall() >= int8MinMatch && agreement.precision() >= int8MinMatch;
+        cout << "\n==================================================" << endl;
+        cout << "INT8 check on " << agreement.frames << " frames: " << agreement.reference << " FP16 boxes, "
+             << agreement.candidate << " INT8 boxes, " << agreement.matched << " matched" << endl;
+        cout << "  Recall: " << fixed << setprecision(3) << agreement.recall()
+             << "  Precision: " << agreement.precision()
+             << "  Mean IoU: " << (agreement.matched ? agreement.iouSum / agreement.matched : 0.0)
+             << "  Mean |score diff|: " << (agreement.matched ? agreement.scoreDiffSum / agreement.matched : 0.0) << endl;
+        cout << "  " << (accepted ? "ACCEPTED" : "REJECTED") << " (required " << int8MinMatch << ")" << endl;
+        cout << "==================================================" << endl;
+        if (!accepted) {
+            std::remove(candidatePath.c_str());
+            return -1;
+        }
+        if (std::rename(candidatePath.c_str(), target.c_str()) != 0) {
+            cerr << "Error: cannot move " << candidatePath << " to " << target << endl;
+            return -1;
+        }
+        if (!enginePath.empty() && !engineCacheDir.empty()) {
+            EnginePlanFile plan(target);
+            writeEnginePlan(cachedEnginePath(engineCacheDir, options, int8Key), plan.key(), plan.plan(), plan.planSize());
+        }
+        cout << "INT8 engine saved to: " << target << endl;
+        return 0;
+    }
+
+    if (mode == "replay") {
+        // the post-inference stages alone, as fast as the CPU goes: no decode, no engine, no window
+        DetectionLogReader log(replayPath);
+        if (!log.isOpened()) { cerr << "Error: Cannot open detection log: " << replayPath << endl; return -1; }
+        const DetectionLogHeader& header = log.header();
+        CamIntrinsics logK{header.fx, header.fy, header.cx, header.cy};
+        Size frameSize(header.width, header.height);
+
+        cout << "\n==================================================" << endl;
+        cout << "Replaying Detections (tracking + distance + publishing)" << endl;
+        cout << "==================================================" << endl;
+        cout << "Log: " << replayPath << " (" << log.bytes() / 1024 << " KiB)" << endl;
+        cout << "Frame: " << frameSize.width << "x" << frameSize.height
+             << ", fx=" << logK.fx << " fy=" << logK.fy << " cx=" << logK.cx << " cy=" << logK.cy
+             << ", H=" << header.camera_height << " m" << endl;
+        cout << "==================================================" << endl;
+
+        GroundDistance gdist(logK, header.camera_height, frameSize);
+        RealtimeDistanceStreamer streamer("http://localhost:5001/webhook", 256, 16, 2, wireFormat);
+        Metrics& metrics = Metrics::instance();
+        metrics.addGauge("publish_queued", "frames waiting for the webhook", [&streamer] { return double(streamer.stats().queued); });
+        metrics.addGauge("publish_dropped", "frames evicted before publishing", [&streamer] { return double(streamer.stats().dropped); });
+        unique_ptr<MetricsReporter> reporter;
+        if (metricsPort > 0 || metricsEvery > 0.0)
+            reporter.reset(new MetricsReporter(metricsPort, metricsEvery));
+        auto onSignal = [](int) { gInterrupted = true; };
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+
+        FrameTracker frameTracker(gdist, streamer, assignMethod, liveUpdateFrames, nullptr, false);
+        vector<DetectRes> detections;
+        vector<TrackedBox> tracked;
+        vector<GroundPoint> ground;
+        const DetectionLogFrame* record = nullptr;
+        Span<const DetectionLogBox> boxes;
+        uint64_t frames = 0, keyframes = 0, boxCount = 0;
+        int lastEpoch = 0, lastFrameNum = 0;
+        double lastTheta = 0.0;
+        int64_t lastTime = 0;
+
+        auto startTime = chrono::steady_clock::now();
+        while (!gInterrupted && log.next(record, boxes)) {
+            auto frameStart = chrono::steady_clock::now();
+            if (frames > 0 && record->epoch != lastEpoch)
+                frameTracker.restart(lastFrameNum, lastTheta);
+            bool keyframe = (record->flags & DetectionLogFrame::kKeyframe) != 0;
+            detections.resize(boxes.size());
+            for (size_t i = 0; i < boxes.size(); ++i) {
+                const DetectionLogBox& b = boxes[i];
+                DetectRes& d = detections[i];
+                d.classes = b.classes; d.prob = b.prob;
+                d.x = b.x; d.y = b.y; d.w = b.w; d.h = b.h;
+            }
+            metrics.add(Counter::kFrames);
+            frameTracker.process(keyframe, detections, record->frame_num, record->theta, frameSize, tracked, ground);
+            metrics.record(Stage::kEndToEnd, chrono::steady_clock::now() - frameStart);
+
+            ++frames;
+            keyframes += keyframe;
+            boxCount += boxes.size();
+            lastEpoch = record->epoch;
+            lastFrameNum = record->frame_num;
+            lastTheta = record->theta;
+            lastTime = record->t_ns;
+        }
+        frameTracker.finish(lastFrameNum, lastTheta);
+        chrono::duration<double> totalDuration = chrono::steady_clock::now() - startTime;
+        double logSeconds = lastTime * 1e-9;
+
+        cout << "\n==================================================" << endl;
+        cout << "Replay Complete!" << endl;
+        cout << "  Frames Replayed: " << frames << " (" << keyframes << " detected, " << boxCount << " boxes)" << endl;
+        cout << "  Total Time: " << fixed << setprecision(3) << totalDuration.count() << " seconds" << endl;
+        cout << "  Throughput: " << setprecision(0) << (totalDuration.count() > 0 ? frames / totalDuration.count() : 0.0)
+             << " frames/s";
+        if (logSeconds > 0 && totalDuration.count() > 0)
+            cout << " (" << setprecision(1) << logSeconds / totalDuration.count() << "x the recorded "
+                 << logSeconds << " s)";
+        cout << endl;
+        cout << "  Tracks Confirmed: " << frameTracker.confirmed() << endl;
+        StreamerStats pub = streamer.stats();
+        cout << "  Events Published: " << pub.sent << " (dropped " << pub.dropped
+             << ", failed " << pub.failed << ")" << endl;
+        reporter.reset();
+        metrics.clearGauges();
+        vector<LatencyHistogram::Snapshot> sinceStart;
+        cout << "  Latency (end_to_end is one replayed frame):\n" << metrics.summary(sinceStart);
+        cout << "==================================================" << endl;
+        return 0;
     }
 
     if (mode == "run") {
-        if (videoPath.empty() || enginePath.empty()) {
-            cerr << "Error: --video and --engine required for --run" << endl;
+        if (videoSpecs.empty() || (enginePath.empty() && onnxPath.empty())) {
+            cerr << "Error: --video and --engine (or --onnx) required for --run" << endl;
             printUsage(argv[0]); return -1;
         }
 
+        // one stream per -v, each with its own calibration, pitch, tracker and queues
+        vector<unique_ptr<CameraStream>> cameras;
+        for (const string& spec : videoSpecs) {
+            cameras.emplace_back(new CameraStream);
+            CameraStream& cam = *cameras.back();
+            cam.index = int(cameras.size()) - 1;
+            cam.K = K;
+            cam.H_m = H_m;
+            cam.theta0 = theta_init_deg * M_PI / 180.0;
+            parseCameraSpec(spec, cam);
+            cam.live = liveSource || isLiveSource(cam.path);
+            cam.window = cam.index == 0 ? "YOLO + SORT + Distance" : "YOLO + SORT + Distance [" + to_string(cam.index) + "]";
+        }
+        const bool multiCamera = cameras.size() > 1;
+        bool live = false;
+        for (const auto& cam : cameras)
+            live = live || cam->live;
+        const QueuePolicy policy = live ? QueuePolicy::kDropOldest : QueuePolicy::kBlock;
+
+        vector<int> devices = parseDeviceList(gpuList);
+        if (devices.empty()) {
+            cerr << "Error: no usable GPU in --gpus " << gpuList << endl;
+            return -1;
+        }
+        const bool multiGpu = devices.size() > 1;
+
         cout << "\n==================================================" << endl;
         cout << "Running Inference + Distance + Real-time Stream" << endl;
         cout << "==================================================" << endl;
-        cout << "Video: " << videoPath << endl;
+        for (const auto& cam : cameras) {
+            cout << (multiCamera ? "Camera " + to_string(cam->index) + ": " : "Video: ") << cam->path << endl;
+            cout << "  fx=" << cam->K.fx << " fy=" << cam->K.fy << " cx=" << cam->K.cx << " cy=" << cam->K.cy
+                 << " H=" << cam->H_m << " m, theta_init=" << cam->theta0 * 180.0 / M_PI << " deg" << endl;
+        }
         cout << "Engine: " << enginePath << endl;
-        cout << "fx=" << K.fx << " fy=" << K.fy << " cx=" << K.cx << " cy=" << K.cy << endl;
-        cout << "H=" << H_m << " m, theta_init=" << theta_init_deg << " deg" << endl;
         cout << "Streaming to: http://localhost:5000/pothole" << endl;
         cout << "Dashboard: http://localhost:5000 (after starting server)" << endl;
         cout << "==================================================" << endl;
 
-        YAML::Node config;
-        config["BATCH_SIZE"] = 1;
-        config["INPUT_CHANNEL"] = 3;
-        config["IMAGE_WIDTH"] = 640;
-        config["IMAGE_HEIGHT"] = 640;
-        config["INPUT_WIDTH"] = 640;
-        config["INPUT_HEIGHT"] = 640;
-        config["obj_threshold"] = 0.5;
-        config["nms_threshold"] = 0.4;
-        config["agnostic"] = false;
-        config["CATEGORY_NUM"] = 1;
-        config["onnx_file"] = "";
-        config["engine_file"] = enginePath;
-        config["labels_file"] = "";
-        config["strides"] = std::vector<int>{8, 16, 32};
-        std::vector<std::vector<int>> empty_anchors = {{}, {}, {}};
-        config["anchors"] = empty_anchors;
-        config["num_anchors"] = std::vector<int>{1, 1, 1};
-
-        cout << "\nInitializing YOLO model..." << endl;
-        YOLO detector(config);
-        cout << "Model loaded successfully!" << endl;
-
-        cout << "Opening video file..." << endl;
-        VideoCapture cap(videoPath);
-        cap.set(CAP_PROP_BUFFERSIZE, 1);
-        if (!cap.isOpened()) { cerr << "Error: Cannot open video file: " << videoPath << endl; return -1; }
-
-        int frameWidth  = static_cast<int>(cap.get(CAP_PROP_FRAME_WIDTH));
-        int frameHeight = static_cast<int>(cap.get(CAP_PROP_FRAME_HEIGHT));
-        double fps      = cap.get(CAP_PROP_FPS);
-        int totalFrames = static_cast<int>(cap.get(CAP_PROP_FRAME_COUNT));
-
-        cout << "\nVideo Properties:\n  Resolution: " << frameWidth << "x" << frameHeight
-             << "\n  FPS: " << fps << "\n  Total Frames: " << totalFrames << endl;
-
-        ThetaFuser thetaFuser(0.985);
-        double theta0_rad = theta_init_deg * M_PI / 180.0;
-        thetaFuser.initialize_from_imu(theta0_rad);
-        GroundDistance gdist(K, H_m);
-
-        auto lastTick = chrono::steady_clock::now();
-
-        Sort::Ptr tracker = make_shared<Sort>(30, 3, 0.3f);
+        YAML::Node config = detectorConfig(enginePath);
+        const int runBatch = batchSize > 0 ? batchSize : int(cameras.size());
+        config["BATCH_SIZE"] = runBatch;
+        config["onnx_file"] = onnxPath;    // only read when the engine is missing or was built for something else
+        config["onnx_hash"] = hashFile(onnxPath);    // once for all shards, 0 without an ONNX
+        config["gpu_preprocess"] = gpuPreprocess;
+        config["num_contexts"] = numContexts;
+        config["cuda_graph"] = cudaGraph;
+        config["gpu_postprocess"] = gpuPostprocess;
+        config["engine_cache"] = engineCacheDir;
+        config["overwrite_engine"] = overwriteEngine;
+        config["timing_cache"] = timingCache;
+        if (workspaceMiB > 0)
+            config["workspace_mb"] = workspaceMiB;
+        if (maxHeight > 0) {
+            config["dynamic_min_height"] = minHeight;
+            config["dynamic_opt_height"] = optHeight;
+        }
+        // a dynamic-batch ONNX is built for the batch it runs at, a max batch below it could not load
+        config["min_batch"] = minBatch > 0 ? minBatch : runBatch;
+        config["opt_batch"] = optBatch > 0 ? optBatch : runBatch;
+        config["max_batch"] = maxBatch > 0 ? maxBatch : runBatch;
+        if (int8) {
+            config["int8"] = true;
+            config["calibration_source"] = calibSource;
+            config["calibration_cache"] = calibCache;
+        }
+
+        // one detector per GPU, its contexts and buffers bound to that device
+        vector<unique_ptr<DetectorShard>> shards;
+        for (int device : devices) {
+            cout << "\nInitializing YOLO model" << (multiGpu ? " on GPU " + to_string(device) : "") << "..." << endl;
+            cudaSetDevice(device);
+            shards.emplace_back(new DetectorShard);
+            DetectorShard& shard = *shards.back();
+            shard.device = device;
+            shard.name = EngineKey::current(device).gpu;
+            config["device"] = device;
+            try {
+                shard.detector.reset(new YOLO(config));
+            } catch (const std::exception& e) {
+                cerr << "Error: " << e.what() << endl;
+                return -1;
+            }
+            cout << "Model loaded on GPU " << device << " (" << shard.name << ") in " << fixed << setprecision(1)
+                 << chrono::duration<double, milli>(shard.detector->LoadTime()).count() << " ms" << endl;
+            shard.capturedQ.reset(new FrameScheduler(int(cameras.size()), 4, policy, shard.detector->BatchSize(),
+                                                     chrono::microseconds(int64_t(batchWaitMs * 1000.0))));
+            shard.preparedQ.reset(new BatchQueue(2, policy));
+            shard.spareBatches.reset(new BatchQueue(4, QueuePolicy::kDropOldest));
+        }
+        const int batchFrames = shards[0]->detector->BatchSize();
+
+        cout << "Opening video file" << (multiCamera ? "s" : "") << "..." << endl;
+        for (auto& camPtr : cameras) {
+            CameraStream& cam = *camPtr;
+            // nothing queued yet: spread the cameras evenly, each decoding on the GPU of its detector
+            cam.shard = leastLoadedShard(shards);
+            DetectorShard& shard = *shards[cam.shard];
+            ++shard.cameras;
+            cam.decodeDevice = shard.device;
+            cudaSetDevice(shard.device);
+            cam.cap.reset(new VideoSource(cam.path, decodeBackend, decodeSize));
+            VideoSource& cap = *cam.cap;
+            if (!cap.isOpened()) { cerr << "Error: Cannot open video file: " << cam.path << endl; return -1; }
+
+            int frameWidth  = cap.sourceSize().width;
+            int frameHeight = cap.sourceSize().height;
+            cam.totalFrames = cap.frameCount();
+
+            cout << "\nVideo Properties" << (multiCamera ? " (camera " + to_string(cam.index) + ")" : "")
+                 << ":\n  Resolution: " << frameWidth << "x" << frameHeight
+                 << "\n  FPS: " << cap.fps() << "\n  Total Frames: " << cam.totalFrames
+                 << "\n  Decode: " << (cap.usesNvdec() ? "NVDEC (frames stay on the GPU)" : "VideoCapture (CPU)") << endl;
+            if (multiGpu)
+                cout << "  Detector: GPU " << shard.device << endl;
+            if (cap.frameSize() != cap.sourceSize() && frameWidth > 0 && frameHeight > 0) {
+                // the intrinsics are given for the source resolution
+                float sx = float(cap.frameSize().width) / frameWidth;
+                float sy = float(cap.frameSize().height) / frameHeight;
+                cam.K.fx *= sx; cam.K.cx *= sx;
+                cam.K.fy *= sy; cam.K.cy *= sy;
+                cout << "  Decoded at: " << cap.frameSize().width << "x" << cap.frameSize().height
+                     << " (fx=" << cam.K.fx << " fy=" << cam.K.fy << " cx=" << cam.K.cx << " cy=" << cam.K.cy << ")" << endl;
+            }
+        }
+        double fps = cameras[0]->cap->fps();
+        // a shard's batches only wait for the cameras placed on it
+        for (auto& shard : shards)
+            for (const auto& cam : cameras)
+                if (shards[cam->shard].get() != shard.get())
+                    shard->capturedQ->detach(cam->index);
+
+        // the first frames would otherwise pay for tactic warm-up, lazy allocations and graph capture;
+        // each shard warms up with the input of its first camera
+        vector<chrono::steady_clock::duration> warmupTimes(shards.size());
+        if (warmupRuns > 0) {
+            for (size_t s = 0; s < shards.size(); ++s) {
+                DetectorShard& shard = *shards[s];
+                const CameraStream* first = cameras[0].get();
+                for (const auto& cam : cameras)
+                    if (cam->shard == int(s)) { first = cam.get(); break; }
+                bool deviceFrames = first->cap->usesNvdec() && first->decodeDevice == shard.device;
+                warmupTimes[s] = shard.detector->Warmup(first->cap->frameSize(), deviceFrames, warmupRuns);
+                cout << "Warmup" << (multiGpu ? " (GPU " + to_string(shard.device) + ")" : "") << ": " << warmupRuns
+                     << " run(s) per context in " << fixed << setprecision(1)
+                     << chrono::duration<double, milli>(warmupTimes[s]).count() << " ms" << endl;
+            }
+        }
+        cudaSetDevice(devices[0]);
+        // startup as the only samples of its stages, the warmup inferences don't count as frames
+        Metrics::instance().reset();
+        for (size_t s = 0; s < shards.size(); ++s) {
+            Metrics::instance().record(Stage::kEngineLoad, shards[s]->detector->LoadTime());
+            if (warmupRuns > 0)
+                Metrics::instance().record(Stage::kWarmup, warmupTimes[s]);
+        }
+
+        // the IMU is mounted with the first camera, the others only fuse their own vision pitch
+        unique_ptr<ImuStream> imu;
+        if (!imuPath.empty()) {
+            imu.reset(new ImuStream(imuPath));
+            if (!imu->isOpened())
+                imu.reset();
+        }
+        if (visionPitchHz > 0.0)
+            cout << "Vision pitch: FOE from optical flow at " << visionPitchHz << " Hz" << endl;
+        if (roiCrop)
+            cout << "ROI: detector sees the road band below the horizon (200 m)" << endl;
+
+        for (auto& camPtr : cameras) {
+            CameraStream& cam = *camPtr;
+            cam.thetaFuser.initialize_from_imu(cam.theta0);
+            cam.latestTheta = cam.theta0;
+            if (visionPitchHz > 0.0)
+                cam.vision.reset(new VisionPitch(cam.K, visionPitchHz));
+            cam.gdist.reset(new GroundDistance(cam.K, cam.H_m, cam.cap->frameSize()));
+            cam.roiDist.reset(new GroundDistance(cam.K, cam.H_m));
+            cam.cadence.reset(new DetectionCadence(maxDetectInterval));
+            cam.detectedQ.reset(new FrameQueue(2, cam.live ? QueuePolicy::kDropOldest : QueuePolicy::kBlock));
+
+            if (!detectionLogPath.empty()) {
+                // one log per camera, a log has a single calibration
+                string path = cam.index == 0 ? detectionLogPath : detectionLogPath + "." + to_string(cam.index);
+                DetectionLogHeader header;
+                header.width = cam.cap->frameSize().width;
+                header.height = cam.cap->frameSize().height;
+                header.fx = cam.K.fx; header.fy = cam.K.fy; header.cx = cam.K.cx; header.cy = cam.K.cy;
+                header.camera_height = cam.H_m;
+                cam.detectionLog.reset(new DetectionLogWriter(path, header));
+                if (cam.detectionLog->isOpened())
+                    cout << "Recording detections to: " << path << endl;
+                else
+                    cam.detectionLog.reset();
+            }
+        }
+
         vector<Scalar> colors = generateColors(100);
 
-        // Initialize real-time streamer
-        RealtimeDistanceStreamer streamer("http://localhost:5001/webhook");
-        cout << "Real-time streamer initialized (endpoint: /webhook)" << endl;
+        // Initialize real-time streamer (shared: track ids are unique across the cameras' trackers)
+        RealtimeDistanceStreamer streamer("http://localhost:5001/webhook", 256, 16, 2, wireFormat);
+        cout << "Real-time streamer initialized (endpoint: /webhook, " << wireContentType(wireFormat) << ")" << endl;
 
-        namedWindow("YOLO + SORT + Distance", WINDOW_NORMAL);
-        resizeWindow("YOLO + SORT + Distance", 1280, 720);
+        if (!headless) {
+            for (const auto& cam : cameras) {
+                namedWindow(cam->window, WINDOW_NORMAL);
+                resizeWindow(cam->window, 1280, 720);
+            }
+        }
+        unique_ptr<VideoRecorder> recorder;     // the first camera only, encoding on the GPU it decodes on
+        if (!recordPath.empty())
+            recorder.reset(new VideoRecorder(recordPath, fps, 8, cameras[0]->decodeDevice));
+        auto onSignal = [](int) { gInterrupted = true; };
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
 
-        Mat frame;
         int frameCount = 0;
         // Removed paused flag - model runs continuously without pausing
 
+        FrameQueue trackedQ(4, policy);
+        std::atomic<bool> stopRequested{false};
+        auto stopPipeline = [&] {
+            stopRequested = true;
+            for (auto& shard : shards) {
+                shard->capturedQ->close();
+                shard->preparedQ->close();
+            }
+            for (auto& cam : cameras)
+                cam->detectedQ->close();
+            trackedQ.close();
+        };
+        auto capturedDepth = [&shards] {
+            size_t depth = 0;
+            for (const auto& shard : shards)
+                depth += shard->capturedQ->size();
+            return depth;
+        };
+        auto preparedDepth = [&shards] {
+            size_t depth = 0;
+            for (const auto& shard : shards)
+                depth += shard->preparedQ->size();
+            return depth;
+        };
+        auto capturedDropped = [&shards] {
+            uint64_t dropped = 0;
+            for (const auto& shard : shards)
+                dropped += shard->capturedQ->dropped();
+            return dropped;
+        };
+        auto preparedDropped = [&shards] {
+            uint64_t dropped = 0;
+            for (const auto& shard : shards)
+                dropped += shard->preparedQ->dropped();
+            return dropped;
+        };
+        auto meanBatch = [&shards] {
+            uint64_t keyframes = 0, batches = 0;
+            for (const auto& shard : shards) {
+                keyframes += shard->keyframes;
+                batches += shard->batches;
+            }
+            return batches ? double(keyframes) / batches : 0.0;
+        };
+        auto detectedDepth = [&cameras] {
+            size_t depth = 0;
+            for (const auto& cam : cameras)
+                depth += cam->detectedQ->size();
+            return depth;
+        };
+        auto detectedDropped = [&cameras] {
+            uint64_t dropped = 0;
+            for (const auto& cam : cameras)
+                dropped += cam->detectedQ->dropped();
+            return dropped;
+        };
+
+        // read by the reporter only, nothing here runs per frame
+        Metrics& metrics = Metrics::instance();
+        metrics.addGauge("queue_depth_captured", "frames waiting for a batch", [capturedDepth] { return double(capturedDepth()); });
+        metrics.addGauge("queue_dropped_captured", "frames evicted from the full queue", [capturedDropped] { return double(capturedDropped()); });
+        metrics.addGauge("queue_depth_prepared", "batches waiting for the engine", [preparedDepth] { return double(preparedDepth()); });
+        metrics.addGauge("queue_dropped_prepared", "batches evicted from the full queue", [preparedDropped] { return double(preparedDropped()); });
+        metrics.addGauge("queue_depth_detected", "frames waiting for their tracker", [detectedDepth] { return double(detectedDepth()); });
+        metrics.addGauge("queue_dropped_detected", "frames evicted from the full queue", [detectedDropped] { return double(detectedDropped()); });
+        metrics.addGauge("queue_depth_tracked", "frames waiting in the queue", [&trackedQ] { return double(trackedQ.size()); });
+        metrics.addGauge("queue_dropped_tracked", "frames evicted from the full queue", [&trackedQ] { return double(trackedQ.dropped()); });
+        metrics.addGauge("batch_mean", "detector frames per inference", [meanBatch] { return meanBatch(); });
+        if (multiGpu) {
+            for (const auto& shardPtr : shards) {
+                const DetectorShard* shard = shardPtr.get();
+                string gpu = "gpu" + to_string(shard->device);
+                metrics.addGauge(gpu + "_queue_depth", "frames queued in front of the detector", [shard] { return double(shard->load()); });
+                metrics.addGauge(gpu + "_frames", "frames through the detector shard", [shard] { return double(shard->frames); });
+                metrics.addGauge(gpu + "_cameras", "cameras placed on the shard", [shard] { return double(shard->cameras); });
+            }
+        }
+        metrics.addGauge("log_dropped", "log lines dropped on a full ring", [] { return double(AsyncLogger::instance().dropped()); });
+        metrics.addGauge("log_suppressed", "log lines over their call site's rate", [] { return double(AsyncLogger::instance().suppressed()); });
+        metrics.addGauge("publish_queued", "frames waiting for the webhook", [&streamer] { return double(streamer.stats().queued); });
+        metrics.addGauge("publish_dropped", "frames evicted before publishing", [&streamer] { return double(streamer.stats().dropped); });
+        metrics.addGauge("publish_failed", "frames of failed webhook requests", [&streamer] { return double(streamer.stats().failed); });
+        if (recorder)
+            metrics.addGauge("record_dropped", "frames the recorder dropped", [&recorder] { return double(recorder->dropped()); });
+        if (imu)
+            metrics.addGauge("imu_dropped", "IMU samples evicted from the ring", [&imu] { return double(imu->stats().dropped); });
+        if (visionPitchHz > 0.0)
+            metrics.addGauge("vision_skipped", "frames the pitch estimator was too busy for", [&cameras] {
+                uint64_t skipped = 0;
+                for (const auto& cam : cameras)
+                    skipped += cam->vision->stats().skipped;
+                return double(skipped);
+            });
+        unique_ptr<MetricsReporter> reporter;
+        if (metricsPort > 0 || metricsEvery > 0.0)
+            reporter.reset(new MetricsReporter(metricsPort, metricsEvery));
+
         cout << "\n==================================================" << endl;
-        cout << "Starting continuous tracking... (ESC=Exit)" << endl;
+        cout << "Starting continuous tracking... (" << (headless ? "headless, Ctrl+C" : "ESC") << "=Exit)" << endl;
         cout << "Note: Model runs continuously, no pausing on detection" << endl;
+        cout << "Pipeline: capture -> preprocess -> inference -> track -> " << (headless ? "sink" : "render") << " ("
+             << (live ? "live source, drop-oldest" : "file source, blocking") << " queues)" << endl;
+        if (multiCamera)
+            cout << "Batching: " << cameras.size() << " cameras into batches of up to " << batchFrames
+                 << " frames, waiting at most " << batchWaitMs << " ms" << endl;
+        if (multiGpu)
+            cout << "Sharding: " << shards.size() << " GPUs, file cameras re-placed by measured queue depth every "
+                 << kPlacementCheckFrames << " frames" << (playOnce ? "" : " and at every loop") << endl;
         cout << "==================================================" << endl;
 
         auto startTime = chrono::high_resolution_clock::now();
-        
-        // Frame rate control: 30 FPS = 33.33ms per frame
-        const double targetFps = 30.0;
-        const double frameTimeMs = 1000.0 / targetFps; // ~33.33ms per frame
-        auto lastFrameTime = chrono::high_resolution_clock::now();
 
-        while (true) {
-            // Continuous processing - no pause logic
-            if (!cap.read(frame)) {
-                    // End of video reached - loop back to start
-                    cout << "\nEnd of video reached. Looping back to start..." << endl;
-                    cap.set(cv::CAP_PROP_POS_FRAMES, 0); // Reset to first frame
-                    frameCount = 0; // Reset frame counter
-                    // Reset tracker for new loop
-                    tracker = make_shared<Sort>(30, 3, 0.3f);
-                    // Reinitialize theta fuser
-                    thetaFuser.initialize_from_imu(theta0_rad);
-                    cout << "Video looped - restarting detection..." << endl;
-                    continue; // Continue to next iteration to read first frame
+        // The shard a file camera should move to: one whose measured queue is shorter by at least a
+        // batch, or a level one with two cameras fewer. Its own shard otherwise, so cameras don't
+        // bounce between GPUs on noise.
+        auto placementTarget = [&](const CameraStream& cam) {
+            const DetectorShard& from = *shards[cam.shard];
+            int to = cam.shard;
+            for (int i = 0; i < int(shards.size()); ++i) {
+                const DetectorShard& s = *shards[i];
+                double gain = from.queueDepth() - s.queueDepth();
+                bool shorter = gain >= batchFrames;
+                bool level = std::abs(gain) < batchFrames && s.cameras + 1 < from.cameras;
+                if (i != cam.shard && (shorter || level)
+                    && (to == cam.shard || s.queueDepth() < shards[to]->queueDepth()))
+                    to = i;
+            }
+            return to;
+        };
+
+        // A file camera is re-placed every kPlacementCheckFrames frames and at every loop. It moves
+        // once its frames in flight are tracked and resumes at resumeFrame on the new GPU, so it is
+        // never on two shards at once and keeps its order. Live sources stay where they started.
+        std::mutex placementMutex;
+        auto rebalance = [&](CameraStream& cam, int resumeFrame) {
+            DetectorShard& from = *shards[cam.shard];
+            from.capturedQ->detach(cam.index);      // the rest of its shard stops waiting for it
+            auto due = chrono::steady_clock::now() + chrono::seconds(2);
+            while (cam.inPipeline > 0 && !stopRequested && chrono::steady_clock::now() < due)
+                std::this_thread::sleep_for(chrono::milliseconds(1));
+            std::lock_guard<std::mutex> lock(placementMutex);
+            int to = cam.inPipeline == 0 ? placementTarget(cam) : cam.shard;
+            if (to != cam.shard) {
+                // decode on the new detector's GPU, or keep the old decoder and cross over the host
+                cudaSetDevice(shards[to]->device);
+                unique_ptr<VideoSource> moved(new VideoSource(
+                    cam.path, cam.cap->usesNvdec() ? DecodeBackend::kNvdec : DecodeBackend::kCpu, decodeSize,
+                    resumeFrame));
+                if (moved->isOpened()) {
+                    std::swap(cam.cap, moved);
+                    cudaSetDevice(cam.decodeDevice);    // the old decoder goes on its own GPU
+                    moved.reset();
+                    cam.decodeDevice = shards[to]->device;
                 }
-                frameCount++;
-
-                auto now = chrono::steady_clock::now();
-                double dt = chrono::duration<double>(now - lastTick).count();
-                lastTick = now;
-                double gyro_pitch_rate_rad_s = 0.0;
-                thetaFuser.propagate(gyro_pitch_rate_rad_s, dt);
-
-                bool vehicle_stationary = false;
-                bool accel_reliable = false;
-                if (vehicle_stationary && accel_reliable) {
-                    double theta_abs = theta0_rad;
-                    thetaFuser.imu_absolute_update(theta_abs, 0.3);
-                    thetaFuser.stationary_bias_learn(gyro_pitch_rate_rad_s, 0.002);
+                cudaSetDevice(cam.decodeDevice);
+                --from.cameras;
+                ++shards[to]->cameras;
+                PLOG(Severity::kINFO) << "Camera " << cam.index << " moved from GPU " << from.device << " to GPU "
+                                      << shards[to]->device;
+                cam.shard = to;
+            }
+            shards[cam.shard]->capturedQ->attach(cam.index);
+        };
+
+        // stage 1: decode, one thread per camera
+        vector<std::thread> captureThreads;
+        for (auto& camPtr : cameras) {
+            captureThreads.emplace_back([&, &cam = *camPtr] {
+                cudaSetDevice(cam.decodeDevice);
+                uint64_t seq = 0;
+                int epoch = 0, frameNum = 0;
+                VideoFrame decoded;
+                while (!stopRequested) {
+                    FramePacket pkt;
+                    auto readStart = chrono::steady_clock::now();
+                    bool decodedOk = cam.cap->read(decoded);
+                    if (decodedOk)
+                        Metrics::instance().record(Stage::kDecode, chrono::steady_clock::now() - readStart);
+                    if (!decodedOk) {
+                        // live streams end for good; an empty read right after a rewind means nothing to loop over
+                        if (cam.live || frameNum == 0 || playOnce)
+                            break;
+                        // End of video reached - loop back to start
+                        PLOG(Severity::kINFO) << "End of video reached. Looping back to start...";
+                        if (!cam.cap->rewind())             // Reset to first frame
+                            break;
+                        ++epoch;                            // tracker and theta are reset downstream
+                        frameNum = 0;
+                        cam.cadence->reset();               // the new tracker starts from detections
+                        if (multiGpu)
+                            rebalance(cam, 0);
+                        continue;
+                    }
+                    pkt.frame = std::move(decoded.host);
+                    pkt.gpuFrame = std::move(decoded.device);
+                    pkt.camera = cam.index;
+                    pkt.seq = seq++;
+                    pkt.keyframe = cam.cadence->nextIsKeyframe();
+                    pkt.epoch = epoch;
+                    pkt.frameNum = ++frameNum;
+                    pkt.decodeDevice = cam.decodeDevice;
+                    pkt.captured = chrono::steady_clock::now();
+                    bool keyframe = pkt.keyframe;
+                    ++cam.inPipeline;
+                    pkt.inPipeline.reset(&cam.inPipeline);
+                    if (!shards[cam.shard]->capturedQ->push(cam.index, std::move(pkt), keyframe))
+                        break;
+                    if (multiGpu && !cam.live && frameNum % kPlacementCheckFrames == 0
+                        && placementTarget(cam) != cam.shard)
+                        rebalance(cam, frameNum);       // the next read is frame frameNum, 0-based
                 }
+                for (auto& shard : shards)
+                    shard->capturedQ->finish(cam.index);
+            });
+        }
 
-                vector<Mat> frames = {frame};
-                vector<vector<DetectRes>> batch_res = detector.InferenceImages(frames);
-                vector<DetectRes> detections = batch_res[0];
-
-                Mat sortDetections = convertDetectionsToSort(detections);
-                Mat trackedBboxes = tracker->update(sortDetections);
-
-                double theta = thetaFuser.theta();
-                gdist.update_theta_cache(theta);
-
-                drawTrackedWithDistance(frame, trackedBboxes, colors, gdist);
-
-                // Collect detections for real-time streaming
-                vector<pair<int, pair<float, float>>> frame_detections;
-                vector<pair<int, pair<float, float>>> frame_sizes;
-                bool pothole_detected = false;
-
-                for (int i = 0; i < trackedBboxes.rows; ++i) {
-                    float x1 = trackedBboxes.at<float>(i, 0);
-                    float y1 = trackedBboxes.at<float>(i, 1);
-                    float x2 = trackedBboxes.at<float>(i, 2);
-                    float y2 = trackedBboxes.at<float>(i, 3);
-                    int trackerId = static_cast<int>(trackedBboxes.at<float>(i, 7));
-
-                    int ix1 = cvRound(x1), iy1 = cvRound(y1), ix2 = cvRound(x2), iy2 = cvRound(y2);
-                    Rect box(ix1, iy1, ix2-ix1, iy2-iy1);
-
-                    int contact_x = box.x + box.width/2;
-                    int contact_y = std::min(frame.rows-1, box.y+box.height+1);
-                    Point2f contact_f(contact_x, contact_y);
-
-                    float D=0.f, X=0.f;
-                    bool ok = gdist.distance_from_pixel(contact_f, D, X);
-
-                    if (ok) {
-                        frame_detections.push_back({trackerId, {D, X}});
-                        pothole_detected = true;
-                        
-                        // Calculate pothole size (bounding box area in real-world coordinates)
-                        // Convert pixel dimensions to real-world size
-                        // Approximate: use distance to estimate pixel-to-meter conversion
-                        float pixel_width = box.width;
-                        float pixel_height = box.height;
-                        // Rough conversion: assume camera FOV and use distance
-                        // More accurate would require camera calibration, but this is an approximation
-                        float pixel_to_meter = D / (frame.rows * 0.5f); // Approximate conversion
-                        float size_m2 = (pixel_width * pixel_to_meter) * (pixel_height * pixel_to_meter);
-                        frame_sizes.push_back({trackerId, {size_m2, 0.0f}});
+        // stage 2: cross-camera batching and host-side preprocessing (no letterbox on the host when
+        // the GPU letterbox is enabled, coasted frames only ride along), one thread per shard
+        vector<std::thread> preprocessThreads;
+        for (auto& shardPtr : shards) {
+            preprocessThreads.emplace_back([&, &shard = *shardPtr] {
+                cudaSetDevice(shard.device);
+                YOLO& detector = *shard.detector;
+                FrameBatch batch;
+                vector<Mat> frames;
+                vector<Rect> regions;
+                for (;;) {
+                    shard.spareBatches->tryPop(batch);      // a scattered batch's buffers, when there is one
+                    if (!shard.capturedQ->popBatch(batch.packets))
+                        break;
+                    shard.depth.store(0.875 * shard.queueDepth() + 0.125 * double(shard.load()),
+                                      std::memory_order_relaxed);
+                    batch.keyframes.clear();
+                    batch.onDevice = false;
+                    batch.input.clear();
+                    bool onHost = false;
+                    for (size_t i = 0; i < batch.packets.size(); ++i) {
+                        FramePacket& pkt = batch.packets[i];
+                        CameraStream& cam = *cameras[pkt.camera];
+                        if (!pkt.gpuFrame.empty() && pkt.decodeDevice != shard.device) {
+                            // decoded on the GPU it was placed on before, crosses over the host
+                            pkt.gpuFrame.download(pkt.frame);
+                            pkt.gpuFrame = cuda::GpuMat();
+                        }
+                        if (roiCrop) {
+                            cam.roiDist->update_theta_cache(cam.latestTheta.load(std::memory_order_relaxed));
+                            pkt.roi = roadBand(*cam.roiDist, pkt.frameSize());
+                        }
+                        if (!pkt.keyframe)
+                            continue;
+                        batch.keyframes.push_back(i);
+                        batch.onDevice = batch.onDevice || !pkt.gpuFrame.empty();
+                        onHost = onHost || pkt.gpuFrame.empty();
+                    }
+                    // one engine call per batch: a camera decoding on the CPU next to NVDEC ones goes up too
+                    if (batch.onDevice && onHost)
+                        for (size_t i : batch.keyframes)
+                            if (batch.packets[i].gpuFrame.empty())
+                                batch.packets[i].gpuFrame.upload(batch.packets[i].frame);
+                    if (!batch.onDevice && !batch.keyframes.empty()) {
+                        frames.clear();
+                        regions.clear();
+                        for (size_t i : batch.keyframes) {
+                            frames.push_back(batch.packets[i].frame);
+                            regions.push_back(batch.packets[i].roi);
+                        }
+                        detector.PrepareImages(frames, batch.input, regions);
+                        frames.clear();
                     }
+                    if (!shard.preparedQ->push(std::move(batch)))
+                        break;
                 }
+                shard.preparedQ->close();
+            });
+        }
 
-                // Stream detections to server (non-blocking, runs in separate thread)
-                if (!frame_detections.empty()) {
-                    streamer.send_batch(frame_detections, frameCount, theta*180.0/M_PI, frame_sizes);
-                    
-                    // Log detection but continue processing (no pause)
-                    if (pothole_detected) {
-                        cout << "\n[DETECTED] Pothole detected at frame " << frameCount << " - continuing..." << endl;
+        // stage 3: TensorRT inference + decode/NMS, one engine call per batch
+        // With async contexts, up to MaxInFlight() batches are enqueued before the oldest one is
+        // collected, so the copies and enqueue of batch k+1 overlap the decode of batch k.
+        // Batches of coasted frames skip the engine but queue behind the batches in flight to keep
+        // every camera's capture order. One thread per shard, the last one to finish closes the track
+        // stages' queues.
+        std::atomic<int> shardsRunning{int(shards.size())};
+        vector<std::thread> inferenceThreads;
+        for (auto& shardPtr : shards) {
+            inferenceThreads.emplace_back([&, &shard = *shardPtr] {
+                cudaSetDevice(shard.device);
+                YOLO& detector = *shard.detector;
+                std::deque<pair<uint64_t, FrameBatch>> inFlight;
+                std::atomic<int>& batchesInFlight = shard.batchesInFlight;
+                bool downstreamOpen = true;
+                // back to each camera's track stage, the emptied batch back to the preprocess stage
+                auto scatter = [&](FrameBatch& batch) {
+                    shard.frames += batch.packets.size();
+                    for (FramePacket& pkt : batch.packets)
+                        downstreamOpen = cameras[pkt.camera]->detectedQ->push(std::move(pkt)) && downstreamOpen;
+                    batch.packets.clear();
+                    shard.spareBatches->push(std::move(batch));
+                };
+                // every batch decodes into an arena the track stages read in place; an arena no packet
+                // holds any more is reused, so the pool only grows to the batches between here and rendering
+                vector<shared_ptr<DetectionBatch>> arenas;
+                auto freeArena = [&]() -> shared_ptr<DetectionBatch> {
+                    for (const auto& arena : arenas) {
+                        if (arena.use_count() == 1) {
+                            // the last reader's release pairs with this before the arena is overwritten
+                            std::atomic_thread_fence(std::memory_order_acquire);
+                            return arena;
+                        }
+                    }
+                    arenas.push_back(make_shared<DetectionBatch>());
+                    return arenas.back();
+                };
+                auto assign = [](FrameBatch& batch, const shared_ptr<DetectionBatch>& arena) {
+                    for (size_t k = 0; k < batch.keyframes.size() && k < arena->size(); ++k) {
+                        FramePacket& pkt = batch.packets[batch.keyframes[k]];
+                        pkt.arena = arena;
+                        pkt.arenaIndex = k;
+                    }
+                };
+                auto collectOldest = [&] {
+                    auto [ticket, done] = std::move(inFlight.front());
+                    inFlight.pop_front();
+                    if (!done.keyframes.empty()) {
+                        --batchesInFlight;
+                        shared_ptr<DetectionBatch> arena = freeArena();
+                        detector.Collect(ticket, *arena);
+                        assign(done, arena);
+                    }
+                    scatter(done);
+                };
+                DetectionBatch discarded;   // batches collected after the track stages are gone
+
+                FrameBatch batch;
+                vector<Mat> frames;
+                vector<cuda::GpuMat> gpuFrames;
+                vector<Rect> regions;
+                while (downstreamOpen && shard.preparedQ->pop(batch)) {
+                    if (batch.keyframes.empty()) {
+                        if (inFlight.empty())
+                            scatter(batch);
+                        else
+                            inFlight.emplace_back(0, std::move(batch));
+                        continue;
                     }
+                    frames.clear();
+                    gpuFrames.clear();
+                    regions.clear();
+                    for (size_t i : batch.keyframes) {
+                        const FramePacket& pkt = batch.packets[i];
+                        if (batch.onDevice)
+                            gpuFrames.push_back(pkt.gpuFrame);
+                        else
+                            frames.push_back(pkt.frame);
+                        regions.push_back(pkt.roi);
+                    }
+                    shard.keyframes += batch.keyframes.size();
+                    ++shard.batches;
+                    if (detector.MaxInFlight() > 0) {
+                        while (downstreamOpen && batchesInFlight >= detector.MaxInFlight())
+                            collectOldest();
+                        uint64_t ticket = batch.onDevice ? detector.Submit(gpuFrames, regions)
+                                                         : detector.Submit(frames, batch.input, regions);
+                        inFlight.emplace_back(ticket, std::move(batch));
+                        ++batchesInFlight;
+                    } else {
+                        shared_ptr<DetectionBatch> arena = freeArena();
+                        if (batch.onDevice)
+                            detector.Infer(gpuFrames, *arena, regions);
+                        else
+                            detector.Infer(frames, *arena, regions, batch.input);
+                        assign(batch, arena);
+                        scatter(batch);
+                    }
+                    // the slot holds the decoder frames it needs until Collect
+                    frames.clear();
+                    gpuFrames.clear();
+                }
+                while (downstreamOpen && !inFlight.empty())
+                    collectOldest();
+                while (!inFlight.empty()) {
+                    if (!inFlight.front().second.keyframes.empty())
+                        detector.Collect(inFlight.front().first, discarded);
+                    inFlight.pop_front();
                 }
+                batchesInFlight = 0;
+                if (--shardsRunning == 0)
+                    for (auto& cam : cameras)
+                        cam->detectedQ->close();
+            });
+        }
+
+        // stage 4: tracking, distance and publishing, strictly in capture order, one thread per camera
+        std::atomic<int> trackersRunning{int(cameras.size())};
+        vector<std::thread> trackThreads;
+        for (auto& camPtr : cameras) {
+            trackThreads.emplace_back([&, &cam = *camPtr] {
+                int boundDevice = cam.decodeDevice;
+                cudaSetDevice(boundDevice);         // the vision estimator resizes NVDEC frames here
+                FrameTracker frameTracker(*cam.gdist, streamer, assignMethod, liveUpdateFrames, cam.cadence.get());
+                ThetaFuser& thetaFuser = cam.thetaFuser;
+                ImuStream* camImu = cam.index == 0 ? imu.get() : nullptr;
+                FramePacket pkt;
+                bool haveLast = false;
+                uint64_t lastSeq = 0;
+                int lastEpoch = 0;
+                int lastFrameNum = 0;
+                auto lastTick = chrono::steady_clock::now();
+                chrono::steady_clock::time_point firstCaptured;
+                uint64_t lastVisionId = 0;
+                while (cam.detectedQ->pop(pkt)) {
+                    pkt.inPipeline.reset();
+                    if (pkt.decodeDevice != boundDevice)
+                        cudaSetDevice(boundDevice = pkt.decodeDevice);  // the camera moved to another GPU
+                    if (haveLast && pkt.seq <= lastSeq)
+                        continue;   // never feed SORT out of order
+                    if (haveLast && pkt.epoch != lastEpoch) {
+                        // close the tracks of the previous loop before their ids go away, then reset the tracker
+                        frameTracker.restart(lastFrameNum, thetaFuser.theta());
+                        // Reinitialize theta fuser
+                        thetaFuser.initialize_from_imu(cam.theta0);
+                        PLOG(Severity::kINFO) << "Video looped - restarting detection...";
+                    }
+                    double dt = haveLast ? chrono::duration<double>(pkt.captured - lastTick).count() : 0.0;
+                    if (!haveLast)
+                        firstCaptured = pkt.captured;
+                    haveLast = true;
+                    lastSeq = pkt.seq;
+                    lastEpoch = pkt.epoch;
+                    lastFrameNum = pkt.frameNum;
+                    lastTick = pkt.captured;
+
+                    // the IMU samples between the previous frame and this one, integrated on the capture clock
+                    ImuInterval motion;
+                    if (camImu)
+                        motion = camImu->advance(pkt.captured);
+                    thetaFuser.propagate(motion.pitch_rate, dt);
+
+                    if (motion.stationary && motion.accel_reliable) {
+                        thetaFuser.imu_absolute_update(motion.gravity_pitch, 0.3);
+                        thetaFuser.stationary_bias_learn(motion.pitch_rate, 0.002);
+                    }
+
+                    // hand a frame to the vision estimator now and then, fuse its newest result once
+                    if (cam.vision) {
+                        if (pkt.frame.empty())
+                            cam.vision->offer(pkt.gpuFrame, pkt.captured);
+                        else
+                            cam.vision->offer(pkt.frame, pkt.captured);
+                        VisionPitchOut vis = cam.vision->latest();
+                        if (vis.id != lastVisionId) {
+                            lastVisionId = vis.id;
+                            thetaFuser.vision_update(vis.theta_vis_rad, vis.confidence);
+                        }
+                    }
+
+                    Metrics::instance().add(Counter::kFrames);
+                    if (pkt.keyframe)
+                        ++cam.keyframes;
+                    double theta = thetaFuser.theta();
+                    cam.latestTheta.store(theta, std::memory_order_relaxed);
+                    size_t observed = frameTracker.process(pkt.keyframe, pkt.detections(), pkt.frameNum, theta,
+                                                           pkt.frameSize(), pkt.trackedBboxes, pkt.ground);
+
+                    if (cam.detectionLog) {
+                        // the detector output and the pitch it was measured with, enough to replay this stage
+                        DetectionLogFrame record;
+                        record.t_ns = chrono::duration_cast<chrono::nanoseconds>(pkt.captured - firstCaptured).count();
+                        record.theta = theta;
+                        record.epoch = pkt.epoch;
+                        record.frame_num = pkt.frameNum;
+                        record.flags = pkt.keyframe ? DetectionLogFrame::kKeyframe : 0;
+                        cam.detectionLog->append(record, pkt.detections());
+                    }
+                    pkt.arena.reset();      // the batch's arena can be reused once all its frames are here
 
-                {
-                    std::ostringstream hud;
-                    hud << "Frame: " << frameCount << "/" << totalFrames
-                        << " | Tracks: " << trackedBboxes.rows
-                        << " | theta: " << fixed << setprecision(2) << (theta * 180.0 / M_PI) << " deg"
-                        << " | Streaming: " << (frame_detections.empty() ? "0" : to_string(frame_detections.size())) << " potholes";
-                    putText(frame, hud.str(), Point(10, 30),
-                            FONT_HERSHEY_SIMPLEX, 0.7, Scalar(0, 255, 0), 2);
+                    pkt.theta = theta;
+                    pkt.streamed = observed;
+                    if (!trackedQ.push(std::move(pkt)))
+                        break;
                 }
+                frameTracker.finish(lastFrameNum, thetaFuser.theta());
+                if (--trackersRunning == 0)
+                    trackedQ.close();
+            });
+        }
+
+        // stage 5: render on the main thread (HighGUI is not thread-safe), or just drain when headless
+        // Frame rate control: 30 FPS = 33.33ms per frame
+        const double targetFps = 30.0;
+        const double frameTimeMs = 1000.0 / targetFps; // ~33.33ms per frame
+        auto lastFrameTime = chrono::high_resolution_clock::now();
+
+        // Ctrl+C must not wait for a stalled source to deliver its next frame: the pipeline is stopped
+        // from here, the render loop then drains what is queued and ends
+        std::atomic<bool> renderDone{false};
+        std::thread interruptWatcher([&] {
+            while (!renderDone && !gInterrupted)
+                std::this_thread::sleep_for(chrono::milliseconds(20));
+            if (gInterrupted)
+                stopPipeline();
+        });
+
+        FramePacket pkt;
+        while (trackedQ.pop(pkt)) {
+            frameCount++;
+            CameraStream& cam = *cameras[pkt.camera];
+            ++cam.frames;
+            bool onDevice = !pkt.gpuFrame.empty();
+
+            if (!headless) {
+                if (onDevice)
+                    pkt.gpuFrame.download(pkt.frame);   // NVDEC frames only come to the host for display
+                Mat& frame = pkt.frame;
+                drawTrackedWithDistance(frame, pkt.trackedBboxes, pkt.ground, colors);
+
+                std::ostringstream hud;
+                if (multiCamera)
+                    hud << "Cam " << cam.index << " | ";
+                hud << "Frame: " << pkt.frameNum << "/" << cam.totalFrames
+                    << " | Tracks: " << pkt.trackedBboxes.size()
+                    << " | theta: " << fixed << setprecision(2) << (pkt.theta * 180.0 / M_PI) << " deg"
+                    << " | Streaming: " << pkt.streamed << " potholes";
+                if (cam.cadence->enabled())
+                    hud << " | Detect: 1/" << cam.cadence->interval() << (pkt.keyframe ? "" : " (coast)");
+                putText(frame, hud.str(), Point(10, 30),
+                        FONT_HERSHEY_SIMPLEX, 0.7, Scalar(0, 255, 0), 2);
+            }
 
-                if (frameCount % 30 == 0) {
-                    auto currentTime = chrono::high_resolution_clock::now();
-                    auto duration = chrono::duration_cast<chrono::seconds>(currentTime - startTime);
-                    double processingFps = (duration.count() > 0) ? frameCount / (double)duration.count() : 0;
-                    cout << "Progress: " << frameCount << "/" << totalFrames
-                         << " (" << (frameCount * 100 / max(1,totalFrames)) << "%) "
-                         << "| FPS: " << fixed << setprecision(2) << processingFps << " (target: " << targetFps << ")" << endl;
+            if (recorder && pkt.camera == 0) {
+                RecordFrame rec;
+                if (onDevice && pkt.decodeDevice != recorder->device()) {
+                    // camera 0 moved to another GPU since recording started, its frames cross over the host
+                    if (pkt.frame.empty())
+                        pkt.gpuFrame.download(pkt.frame);
+                    rec.host = pkt.frame;
+                    rec.annotated = !headless;
+                } else if (onDevice) {
+                    rec.device = pkt.gpuFrame;      // annotated on the GPU by the recorder
+                } else {
+                    rec.host = pkt.frame;
+                    rec.annotated = !headless;      // the window overlay is already drawn on it
+                }
+                if (!rec.annotated)
+                    rec.boxes = overlayBoxes(pkt.trackedBboxes, pkt.ground, colors, pkt.frameSize());
+                recorder->submit(std::move(rec));
+            }
+            Metrics::instance().record(Stage::kEndToEnd, chrono::steady_clock::now() - pkt.captured);
+
+            if (frameCount % 30 == 0 && AsyncLogger::instance().enabled(Severity::kINFO)) {
+                auto currentTime = chrono::high_resolution_clock::now();
+                chrono::duration<double> duration = currentTime - startTime;
+                double processingFps = (duration.count() > 0) ? frameCount / duration.count() : 0;
+                // formatted here, written by the logger thread: the render loop never waits on the console
+                LogLine progress(Severity::kINFO);
+                std::ostream& line = progress.stream();
+                line << "Progress: " << (multiCamera ? "cam " + to_string(cam.index) + " " : "")
+                     << pkt.frameNum << "/" << cam.totalFrames
+                     << " (" << (pkt.frameNum * 100 / max(1,cam.totalFrames)) << "%) "
+                     << "| FPS: " << fixed << setprecision(2) << processingFps;
+                if (!headless)
+                    line << " (target: " << targetFps << (multiCamera ? " per camera" : "") << ")";
+                line << " | queues: " << capturedDepth() << "/" << preparedDepth() << "/"
+                     << detectedDepth() << "/" << trackedQ.size()
+                     << " | dropped: " << (capturedDropped() + preparedDropped()
+                                           + detectedDropped() + trackedQ.dropped());
+                if (multiCamera)
+                    line << " | batch: " << setprecision(2) << meanBatch();
+                if (multiGpu) {
+                    line << " | gpu load:";
+                    for (const auto& shard : shards)
+                        line << " " << shard->load();
                 }
-            imshow("YOLO + SORT + Distance", frame);
-            
+                StreamerStats pub = streamer.stats();
+                line << " | published: " << pub.sent << " sent, " << pub.inFlight << " in flight, "
+                     << pub.dropped << " dropped, " << pub.failed << " failed";
+                if (recorder)
+                    line << " | recorded: " << recorder->written() << " (" << recorder->dropped() << " dropped)";
+            }
+
+            if (gInterrupted)
+                break;
+            if (headless)
+                continue;   // no pacing, runs at decoder and engine speed
+
+            imshow(cam.window, pkt.frame);
+            if (pkt.camera != 0)
+                continue;   // paced by the first camera
+
             // Frame rate control: maintain 30 FPS
             auto currentFrameTime = chrono::high_resolution_clock::now();
             auto elapsed = chrono::duration_cast<chrono::milliseconds>(currentFrameTime - lastFrameTime);
             double elapsedMs = elapsed.count();
-            
-            if (elapsedMs < frameTimeMs) {
-                // Wait to maintain 30 FPS
-                int waitTime = static_cast<int>(frameTimeMs - elapsedMs);
-                int key = waitKey(waitTime);
-                
-                if (key == 27) { 
-                    cout << "\nESC pressed. Exiting..." << endl;
-                    break;
-                }
-            } else {
-                // Frame took longer than target time, process immediately
-                int key = waitKey(1);
-                
-                if (key == 27) { 
-                    cout << "\nESC pressed. Exiting..." << endl;
-                    break;
-                }
+
+            // Wait to maintain 30 FPS, or process immediately if the frame took longer than target time
+            int waitTime = elapsedMs < frameTimeMs ? static_cast<int>(frameTimeMs - elapsedMs) : 1;
+            int key = waitKey(waitTime);
+            if (key == 27) {
+                cout << "\nESC pressed. Exiting..." << endl;
+                break;
             }
-            
+
             lastFrameTime = chrono::high_resolution_clock::now();
             // Removed SPACEBAR pause/resume - model runs continuously
         }
+        renderDone = true;
+        interruptWatcher.join();
+        if (gInterrupted)
+            cout << "\nInterrupted. Exiting..." << endl;
+        // nothing renders any more: close the recording before waiting on sources that may not return
+        if (recorder)
+            recorder->finish();
+
+        stopPipeline();
+        for (std::thread& t : captureThreads)
+            t.join();
+        for (std::thread& t : preprocessThreads)
+            t.join();
+        for (std::thread& t : inferenceThreads)
+            t.join();
+        for (std::thread& t : trackThreads)
+            t.join();
 
         auto endTime = chrono::high_resolution_clock::now();
-        auto totalDuration = chrono::duration_cast<chrono::seconds>(endTime - startTime);
-        double avgFps = (totalDuration.count() > 0) ? frameCount / (double)totalDuration.count() : 0;
+        chrono::duration<double> totalDuration = endTime - startTime;
+        double avgFps = (totalDuration.count() > 0) ? frameCount / totalDuration.count() : 0;
 
+        uint64_t keyframeCount = 0;
+        for (const auto& cam : cameras)
+            keyframeCount += cam->keyframes;
+        AsyncLogger::instance().flush();    // the pipeline's last lines before the summary
         cout << "\n==================================================" << endl;
         cout << "Tracking Complete!" << endl;
         cout << "  Frames Processed: " << frameCount << endl;
-        cout << "  Total Time: " << totalDuration.count() << " seconds" << endl;
+        cout << "  Total Time: " << fixed << setprecision(2) << totalDuration.count() << " seconds" << endl;
         cout << "  Average FPS: " << fixed << setprecision(2) << avgFps << endl;
+        if (cameras[0]->cadence->enabled())
+            cout << "  Detector Runs: " << keyframeCount << " (" << setprecision(1)
+                 << (frameCount > 0 ? 100.0 * keyframeCount / frameCount : 0.0) << "% of frames)" << endl;
+        if (multiCamera) {
+            for (const auto& cam : cameras)
+                cout << "  Camera " << cam->index << ": " << cam->frames << " frames, " << cam->keyframes
+                     << " detector runs (" << cam->path << ")" << endl;
+            cout << "  Mean Batch: " << setprecision(2) << meanBatch() << " of " << batchFrames << " frames" << endl;
+        }
+        if (multiGpu) {
+            for (const auto& shard : shards) {
+                uint64_t batches = shard->batches;
+                cout << "  GPU " << shard->device << " (" << shard->name << "): " << shard->cameras << " camera(s), "
+                     << shard->frames << " frames, " << shard->keyframes << " detector frames, " << setprecision(2)
+                     << (totalDuration.count() > 0 ? shard->frames / totalDuration.count() : 0.0) << " FPS, batch "
+                     << (batches ? double(shard->keyframes) / batches : 0.0) << endl;
+            }
+        }
+        for (const auto& cam : cameras) {
+            if (!cam->vision)
+                continue;
+            VisionPitchStats vs = cam->vision->stats();
+            cout << "  Vision Pitch" << (multiCamera ? " (camera " + to_string(cam->index) + ")" : "") << ": "
+                 << vs.estimates << " estimates (" << vs.confident << " confident, "
+                 << vs.skipped << " skipped), CPU " << setprecision(2) << vs.mean_cpu_ms << " ms avg / "
+                 << vs.max_cpu_ms << " ms max" << endl;
+        }
+        StreamerStats pub = streamer.stats();
+        cout << "  Events Published: " << pub.sent << " (dropped " << pub.dropped
+             << ", failed " << pub.failed << ")" << endl;
+        for (const auto& cam : cameras)
+            if (cam->detectionLog)
+                cout << "  Detections Logged: " << cam->detectionLog->frames() << " frames"
+                     << (cam->detectionLog->failed() ? " (cut short by a write error)" : "")
+                     << (multiCamera ? " (camera " + to_string(cam->index) + ")" : "") << endl;
+        reporter.reset();
+        Metrics::instance().clearGauges();      // they read the queues and sinks of this scope
+        vector<LatencyHistogram::Snapshot> sinceStart;
+        cout << "  Latency:\n" << Metrics::instance().summary(sinceStart);
         cout << "==================================================" << endl;
 
-        cap.release();
-        destroyAllWindows();
+        recorder.reset();   // drains the encoder queue
+        if (!headless)
+            destroyAllWindows();
     }
 
     return 0;
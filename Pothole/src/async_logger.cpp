@@ -0,0 +1,202 @@
+#include "async_logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+constexpr int kIdleWaitMs = 5;
+
+const char *severityPrefix(AsyncLogger::Severity severity)
+{
+    switch (severity) {
+    case AsyncLogger::Severity::kINTERNAL_ERROR: return "[F] ";
+    case AsyncLogger::Severity::kERROR: return "[E] ";
+    case AsyncLogger::Severity::kWARNING: return "[W] ";
+    case AsyncLogger::Severity::kINFO: return "[I] ";
+    default: return "[V] ";
+    }
+}
+
+int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+/**********************************************
+* AsyncLogger
+**********************************************/
+AsyncLogger &AsyncLogger::instance()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger() : threshold(int(Severity::kINFO))
+{
+    writer = std::thread(&AsyncLogger::run, this);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop = true;
+    wake.notify_all();
+    if (writer.joinable())
+        writer.join();
+}
+
+AsyncLogger::ThreadRing &AsyncLogger::localRing()
+{
+    // owned with the writer, so lines of a thread that exited are still written
+    struct Handle {
+        std::shared_ptr<ThreadRing> ring;
+        ~Handle() { if (ring) ring->retired = true; }
+    };
+    thread_local Handle handle;
+    if (!handle.ring) {
+        handle.ring = std::make_shared<ThreadRing>();
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(handle.ring);
+    }
+    return *handle.ring;
+}
+
+void AsyncLogger::write(Severity severity, const char *text, size_t length)
+{
+    Record record;
+    record.t_ns = nowNs();
+    record.severity = severity;
+    while (length > 0 && text[length - 1] == '\n')
+        --length;
+    record.length = uint16_t(std::min(length, kLineBytes));
+    std::memcpy(record.text, text, record.length);
+    if (stop) {
+        emit(record);   // the writer is gone, only during shutdown
+        return;
+    }
+    if (!localRing().ring.tryPush(record)) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    queuedCount.fetch_add(1, std::memory_order_release);
+    if (severity <= Severity::kERROR)
+        wake.notify_one();
+}
+
+void AsyncLogger::flush()
+{
+    uint64_t target = queuedCount.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wake.notify_one();
+    drained.wait(lock, [&] { return stop || handledCount.load(std::memory_order_acquire) >= target; });
+}
+
+void AsyncLogger::run()
+{
+    std::vector<std::shared_ptr<ThreadRing>> local;
+    while (true) {
+        bool stopping = stop;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            // a retired ring can't get new lines, the drain below empties it for good
+            local = rings;
+            rings.erase(std::remove_if(rings.begin(), rings.end(),
+                                       [](const std::shared_ptr<ThreadRing> &r) { return r->retired.load(); }),
+                        rings.end());
+        }
+        size_t lines = drain(local);
+        if (lines > 0) {
+            std::fflush(stdout);
+            std::fflush(stderr);
+            handledCount.fetch_add(lines, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            drained.notify_all();
+            continue;
+        }
+        if (stopping)
+            break;
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        drained.notify_all();
+        wake.wait_for(lock, std::chrono::milliseconds(kIdleWaitMs));
+    }
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    drained.notify_all();
+}
+
+size_t AsyncLogger::drain(std::vector<std::shared_ptr<ThreadRing>> &local)
+{
+    // at most one ring's worth per thread and pass, so a busy thread can't starve the others
+    size_t lines = 0;
+    Record record;
+    for (const std::shared_ptr<ThreadRing> &ring : local) {
+        for (size_t n = 0; n < kRingLines && ring->ring.tryPop(record); ++n) {
+            emit(record);
+            ++lines;
+        }
+    }
+    writtenCount.fetch_add(lines, std::memory_order_relaxed);
+    return lines;
+}
+
+void AsyncLogger::emit(const Record &record)
+{
+    std::time_t seconds = std::time_t(record.t_ns / 1000000000);
+    std::tm local{};
+    localtime_r(&seconds, &local);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "[%m/%d/%Y-%H:%M:%S] ", &local);
+    std::FILE *out = record.severity >= Severity::kINFO ? stdout : stderr;
+    std::fputs(stamp, out);
+    std::fputs(severityPrefix(record.severity), out);
+    std::fwrite(record.text, 1, record.length, out);
+    std::fputc('\n', out);
+}
+
+/**********************************************
+* LogSite
+**********************************************/
+uint32_t LogSite::admit()
+{
+    int64_t second = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t current = window.load(std::memory_order_relaxed);
+    if (current != second && window.compare_exchange_strong(current, second, std::memory_order_relaxed))
+        count.store(0, std::memory_order_relaxed);
+    if (count.fetch_add(1, std::memory_order_relaxed) >= perSecond) {
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        AsyncLogger::instance().addSuppressed(1);
+        return 0;
+    }
+    return 1 + suppressed.exchange(0, std::memory_order_relaxed);
+}
+
+/**********************************************
+* LogLine
+**********************************************/
+LogLine::LocalStream &LogLine::local()
+{
+    thread_local LocalStream stream;
+    return stream;
+}
+
+LogLine::LogLine(AsyncLogger::Severity severity, uint32_t suppressed_before)
+    : severity(severity), out(local().stream)
+{
+    local().buffer.reset();
+    out.clear();            // a truncated line left it bad
+    out.flags(std::ios_base::dec | std::ios_base::skipws);
+    out.precision(6);
+    out.fill(' ');
+    if (suppressed_before > 0)
+        out << "(" << suppressed_before << " similar suppressed) ";
+}
+
+LogLine::~LogLine()
+{
+    AsyncLogger::instance().write(severity, local().buffer.begin(), local().buffer.size());
+}
@@ -8,14 +8,18 @@
 
 namespace fs = std::filesystem;
 
+Logger gLogger{Logger::Severity::kINFO};
+// reportable up to kVERBOSE: the AsyncLogger threshold filters them, whichever thread they belong to
+thread_local LogStreamConsumer gLogVerbose{Severity::kVERBOSE, Severity::kVERBOSE};
+thread_local LogStreamConsumer gLogInfo{Severity::kVERBOSE, Severity::kINFO};
+thread_local LogStreamConsumer gLogWarning{Severity::kVERBOSE, Severity::kWARNING};
+thread_local LogStreamConsumer gLogError{Severity::kVERBOSE, Severity::kERROR};
+thread_local LogStreamConsumer gLogFatal{Severity::kVERBOSE, Severity::kINTERNAL_ERROR};
+
 // Set TensorRT logging severity for all loggers
 void setReportableSeverity(Logger::Severity severity) {
+    AsyncLogger::instance().setThreshold(severity);
     gLogger.setReportableSeverity(severity);
-    gLogVerbose.setReportableSeverity(severity);
-    gLogInfo.setReportableSeverity(severity);
-    gLogWarning.setReportableSeverity(severity);
-    gLogError.setReportableSeverity(severity);
-    gLogFatal.setReportableSeverity(severity);
 }
 
 // Read all image files from a folder
@@ -0,0 +1,43 @@
+#include "detect_cadence.h"
+#include <algorithm>
+#include <cmath>
+
+DetectionCadence::DetectionCadence(int max_interval, float sigma_limit, float flow_budget)
+    : max_interval(std::max(max_interval, 1)), sigma_limit(sigma_limit), flow_budget(flow_budget) {
+}
+
+bool DetectionCadence::nextIsKeyframe() {
+    // the tracking side runs a few frames behind, so its decisions land with the queue's latency
+    if (force.exchange(false, std::memory_order_relaxed) ||
+        ++since_keyframe >= current.load(std::memory_order_relaxed)) {
+        since_keyframe = 0;
+        return true;
+    }
+    return false;
+}
+
+void DetectionCadence::onKeyframe(const sort::TrackStats &stats) {
+    if (!enabled())
+        return;
+    if (stats.spawned > 0 || stats.tentative > 0 || stats.missed > 0) {
+        // confirmation needs minHits consecutive keyframes and a miss means the prediction drifted
+        current.store(1, std::memory_order_relaxed);
+        return;
+    }
+    int cap = max_interval;
+    if (stats.maxFlow > 0.f)
+        cap = std::min(cap, std::max(1, int(std::floor(flow_budget / stats.maxFlow))));
+    current.store(std::min(current.load(std::memory_order_relaxed) + 1, cap), std::memory_order_relaxed);
+}
+
+void DetectionCadence::onCoast(const sort::TrackStats &stats) {
+    if (stats.maxSigma > sigma_limit) {
+        current.store(std::max(1, current.load(std::memory_order_relaxed) / 2), std::memory_order_relaxed);
+        force.store(true, std::memory_order_relaxed);
+    }
+}
+
+void DetectionCadence::reset() {
+    current.store(1, std::memory_order_relaxed);
+    force.store(true, std::memory_order_relaxed);
+}
@@ -0,0 +1,117 @@
+#include "detection_log.h"
+#include "async_logger.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t kWriteBuffer = 1 << 20;    // ~40k boxes between syscalls
+
+} // namespace
+
+/**********************************************
+* DetectionLogWriter
+**********************************************/
+DetectionLogWriter::DetectionLogWriter(const std::string &path, const DetectionLogHeader &header)
+    : path(path), buffer(kWriteBuffer)
+{
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        PLOG(AsyncLogger::Severity::kERROR) << "DetectionLog: cannot create " << path << ": " << std::strerror(errno);
+        return;
+    }
+    std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        PLOG(AsyncLogger::Severity::kERROR) << "DetectionLog: cannot write " << path;
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+DetectionLogWriter::~DetectionLogWriter()
+{
+    if (file)
+        std::fclose(file);
+}
+
+void DetectionLogWriter::append(const DetectionLogFrame &frame, Span<const DetectRes> detections)
+{
+    if (!file || write_failed)
+        return;
+    boxes.resize(detections.size());
+    for (size_t i = 0; i < detections.size(); i++) {
+        const DetectRes &d = detections[i];
+        boxes[i] = {d.classes, d.prob, d.x, d.y, d.w, d.h};
+    }
+    DetectionLogFrame record = frame;
+    record.count = uint32_t(boxes.size());
+    if (std::fwrite(&record, sizeof(record), 1, file) != 1
+        || (!boxes.empty() && std::fwrite(boxes.data(), sizeof(DetectionLogBox), boxes.size(), file) != boxes.size())) {
+        // the log ends at its last complete frame, as after a crash
+        PLOG(AsyncLogger::Severity::kERROR) << "DetectionLog: cannot write " << path << " after " << frame_count
+                                            << " frames: " << std::strerror(errno) << ", logging stopped";
+        write_failed = true;
+        return;
+    }
+    frame_count++;
+}
+
+/**********************************************
+* DetectionLogReader
+**********************************************/
+DetectionLogReader::DetectionLogReader(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        PLOG(AsyncLogger::Severity::kERROR) << "DetectionLog: cannot open " << path << ": " << std::strerror(errno);
+        return;
+    }
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(DetectionLogHeader)) {
+        PLOG(AsyncLogger::Severity::kERROR) << "DetectionLog: " << path << " is not a detection log";
+        ::close(fd);
+        return;
+    }
+    void *map = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        PLOG(AsyncLogger::Severity::kERROR) << "DetectionLog: cannot map " << path << ": " << std::strerror(errno);
+        return;
+    }
+    ::madvise(map, size_t(st.st_size), MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t *>(map);
+    size = size_t(st.st_size);
+    const DetectionLogHeader &h = header();
+    if (std::memcmp(h.magic, "PDET", 4) != 0 || h.version != 1 || h.width <= 0 || h.height <= 0) {
+        PLOG(AsyncLogger::Severity::kERROR) << "DetectionLog: " << path << " has an unsupported header";
+        ::munmap(map, size);
+        data = nullptr;
+        size = 0;
+        return;
+    }
+    rewind();
+}
+
+DetectionLogReader::~DetectionLogReader()
+{
+    if (data)
+        ::munmap(const_cast<uint8_t *>(data), size);
+}
+
+bool DetectionLogReader::next(const DetectionLogFrame *&frame, Span<const DetectionLogBox> &boxes)
+{
+    if (!data || size - offset < sizeof(DetectionLogFrame))
+        return false;
+    const auto *record = reinterpret_cast<const DetectionLogFrame *>(data + offset);
+    size_t payload = size_t(record->count) * sizeof(DetectionLogBox);
+    if (size - offset - sizeof(DetectionLogFrame) < payload)
+        return false;   // truncated tail
+    frame = record;
+    boxes = Span<const DetectionLogBox>(reinterpret_cast<const DetectionLogBox *>(record + 1), record->count);
+    offset += sizeof(DetectionLogFrame) + payload;
+    return true;
+}
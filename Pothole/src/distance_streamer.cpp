@@ -0,0 +1,195 @@
+#include "distance_streamer.h"
+#include <chrono>
+
+namespace {
+
+constexpr long kRequestTimeoutMs = 1000;    // a slow server must not hold a connection for long
+constexpr int kPollMs = 50;                 // upper bound, producers wake the poll right away
+
+size_t discardResponse(char*, size_t size, size_t nmemb, void*)
+{
+    return size * nmemb;
+}
+
+} // namespace
+
+RealtimeDistanceStreamer::RealtimeDistanceStreamer(const std::string& endpoint_url, size_t queue_frames,
+                                                   int frames_per_request, int requests_in_flight, WireFormat format)
+    : endpoint_(endpoint_url), framesPerRequest_(frames_per_request < 1 ? 1 : frames_per_request),
+      encoder_(format), ring_(queue_frames), requests_(requests_in_flight < 1 ? 1 : requests_in_flight)
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    multi_ = curl_multi_init();
+    // connections are reused across requests; HTTP/2 servers get all requests multiplexed on one
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, (long)requests_.size());
+
+    std::string contentType = std::string("Content-Type: ") + wireContentType(format);
+    headers_ = curl_slist_append(headers_, contentType.c_str());
+    for (Request& request : requests_) {
+        request.easy = curl_easy_init();
+        curl_easy_setopt(request.easy, CURLOPT_URL, endpoint_.c_str());
+        curl_easy_setopt(request.easy, CURLOPT_HTTPHEADER, headers_);
+        curl_easy_setopt(request.easy, CURLOPT_TIMEOUT_MS, kRequestTimeoutMs);
+        curl_easy_setopt(request.easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(request.easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(request.easy, CURLOPT_WRITEFUNCTION, discardResponse);
+        curl_easy_setopt(request.easy, CURLOPT_PRIVATE, &request);
+    }
+
+    worker_ = std::thread(&RealtimeDistanceStreamer::run, this);
+}
+
+RealtimeDistanceStreamer::~RealtimeDistanceStreamer()
+{
+    stop_ = true;
+    curl_multi_wakeup(multi_);
+    if (worker_.joinable())
+        worker_.join();
+
+    for (Request& request : requests_) {
+        if (request.busy)
+            curl_multi_remove_handle(multi_, request.easy);
+        curl_easy_cleanup(request.easy);
+    }
+    curl_slist_free_all(headers_);
+    curl_multi_cleanup(multi_);
+    curl_global_cleanup();
+}
+
+void RealtimeDistanceStreamer::send_batch(const std::vector<std::pair<int, std::pair<float, float>>>& detections,
+                                          int frame_num, double theta_deg,
+                                          const std::vector<std::pair<int, std::pair<float, float>>>& sizes)
+{
+    StreamedFrame frame;
+    frame.frame = frame_num;
+    frame.thetaDeg = theta_deg;
+    frame.timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    frame.count = 0;
+    for (size_t i = 0; i < detections.size() && frame.count < StreamedFrame::kMaxTracks; ++i) {
+        StreamedTrack& track = frame.tracks[frame.count++];
+        track.id = detections[i].first;
+        track.d = detections[i].second.first;
+        track.x = detections[i].second.second;
+        track.size = i < sizes.size() ? sizes[i].second.first : 0.0f;
+    }
+
+    enqueue(frame);
+    curl_multi_wakeup(multi_);
+}
+
+void RealtimeDistanceStreamer::send_events(Span<const StreamedTrack> events, int frame_num, double theta_deg)
+{
+    if (events.empty())
+        return;
+    StreamedFrame frame;
+    frame.frame = frame_num;
+    frame.thetaDeg = theta_deg;
+    frame.timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    frame.count = 1;
+    for (const StreamedTrack& event : events) {
+        frame.tracks[0] = event;
+        enqueue(frame);
+    }
+    curl_multi_wakeup(multi_);
+}
+
+void RealtimeDistanceStreamer::enqueue(const StreamedFrame& frame)
+{
+    StreamedFrame evicted;
+    queued_ += 1;   // before the push, so the publisher never decrements first
+    size_t dropped = ring_.pushDropOldest(frame, evicted);
+    if (dropped) {
+        queued_ -= dropped;
+        dropped_ += dropped;
+    }
+}
+
+StreamerStats RealtimeDistanceStreamer::stats() const
+{
+    StreamerStats s;
+    s.sent = sent_.load();
+    s.failed = failed_.load();
+    s.dropped = dropped_.load();
+    s.inFlight = inFlight_.load();
+    s.queued = queued_.load();
+    return s;
+}
+
+// coalesce up to framesPerRequest_ queued frames into one request body, returns the frame count
+int RealtimeDistanceStreamer::fillRequest(Request& request)
+{
+    StreamedFrame frame;
+    int n = 0;
+    encoder_.begin(request.body);
+    while (n < framesPerRequest_ && ring_.tryPop(frame)) {
+        encoder_.append(request.body, frame);
+        ++n;
+    }
+    encoder_.finish(request.body);
+    if (n > 0)
+        queued_ -= n;
+    return n;
+}
+
+void RealtimeDistanceStreamer::run()
+{
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    while (true) {
+        bool stopping = stop_.load();
+        if (stopping && deadline == std::chrono::steady_clock::time_point::max())
+            deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kRequestTimeoutMs);
+
+        for (Request& request : requests_) {
+            if (request.busy)
+                continue;
+            int frames = fillRequest(request);
+            if (frames == 0)
+                break;
+            curl_easy_setopt(request.easy, CURLOPT_POSTFIELDS, request.body.c_str());
+            curl_easy_setopt(request.easy, CURLOPT_POSTFIELDSIZE, (long)request.body.size());
+            request.frames = frames;
+            request.busy = true;
+            inFlight_ += frames;
+            curl_multi_add_handle(multi_, request.easy);
+        }
+
+        int running = 0;
+        curl_multi_perform(multi_, &running);
+
+        CURLMsg* msg;
+        int left = 0;
+        while ((msg = curl_multi_info_read(multi_, &left))) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+            char* priv = nullptr;
+            long code = 0;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+            Request* request = reinterpret_cast<Request*>(priv);
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &code);
+            bool ok = msg->data.result == CURLE_OK && code >= 200 && code < 300;
+            (ok ? sent_ : failed_) += request->frames;
+            inFlight_ -= request->frames;
+            curl_multi_remove_handle(multi_, request->easy);
+            request->busy = false;
+            request->frames = 0;
+        }
+
+        if (stopping) {
+            // flush what is queued, but never hold up shutdown past one request timeout
+            bool idle = inFlight_.load() == 0 && queued_.load() == 0;
+            if (idle || std::chrono::steady_clock::now() >= deadline)
+                break;
+        }
+        curl_multi_poll(multi_, nullptr, 0, kPollMs, nullptr);
+    }
+
+    StreamedFrame frame;
+    while (ring_.tryPop(frame)) {
+        --queued_;
+        ++dropped_;
+    }
+}
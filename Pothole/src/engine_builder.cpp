@@ -0,0 +1,380 @@
+#include "engine_builder.h"
+#include "common.h"
+#include "int8_calibrator.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char kPlanMagic[8] = {'P', 'H', 'T', 'R', 'T', 'P', 'L', '1'};
+constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+// fixed-size prefix of a keyed plan file; the plan follows at header_size, which keeps it aligned
+struct PlanHeader {
+    char magic[8];
+    uint32_t header_size;
+    int32_t trt;
+    int32_t sm;
+    uint32_t reserved0;
+    uint64_t onnx;
+    uint64_t options;
+    uint64_t plan_size;
+    char gpu[96];
+    uint8_t reserved[112];
+};
+static_assert(sizeof(PlanHeader) == 256, "plan header layout");
+
+uint64_t fnv(uint64_t h, const void *data, size_t size)
+{
+    // 8 bytes per round, fast enough to hash a large ONNX on every start
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h = (h ^ w) * kFnvPrime;
+    }
+    for (; size > 0; ++p, --size)
+        h = (h ^ *p) * kFnvPrime;
+    return h;
+}
+
+template<typename T>
+uint64_t fnvValue(uint64_t h, const T &value)
+{
+    return fnv(h, &value, sizeof(value));
+}
+
+bool readFile(const std::string &path, std::vector<char> &out)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    out.resize(size_t(file.tellg()));
+    file.seekg(0);
+    return bool(file.read(out.data(), std::streamsize(out.size())));
+}
+
+// temporary file + rename, so concurrent readers see the old or the new file, never half of one
+bool writeFileAtomic(const std::string &path, const void *head, size_t head_size, const void *body, size_t body_size)
+{
+    std::string tmp = path + ".tmp." + std::to_string(::getpid());
+    std::FILE *file = std::fopen(tmp.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = (head_size == 0 || std::fwrite(head, head_size, 1, file) == 1)
+              && (body_size == 0 || std::fwrite(body, body_size, 1, file) == 1);
+    ok = std::fflush(file) == 0 && ok;
+    ok = ::fsync(::fileno(file)) == 0 && ok;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string hex(uint64_t v)
+{
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << v;
+    return out.str();
+}
+
+// a height left at 0 defaults to max_height / divisor on the 32-row stride: H/4 and H/2 for the
+// profile minimum and optimum, so the --roi road band runs below the full square
+int profileHeight(int height, int max_height, int divisor)
+{
+    return height > 0 ? height : std::max(32, max_height / divisor / 32 * 32);
+}
+
+} // namespace
+
+/**********************************************
+* EngineKey
+**********************************************/
+EngineKey EngineKey::current(int device)
+{
+    EngineKey key;
+    cudaDeviceProp prop{};
+    if (cudaGetDeviceProperties(&prop, device) == cudaSuccess) {
+        key.gpu = prop.name;
+        key.sm = prop.major * 10 + prop.minor;
+    }
+    key.trt = getInferLibVersion();
+    return key;
+}
+
+std::string EngineKey::mismatch(const EngineKey &expected, bool match_model) const
+{
+    std::ostringstream why;
+    if (gpu != expected.gpu || sm != expected.sm)
+        why << "built for " << gpu << " (sm " << sm << "), this is " << expected.gpu << " (sm " << expected.sm << ")";
+    else if (trt != expected.trt)
+        why << "built with TensorRT " << trt << ", the runtime is " << expected.trt;
+    else if (match_model && onnx != expected.onnx)
+        why << "built from a different ONNX";
+    else if (match_model && options != expected.options)
+        why << "built with different options (precision, workspace or profile)";
+    return why.str();
+}
+
+std::string EngineKey::str() const
+{
+    std::string slug;
+    for (char c : gpu) {
+        if (std::isalnum(static_cast<unsigned char>(c)))
+            slug += char(std::tolower(static_cast<unsigned char>(c)));
+        else if (!slug.empty() && slug.back() != '_')
+            slug += '_';
+    }
+    while (!slug.empty() && slug.back() == '_')
+        slug.pop_back();
+    return (slug.empty() ? "gpu" : slug) + "-sm" + std::to_string(sm) + "-trt" + std::to_string(trt)
+           + "-" + hex(onnx) + "-" + hex(options);
+}
+
+uint64_t hashFile(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st{};
+    uint64_t h = 0;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *map = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            ::madvise(map, size_t(st.st_size), MADV_SEQUENTIAL);
+            h = fnv(kFnvOffset, map, size_t(st.st_size));
+            ::munmap(map, size_t(st.st_size));
+        }
+    }
+    ::close(fd);
+    return h;
+}
+
+uint64_t hashOptions(const EngineBuildOptions &options)
+{
+    // everything but the paths
+    uint64_t h = kFnvOffset;
+    h = fnvValue(h, uint64_t(options.workspace));
+    h = fnvValue(h, options.fp16);
+    h = fnvValue(h, options.int8);
+    // the heights as built, so a plan cached before a default changed is not picked up again
+    for (int v : {options.min_batch, options.opt_batch, options.max_batch,
+                  profileHeight(options.min_height, options.max_height, 4),
+                  profileHeight(options.opt_height, options.max_height, 2),
+                  options.max_height, options.width, options.channels})
+        h = fnvValue(h, v);
+    return h;
+}
+
+EngineKey engineKey(const EngineBuildOptions &options, int device)
+{
+    EngineKey key = EngineKey::current(device);
+    key.onnx = options.onnx_hash ? options.onnx_hash : hashFile(options.onnx_file);
+    key.options = hashOptions(options);
+    return key;
+}
+
+std::string cachedEnginePath(const std::string &dir, const EngineBuildOptions &options, const EngineKey &key)
+{
+    std::string stem = options.onnx_file;
+    size_t slash = stem.find_last_of('/');
+    if (slash != std::string::npos)
+        stem = stem.substr(slash + 1);
+    size_t dot = stem.find_last_of('.');
+    if (dot != std::string::npos && dot > 0)
+        stem = stem.substr(0, dot);
+    return dir + (dir.empty() || dir.back() == '/' ? "" : "/") + stem + "-" + key.str() + ".plan";
+}
+
+/**********************************************
+* build
+**********************************************/
+std::unique_ptr<nvinfer1::IHostMemory> buildSerializedEngine(const EngineBuildOptions &options)
+{
+    std::unique_ptr<nvinfer1::IBuilder> builder(nvinfer1::createInferBuilder(gLogger.getTRTLogger()));
+    if (!builder) {
+        PLOG(Severity::kERROR) << "EngineBuilder: cannot create the TensorRT builder";
+        return nullptr;
+    }
+    std::unique_ptr<nvinfer1::INetworkDefinition> network(builder->createNetworkV2(0U));
+    std::unique_ptr<nvinfer1::ITimingCache> timing;    // declared first so they outlive the config using them
+    std::unique_ptr<FrameCalibrator> calibrator;
+    std::unique_ptr<nvinfer1::IBuilderConfig> config(builder->createBuilderConfig());
+    std::unique_ptr<nvonnxparser::IParser> parser(nvonnxparser::createParser(*network, gLogger.getTRTLogger()));
+    if (!parser->parseFromFile(options.onnx_file.c_str(), static_cast<int>(gLogger.getReportableSeverity()))) {
+        PLOG(Severity::kERROR) << "EngineBuilder: failure while parsing " << options.onnx_file;
+        return nullptr;
+    }
+
+    // one profile over the dynamic axes of the input: batch, height (e.g. the --roi road band) and width
+    nvinfer1::ITensor *input = network->getNbInputs() > 0 ? network->getInput(0) : nullptr;
+    nvinfer1::Dims dims = input ? input->getDimensions() : nvinfer1::Dims{};
+    bool dynamic = false;
+    for (int i = 0; i < dims.nbDims; ++i)
+        dynamic = dynamic || dims.d[i] < 0;
+    nvinfer1::IOptimizationProfile *profile = nullptr;
+    nvinfer1::Dims calibration_dims = dims;     // the calibrator feeds the opt shape
+    if (dynamic && dims.nbDims == 4) {
+        int max_h = options.max_height;
+        int min_h = profileHeight(options.min_height, max_h, 4);
+        int opt_h = profileHeight(options.opt_height, max_h, 2);
+        auto pick = [&](int axis, int flexible) { return dims.d[axis] < 0 ? flexible : int(dims.d[axis]); };
+        nvinfer1::Dims4 min_dims{pick(0, options.min_batch), pick(1, options.channels), pick(2, min_h), pick(3, options.width)};
+        nvinfer1::Dims4 opt_dims{pick(0, options.opt_batch), pick(1, options.channels), pick(2, opt_h), pick(3, options.width)};
+        nvinfer1::Dims4 max_dims{pick(0, options.max_batch), pick(1, options.channels), pick(2, max_h), pick(3, options.width)};
+        profile = builder->createOptimizationProfile();
+        profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMIN, min_dims);
+        profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kOPT, opt_dims);
+        profile->setDimensions(input->getName(), nvinfer1::OptProfileSelector::kMAX, max_dims);
+        if (!profile->isValid()) {
+            PLOG(Severity::kERROR) << "EngineBuilder: invalid profile, need min <= opt <= max for batch and height";
+            return nullptr;
+        }
+        config->addOptimizationProfile(profile);
+        calibration_dims = opt_dims;
+        PLOG(Severity::kINFO) << "EngineBuilder: profile " << input->getName() << " batch " << min_dims.d[0] << "/" << opt_dims.d[0]
+                              << "/" << max_dims.d[0] << ", height " << min_dims.d[2] << "/" << opt_dims.d[2] << "/" << max_dims.d[2]
+                              << " (min/opt/max)";
+    }
+
+    config->setMemoryPoolLimit(nvinfer1::MemoryPoolType::kWORKSPACE, options.workspace);
+    if (options.fp16 || options.int8)
+        config->setFlag(nvinfer1::BuilderFlag::kFP16);
+    if (options.int8) {
+        // implicit quantization through the calibrator API: deprecated in TensorRT 10, but the only
+        // way that works with a plain (not QDQ-annotated) ONNX export
+        if (options.calibration_source.empty() && !std::ifstream(options.calibration_cache)) {
+            PLOG(Severity::kERROR) << "EngineBuilder: INT8 needs calibration frames or a calibration cache";
+            return nullptr;
+        }
+        if (calibration_dims.nbDims != 4) {
+            PLOG(Severity::kERROR) << "EngineBuilder: INT8 calibration expects an NCHW input";
+            return nullptr;
+        }
+        config->setFlag(nvinfer1::BuilderFlag::kINT8);
+        calibrator.reset(new FrameCalibrator(options.calibration_source, options.calibration_cache,
+                                             int(calibration_dims.d[0]), int(calibration_dims.d[3]),
+                                             int(calibration_dims.d[2]), options.calibration_frames));
+        config->setInt8Calibrator(calibrator.get());
+        if (profile)
+            config->setCalibrationProfile(profile);
+    }
+
+    // tactic timings of earlier builds on this GPU skip most of the auto-tuning
+    std::vector<char> cache_blob;
+    if (!options.timing_cache.empty() && readFile(options.timing_cache, cache_blob)) {
+        PLOG(Severity::kINFO) << "EngineBuilder: timing cache " << options.timing_cache << " (" << cache_blob.size() / 1024 << " KiB)";
+    }
+    timing.reset(config->createTimingCache(cache_blob.data(), cache_blob.size()));
+    if (!timing || !config->setTimingCache(*timing, false)) {
+        PLOG(Severity::kWARNING) << "EngineBuilder: timing cache does not match this device, starting from an empty one";
+        timing.reset(config->createTimingCache(nullptr, 0));
+        config->setTimingCache(*timing, false);
+    }
+
+    PLOG(Severity::kINFO) << "EngineBuilder: building " << options.onnx_file
+                          << (options.int8 ? " (INT8 + FP16)" : options.fp16 ? " (FP16)" : " (FP32)") << "...";
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<nvinfer1::IHostMemory> plan(builder->buildSerializedNetwork(*network, *config));
+    if (!plan) {
+        PLOG(Severity::kERROR) << "EngineBuilder: build failed";
+        return nullptr;
+    }
+    PLOG(Severity::kINFO) << "EngineBuilder: built " << plan->size() / (1 << 20) << " MiB plan in " << std::fixed << std::setprecision(1)
+                          << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s";
+
+    if (!options.timing_cache.empty()) {
+        std::unique_ptr<nvinfer1::IHostMemory> blob(config->getTimingCache()->serialize());
+        if (!blob || !writeFileAtomic(options.timing_cache, nullptr, 0, blob->data(), blob->size())) {
+            PLOG(Severity::kERROR) << "EngineBuilder: cannot write timing cache " << options.timing_cache;
+        }
+    }
+    return plan;
+}
+
+bool writeEnginePlan(const std::string &path, const EngineKey &key, const void *plan, size_t size)
+{
+    PlanHeader header{};
+    std::memcpy(header.magic, kPlanMagic, sizeof(header.magic));
+    header.header_size = sizeof(PlanHeader);
+    header.trt = key.trt;
+    header.sm = key.sm;
+    header.onnx = key.onnx;
+    header.options = key.options;
+    header.plan_size = size;
+    std::strncpy(header.gpu, key.gpu.c_str(), sizeof(header.gpu) - 1);
+    if (!writeFileAtomic(path, &header, sizeof(header), plan, size)) {
+        PLOG(Severity::kERROR) << "EngineBuilder: cannot write " << path << ": " << std::strerror(errno);
+        return false;
+    }
+    PLOG(Severity::kINFO) << "EngineBuilder: saved " << path;
+    return true;
+}
+
+/**********************************************
+* EnginePlanFile
+**********************************************/
+EnginePlanFile::EnginePlanFile(const std::string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st{};
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return;
+    }
+    void *map = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        PLOG(Severity::kERROR) << "EnginePlanFile: cannot map " << path << ": " << std::strerror(errno);
+        return;
+    }
+    // the plan is read front to back once by the deserializer
+    ::madvise(map, size_t(st.st_size), MADV_SEQUENTIAL);
+    ::madvise(map, size_t(st.st_size), MADV_WILLNEED);
+    data = static_cast<const uint8_t *>(map);
+    size = size_t(st.st_size);
+
+    if (size < sizeof(PlanHeader) || std::memcmp(data, kPlanMagic, sizeof(kPlanMagic)) != 0)
+        return;     // bare plan
+    PlanHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.header_size < sizeof(PlanHeader) || header.header_size > size
+        || header.plan_size != size - header.header_size) {
+        PLOG(Severity::kERROR) << "EnginePlanFile: " << path << " is truncated or corrupt";
+        ::munmap(map, size);
+        data = nullptr;
+        size = 0;
+        return;
+    }
+    header.gpu[sizeof(header.gpu) - 1] = '\0';
+    has_key = true;
+    plan_offset = header.header_size;
+    plan_key.gpu = header.gpu;
+    plan_key.sm = header.sm;
+    plan_key.trt = header.trt;
+    plan_key.onnx = header.onnx;
+    plan_key.options = header.options;
+}
+
+EnginePlanFile::~EnginePlanFile()
+{
+    if (data)
+        ::munmap(const_cast<uint8_t *>(data), size);
+}
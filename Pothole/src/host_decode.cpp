@@ -0,0 +1,134 @@
+#include "host_decode.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HOST_DECODE_AVX2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define HOST_DECODE_NEON 1
+#endif
+
+namespace {
+
+// argmax over the class channels of one surviving anchor, then scale its box
+inline void emitAnchor(const float *out, int num_anchors, int num_classes, int i, float ratio,
+                       DetectRes *results, int &n)
+{
+    float score = out[4 * num_anchors + i];
+    int cls = 0;
+    for (int c = 1; c < num_classes; ++c) {
+        float s = out[(4 + c) * num_anchors + i];
+        if (s > score) {
+            score = s;
+            cls = c;
+        }
+    }
+    DetectRes &box = results[n++];
+    box.prob = score;
+    box.classes = cls;
+    box.x = out[i] * ratio;
+    box.y = out[num_anchors + i] * ratio;
+    box.w = out[2 * num_anchors + i] * ratio;
+    box.h = out[3 * num_anchors + i] * ratio;
+}
+
+int decodeScalar(const float *out, int begin, int num_anchors, int num_classes, float obj_threshold,
+                 float ratio, DetectRes *results, int n, int capacity)
+{
+    for (int i = begin; i < num_anchors && n < capacity; ++i) {
+        float best = out[4 * num_anchors + i];
+        for (int c = 1; c < num_classes; ++c)
+            best = std::max(best, out[(4 + c) * num_anchors + i]);
+        if (best >= obj_threshold)
+            emitAnchor(out, num_anchors, num_classes, i, ratio, results, n);
+    }
+    return n;
+}
+
+#if HOST_DECODE_AVX2
+__attribute__((target("avx2")))
+int decodeAvx2(const float *out, int num_anchors, int num_classes, float obj_threshold,
+               float ratio, DetectRes *results, int capacity)
+{
+    const __m256 thr = _mm256_set1_ps(obj_threshold);
+    const float *scores = out + 4 * num_anchors;
+    int i = 0, n = 0;
+    // anchors are contiguous within a channel, so 8 neighbouring anchors are one load per class
+    for (; i + 8 <= num_anchors && n + 8 <= capacity; i += 8) {
+        __m256 best = _mm256_loadu_ps(scores + i);
+        for (int c = 1; c < num_classes; ++c)
+            best = _mm256_max_ps(best, _mm256_loadu_ps(scores + c * num_anchors + i));
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(best, thr, _CMP_GE_OQ));
+        while (mask) {
+            int lane = __builtin_ctz(mask);
+            mask &= mask - 1;
+            emitAnchor(out, num_anchors, num_classes, i + lane, ratio, results, n);
+        }
+    }
+    return decodeScalar(out, i, num_anchors, num_classes, obj_threshold, ratio, results, n, capacity);
+}
+#endif
+
+#if HOST_DECODE_NEON
+int decodeNeon(const float *out, int num_anchors, int num_classes, float obj_threshold,
+               float ratio, DetectRes *results, int capacity)
+{
+    const float32x4_t thr = vdupq_n_f32(obj_threshold);
+    const float *scores = out + 4 * num_anchors;
+    int i = 0, n = 0;
+    for (; i + 8 <= num_anchors && n + 8 <= capacity; i += 8) {
+        float32x4_t lo = vld1q_f32(scores + i);
+        float32x4_t hi = vld1q_f32(scores + i + 4);
+        for (int c = 1; c < num_classes; ++c) {
+            lo = vmaxq_f32(lo, vld1q_f32(scores + c * num_anchors + i));
+            hi = vmaxq_f32(hi, vld1q_f32(scores + c * num_anchors + i + 4));
+        }
+        uint32x4_t mlo = vcgeq_f32(lo, thr);
+        uint32x4_t mhi = vcgeq_f32(hi, thr);
+        if (vmaxvq_u32(vorrq_u32(mlo, mhi)) == 0)
+            continue;
+        uint32_t lanes[8];
+        vst1q_u32(lanes, mlo);
+        vst1q_u32(lanes + 4, mhi);
+        for (int k = 0; k < 8; ++k)
+            if (lanes[k])
+                emitAnchor(out, num_anchors, num_classes, i + k, ratio, results, n);
+    }
+    return decodeScalar(out, i, num_anchors, num_classes, obj_threshold, ratio, results, n, capacity);
+}
+#endif
+
+} // namespace
+
+int decodeYoloOutputHost(const float *output, int num_anchors, int num_classes, float obj_threshold,
+                         float ratio, DetectRes *results, int capacity)
+{
+#if HOST_DECODE_AVX2
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2)
+        return decodeAvx2(output, num_anchors, num_classes, obj_threshold, ratio, results, capacity);
+#elif HOST_DECODE_NEON
+    return decodeNeon(output, num_anchors, num_classes, obj_threshold, ratio, results, capacity);
+#endif
+    return decodeScalar(output, 0, num_anchors, num_classes, obj_threshold, ratio, results, 0, capacity);
+}
+
+void letterboxBgrToTensorHost(const cv::Mat &src, float *chw, int width, int height)
+{
+    float ratio = std::min(float(width) / float(src.cols), float(height) / float(src.rows));
+    cv::Mat flt_img = cv::Mat::zeros(cv::Size(width, height), CV_8UC3);
+    cv::Mat rsz_img;
+    cv::resize(src, rsz_img, cv::Size(), ratio, ratio);
+    rsz_img.copyTo(flt_img(cv::Rect(0, 0, std::min(rsz_img.cols, width), std::min(rsz_img.rows, height))));
+    flt_img.convertTo(flt_img, CV_32FC3, 1.0 / 255);
+
+    //HWC TO CHW
+    int channelLength = width * height;
+    std::vector<cv::Mat> split_img = {
+            cv::Mat(height, width, CV_32FC1, chw + channelLength * 2),
+            cv::Mat(height, width, CV_32FC1, chw + channelLength),
+            cv::Mat(height, width, CV_32FC1, chw)
+    };
+    cv::split(flt_img, split_img);
+}
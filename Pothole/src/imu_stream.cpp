@@ -0,0 +1,222 @@
+#include "imu_stream.h"
+#include "async_logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kPollMs = 100;                // bounds the shutdown latency of a quiet device
+constexpr double kGravity = 9.80665;
+constexpr double kStationaryGyro = 0.02;    // rad/s, mean angular rate magnitude
+constexpr double kStationaryAccelStd = 0.15;    // m/s^2, accel magnitude standard deviation
+constexpr double kReliableAccel = 0.3;      // m/s^2, allowed deviation of the mean magnitude from g
+
+int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+ImuStream::ImuStream(const std::string &path, size_t ring_samples, int window)
+    : ring(ring_samples), window_samples(window < 2 ? 2 : window)
+{
+    fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        PLOG(AsyncLogger::Severity::kERROR) << "IMU: cannot open " << path << ": " << std::strerror(errno);
+        return;
+    }
+    struct stat st;
+    replay = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    reader = std::thread(&ImuStream::run, this);
+}
+
+ImuStream::~ImuStream()
+{
+    stop = true;
+    if (reader.joinable())
+        reader.join();
+    if (fd >= 0)
+        ::close(fd);
+    ImuStats s = stats();
+    if (fd >= 0) {
+        PLOG(AsyncLogger::Severity::kINFO) << "IMU: " << s.received << " samples (" << s.dropped << " dropped, "
+                                           << s.malformed << " malformed)";
+    }
+}
+
+ImuStats ImuStream::stats() const
+{
+    ImuStats s;
+    s.received = received.load();
+    s.dropped = dropped.load();
+    s.malformed = malformed.load();
+    return s;
+}
+
+void ImuStream::run()
+{
+    char buf[4096];
+    std::string line;
+    ImuSample sample, evicted;
+    while (!stop) {
+        struct pollfd p = {fd, POLLIN, 0};
+        if (!replay && ::poll(&p, 1, kPollMs) <= 0)
+            continue;
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n == 0) {
+            if (replay)
+                break;      // end of the recording
+            std::this_thread::sleep_for(std::chrono::milliseconds(kPollMs));   // FIFO without a writer
+            continue;
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR)
+                break;
+            continue;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buf[i] != '\n') {
+                line.push_back(buf[i]);
+                continue;
+            }
+            if (!line.empty() && parseLine(line.c_str(), sample)) {
+                received++;
+                if (replay) {
+                    int64_t wait;
+                    while ((wait = sample.t_ns - nowNs()) > 0 && !stop)
+                        std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<int64_t>(wait, kPollMs * 1000000)));
+                    while (!ring.tryPush(sample) && !stop)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                } else {
+                    dropped += ring.pushDropOldest(sample, evicted);
+                }
+            }
+            line.clear();
+        }
+    }
+}
+
+bool ImuStream::parseLine(const char *line, ImuSample &sample)
+{
+    double v[7];
+    int fields = std::sscanf(line, "%lf,%lf,%lf,%lf,%lf,%lf,%lf", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]);
+    int64_t arrival = nowNs();
+    const double *g = v;
+    if (fields == 7) {
+        // device clock: the least delayed sample seen so far sets the offset to the host clock;
+        // a recording is anchored at its first sample and paced in real time by run()
+        int64_t device = int64_t(v[0] * 1e9);
+        if (!replay || clock_offset_ns == INT64_MAX)
+            clock_offset_ns = std::min(clock_offset_ns, arrival - device);
+        sample.t_ns = device + clock_offset_ns;
+        g = v + 1;
+    } else if (fields == 6) {
+        sample.t_ns = arrival;
+    } else {
+        if (line[0] != '#')
+            malformed++;
+        return false;
+    }
+    sample.gx = float(g[0]);
+    sample.gy = float(g[1]);
+    sample.gz = float(g[2]);
+    sample.ax = float(g[3]);
+    sample.ay = float(g[4]);
+    sample.az = float(g[5]);
+    return true;
+}
+
+void ImuStream::observe(const ImuSample &sample)
+{
+    window_samples[window_next] = sample;
+    window_next = (window_next + 1) % window_samples.size();
+    window_full = std::min(window_full + 1, window_samples.size());
+}
+
+ImuInterval ImuStream::advance(std::chrono::steady_clock::time_point t)
+{
+    int64_t t_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    ImuInterval out;
+    if (!have_cursor) {
+        have_cursor = true;
+        cursor_ns = t_ns;
+    }
+    int64_t begin = cursor_ns;
+    if (t_ns <= begin)
+        return out;
+
+    // integral of the pitch rate over [a, b] clipped to [begin, t_ns], the rate linear between samples
+    double delta = 0.0;
+    auto integrate = [&](const ImuSample &a, const ImuSample &b) {
+        int64_t lo = std::max(a.t_ns, begin), hi = std::min(b.t_ns, t_ns);
+        if (hi <= lo || b.t_ns <= a.t_ns)
+            return;
+        double ra = pitchRate(a), rb = pitchRate(b);
+        double span = double(b.t_ns - a.t_ns);
+        double r_lo = ra + (rb - ra) * double(lo - a.t_ns) / span;
+        double r_hi = ra + (rb - ra) * double(hi - a.t_ns) / span;
+        delta += 0.5 * (r_lo + r_hi) * double(hi - lo) * 1e-9;
+    };
+
+    int64_t covered = begin;    // delta is integrated up to here
+    while (true) {
+        ImuSample s;
+        if (have_pending) {
+            s = pending;
+        } else if (!ring.tryPop(s)) {
+            break;
+        }
+        have_pending = false;
+        if (have_last && s.t_ns <= last.t_ns)
+            continue;   // out of order or duplicate
+        if (have_last) {
+            integrate(last, s);
+            covered = std::max(covered, std::min(s.t_ns, t_ns));
+        }
+        if (s.t_ns > t_ns) {
+            pending = s;            // straddles the frame, integrated again from t_ns next time
+            have_pending = true;
+            break;
+        }
+        last = s;
+        have_last = true;
+        observe(s);
+        out.samples++;
+    }
+    // past the newest sample, hold its rate
+    if (have_last && covered < t_ns)
+        delta += pitchRate(last) * double(t_ns - covered) * 1e-9;
+
+    out.dt = double(t_ns - begin) * 1e-9;
+    out.pitch_rate = delta / out.dt;
+    cursor_ns = t_ns;
+
+    if (window_full >= window_samples.size()) {
+        double gyro = 0.0, accel = 0.0, accel_sq = 0.0, ay = 0.0, az = 0.0;
+        for (const ImuSample &s : window_samples) {
+            gyro += std::sqrt(double(s.gx) * s.gx + double(s.gy) * s.gy + double(s.gz) * s.gz);
+            double a = std::sqrt(double(s.ax) * s.ax + double(s.ay) * s.ay + double(s.az) * s.az);
+            accel += a;
+            accel_sq += a * a;
+            ay += s.ay;
+            az += s.az;
+        }
+        double n = double(window_samples.size());
+        double mean = accel / n;
+        double var = std::max(0.0, accel_sq / n - mean * mean);
+        out.stationary = gyro / n < kStationaryGyro && std::sqrt(var) < kStationaryAccelStd;
+        out.accel_reliable = std::abs(mean - kGravity) < kReliableAccel;
+        // at rest the accelerometer reads +g along camera up, (0, -cos, -sin) * g for a downward pitch
+        out.gravity_pitch = std::atan2(-az / n, -ay / n);
+    }
+    return out;
+}
@@ -0,0 +1,114 @@
+#include "int8_calibrator.h"
+#include "common.h"
+#include "host_decode.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+
+FrameCalibrator::FrameCalibrator(const std::string &source, const std::string &cache_file, int batch, int width,
+                                 int height, int max_frames)
+    : cache_file(cache_file), batch(std::max(1, batch)), width(width), height(height)
+{
+    remaining = std::max(0, max_frames);
+    if (source.empty()) {
+        remaining = 0;
+    } else if (std::filesystem::is_directory(source)) {
+        // every n-th image, so a long drive is covered end to end
+        std::vector<std::string> all = readFolder(source);
+        size_t stride = std::max<size_t>(1, all.size() / std::max(1, remaining));
+        for (size_t i = 0; i < all.size() && int(images.size()) < remaining; i += stride)
+            images.push_back(all[i]);
+        remaining = int(images.size());
+    } else if (video.open(source)) {
+        int count = int(video.get(cv::CAP_PROP_FRAME_COUNT));
+        video_stride = count > remaining && remaining > 0 ? count / remaining : 1;
+    } else {
+        PLOG(Severity::kWARNING) << "FrameCalibrator: cannot open " << source << ", using the calibration cache only";
+        remaining = 0;
+    }
+    host.resize(size_t(this->batch) * 3 * width * height);
+    cudaMalloc(&device, host.size() * sizeof(float));
+    PLOG(Severity::kINFO) << "FrameCalibrator: " << remaining << " frames from " << (source.empty() ? "(none)" : source)
+                          << " at " << width << "x" << height << ", batch " << this->batch;
+}
+
+FrameCalibrator::~FrameCalibrator()
+{
+    if (device)
+        cudaFree(device);
+}
+
+bool FrameCalibrator::nextFrame(cv::Mat &frame)
+{
+    while (remaining > 0) {
+        --remaining;
+        if (!images.empty()) {
+            frame = cv::imread(images[next_image++], cv::IMREAD_COLOR);
+        } else {
+            // grab() skips without decoding to RGB, cheaper than seeking on most containers
+            for (int i = 1; i < video_stride && video.grab(); ++i) {}
+            if (!video.read(frame))
+                remaining = 0;
+        }
+        if (!frame.empty())
+            return true;
+    }
+    return false;
+}
+
+bool FrameCalibrator::getBatch(void *bindings[], const char *names[], int32_t nbBindings) noexcept
+{
+    (void)names;
+    // only full batches, a partial one would skew the histograms towards black padding
+    size_t per_image = size_t(3) * width * height;
+    cv::Mat frame;
+    for (int i = 0; i < batch; ++i) {
+        if (!nextFrame(frame))
+            return false;
+        letterboxBgrToTensorHost(frame, host.data() + i * per_image, width, height);
+    }
+    frames_used += batch;
+    if (frames_used % (batch * 50) == 0) {
+        PLOG(Severity::kINFO) << "FrameCalibrator: " << frames_used << " frames";
+    }
+    if (cudaMemcpy(device, host.data(), host.size() * sizeof(float), cudaMemcpyHostToDevice) != cudaSuccess)
+        return false;
+    if (nbBindings > 0)
+        bindings[0] = device;
+    return true;
+}
+
+const void *FrameCalibrator::readCalibrationCache(size_t &length) noexcept
+{
+    cache.clear();
+    std::ifstream file(cache_file, std::ios::binary);
+    if (!cache_file.empty() && file)
+        cache.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    length = cache.size();
+    if (!cache.empty()) {
+        PLOG(Severity::kINFO) << "FrameCalibrator: using calibration cache " << cache_file;
+    }
+    return cache.empty() ? nullptr : cache.data();
+}
+
+void FrameCalibrator::writeCalibrationCache(const void *data, size_t length) noexcept
+{
+    if (cache_file.empty())
+        return;
+    std::ofstream file(cache_file, std::ios::binary);
+    if (!file) {
+        PLOG(Severity::kERROR) << "FrameCalibrator: cannot create calibration cache " << cache_file;
+        return;
+    }
+    file.write(static_cast<const char *>(data), std::streamsize(length));
+    file.close();
+    if (!file) {
+        // a cut short cache would be read back by the next build
+        std::error_code ec;
+        std::filesystem::remove(cache_file, ec);
+        PLOG(Severity::kERROR) << "FrameCalibrator: cannot write calibration cache " << cache_file;
+        return;
+    }
+    PLOG(Severity::kINFO) << "FrameCalibrator: wrote calibration cache " << cache_file << " after " << frames_used << " frames";
+}
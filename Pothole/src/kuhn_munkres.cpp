@@ -1,4 +1,5 @@
 #include "kuhn_munkres.h"
+#include <algorithm>
 
 namespace kuhn_munkres {
 using std::max;
@@ -12,17 +13,33 @@ KuhnMunkres::~KuhnMunkres() {
 }
 
 vector<pair<int, int> > KuhnMunkres::compute(const Vec2f& costMatrix) {
-    this->C = KuhnMunkres::padMatrix(costMatrix);
-    this->n = C.size();
-    this->originalLength = costMatrix.size();
-    this->originalWidth = costMatrix.size() == 0 ? 0 : costMatrix[0].size();
-    this->rowCovered = Vec1b(n, false);
-    this->colCovered = Vec1b(n, false);
+    int rows = costMatrix.size();
+    int cols = 0;
+    for (const auto& row : costMatrix) cols = max(cols, int(row.size()));
+    this->input.assign(size_t(rows) * cols, 0.0f);
+    for (int i = 0; i < rows; ++i)
+        std::copy(costMatrix[i].begin(), costMatrix[i].end(), this->input.begin() + size_t(i) * cols);
+
+    vector<pair<int, int> > result;
+    compute(this->input.data(), rows, cols, result);
+    return result;
+}
+
+void KuhnMunkres::compute(const float *costMatrix, int rows, int cols, vector<pair<int, int> > &result) {
+    // pad to square with zeros
+    this->n = max(rows, cols);
+    this->originalLength = rows;
+    this->originalWidth = cols;
+    this->C.assign(size_t(n) * n, 0.0f);
+    for (int i = 0; i < rows; ++i)
+        std::copy(costMatrix + size_t(i) * cols, costMatrix + size_t(i + 1) * cols, this->C.begin() + size_t(i) * n);
+    this->rowCovered.assign(n, false);
+    this->colCovered.assign(n, false);
     this->Z0_r = 0;
     this->Z0_c = 0;
-    this->path = Vec2i(n*n, Vec1i(2));
-    this->marked = KuhnMunkres::makeMatrix(n, 0);
-    vector<StepFunc> steps = {
+    this->path.resize(size_t(n) * n * 2);
+    this->marked.assign(size_t(n) * n, 0);
+    static const StepFunc steps[] = {
         nullptr,
         &KuhnMunkres::step1,
         &KuhnMunkres::step2,
@@ -40,13 +57,11 @@ vector<pair<int, int> > KuhnMunkres::compute(const Vec2f& costMatrix) {
         step = (this->*func)();
     }
 
-    vector<pair<int, int> > result;
+    result.clear();
     for (int i = 0; i < this->originalLength; ++i)
         for (int j = 0; j < this->originalWidth; ++j)
-            if (this->marked[i][j] == 1)
+            if (this->marked[i * n + j] == 1)
                 result.push_back({i, j});
-
-    return result;
 }
 
 Vec2f KuhnMunkres::makeCostMatrix(const Vec2f& profixMatrix, InversionFunc func) {
@@ -68,38 +83,13 @@ Vec2f KuhnMunkres::makeCostMatrix(const Vec2f& profixMatrix, InversionFunc func)
     return costMatrix;
 }
 
-Vec2f KuhnMunkres::padMatrix(const Vec2f& matrix, const float padValue) {
-    int maxColumns = 0;
-    int totalRows = matrix.size();
-    for (auto row : matrix) maxColumns = max(maxColumns, int(row.size()));
-    totalRows = max(totalRows, maxColumns);
-
-    Vec2f newMatrix;
-    for (auto row : matrix) {
-        auto newRow = row;
-        while (newRow.size() < totalRows)
-            // Row too short, pad it.
-            newRow.push_back(padValue);
-        newMatrix.push_back(newRow);
-    }
-
-    while (newMatrix.size() < totalRows)
-        newMatrix.push_back(Vec1f(totalRows, padValue));
-
-    return newMatrix;
-}
-
-Vec2i KuhnMunkres::makeMatrix(const int &n, const int &val) {
-    return Vec2i(n, Vec1i(n, val));
-}
-
 int KuhnMunkres::step1() {
     for (int i = 0; i < this->n; ++i) {
-        float minVal = *std::min_element(this->C[i].begin(), this->C[i].end());
+        float minVal = *std::min_element(this->C.begin() + i * n, this->C.begin() + (i + 1) * n);
         // Find the minimum value for this row and substract that mininum
         // from every element in the row.
         for (int j = 0; j < this->n; ++j)
-            this->C[i][j] -= minVal;
+            this->C[i * n + j] -= minVal;
     }
 
     return 2;
@@ -108,8 +98,8 @@ int KuhnMunkres::step1() {
 int KuhnMunkres::step2() {
     for (int i = 0; i < this->n; ++i) {
         for (int j = 0; j < this->n; ++j) {
-            if (this->C[i][j] == 0 && !this->colCovered[j] && !this->rowCovered[i]) {
-                this->marked[i][j] = 1;
+            if (this->C[i * n + j] == 0 && !this->colCovered[j] && !this->rowCovered[i]) {
+                this->marked[i * n + j] = 1;
                 this->colCovered[j] = true;
                 this->rowCovered[i] = true;
                 break;
@@ -125,7 +115,7 @@ int KuhnMunkres::step3() {
     int count = 0;
     for (int i = 0; i < this->n; ++i) {
         for (int j = 0; j < this->n; ++j) {
-            if (this->marked[i][j] == 1 and !this->colCovered[j]) {
+            if (this->marked[i * n + j] == 1 and !this->colCovered[j]) {
                 this->colCovered[j] = true;
                 count += 1;
             }
@@ -144,7 +134,7 @@ int KuhnMunkres::step4() {
         if (row < 0) {
             return 6;
         } else {
-            this->marked[row][col] = 2;
+            this->marked[row * n + col] = 2;
             starCol = findStarInRow(row);
             if (starCol >= 0) {
                 col = starCol;
@@ -161,21 +151,21 @@ int KuhnMunkres::step4() {
 
 int KuhnMunkres::step5() {
     int count = 0;
-    this->path[count][0] = this->Z0_r;
-    this->path[count][1] = this->Z0_c;
+    this->path[2 * count] = this->Z0_r;
+    this->path[2 * count + 1] = this->Z0_c;
     while (true) {
-        int row = findStarInCol(this->path[count][1]);
+        int row = findStarInCol(this->path[2 * count + 1]);
         if (row >= 0) {
             count += 1;
-            this->path[count][0] = row;
-            this->path[count][1] = this->path[count - 1][1];
+            this->path[2 * count] = row;
+            this->path[2 * count + 1] = this->path[2 * (count - 1) + 1];
 
-            int col = findPrimeInRow(this->path[count][0]);
+            int col = findPrimeInRow(this->path[2 * count]);
             count += 1;
-            this->path[count][0] = this->path[count - 1][0];
-            this->path[count][1] = col;
+            this->path[2 * count] = this->path[2 * (count - 1)];
+            this->path[2 * count + 1] = col;
         } else {
-            this->convertPath(path, count);
+            this->convertPath(count);
             this->clearCovers();
             this->erasePrimes();
             return 3;
@@ -189,12 +179,12 @@ int KuhnMunkres::step6() {
     for (int i = 0; i < this->n; ++i) {
         for (int j = 0; j < this->n; ++j) {
             if (this->rowCovered[i]) {
-                this->C[i][j] += minVal;
+                this->C[i * n + j] += minVal;
                 events += 1;
             }
 
             if (!this->colCovered[j]) {
-                this->C[i][j] -= minVal;
+                this->C[i * n + j] -= minVal;
                 events += 1;
             }
 
@@ -213,8 +203,8 @@ float KuhnMunkres::findSmallest() const {
     float minVal = __FLT_MAX__;
     for (int i = 0; i < this->n; ++i) {
         for (int j = 0; j < this->n; ++j) {
-            if (!this->rowCovered[i] && !this->colCovered[j] && minVal > this->C[i][j]) {
-                minVal = this->C[i][j];
+            if (!this->rowCovered[i] && !this->colCovered[j] && minVal > this->C[i * n + j]) {
+                minVal = this->C[i * n + j];
             }
         }
     }
@@ -230,7 +220,7 @@ pair<int, int> KuhnMunkres::findAZero(const int i0, const int j0) const {
     while (!done) {
         int j = j0;
         while (true) {
-            if (this->C[i][j] == 0 && !this->rowCovered[i] & !this->colCovered[j]) {
+            if (this->C[i * n + j] == 0 && !this->rowCovered[i] & !this->colCovered[j]) {
                 row = i;
                 col = j;
                 done = true;
@@ -247,7 +237,7 @@ pair<int, int> KuhnMunkres::findAZero(const int i0, const int j0) const {
 
 int KuhnMunkres::findStarInRow(const int row) const {
     for (int j = 0; j < this->n; ++j)
-        if (this->marked[row][j] == 1)
+        if (this->marked[row * n + j] == 1)
             return j;
 
     return -1;
@@ -255,7 +245,7 @@ int KuhnMunkres::findStarInRow(const int row) const {
 
 int KuhnMunkres::findStarInCol(const int col) const {
     for (int i = 0; i < this->n; ++i)
-        if (this->marked[i][col] == 1)
+        if (this->marked[i * n + col] == 1)
             return i;
 
     return -1;
@@ -263,18 +253,16 @@ int KuhnMunkres::findStarInCol(const int col) const {
 
 int KuhnMunkres::findPrimeInRow(const int row) const {
     for (int j = 0; j < this->n; ++j)
-        if (this->marked[row][j] == 2)
+        if (this->marked[row * n + j] == 2)
             return j;
 
     return -1;
 }
 
-void KuhnMunkres::convertPath(const Vec2i& path, const int count) {
+void KuhnMunkres::convertPath(const int count) {
     for (int i = 0; i < count + 1; ++i) {
-        if (this->marked[path[i][0]][path[i][1]] == 1)
-            this->marked[path[i][0]][path[i][1]] = 0;
-        else
-            this->marked[path[i][0]][path[i][1]] = 1;
+        int &mark = this->marked[this->path[2 * i] * n + this->path[2 * i + 1]];
+        mark = mark == 1 ? 0 : 1;
     }
 }
 
@@ -288,8 +276,8 @@ void KuhnMunkres::clearCovers() {
 void KuhnMunkres::erasePrimes() {
     for (int i = 0; i < this->n; ++i)
         for (int j = 0; j < this->n; ++j)
-            if (this->marked[i][j] == 2)
-                this->marked[i][j] = 0;
+            if (this->marked[i * n + j] == 2)
+                this->marked[i * n + j] = 0;
 }
 
 } // namespace kuhn_munkres
\ No newline at end of file
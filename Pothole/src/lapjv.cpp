@@ -0,0 +1,132 @@
+#include "lapjv.h"
+#include <algorithm>
+#include <limits>
+
+namespace lapjv {
+
+namespace {
+constexpr double kInf = std::numeric_limits<double>::infinity();
+}
+
+LapJV::LapJV() {
+
+}
+
+LapJV::~LapJV() {
+
+}
+
+void LapJV::compute(const float *costMatrix, int rows, int cols, vector<pair<int, int> > &result) {
+    result.clear();
+    if (rows == 0 || cols == 0)
+        return;
+
+    // the augmentation needs rows <= cols
+    this->transposed = rows > cols;
+    if (this->transposed) {
+        this->transposedCost.resize(size_t(rows) * cols);
+        for (int i = 0; i < rows; ++i)
+            for (int j = 0; j < cols; ++j)
+                this->transposedCost[size_t(j) * rows + i] = costMatrix[size_t(i) * cols + j];
+        this->cost = this->transposedCost.data();
+        this->nr = cols;
+        this->nc = rows;
+    } else {
+        this->cost = costMatrix;
+        this->nr = rows;
+        this->nc = cols;
+    }
+
+    this->u.assign(nr, 0.0);
+    this->v.assign(nc, 0.0);
+    this->shortest.resize(nc);
+    this->path.assign(nc, -1);
+    this->col4row.assign(nr, -1);
+    this->row4col.assign(nc, -1);
+    this->remaining.resize(nc);
+    this->visitedRow.resize(nr);
+    this->visitedCol.resize(nc);
+
+    for (int curRow = 0; curRow < nr; ++curRow) {
+        double minVal = 0.0;
+        int sink = augmentingPath(curRow, minVal);
+        if (sink < 0)
+            return;     // only with non-finite costs
+
+        // dual update
+        this->u[curRow] += minVal;
+        for (int i = 0; i < nr; ++i)
+            if (this->visitedRow[i] && i != curRow)
+                this->u[i] += minVal - this->shortest[this->col4row[i]];
+        for (int j = 0; j < nc; ++j)
+            if (this->visitedCol[j])
+                this->v[j] -= minVal - this->shortest[j];
+
+        // flip the assignments along the path
+        int j = sink;
+        while (true) {
+            int i = this->path[j];
+            this->row4col[j] = i;
+            std::swap(this->col4row[i], j);
+            if (i == curRow) break;
+        }
+    }
+
+    for (int i = 0; i < nr; ++i) {
+        if (this->transposed)
+            result.push_back({this->col4row[i], i});
+        else
+            result.push_back({i, this->col4row[i]});
+    }
+    if (this->transposed)
+        std::sort(result.begin(), result.end());
+}
+
+int LapJV::augmentingPath(int row, double &minVal) {
+    int numRemaining = nc;
+    for (int it = 0; it < nc; ++it)
+        this->remaining[it] = nc - it - 1;  // scan low columns first
+    std::fill(this->visitedRow.begin(), this->visitedRow.end(), 0);
+    std::fill(this->visitedCol.begin(), this->visitedCol.end(), 0);
+    std::fill(this->shortest.begin(), this->shortest.end(), kInf);
+
+    minVal = 0.0;
+    int sink = -1;
+    int i = row;
+    while (sink == -1) {
+        int index = -1;
+        double lowest = kInf;
+        this->visitedRow[i] = 1;
+        const float *costRow = this->cost + size_t(i) * nc;
+
+        for (int it = 0; it < numRemaining; ++it) {
+            int j = this->remaining[it];
+            double reduced = minVal + costRow[j] - this->u[i] - this->v[j];
+            if (reduced < this->shortest[j]) {
+                this->path[j] = i;
+                this->shortest[j] = reduced;
+            }
+            // ties go to unassigned columns, which end the search
+            if (this->shortest[j] < lowest || (this->shortest[j] == lowest && this->row4col[j] == -1)) {
+                lowest = this->shortest[j];
+                index = it;
+            }
+        }
+
+        minVal = lowest;
+        if (minVal == kInf)
+            return -1;
+
+        int j = this->remaining[index];
+        if (this->row4col[j] == -1)
+            sink = j;
+        else
+            i = this->row4col[j];
+
+        this->visitedCol[j] = 1;
+        this->remaining[index] = this->remaining[--numRemaining];
+    }
+    return sink;
+}
+
+} // namespace lapjv
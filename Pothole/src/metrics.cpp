@@ -0,0 +1,279 @@
+#include "metrics.h"
+#include "async_logger.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kPollMs = 200;    // bounds the shutdown latency of the reporter
+const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+} // namespace
+
+const char *stageName(Stage stage)
+{
+    switch (stage) {
+        case Stage::kDecode:        return "decode";
+        case Stage::kPreprocess:    return "preprocess";
+        case Stage::kEnqueue:       return "enqueue";
+        case Stage::kGpuInput:      return "gpu_input";
+        case Stage::kGpuInfer:      return "gpu_infer";
+        case Stage::kGpuOutput:     return "gpu_output";
+        case Stage::kCollect:       return "collect";
+        case Stage::kTrack:         return "track";
+        case Stage::kDistance:      return "distance";
+        case Stage::kPublish:       return "publish";
+        case Stage::kVisionPitch:   return "vision_pitch";
+        case Stage::kEndToEnd:      return "end_to_end";
+        case Stage::kEngineLoad:    return "engine_load";
+        case Stage::kWarmup:        return "warmup";
+        default:                    return "unknown";
+    }
+}
+
+const char *counterName(Counter counter)
+{
+    switch (counter) {
+        case Counter::kFrames:      return "frames";
+        case Counter::kCandidates:  return "candidates";
+        case Counter::kDetections:  return "detections";
+        case Counter::kCandidateOverflow: return "candidate_overflow";
+        default:                    return "unknown";
+    }
+}
+
+/**********************************************
+* LatencyHistogram
+**********************************************/
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot s;
+    s.counts.resize(kBuckets);
+    for (int i = 0; i < kBuckets; i++) {
+        s.counts[i] = counts[i].load(std::memory_order_relaxed);
+        s.total += s.counts[i];
+    }
+    s.sum = sum.load(std::memory_order_relaxed);
+    s.max = max.load(std::memory_order_relaxed);
+    return s;
+}
+
+void LatencyHistogram::reset()
+{
+    for (std::atomic<uint64_t> &c : counts)
+        c.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::Snapshot::percentile(double p) const
+{
+    if (total == 0)
+        return 0.0;
+    // rank of the sample at p, 1-based
+    uint64_t rank = uint64_t(p * double(total) + 0.5);
+    rank = rank < 1 ? 1 : (rank > total ? total : rank);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank)
+            return bucketValue(int(i));
+    }
+    return double(max);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(const Snapshot &earlier) const
+{
+    if (earlier.counts.size() != counts.size())
+        return *this;
+    Snapshot s;
+    s.counts.resize(counts.size());
+    for (size_t i = 0; i < counts.size(); i++) {
+        s.counts[i] = counts[i] - earlier.counts[i];
+        s.total += s.counts[i];
+    }
+    s.sum = sum - earlier.sum;
+    s.max = max;
+    return s;
+}
+
+/**********************************************
+* Metrics
+**********************************************/
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::reset()
+{
+    for (LatencyHistogram &h : histograms)
+        h.reset();
+    for (std::atomic<uint64_t> &c : counters)
+        c.store(0, std::memory_order_relaxed);
+}
+
+void Metrics::addGauge(const std::string &name, const std::string &help, std::function<double()> read)
+{
+    std::lock_guard<std::mutex> lock(gaugeMutex);
+    gauges.push_back({name, help, std::move(read)});
+}
+
+void Metrics::clearGauges()
+{
+    std::lock_guard<std::mutex> lock(gaugeMutex);
+    gauges.clear();
+}
+
+std::string Metrics::prometheus() const
+{
+    std::ostringstream out;
+    out << "# HELP pothole_stage_seconds per-stage latency\n";
+    out << "# TYPE pothole_stage_seconds summary\n";
+    for (int i = 0; i < int(Stage::kCount); i++) {
+        LatencyHistogram::Snapshot s = histograms[i].snapshot();
+        const char *name = stageName(Stage(i));
+        for (double q : kQuantiles)
+            out << "pothole_stage_seconds{stage=\"" << name << "\",quantile=\"" << q << "\"} "
+                << s.percentile(q) * 1e-9 << "\n";
+        out << "pothole_stage_seconds_sum{stage=\"" << name << "\"} " << s.sum * 1e-9 << "\n";
+        out << "pothole_stage_seconds_count{stage=\"" << name << "\"} " << s.total << "\n";
+        out << "pothole_stage_max_seconds{stage=\"" << name << "\"} " << s.max * 1e-9 << "\n";
+    }
+    for (int i = 0; i < int(Counter::kCount); i++) {
+        const char *name = counterName(Counter(i));
+        out << "# TYPE pothole_" << name << "_total counter\n";
+        out << "pothole_" << name << "_total " << counters[i].load(std::memory_order_relaxed) << "\n";
+    }
+    std::lock_guard<std::mutex> lock(gaugeMutex);
+    for (const Gauge &g : gauges) {
+        out << "# HELP pothole_" << g.name << " " << g.help << "\n";
+        out << "# TYPE pothole_" << g.name << " gauge\n";
+        out << "pothole_" << g.name << " " << g.read() << "\n";
+    }
+    return out.str();
+}
+
+std::string Metrics::summary(std::vector<LatencyHistogram::Snapshot> &since) const
+{
+    since.resize(int(Stage::kCount));
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "  stage            count     mean      p50      p99    p99.9   (ms)\n";
+    for (int i = 0; i < int(Stage::kCount); i++) {
+        LatencyHistogram::Snapshot now = histograms[i].snapshot();
+        LatencyHistogram::Snapshot s = now.since(since[i]);
+        since[i] = std::move(now);
+        if (s.total == 0)
+            continue;
+        out << "  " << std::left << std::setw(14) << stageName(Stage(i)) << std::right
+            << std::setw(8) << s.total
+            << std::setw(9) << s.mean() * 1e-6
+            << std::setw(9) << s.percentile(0.5) * 1e-6
+            << std::setw(9) << s.percentile(0.99) * 1e-6
+            << std::setw(9) << s.percentile(0.999) * 1e-6 << "\n";
+    }
+    std::lock_guard<std::mutex> lock(gaugeMutex);
+    for (const Gauge &g : gauges)
+        out << "  " << std::left << std::setw(22) << g.name << std::right << std::setprecision(0) << g.read() << "\n";
+    return out.str();
+}
+
+/**********************************************
+* MetricsReporter
+**********************************************/
+MetricsReporter::MetricsReporter(int port, double interval_s) : interval_s(interval_s)
+{
+    if (port > 0) {
+        listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(uint16_t(port));
+        if (listen_fd < 0 || ::bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(listen_fd, 4) != 0) {
+            PLOG(AsyncLogger::Severity::kERROR) << "Metrics: cannot listen on port " << port << ": " << std::strerror(errno);
+            if (listen_fd >= 0)
+                ::close(listen_fd);
+            listen_fd = -1;
+        } else {
+            PLOG(AsyncLogger::Severity::kINFO) << "Metrics: serving http://0.0.0.0:" << port << "/metrics";
+        }
+    }
+    if (listen_fd >= 0 || interval_s > 0.0)
+        worker = std::thread(&MetricsReporter::run, this);
+}
+
+MetricsReporter::~MetricsReporter()
+{
+    stop = true;
+    if (worker.joinable())
+        worker.join();
+    if (listen_fd >= 0)
+        ::close(listen_fd);
+}
+
+void MetricsReporter::run()
+{
+    std::vector<LatencyHistogram::Snapshot> since;
+    auto next = std::chrono::steady_clock::now() + std::chrono::duration<double>(interval_s);
+    while (!stop) {
+        if (listen_fd >= 0) {
+            pollfd p = {listen_fd, POLLIN, 0};
+            if (::poll(&p, 1, kPollMs) > 0) {
+                int client = ::accept(listen_fd, nullptr, nullptr);
+                if (client >= 0) {
+                    serve(client);
+                    ::close(client);
+                }
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kPollMs));
+        }
+        if (interval_s > 0.0 && std::chrono::steady_clock::now() >= next) {
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(interval_s));
+            // a line at a time, the table is longer than a log line
+            std::istringstream table(Metrics::instance().summary(since));
+            PLOG(AsyncLogger::Severity::kINFO) << "[metrics] last " << interval_s << " s";
+            for (std::string line; std::getline(table, line);)
+                PLOG(AsyncLogger::Severity::kINFO) << line;
+        }
+    }
+}
+
+void MetricsReporter::serve(int client)
+{
+    // one short request per connection; anything but GET /metrics is a 404
+    timeval timeout{1, 0};
+    ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char request[1024];
+    ssize_t n = ::recv(client, request, sizeof(request) - 1, 0);
+    if (n <= 0)
+        return;
+    request[n] = '\0';
+    bool metrics = std::strncmp(request, "GET /metrics", 12) == 0;
+    std::string body = metrics ? Metrics::instance().prometheus() : std::string("not found\n");
+    std::ostringstream head;
+    head << "HTTP/1.1 " << (metrics ? "200 OK" : "404 Not Found") << "\r\n"
+         << "Content-Type: text/plain; version=0.0.4\r\n"
+         << "Content-Length: " << body.size() << "\r\n"
+         << "Connection: close\r\n\r\n";
+    std::string response = head.str() + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t w = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (w <= 0)
+            break;
+        sent += size_t(w);
+    }
+}
@@ -1,144 +1,266 @@
 #include "model.h"
 #include "common.h"
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sys/stat.h>
 
-void Model::onnxToTRTModel() {
-    // create the builder
-    nvinfer1::IBuilder *builder = nvinfer1::createInferBuilder(gLogger.getTRTLogger());
-    assert(builder != nullptr);
+nvinfer1::IRuntime *Model::SharedRuntime(int device) {
+    static std::mutex mutex;
+    static std::map<int, std::unique_ptr<nvinfer1::IRuntime>> runtimes;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<nvinfer1::IRuntime> &runtime = runtimes[device];
+    if (!runtime)
+        runtime.reset(nvinfer1::createInferRuntime(gLogger.getTRTLogger()));
+    return runtime.get();
+}
 
-    // TensorRT 8+ uses 0U instead of explicit batch flag
-    auto network = builder->createNetworkV2(0U);
-    auto config = builder->createBuilderConfig();
+EngineBuildOptions Model::buildOptions() const {
+    EngineBuildOptions options;
+    options.onnx_file = onnx_file;
+    options.onnx_hash = onnx_hash;
+    options.timing_cache = timing_cache_file;
+    if (build_workspace > 0)
+        options.workspace = build_workspace;
+    options.int8 = build_int8;
+    options.calibration_source = calibration_source;
+    options.calibration_cache = calibration_cache_file;
+    options.min_batch = MIN_BATCH_SIZE > 0 ? MIN_BATCH_SIZE : BATCH_SIZE;
+    options.opt_batch = OPT_BATCH_SIZE > 0 ? OPT_BATCH_SIZE : BATCH_SIZE;
+    options.max_batch = MAX_BATCH_SIZE > 0 ? MAX_BATCH_SIZE : BATCH_SIZE;
+    options.min_height = MIN_INPUT_HEIGHT;
+    options.opt_height = OPT_INPUT_HEIGHT;
+    options.max_height = IMAGE_HEIGHT;
+    options.width = IMAGE_WIDTH;
+    options.channels = INPUT_CHANNEL;
+    return options;
+}
 
-    auto parser = nvonnxparser::createParser(*network, gLogger.getTRTLogger());
-    if (!parser->parseFromFile(onnx_file.c_str(), static_cast<int>(gLogger.getReportableSeverity()))) {
-        gLogError << "Failure while parsing ONNX file" << std::endl;
-    }
-    
-    // Build the engine - Updated API
-    config->setMemoryPoolLimit(nvinfer1::MemoryPoolType::kWORKSPACE, 1ULL << 30); // 1 GB
-    config->setFlag(nvinfer1::BuilderFlag::kFP16);
-
-    std::cout << "start building engine" << std::endl;
-    nvinfer1::IHostMemory* serializedModel = builder->buildSerializedNetwork(*network, *config);
-    std::cout << "build engine done" << std::endl;
-    assert(serializedModel);
-    
-    // save engine
-    std::ofstream file;
-    file.open(engine_file, std::ios::binary | std::ios::out);
-    std::cout << "writing engine file..." << std::endl;
-    file.write((const char*)serializedModel->data(), serializedModel->size());
-    std::cout << "save engine file done" << std::endl;
-    file.close();
-    
-    // Deserialize to get engine
-    nvinfer1::IRuntime* runtime = nvinfer1::createInferRuntime(gLogger.getTRTLogger());
-    engine = runtime->deserializeCudaEngine(serializedModel->data(), serializedModel->size());
-    
-    // Clean up - no more destroy() calls, use delete
-    delete serializedModel;
-    delete parser;
-    delete network;
-    delete config;
-    delete builder;
+static bool fileExists(const std::string &path) {
+    struct stat st{};
+    return !path.empty() && ::stat(path.c_str(), &st) == 0;
 }
 
-bool Model::readTrtFile() {
-    std::string cached_engine;
-    std::fstream file;
-    std::cout << "loading filename from:" << engine_file << std::endl;
-    nvinfer1::IRuntime *trtRuntime;
-    file.open(engine_file, std::ios::binary | std::ios::in);
+void Model::onnxToTRTModel(const EngineBuildOptions &options, const EngineKey &key, const std::string &cache_path) {
+    std::unique_ptr<nvinfer1::IHostMemory> plan = buildSerializedEngine(options);
+    if (!plan)
+        return;
+    // the shared cache, so the next start on this hardware skips the build; the user's engine file
+    // only when there is none yet or overwrite_engine asks for it
+    if (!cache_path.empty())
+        writeEnginePlan(cache_path, key, plan->data(), plan->size());
+    if (!engine_file.empty() && (overwrite_engine || !fileExists(engine_file))) {
+        writeEnginePlan(engine_file, key, plan->data(), plan->size());
+    } else if (!engine_file.empty()) {
+        PLOG(Severity::kWARNING) << "LoadEngine: kept " << engine_file << ", the rebuilt plan is "
+                                 << (cache_path.empty() ? "not saved (set --engine-cache to keep it)" : "in " + cache_path)
+                                 << ", --overwrite-engine replaces " << engine_file;
+    }
+    engine = SharedRuntime(device)->deserializeCudaEngine(plan->data(), plan->size());
+}
 
-    if (!file.is_open()) {
-        std::cout << "read file error: " << engine_file << std::endl;
+bool Model::readTrtFile(const std::string &path, const EngineKey &expected, bool match_model, std::string &why) {
+    // the plan is mapped and deserialized in place: the only copy is TensorRT's own
+    EnginePlanFile file(path);
+    if (!file.isOpened()) {
+        why = path + " is missing or unreadable";
         return false;
     }
-
-    while (file.peek() != EOF) {
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        cached_engine.append(buffer.str());
+    if (file.tagged()) {
+        std::string mismatch = file.key().mismatch(expected, match_model);
+        if (!mismatch.empty()) {
+            why = path + " " + mismatch;
+            PLOG(Severity::kWARNING) << "LoadEngine: rejecting " << path << ": " << mismatch;
+            return false;
+        }
+    } else {
+        PLOG(Severity::kWARNING) << "LoadEngine: " << path << " carries no build key (e.g. from trtexec), loading it unchecked";
+    }
+    engine = SharedRuntime(device)->deserializeCudaEngine(file.plan(), file.planSize());
+    if (engine == nullptr) {
+        why = "cannot deserialize " + path;
+        PLOG(Severity::kERROR) << "LoadEngine: " << why;
+    } else {
+        gLogVerbose << "deserialized " << file.planSize() / (1 << 20) << " MiB plan from " << path << std::endl;
     }
-    file.close();
-
-    trtRuntime = nvinfer1::createInferRuntime(gLogger.getTRTLogger());
-    // Updated API - remove nullptr parameter
-    engine = trtRuntime->deserializeCudaEngine(cached_engine.data(), cached_engine.size());
-    std::cout << "deserialize done" << std::endl;
-    
     return (engine != nullptr);
 }
 
+static bool dynamicShape(const nvinfer1::Dims &dims) {
+    for (int i = 0; i < dims.nbDims; ++i)
+        if (dims.d[i] < 0)
+            return true;
+    return false;
+}
+
 void Model::LoadEngine() {
-    std::cout << "LoadEngine: Step 1 - Checking engine file..." << std::endl;
-    
-    // create and load engine
-    std::fstream existEngine;
-    existEngine.open(engine_file, std::ios::in);
-    if (existEngine) {
-        std::cout << "LoadEngine: Step 2 - Reading TRT file..." << std::endl;
-        readTrtFile();
-        assert(engine != nullptr);
-        std::cout << "LoadEngine: Step 3 - Engine loaded successfully" << std::endl;
-    } else {
-        std::cout << "LoadEngine: Step 2 - Building engine from ONNX..." << std::endl;
-        onnxToTRTModel();
-        assert(engine != nullptr);
-        std::cout << "LoadEngine: Step 3 - Engine built successfully" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    // the engine, its contexts and every buffer live on this device (the builder too)
+    BindDevice();
+
+    // engine_file when it was built for this GPU and TensorRT (and from this ONNX, when one is
+    // configured), else the cached plan for the same key, else a fresh build that fills both
+    bool have_onnx = fileExists(onnx_file);
+    EngineBuildOptions options = buildOptions();
+    EngineKey key = have_onnx ? engineKey(options, device) : EngineKey::current(device);
+    std::string cache_path = have_onnx && !engine_cache_dir.empty() ? cachedEnginePath(engine_cache_dir, options, key) : "";
+    std::string why = engine_file.empty() ? "no engine file configured" : engine_file + " does not exist";
+    if (fileExists(engine_file))
+        readTrtFile(engine_file, key, have_onnx, why);
+    std::string cache_why;
+    if (engine == nullptr && fileExists(cache_path) && !readTrtFile(cache_path, key, true, cache_why))
+        why += ", " + cache_why;
+    if (engine == nullptr && have_onnx) {
+        PLOG(Severity::kINFO) << "LoadEngine: no usable plan for " << key.str() << " (" << why << "), building it from "
+                              << onnx_file;
+        onnxToTRTModel(options, key, cache_path);
     }
+    if (engine == nullptr)
+        throw std::runtime_error("no usable TensorRT engine (" + (engine_file.empty() ? onnx_file : engine_file)
+                                 + "), pass the ONNX with --onnx to build one");
 
-    std::cout << "LoadEngine: Step 4 - Creating execution context..." << std::endl;
     context = engine->createExecutionContext();
     assert(context != nullptr);
-    std::cout << "LoadEngine: Step 5 - Context created successfully" << std::endl;
 
-    // ====== DEBUG INFO (TensorRT 10 API) ======
-    std::cout << "\n=== Engine Debug Info ===" << std::endl;
     int nbIOTensors = engine->getNbIOTensors();
-    std::cout << "Number of IO tensors: " << nbIOTensors << std::endl;
-    
     for (int i = 0; i < nbIOTensors; ++i) {
         const char* tensorName = engine->getIOTensorName(i);
         nvinfer1::Dims dims = engine->getTensorShape(tensorName);
-        nvinfer1::DataType dtype = engine->getTensorDataType(tensorName);
         nvinfer1::TensorIOMode ioMode = engine->getTensorIOMode(tensorName);
-        
-        std::cout << "Tensor " << i << ": " << tensorName << std::endl;
-        std::cout << "  Shape: ";
-        for (int j = 0; j < dims.nbDims; ++j) {
-            std::cout << dims.d[j];
-            if (j < dims.nbDims - 1) std::cout << "x";
-        }
-        std::cout << std::endl;
-        std::cout << "  DataType: " << (int)dtype << std::endl;
-        std::cout << "  Is Input: " << (ioMode == nvinfer1::TensorIOMode::kINPUT) << std::endl;
+        gLogVerbose << "tensor " << i << " " << tensorName << (ioMode == nvinfer1::TensorIOMode::kINPUT ? " (input) " : " (output) ");
+        for (int j = 0; j < dims.nbDims; ++j)
+            gLogVerbose << dims.d[j] << (j < dims.nbDims - 1 ? "x" : "");
+        gLogVerbose << " type " << int(engine->getTensorDataType(tensorName)) << std::endl;
     }
-    std::cout << "========================\n" << std::endl;
-    // ====== END DEBUG INFO ======
 
-    std::cout << "LoadEngine: Step 6 - Allocating buffers..." << std::endl;
-    // Get buffers - TensorRT 10 API
+    // a dynamic input is sized for the profile maximum, the output shape then follows from the context
+    const char* inputName = engine->getIOTensorName(0);
+    // (NCHW; a dynamic batch is bound to BATCH_SIZE, a dynamic height changes per submitted batch)
+    nvinfer1::Dims input_dims = engine->getTensorShape(inputName);
+    bool dynamic_batch = input_dims.nbDims == 4 && input_dims.d[0] < 0;
+    dynamic_input = input_dims.nbDims == 4 && input_dims.d[2] < 0;
+    if (!dynamic_batch && input_dims.nbDims == 4 && input_dims.d[0] != BATCH_SIZE) {
+        // a static batch is part of the plan, partial batches are padded up to it
+        PLOG(Severity::kWARNING) << "LoadEngine: engine batch is fixed at " << input_dims.d[0] << ", BATCH_SIZE " << BATCH_SIZE << " ignored";
+        BATCH_SIZE = int(input_dims.d[0]);
+    }
+    if (dynamic_input || dynamic_batch) {
+        nvinfer1::Dims max_dims = engine->getProfileShape(inputName, 0, nvinfer1::OptProfileSelector::kMAX);
+        nvinfer1::Dims min_dims = engine->getProfileShape(inputName, 0, nvinfer1::OptProfileSelector::kMIN);
+        if (dynamic_batch && (BATCH_SIZE < min_dims.d[0] || BATCH_SIZE > max_dims.d[0]))
+            throw std::runtime_error("BATCH_SIZE " + std::to_string(BATCH_SIZE) + " is outside the engine's batch profile "
+                                     + std::to_string(min_dims.d[0]) + ".." + std::to_string(max_dims.d[0]));
+        max_dims.d[0] = BATCH_SIZE;
+        IMAGE_HEIGHT = int(max_dims.d[2]);
+        IMAGE_WIDTH = int(max_dims.d[3]);
+        if (dynamic_input)
+            MIN_INPUT_HEIGHT = int(min_dims.d[2]);
+        context->setInputShape(inputName, max_dims);
+        if (dynamic_input) {
+            PLOG(Severity::kINFO) << "LoadEngine: dynamic input height " << MIN_INPUT_HEIGHT << ".." << IMAGE_HEIGHT
+                                  << " at width " << IMAGE_WIDTH;
+        }
+        if (dynamic_batch) {
+            PLOG(Severity::kINFO) << "LoadEngine: dynamic batch " << min_dims.d[0] << ".." << max_dims.d[0] << ", bound to " << BATCH_SIZE;
+        }
+    }
     bufferSize.resize(nbIOTensors);
     
     for (int i = 0; i < nbIOTensors; ++i) {
         const char* tensorName = engine->getIOTensorName(i);
-        nvinfer1::Dims dims = engine->getTensorShape(tensorName);
+        nvinfer1::Dims dims = context->getTensorShape(tensorName);
         nvinfer1::DataType dtype = engine->getTensorDataType(tensorName);
         int64_t totalSize = volume(dims) * getElementSize(dtype);
         bufferSize[i] = totalSize;
-        std::cout << "  Allocating tensor " << i << " (" << tensorName << "): " << totalSize << " bytes" << std::endl;
         cudaMalloc(&buffers[i], totalSize);
     }
+    // the copies of the synchronous path are then true async DMA, and nothing is allocated per frame
+    cudaHostAlloc((void **)&hostInput, bufferSize[0], cudaHostAllocDefault);
+    cudaHostAlloc((void **)&hostOutput, bufferSize[1], cudaHostAllocDefault);
     
-    std::cout << "LoadEngine: Step 7 - Creating CUDA stream..." << std::endl;
     // get stream
     cudaStreamCreate(&stream);
     
-    std::cout << "LoadEngine: Step 8 - Computing output size..." << std::endl;
     outSize = int(bufferSize[1] / sizeof(float) / BATCH_SIZE);
-    std::cout << "  Output size: " << outSize << std::endl;
     
-    std::cout << "LoadEngine: COMPLETE! ✓" << std::endl;
+    if (NUM_CONTEXTS > 0)
+        createInferSlots();
+
+    load_time = std::chrono::steady_clock::now() - start;
+    PLOG(Severity::kINFO) << "LoadEngine: " << engine_file << " ready on GPU " << device << " in " << std::fixed << std::setprecision(1)
+                          << std::chrono::duration<double, std::milli>(load_time).count() << " ms ("
+                          << nbIOTensors << " IO tensors, output " << outSize << " floats, "
+                          << NUM_CONTEXTS << " async contexts)";
+}
+
+Model::~Model() {
+    BindDevice();
+    for (InferSlot &slot : slots) {
+        if (slot.graph) cudaGraphExecDestroy(slot.graph);
+        if (slot.hostRaw) cudaFreeHost(slot.hostRaw);
+        for (cudaEvent_t event : {slot.done, slot.started, slot.inputReady, slot.inferred})
+            if (event) cudaEventDestroy(event);
+        if (slot.stream) cudaStreamDestroy(slot.stream);
+        for (void *buffer : slot.buffers)
+            if (buffer) cudaFree(buffer);
+        if (slot.hostInput) cudaFreeHost(slot.hostInput);
+        if (slot.hostOutput) cudaFreeHost(slot.hostOutput);
+        if (slot.rawInput) cudaFree(slot.rawInput);
+        freeGpuDetections(slot.detections);
+        delete slot.context;
+    }
+    for (void *buffer : buffers)
+        if (buffer) cudaFree(buffer);
+    if (hostInput) cudaFreeHost(hostInput);
+    if (hostOutput) cudaFreeHost(hostOutput);
+    if (stream) cudaStreamDestroy(stream);
+    // contexts before their engine, the engine before the shared runtime (destroyed at exit)
+    delete context;
+    delete engine;
+}
+
+void Model::createInferSlots() {
+    slots.resize(NUM_CONTEXTS);
+    const char* inputName = engine->getIOTensorName(0);
+    const char* outputName = engine->getIOTensorName(1);
+    for (InferSlot &slot : slots) {
+        slot.context = engine->createExecutionContext();
+        assert(slot.context != nullptr);
+        cudaStreamCreateWithFlags(&slot.stream, cudaStreamNonBlocking);
+        // timed events, Collect() reads the per-stage GPU times from them
+        cudaEventCreate(&slot.done);
+        cudaEventCreate(&slot.started);
+        cudaEventCreate(&slot.inputReady);
+        cudaEventCreate(&slot.inferred);
+        cudaMalloc(&slot.buffers[0], bufferSize[0]);
+        cudaMalloc(&slot.buffers[1], bufferSize[1]);
+        cudaHostAlloc((void **)&slot.hostInput, bufferSize[0], cudaHostAllocDefault);
+        cudaHostAlloc((void **)&slot.hostOutput, bufferSize[1], cudaHostAllocDefault);
+        // the shape LoadEngine bound; bindInputHeight changes the height of a dynamic engine per batch
+        if (dynamicShape(engine->getTensorShape(inputName)))
+            slot.context->setInputShape(inputName, context->getTensorShape(inputName));
+        // bindings never change for a slot, so they are set once here instead of per frame
+        slot.context->setTensorAddress(inputName, slot.buffers[0]);
+        slot.context->setTensorAddress(outputName, slot.buffers[1]);
+    }
+}
+
+InferSlot *Model::acquireInferSlot() {
+    // hand out slots round-robin so that tickets complete in submission order
+    if (slots.empty())
+        return nullptr;
+    InferSlot &slot = slots[nextTicket % slots.size()];
+    if (slot.ticket != 0)
+        return nullptr;
+    slot.ticket = nextTicket++;
+    return &slot;
+}
+
+InferSlot *Model::findInferSlot(uint64_t ticket) {
+    if (ticket == 0 || slots.empty())
+        return nullptr;
+    InferSlot &slot = slots[ticket % slots.size()];
+    return slot.ticket == ticket ? &slot : nullptr;
 }
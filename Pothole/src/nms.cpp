@@ -0,0 +1,170 @@
+#include "nms.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+constexpr int kMaxGridCells = 4096;
+constexpr int kGridMinBoxes = 32;   // below this the plain pairwise pass is cheaper
+}
+
+NmsMethod parseNmsMethod(const std::string &name) {
+    return name == "greedy" ? NmsMethod::kGreedy : NmsMethod::kGrid;
+}
+
+void NmsEngine::run(std::vector<DetectRes> &detections) {
+    loadBoxes(detections);
+
+    bool finite = true;
+    for (int i = 0; i < n && finite; ++i)
+        finite = std::isfinite(x1[i]) && std::isfinite(y1[i]) && std::isfinite(x2[i]) && std::isfinite(y2[i]);
+    // the grid relies on "suppressed => overlapping", which only holds for a positive threshold
+    if (config.method == NmsMethod::kGrid && config.threshold > 0.f && finite && n >= kGridMinBoxes)
+        suppressGrid();
+    else
+        suppressGreedy();
+
+    survivors.clear();
+    for (int i = 0; i < n; ++i)
+        if (!suppressed[i])
+            survivors.push_back(detections[order[i]]);
+    detections.assign(survivors.begin(), survivors.end());
+}
+
+void NmsEngine::loadBoxes(const std::vector<DetectRes> &detections) {
+    int total = (int)detections.size();
+    order.resize(total);
+    std::iota(order.begin(), order.end(), 0);
+    auto byScore = [&detections](int a, int b) { return detections[a].prob > detections[b].prob; };
+
+    // top-K pre-filter, the cost of everything below scales with the kept candidates only
+    n = config.topK > 0 && config.topK < total ? config.topK : total;
+    if (n < total) {
+        std::nth_element(order.begin(), order.begin() + n, order.end(), byScore);
+        order.resize(n);
+    }
+    std::sort(order.begin(), order.end(), byScore);
+
+    x1.resize(n); y1.resize(n); x2.resize(n); y2.resize(n);
+    cx.resize(n); cy.resize(n); area.resize(n); cls.resize(n);
+    for (int i = 0; i < n; ++i) {
+        const DetectRes &d = detections[order[i]];
+        x1[i] = d.x - d.w / 2;
+        y1[i] = d.y - d.h / 2;
+        x2[i] = d.x + d.w / 2;
+        y2[i] = d.y + d.h / 2;
+        cx[i] = d.x;
+        cy[i] = d.y;
+        area[i] = d.w * d.h;
+        cls[i] = d.classes;
+    }
+    suppressed.assign(n, 0);
+}
+
+bool NmsEngine::pairEligible(int a, int b) const {
+    return config.agnostic || cls[a] == cls[b];
+}
+
+// same DIoU as YOLO::IOUCalculate
+float NmsEngine::diou(int a, int b) const {
+    float inter_l = std::max(x1[a], x1[b]);
+    float inter_t = std::max(y1[a], y1[b]);
+    float inter_r = std::min(x2[a], x2[b]);
+    float inter_b = std::min(y2[a], y2[b]);
+    if (inter_b < inter_t || inter_r < inter_l)
+        return 0;
+    float inter_area = (inter_b - inter_t) * (inter_r - inter_l);
+    float union_area = area[a] + area[b] - inter_area;
+    if (union_area == 0)
+        return 0;
+    float outer_w = std::max(x2[a], x2[b]) - std::min(x1[a], x1[b]);
+    float outer_h = std::max(y2[a], y2[b]) - std::min(y1[a], y1[b]);
+    float distance_d = (cx[a] - cx[b]) * (cx[a] - cx[b]) + (cy[a] - cy[b]) * (cy[a] - cy[b]);
+    float distance_c = outer_w * outer_w + outer_h * outer_h;
+    return inter_area / union_area - distance_d / distance_c;
+}
+
+void NmsEngine::suppressGreedy() {
+    for (int i = 0; i < n; ++i) {
+        if (suppressed[i])
+            continue;
+        for (int j = i + 1; j < n; ++j)
+            if (!suppressed[j] && pairEligible(i, j) && diou(i, j) > config.threshold)
+                suppressed[j] = 1;
+    }
+}
+
+void NmsEngine::buildGrid() {
+    // cells of about twice the median box side: most boxes touch at most four cells
+    sides.resize(n);
+    for (int i = 0; i < n; ++i)
+        sides[i] = std::max(x2[i] - x1[i], y2[i] - y1[i]);
+    std::nth_element(sides.begin(), sides.begin() + n / 2, sides.end());
+    cellSize = std::max(2.f * sides[n / 2], 1.f);
+
+    gridX0 = *std::min_element(x1.begin(), x1.end());
+    gridY0 = *std::min_element(y1.begin(), y1.end());
+    float spanX = *std::max_element(x2.begin(), x2.end()) - gridX0;
+    float spanY = *std::max_element(y2.begin(), y2.end()) - gridY0;
+    do {
+        gridW = int(spanX / cellSize) + 1;
+        gridH = int(spanY / cellSize) + 1;
+        if ((long long)gridW * gridH > kMaxGridCells)
+            cellSize *= 2.f;
+    } while ((long long)gridW * gridH > kMaxGridCells);
+
+    auto cellRange = [this](int i, int &c0, int &c1, int &r0, int &r1) {
+        c0 = std::min(gridW - 1, std::max(0, int((x1[i] - gridX0) / cellSize)));
+        c1 = std::min(gridW - 1, std::max(0, int((x2[i] - gridX0) / cellSize)));
+        r0 = std::min(gridH - 1, std::max(0, int((y1[i] - gridY0) / cellSize)));
+        r1 = std::min(gridH - 1, std::max(0, int((y2[i] - gridY0) / cellSize)));
+    };
+
+    // counting sort of (cell, box) pairs; boxes are inserted by rank so every cell stays score-ordered
+    cellStart.assign(gridW * gridH + 1, 0);
+    int c0, c1, r0, r1;
+    for (int i = 0; i < n; ++i) {
+        cellRange(i, c0, c1, r0, r1);
+        for (int r = r0; r <= r1; ++r)
+            for (int c = c0; c <= c1; ++c)
+                cellStart[r * gridW + c + 1]++;
+    }
+    std::partial_sum(cellStart.begin(), cellStart.end(), cellStart.begin());
+    cellItems.resize(cellStart.back());
+    cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+    for (int i = 0; i < n; ++i) {
+        cellRange(i, c0, c1, r0, r1);
+        for (int r = r0; r <= r1; ++r)
+            for (int c = c0; c <= c1; ++c)
+                cellItems[cellFill[r * gridW + c]++] = i;
+    }
+}
+
+void NmsEngine::suppressGrid() {
+    buildGrid();
+    visited.assign(n, -1);
+    for (int i = 0; i < n; ++i) {
+        if (suppressed[i])
+            continue;
+        int c0 = std::min(gridW - 1, std::max(0, int((x1[i] - gridX0) / cellSize)));
+        int c1 = std::min(gridW - 1, std::max(0, int((x2[i] - gridX0) / cellSize)));
+        int r0 = std::min(gridH - 1, std::max(0, int((y1[i] - gridY0) / cellSize)));
+        int r1 = std::min(gridH - 1, std::max(0, int((y2[i] - gridY0) / cellSize)));
+        for (int r = r0; r <= r1; ++r) {
+            for (int c = c0; c <= c1; ++c) {
+                int cell = r * gridW + c;
+                auto first = cellItems.begin() + cellStart[cell];
+                auto last = cellItems.begin() + cellStart[cell + 1];
+                // only lower-scored boxes can be suppressed by i
+                for (auto it = std::upper_bound(first, last, i); it != last; ++it) {
+                    int j = *it;
+                    if (suppressed[j] || visited[j] == i)
+                        continue;
+                    visited[j] = i;
+                    if (pairEligible(i, j) && diou(i, j) > config.threshold)
+                        suppressed[j] = 1;
+                }
+            }
+        }
+    }
+}
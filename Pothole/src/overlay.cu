@@ -0,0 +1,40 @@
+#include "overlay.h"
+
+namespace {
+
+// one z-slice per rectangle, threads cover the rectangle's own extent
+__global__ void overlayRectsKernel(uint8_t *img, int img_w, int img_h, size_t pitch,
+                                   const OverlayRect *rects)
+{
+    const OverlayRect r = rects[blockIdx.z];
+    int dx = blockIdx.x * blockDim.x + threadIdx.x;
+    int dy = blockIdx.y * blockDim.y + threadIdx.y;
+    if (dx >= r.w || dy >= r.h)
+        return;
+    if (r.thickness > 0 && dx >= r.thickness && dx < r.w - r.thickness
+        && dy >= r.thickness && dy < r.h - r.thickness)
+        return;     // inside the outline
+
+    int x = r.x + dx;
+    int y = r.y + dy;
+    if (x < 0 || y < 0 || x >= img_w || y >= img_h)
+        return;
+    uint8_t *px = img + y * pitch + x * 3;
+    px[0] = r.b;
+    px[1] = r.g;
+    px[2] = r.r;
+}
+
+} // namespace
+
+cudaError_t drawOverlayRects(uint8_t *d_img, int img_w, int img_h, size_t pitch,
+                             const OverlayRect *d_rects, int count, int max_w, int max_h,
+                             cudaStream_t stream)
+{
+    if (count <= 0 || max_w <= 0 || max_h <= 0)
+        return cudaSuccess;
+    dim3 block(32, 8);
+    dim3 grid((max_w + block.x - 1) / block.x, (max_h + block.y - 1) / block.y, count);
+    overlayRectsKernel<<<grid, block, 0, stream>>>(d_img, img_w, img_h, pitch, d_rects);
+    return cudaGetLastError();
+}
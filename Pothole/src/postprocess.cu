@@ -0,0 +1,174 @@
+#include "postprocess.h"
+
+namespace {
+
+constexpr int kNmsThreads = 256;
+
+__global__ void thresholdKernel(const float *output, int num_anchors, int num_classes, float obj_threshold,
+                                DeviceDetection *candidates, int *candidate_count)
+{
+    int i = blockIdx.x * blockDim.x + threadIdx.x;
+    int b = blockIdx.y;
+    if (i >= num_anchors)
+        return;
+
+    // channel-first layout [C, N]: 0-3 box, 4.. class scores
+    const float *out = output + size_t(b) * (num_classes + 4) * num_anchors;
+    float score = out[4 * num_anchors + i];
+    int cls = 0;
+    for (int c = 1; c < num_classes; ++c) {
+        float s = out[(4 + c) * num_anchors + i];
+        if (s > score) {
+            score = s;
+            cls = c;
+        }
+    }
+    if (score < obj_threshold)
+        return;
+
+    // keeps counting past the end, so the host sees the overflow and decodes the image itself
+    int slot = atomicAdd(&candidate_count[b], 1);
+    if (slot >= kGpuMaxCandidates)
+        return;
+    DeviceDetection &d = candidates[b * kGpuMaxCandidates + slot];
+    d.classes = cls;
+    d.prob = score;
+    d.x = out[i];
+    d.y = out[num_anchors + i];
+    d.w = out[2 * num_anchors + i];
+    d.h = out[3 * num_anchors + i];
+}
+
+// DIoU, identical to YOLO::IOUCalculate
+__device__ float diou(const DeviceDetection &a, const DeviceDetection &b)
+{
+    float inter_l = fmaxf(a.x - a.w / 2, b.x - b.w / 2);
+    float inter_t = fmaxf(a.y - a.h / 2, b.y - b.h / 2);
+    float inter_r = fminf(a.x + a.w / 2, b.x + b.w / 2);
+    float inter_b = fminf(a.y + a.h / 2, b.y + b.h / 2);
+    if (inter_b < inter_t || inter_r < inter_l)
+        return 0.f;
+    float inter_area = (inter_b - inter_t) * (inter_r - inter_l);
+    float union_area = a.w * a.h + b.w * b.h - inter_area;
+    if (union_area == 0.f)
+        return 0.f;
+    float outer_w = fmaxf(a.x + a.w / 2, b.x + b.w / 2) - fminf(a.x - a.w / 2, b.x - b.w / 2);
+    float outer_h = fmaxf(a.y + a.h / 2, b.y + b.h / 2) - fminf(a.y - a.h / 2, b.y - b.h / 2);
+    float distance_d = (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
+    float distance_c = outer_w * outer_w + outer_h * outer_h;
+    return inter_area / union_area - distance_d / distance_c;
+}
+
+// one block per image: bitonic sort of the candidates by score, then greedy NMS
+__global__ void nmsKernel(const DeviceDetection *candidates, const int *candidate_count,
+                          float nms_threshold, bool agnostic,
+                          DeviceDetection *detections, int *count, int max_detections)
+{
+    __shared__ float score[kGpuMaxCandidates];
+    __shared__ short order[kGpuMaxCandidates];
+    __shared__ unsigned char keep[kGpuMaxCandidates];
+
+    int b = blockIdx.x;
+    int n = min(candidate_count[b], kGpuMaxCandidates);
+    const DeviceDetection *cand = candidates + b * kGpuMaxCandidates;
+
+    for (int i = threadIdx.x; i < kGpuMaxCandidates; i += blockDim.x) {
+        score[i] = i < n ? cand[i].prob : -1.f;
+        order[i] = short(i);
+        keep[i] = i < n;
+    }
+    __syncthreads();
+
+    // descending bitonic sort, padding (-1) sinks to the end
+    for (int k = 2; k <= kGpuMaxCandidates; k <<= 1) {
+        for (int j = k >> 1; j > 0; j >>= 1) {
+            for (int i = threadIdx.x; i < kGpuMaxCandidates; i += blockDim.x) {
+                int ixj = i ^ j;
+                if (ixj > i) {
+                    bool descending = (i & k) == 0;
+                    if ((score[i] < score[ixj]) == descending) {
+                        float ts = score[i]; score[i] = score[ixj]; score[ixj] = ts;
+                        short to = order[i]; order[i] = order[ixj]; order[ixj] = to;
+                    }
+                }
+            }
+            __syncthreads();
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        if (keep[i]) {
+            DeviceDetection a = cand[order[i]];
+            for (int j = i + 1 + threadIdx.x; j < n; j += blockDim.x) {
+                if (!keep[j])
+                    continue;
+                const DeviceDetection &o = cand[order[j]];
+                if ((agnostic || o.classes == a.classes) && diou(a, o) > nms_threshold)
+                    keep[j] = 0;
+            }
+        }
+        __syncthreads();
+    }
+
+    if (threadIdx.x == 0) {
+        int kept = 0;
+        for (int i = 0; i < n && kept < max_detections; ++i)
+            if (keep[i])
+                detections[b * max_detections + kept++] = cand[order[i]];
+        count[b] = kept;
+    }
+}
+
+} // namespace
+
+bool allocGpuDetections(GpuDetections &det, int batch, int maxDetections)
+{
+    det.batch = batch;
+    det.maxDetections = maxDetections;
+    bool ok = cudaMalloc((void **)&det.candidates, sizeof(DeviceDetection) * batch * kGpuMaxCandidates) == cudaSuccess
+           && cudaMalloc((void **)&det.candidateCount, sizeof(int) * batch) == cudaSuccess
+           && cudaMalloc((void **)&det.detections, sizeof(DeviceDetection) * batch * maxDetections) == cudaSuccess
+           && cudaMalloc((void **)&det.count, sizeof(int) * batch) == cudaSuccess
+           && cudaHostAlloc((void **)&det.hostDetections, sizeof(DeviceDetection) * batch * maxDetections,
+                            cudaHostAllocDefault) == cudaSuccess
+           && cudaHostAlloc((void **)&det.hostCount, sizeof(int) * batch, cudaHostAllocDefault) == cudaSuccess
+           && cudaHostAlloc((void **)&det.hostCandidateCount, sizeof(int) * batch, cudaHostAllocDefault) == cudaSuccess;
+    if (!ok) {
+        cudaGetLastError();
+        freeGpuDetections(det);
+    }
+    return ok;
+}
+
+void freeGpuDetections(GpuDetections &det)
+{
+    if (det.candidates) cudaFree(det.candidates);
+    if (det.candidateCount) cudaFree(det.candidateCount);
+    if (det.detections) cudaFree(det.detections);
+    if (det.count) cudaFree(det.count);
+    if (det.hostDetections) cudaFreeHost(det.hostDetections);
+    if (det.hostCount) cudaFreeHost(det.hostCount);
+    if (det.hostCandidateCount) cudaFreeHost(det.hostCandidateCount);
+    det = GpuDetections();
+}
+
+cudaError_t decodeYoloOutput(const float *d_output, int num_anchors, int num_classes,
+                             float obj_threshold, float nms_threshold, bool agnostic,
+                             GpuDetections &det, cudaStream_t stream)
+{
+    cudaMemsetAsync(det.candidateCount, 0, sizeof(int) * det.batch, stream);
+
+    dim3 block(256);
+    dim3 grid((num_anchors + block.x - 1) / block.x, det.batch);
+    thresholdKernel<<<grid, block, 0, stream>>>(d_output, num_anchors, num_classes, obj_threshold,
+                                                det.candidates, det.candidateCount);
+    nmsKernel<<<det.batch, kNmsThreads, 0, stream>>>(det.candidates, det.candidateCount,
+                                                    nms_threshold, agnostic,
+                                                    det.detections, det.count, det.maxDetections);
+
+    cudaMemcpyAsync(det.hostCount, det.count, sizeof(int) * det.batch, cudaMemcpyDeviceToHost, stream);
+    cudaMemcpyAsync(det.hostCandidateCount, det.candidateCount, sizeof(int) * det.batch, cudaMemcpyDeviceToHost, stream);
+    cudaMemcpyAsync(det.hostDetections, det.detections, sizeof(DeviceDetection) * det.batch * det.maxDetections,
+                    cudaMemcpyDeviceToHost, stream);
+    return cudaGetLastError();
+}
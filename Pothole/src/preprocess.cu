@@ -0,0 +1,67 @@
+#include "preprocess.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+__global__ void letterboxKernel(const uint8_t *src, int src_w, int src_h, size_t src_pitch,
+                                float *dst, int dst_w, int dst_h,
+                                int rsz_w, int rsz_h, float inv_ratio)
+{
+    int x = blockIdx.x * blockDim.x + threadIdx.x;
+    int y = blockIdx.y * blockDim.y + threadIdx.y;
+    if (x >= dst_w || y >= dst_h)
+        return;
+
+    int plane = dst_w * dst_h;
+    int idx = y * dst_w + x;
+
+    // padding area (right / bottom) stays black
+    if (x >= rsz_w || y >= rsz_h) {
+        dst[idx] = 0.f;
+        dst[idx + plane] = 0.f;
+        dst[idx + 2 * plane] = 0.f;
+        return;
+    }
+
+    // same pixel-center mapping as cv::resize INTER_LINEAR
+    float sx = fmaxf((x + 0.5f) * inv_ratio - 0.5f, 0.f);
+    float sy = fmaxf((y + 0.5f) * inv_ratio - 0.5f, 0.f);
+    int x0 = min(int(sx), src_w - 1);
+    int y0 = min(int(sy), src_h - 1);
+    int x1 = min(x0 + 1, src_w - 1);
+    int y1 = min(y0 + 1, src_h - 1);
+    float ax = sx - x0;
+    float ay = sy - y0;
+
+    const uint8_t *row0 = src + y0 * src_pitch;
+    const uint8_t *row1 = src + y1 * src_pitch;
+
+    // BGR interleaved -> RGB planar, scaled to [0, 1]
+#pragma unroll
+    for (int c = 0; c < 3; ++c) {
+        float top = (1.f - ax) * row0[x0 * 3 + c] + ax * row0[x1 * 3 + c];
+        float bottom = (1.f - ax) * row1[x0 * 3 + c] + ax * row1[x1 * 3 + c];
+        dst[idx + (2 - c) * plane] = ((1.f - ay) * top + ay * bottom) * (1.f / 255.f);
+    }
+}
+
+} // namespace
+
+cudaError_t letterboxBgrToTensor(const uint8_t *d_src, int src_w, int src_h, size_t src_pitch,
+                                 float *d_dst, int dst_w, int dst_h, cudaStream_t stream)
+{
+    float ratio = float(dst_w) / float(src_w) < float(dst_h) / float(src_h)
+                  ? float(dst_w) / float(src_w)
+                  : float(dst_h) / float(src_h);
+    // cv::resize rounds the destination size the same way
+    int rsz_w = std::min(dst_w, int(std::lrint(double(src_w) * ratio)));
+    int rsz_h = std::min(dst_h, int(std::lrint(double(src_h) * ratio)));
+
+    dim3 block(32, 8);
+    dim3 grid((dst_w + block.x - 1) / block.x, (dst_h + block.y - 1) / block.y);
+    letterboxKernel<<<grid, block, 0, stream>>>(d_src, src_w, src_h, src_pitch,
+                                                d_dst, dst_w, dst_h,
+                                                rsz_w, rsz_h, 1.f / ratio);
+    return cudaGetLastError();
+}
@@ -1,11 +1,49 @@
 #include "sort.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
 
 using namespace sort;
 
-Sort::Sort(int maxAge, int minHits, float iouThresh)
-    : maxAge(maxAge), minHits(minHits), iouThresh(iouThresh)
+namespace {
+
+int findRoot(vector<int> &parent, int x)
+{
+    while (parent[x] != x)
+        x = parent[x] = parent[parent[x]];  // path halving
+    return x;
+}
+
+inline void setBit(vector<uint64_t> &bits, int i)
+{
+    bits[i >> 6] |= uint64_t(1) << (i & 63);
+}
+
+inline bool testBit(const vector<uint64_t> &bits, int i)
+{
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+} // namespace
+
+
+AssignMethod sort::parseAssignMethod(const std::string &name)
+{
+    return name == "hungarian" ? AssignMethod::kHungarian : AssignMethod::kLapjv;
+}
+
+
+Sort::Sort(int maxAge, int minHits, float iouThresh, int capacity, AssignMethod assignMethod)
+    : maxAge(maxAge), minHits(minHits), iouThresh(iouThresh), assignMethod(assignMethod), pool(capacity)
 {
     km = std::make_shared<KuhnMunkres>();
+    lap = std::make_shared<LapJV>();
+    predSlots.reserve(capacity);
+    matchedMask.assign(capacity, 0);
+    lostPreds.reserve(capacity);
+    matchedDetPred.reserve(capacity);
+    subMatches.reserve(capacity);
+    deadIds.reserve(capacity);
 }
 
 
@@ -14,132 +52,296 @@ Sort::~Sort()
 }
 
 
-cv::Mat Sort::update(const cv::Mat &bboxesDet)
+int Sort::update(Span<const Detection> bboxesDet, Span<TrackedBox> bboxesPost)
 {
-    assert(bboxesDet.rows >= 0 && bboxesDet.cols == 6); // detections, [xc, yc, w, h, score, class_id]
+    const vector<int> &live = pool.liveSlots();
+    float bbox[4];
+    deadIds.clear();
 
-    cv::Mat bboxesPred(0, 6, CV_32F, cv::Scalar(0));  // predictions used in data association, [xc, yc, w, h, ...]
-    cv::Mat bboxesPost(0, 9, CV_32F, cv::Scalar(0));  // bounding boxes estimate, [xc, yc, w, h, score, class_id, vx, vy, tracker_id]
-
-    // kalman bbox tracker predict
-    for (auto it = trackers.begin(); it != trackers.end();)
+    predictTracks();
+    for (int slot : live)
     {
-        cv::Mat bboxPred = (*it)->predict();   // Mat(1, 4)
-        if (isAnyNan<float>(bboxPred))
-            trackers.erase(it);     // remove the NAN value and corresponding tracker
-        else{
-            cv::hconcat(bboxPred, cv::Mat(1, 2, CV_32F,cv::Scalar(0)), bboxPred);   // Mat(1, 6)
-            cv::vconcat(bboxesPred, bboxPred, bboxesPred);  // Mat(N, 6)
-            ++it;
-        }
+        pool.hitStreak[slot] = pool.timeSinceUpdate[slot] > 0 ? 0 : pool.hitStreak[slot];
+        pool.timeSinceUpdate[slot]++;
     }
+    predSlots.assign(live.begin(), live.end());
 
-    TypeAssociate asTuple = dataAssociate(bboxesDet, bboxesPred);
-    TypeMatchedPairs matchedDetPred = std::get<0>(asTuple);
-    TypeLostDets lostDets = std::get<1>(asTuple);
-    TypeLostPreds lostPreds = std::get<2>(asTuple);
+    dataAssociate(bboxesDet);
+    missedCount = 0;
+    for (int predInd : lostPreds)
+        missedCount += pool.hitStreak[predSlots[predInd]] >= minHits;
 
     // update matched trackers with assigned detections
-    for (auto pair : matchedDetPred)
+    int extent = pool.extent();
+    std::fill(matchedMask.begin(), matchedMask.begin() + extent, 0);
+    for (auto [detInd, predInd] : matchedDetPred)
+    {
+        int slot = predSlots[predInd];
+        const Detection &det = bboxesDet[detInd];
+        const float meas[4] = {det.xc, det.yc, det.w, det.h};
+        pool.filters.setMeasurement(slot, meas);
+        matchedMask[slot] = 1;
+    }
+    pool.filters.correctAll(matchedMask.data(), extent);
+
+    int count = 0;
+    for (auto [detInd, predInd] : matchedDetPred)
     {
-        int detInd = pair.first;
-        int predInd = pair.second;
-        cv::Mat bboxPost = trackers[predInd]->update(bboxesDet.rowRange(detInd, detInd + 1));
+        int slot = predSlots[predInd];
+        const Detection &det = bboxesDet[detInd];
+        pool.filters.getBox(slot, bbox);
+        pool.timeSinceUpdate[slot] = 0;
+        pool.hitStreak[slot] += 1;
+        pool.xc[slot] = bbox[0];
+        pool.yc[slot] = bbox[1];
+        pool.w[slot] = bbox[2];
+        pool.h[slot] = bbox[3];
+        pool.score[slot] = det.score;
+        pool.classId[slot] = det.classId;
 
-        if (trackers[predInd]->getHitStreak() >= minHits)
+        if (pool.hitStreak[slot] >= minHits && count < (int)bboxesPost.size())
         {
-            float score = bboxesDet.at<float>(detInd, 4);
-            int classId = bboxesDet.at<float>(detInd, 5);
-            float dx = trackers[predInd]->getState().at<float>(4, 0);
-            float dy = trackers[predInd]->getState().at<float>(5, 0);
-            int trackerId = trackers[predInd]->getFilterId();
-            cv::Mat tailData = (cv::Mat_<float>(1, 5) << score, classId, dx, dy, trackerId);
-            cv::hconcat(bboxPost, tailData, bboxPost);
-            cv::vconcat(bboxesPost, bboxPost, bboxesPost);  // Mat(N, 9)
+            TrackedBox &post = bboxesPost[count++];
+            post.xc = bbox[0];
+            post.yc = bbox[1];
+            post.w = bbox[2];
+            post.h = bbox[3];
+            post.score = det.score;
+            post.classId = det.classId;
+            pool.filters.getVelocity(slot, post.dx, post.dy);
+            post.trackerId = pool.id[slot];
         }
     }
 
     // remove dead trackers
-    trackers.erase(
-        std::remove_if(trackers.begin(), trackers.end(),
-            [&](const KalmanBoxTracker::Ptr& kbt)->bool {
-                return kbt->getTimeSinceUpdate() > maxAge;
-            }),
-        trackers.end()
-    );
+    for (size_t k = 0; k < live.size();)
+    {
+        if (pool.timeSinceUpdate[live[k]] > maxAge)
+        {
+            deadIds.push_back(pool.id[live[k]]);
+            pool.release(live[k]);
+        }
+        else
+            ++k;
+    }
 
     // create and initialize new trackers for unmatched detections
+    spawnedCount = 0;
     for (int lostInd : lostDets)
     {
-        cv::Mat lostBbox = bboxesDet.rowRange(lostInd, lostInd + 1);
-        trackers.push_back(make_shared<KalmanBoxTracker>(lostBbox));
+        const Detection &det = bboxesDet[lostInd];
+        const float meas[4] = {det.xc, det.yc, det.w, det.h};
+        int slot = pool.spawn(meas);
+        if (slot < 0)
+            break;  // pool full
+        pool.score[slot] = det.score;
+        pool.classId[slot] = det.classId;
+        ++spawnedCount;
     }
 
-    return bboxesPost;
+    return count;
+}
+
+
+int Sort::coast(Span<TrackedBox> bboxesPost)
+{
+    deadIds.clear();
+    predictTracks();
+
+    int count = 0;
+    for (int slot : pool.liveSlots())
+    {
+        if (pool.timeSinceUpdate[slot] > 0 || pool.hitStreak[slot] < minHits || count >= (int)bboxesPost.size())
+            continue;
+        TrackedBox &post = bboxesPost[count++];
+        post.xc = pool.xc[slot];
+        post.yc = pool.yc[slot];
+        post.w = pool.w[slot];
+        post.h = pool.h[slot];
+        post.score = pool.score[slot];
+        post.classId = pool.classId[slot];
+        pool.filters.getVelocity(slot, post.dx, post.dy);
+        post.trackerId = pool.id[slot];
+    }
+    return count;
 }
 
 
-TypeAssociate Sort::dataAssociate(const cv::Mat& bboxesDet, const cv::Mat& bboxesPred)
+TrackStats Sort::getStats() const
 {
-    TypeMatchedPairs matchedDetPred;
-    TypeLostDets lostDets;
-    TypeLostPreds lostPreds;
-
-    // initialize
-    for (int i = 0; i < bboxesDet.rows; ++i)
-        lostDets.push_back(i);  // size M
-    for (int j = 0; j < bboxesPred.rows; ++j)
-        lostPreds.push_back(j); // size N
-
-    // nothing detected or predicted
-    if (bboxesDet.rows == 0 || bboxesPred.rows == 0)
-        return make_tuple(matchedDetPred, lostDets, lostPreds);
-
-    // compute IoU matrix
-    cv::Mat iouMat = getIouMatrix(bboxesDet, bboxesPred);   // Mat(M, N)
-
-    // Kuhn Munkres assignment algorithm
-    Vec2f costMatrix(iouMat.rows, Vec1f(iouMat.cols, 0.0f));
-    for (int i = 0; i < iouMat.rows; ++i)
-        for (int j = 0; j < iouMat.cols; ++j)
-            costMatrix[i][j] = 1.0f - iouMat.at<float>(i, j);
-    auto indices = km->compute(costMatrix);
-
-    // find matched pairs and lost detect and predict
-    for (auto [detInd, predInd] : indices) {
-        matchedDetPred.push_back({detInd, predInd});
-        lostDets.erase(remove(lostDets.begin(), lostDets.end(), detInd), lostDets.end());
-        lostPreds.erase(remove(lostPreds.begin(), lostPreds.end(), predInd), lostPreds.end());
+    TrackStats stats = {0, 0, spawnedCount, missedCount, 0.f, 0.f};
+    for (int slot : pool.liveSlots())
+    {
+        if (pool.hitStreak[slot] < minHits)
+        {
+            stats.tentative++;
+            continue;
+        }
+        stats.confirmed++;
+        float width = std::max(pool.w[slot], 1.f);
+        float dx, dy;
+        pool.filters.getVelocity(slot, dx, dy);
+        stats.maxSigma = std::max(stats.maxSigma, pool.filters.getCentreSigma(slot) / width);
+        stats.maxFlow = std::max(stats.maxFlow, std::sqrt(dx * dx + dy * dy) / width);
     }
+    return stats;
+}
 
-    return make_tuple(matchedDetPred, lostDets, lostPreds);
+
+void Sort::predictTracks()
+{
+    const vector<int> &live = pool.liveSlots();
+    float bbox[4];
+
+    // kalman bbox tracker predict, all tracks in one pass
+    pool.filters.predictAll(pool.extent());
+    for (size_t k = 0; k < live.size();)
+    {
+        int slot = live[k];
+        pool.filters.getBox(slot, bbox);
+        if (std::isnan(bbox[0]) || std::isnan(bbox[1]) || std::isnan(bbox[2]) || std::isnan(bbox[3]))
+        {
+            deadIds.push_back(pool.id[slot]);
+            pool.release(slot);     // remove the NAN value and corresponding tracker, live[k] is refilled
+            continue;
+        }
+        pool.xc[slot] = bbox[0];
+        pool.yc[slot] = bbox[1];
+        pool.w[slot] = bbox[2];
+        pool.h[slot] = bbox[3];
+        ++k;
+    }
 }
 
 
-cv::Mat Sort::getIouMatrix(const cv::Mat& bboxesA, const cv::Mat& bboxesB)
+void Sort::dataAssociate(Span<const Detection> bboxesDet)
 {
-    assert(bboxesA.cols >= 4 && bboxesB.cols >= 4);
-    int numA = bboxesA.rows;
-    int numB = bboxesB.rows;
-    cv::Mat iouMat(numA, numB, CV_32F, cv::Scalar(0.0));
+    int numDet = (int)bboxesDet.size();
+    int numPred = (int)predSlots.size();
+
+    matchedDetPred.clear();
+    lostDets.clear();
+    lostPreds.clear();
 
-    cv::Rect re1, re2;
-    for (int i = 0; i < numA; ++i)
+    if (numDet > 0 && numPred > 0)
     {
-        for (int j = 0; j < numB; ++j)
+        // IoU matrix, Mat(M, N), and the gated bipartite graph
+        iouMatrix.resize(size_t(numDet) * numPred);
+        parent.resize(numDet + numPred);
+        for (int node = 0; node < numDet + numPred; ++node)
+            parent[node] = node;
+        for (int i = 0; i < numDet; ++i)
+        {
+            const Detection &det = bboxesDet[i];
+            for (int j = 0; j < numPred; ++j)
+            {
+                int slot = predSlots[j];
+                float iou = getIou(det.xc, det.yc, det.w, det.h,
+                                   pool.xc[slot], pool.yc[slot], pool.w[slot], pool.h[slot]);
+                iouMatrix[size_t(i) * numPred + j] = iou;
+                if (iou >= iouThresh)
+                    parent[findRoot(parent, i)] = findRoot(parent, numDet + j);
+            }
+        }
+
+        // bucket the nodes by component root
+        int numNodes = numDet + numPred;
+        compStart.assign(numNodes + 1, 0);
+        for (int node = 0; node < numNodes; ++node)
+            compStart[findRoot(parent, node) + 1]++;
+        for (int c = 0; c < numNodes; ++c)
+            compStart[c + 1] += compStart[c];
+        compNodes.resize(numNodes);
+        compFill.assign(compStart.begin(), compStart.end() - 1);
+        for (int node = 0; node < numNodes; ++node)
+            compNodes[compFill[findRoot(parent, node)]++] = node;
+
+        for (int c = 0; c < numNodes; ++c)
         {
-            re1.x = bboxesA.at<float>(i, 0) - bboxesA.at<float>(i, 2) / 2.0;
-            re1.y = bboxesA.at<float>(i, 1) - bboxesA.at<float>(i, 3) / 2.0;
-            re1.width = bboxesA.at<float>(i, 2);
-            re1.height = bboxesA.at<float>(i, 3);
-            re2.x = bboxesB.at<float>(j, 0) - bboxesB.at<float>(j, 2) / 2.0;
-            re2.y = bboxesB.at<float>(j, 1) - bboxesB.at<float>(j, 3) / 2.0;
-            re2.width = bboxesB.at<float>(j, 2);
-            re2.height = bboxesB.at<float>(j, 3);
-
-            iouMat.at<float>(i, j) = (re1 & re2).area() / ((re1 | re2).area() + FLT_EPSILON);
+            if (compStart[c + 1] - compStart[c] < 2)
+                continue;   // isolated detection or prediction
+            compRows.clear();
+            compCols.clear();
+            for (int k = compStart[c]; k < compStart[c + 1]; ++k)
+            {
+                int node = compNodes[k];
+                if (node < numDet)
+                    compRows.push_back(node);
+                else
+                    compCols.push_back(node - numDet);
+            }
+
+            if (compRows.size() == 1 || compCols.size() == 1)
+            {
+                // star component, every edge is gated in: keep the best one, no solver
+                int bestDet = compRows[0], bestPred = compCols[0];
+                float bestIou = -1.f;
+                for (int i : compRows)
+                    for (int j : compCols)
+                        if (iouMatrix[size_t(i) * numPred + j] > bestIou)
+                        {
+                            bestIou = iouMatrix[size_t(i) * numPred + j];
+                            bestDet = i;
+                            bestPred = j;
+                        }
+                matchedDetPred.push_back({bestDet, bestPred});
+            }
+            else
+            {
+                solveComponent(numPred);
+            }
         }
+        std::sort(matchedDetPred.begin(), matchedDetPred.end());
+    }
+
+    // find lost detect and predict
+    detMatched.assign((numDet + 63) / 64, 0);
+    predMatched.assign((numPred + 63) / 64, 0);
+    for (auto [detInd, predInd] : matchedDetPred)
+    {
+        setBit(detMatched, detInd);
+        setBit(predMatched, predInd);
     }
+    for (int i = 0; i < numDet; ++i)
+        if (!testBit(detMatched, i))
+            lostDets.push_back(i);
+    for (int j = 0; j < numPred; ++j)
+        if (!testBit(predMatched, j))
+            lostPreds.push_back(j);
+}
+
+
+void Sort::solveComponent(int numPred)
+{
+    int rows = (int)compRows.size();
+    int cols = (int)compCols.size();
+    // gated-out pairs cost more than any complete set of gated-in ones
+    const float gatedCost = float(std::min(rows, cols)) + 1.0f;
+    subCost.resize(size_t(rows) * cols);
+    for (int r = 0; r < rows; ++r)
+        for (int c = 0; c < cols; ++c)
+        {
+            float iou = iouMatrix[size_t(compRows[r]) * numPred + compCols[c]];
+            subCost[size_t(r) * cols + c] = iou >= iouThresh ? 1.0f - iou : gatedCost;
+        }
+
+    if (assignMethod == AssignMethod::kHungarian)
+        km->compute(subCost.data(), rows, cols, subMatches);
+    else
+        lap->compute(subCost.data(), rows, cols, subMatches);
+
+    for (auto [r, c] : subMatches)
+        if (iouMatrix[size_t(compRows[r]) * numPred + compCols[c]] >= iouThresh)
+            matchedDetPred.push_back({compRows[r], compCols[c]});
+}
+
 
-    return iouMat;
-}
\ No newline at end of file
+float Sort::getIou(float xcA, float ycA, float wA, float hA, float xcB, float ycB, float wB, float hB)
+{
+    float interW = std::min(xcA + wA / 2, xcB + wB / 2) - std::max(xcA - wA / 2, xcB - wB / 2);
+    float interH = std::min(ycA + hA / 2, ycB + hB / 2) - std::max(ycA - hA / 2, ycB - hB / 2);
+    if (interW <= 0 || interH <= 0)
+        return 0.0f;
+    float interArea = interW * interH;
+    return interArea / (wA * hA + wB * hB - interArea + FLT_EPSILON);
+}
@@ -0,0 +1,86 @@
+#include "track_events.h"
+
+TrackEventAggregator::TrackEventAggregator(int live_interval, int capacity)
+    : liveInterval_(live_interval < 0 ? 0 : live_interval)
+{
+    tracks_.reserve(capacity);
+    confirmed_.reserve(capacity);
+    events_.reserve(capacity);
+}
+
+void TrackEventAggregator::observe(const TrackObservation& obs, int frame)
+{
+    auto inserted = tracks_.try_emplace(obs.trackerId);
+    Stats& stats = inserted.first->second;
+    if (inserted.second) {
+        stats.firstFrame = frame;
+        stats.lastReport = frame;
+        stats.closestD = obs.d;
+        confirmed_.push_back(obs.trackerId);
+    }
+    stats.lastFrame = frame;
+    stats.hits++;
+    stats.latestD = obs.d;
+    stats.latestX = obs.x;
+    stats.latestSize = obs.sizeM2;
+    if (obs.d <= stats.closestD) {
+        stats.closestD = obs.d;
+        stats.closestX = obs.x;
+        stats.closestSize = obs.sizeM2;
+    }
+    if (obs.score > stats.maxScore)
+        stats.maxScore = obs.score;
+}
+
+Span<const StreamedTrack> TrackEventAggregator::finishFrame(int frame, Span<const int> deadIds)
+{
+    events_.clear();
+    for (int id : confirmed_)
+        emit(TrackEventType::kConfirmed, id, tracks_[id]);
+    confirmed_.clear();
+
+    if (liveInterval_ > 0) {
+        for (auto& [id, stats] : tracks_) {
+            if (stats.lastFrame == frame && frame - stats.lastReport >= liveInterval_) {
+                emit(TrackEventType::kLive, id, stats);
+                stats.lastReport = frame;
+            }
+        }
+    }
+
+    for (int id : deadIds) {
+        auto it = tracks_.find(id);
+        if (it == tracks_.end())
+            continue;   // never observed with a valid distance
+        emit(TrackEventType::kEnded, id, it->second);
+        tracks_.erase(it);
+    }
+    return events_;
+}
+
+Span<const StreamedTrack> TrackEventAggregator::flush()
+{
+    events_.clear();
+    for (const auto& [id, stats] : tracks_)
+        emit(TrackEventType::kEnded, id, stats);
+    tracks_.clear();
+    confirmed_.clear();
+    return events_;
+}
+
+void TrackEventAggregator::emit(TrackEventType type, int id, const Stats& stats)
+{
+    StreamedTrack event;
+    event.id = id;
+    event.event = type;
+    // confirmed and live events report where the pothole is now, the final one its best estimate
+    bool summary = type == TrackEventType::kEnded;
+    event.d = summary ? stats.closestD : stats.latestD;
+    event.x = summary ? stats.closestX : stats.latestX;
+    event.size = summary ? stats.closestSize : stats.latestSize;
+    event.score = stats.maxScore;
+    event.firstFrame = stats.firstFrame;
+    event.lastFrame = stats.lastFrame;
+    event.hits = stats.hits;
+    events_.push_back(event);
+}
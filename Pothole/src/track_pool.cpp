@@ -0,0 +1,58 @@
+#include "track_pool.h"
+#include <algorithm>
+
+using namespace sort;
+
+std::atomic<int> TrackPool::count{0};
+
+TrackPool::TrackPool(int capacity)
+    : id(capacity, -1), timeSinceUpdate(capacity, 0), hitStreak(capacity, 0),
+      xc(capacity, 0.f), yc(capacity, 0.f), w(capacity, 0.f), h(capacity, 0.f),
+      score(capacity, 0.f), classId(capacity, 0),
+      filters(capacity), livePos(capacity, -1)
+{
+    live.reserve(capacity);
+    freeSlots.reserve(capacity);
+    // pop_back hands out the lowest slots first
+    for (int slot = capacity - 1; slot >= 0; --slot)
+        freeSlots.push_back(slot);
+}
+
+
+int TrackPool::spawn(const float *bbox)
+{
+    if (freeSlots.empty())
+        return -1;
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    id[slot] = TrackPool::count++;
+    timeSinceUpdate[slot] = 0;
+    hitStreak[slot] = 0;
+    xc[slot] = bbox[0];
+    yc[slot] = bbox[1];
+    w[slot] = bbox[2];
+    h[slot] = bbox[3];
+    filters.init(slot, bbox);
+
+    livePos[slot] = (int)live.size();
+    live.push_back(slot);
+    highWater = std::max(highWater, slot + 1);
+    return slot;
+}
+
+
+void TrackPool::release(int slot)
+{
+    int pos = livePos[slot];
+    assert(pos >= 0);
+    int last = live.back();
+    live[pos] = last;
+    livePos[last] = pos;
+    live.pop_back();
+    livePos[slot] = -1;
+    id[slot] = -1;
+    freeSlots.push_back(slot);
+    while (highWater > 0 && livePos[highWater - 1] < 0)
+        --highWater;
+}
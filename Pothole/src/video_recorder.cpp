@@ -0,0 +1,199 @@
+#include "video_recorder.h"
+#include "async_logger.h"
+#include <algorithm>
+#include <opencv2/opencv_modules.hpp>
+
+// cudacodec::VideoWriter (NVENC) was reintroduced in OpenCV 4.7
+#if defined(HAVE_OPENCV_CUDACODEC) && (CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 7))
+#define TRACKER_HAVE_NVENC 1
+#include <opencv2/cudacodec.hpp>
+#include <opencv2/core/cuda_stream_accessor.hpp>
+#endif
+
+namespace {
+constexpr double kLabelScale = 0.5;
+constexpr int kBoxThickness = 2;
+constexpr int kContactDot = 7;      // side of the contact marker, pixels
+}
+
+struct VideoRecorder::NvencWriter {
+#ifdef TRACKER_HAVE_NVENC
+    cv::Ptr<cv::cudacodec::VideoWriter> writer;
+    cv::cuda::Stream stream;
+    cv::cuda::GpuMat staging;       // host frames uploaded once for drawing and encoding
+    std::vector<cv::Mat> strips;    // label rasters, alive until the stream has uploaded them
+#endif
+};
+
+VideoRecorder::VideoRecorder(const std::string &path, double fps, size_t queue_frames, int device)
+    : path(path), fps(fps > 0.0 ? fps : 30.0), cuda_device(device), queue(queue_frames, QueuePolicy::kDropOldest) {
+    worker = std::thread(&VideoRecorder::run, this);
+}
+
+VideoRecorder::~VideoRecorder() {
+    finish();
+    PLOG(AsyncLogger::Severity::kINFO) << "Recorder: " << written() << " frames written to " << path
+                                       << " (" << dropped() << " dropped)";
+}
+
+void VideoRecorder::submit(RecordFrame &&frame) {
+    queue.push(std::move(frame));
+}
+
+void VideoRecorder::finish() {
+    queue.close();
+    if (worker.joinable())
+        worker.join();
+}
+
+void VideoRecorder::run() {
+    // the writer, its stream and d_rects belong to this device, so they are created and freed here
+    cudaSetDevice(cuda_device);
+    RecordFrame frame;
+    while (queue.pop(frame)) {
+        cv::Size size = frame.device.empty() ? frame.host.size() : frame.device.size();
+        if (!opened && !failed)
+            failed = !open(size);
+        if (failed)
+            continue;
+        if (usesNvenc() && writeDevice(frame))
+            continue;
+        writeHost(frame);
+    }
+    frame = RecordFrame();
+#ifdef TRACKER_HAVE_NVENC
+    if (nvenc && nvenc->writer)
+        nvenc->writer->release();
+#endif
+    nvenc.reset();
+    writer.release();
+    if (d_rects)
+        cudaFree(d_rects);
+    d_rects = nullptr;
+}
+
+bool VideoRecorder::open(cv::Size size) {
+    opened = true;
+#ifdef TRACKER_HAVE_NVENC
+    try {
+        std::unique_ptr<NvencWriter> w(new NvencWriter);
+        w->writer = cv::cudacodec::createVideoWriter(path, size, cv::cudacodec::Codec::H264, fps,
+                                                     cv::cudacodec::ColorFormat::BGR, nullptr, w->stream);
+        nvenc = std::move(w);
+        PLOG(AsyncLogger::Severity::kINFO) << "Recorder: NVENC H.264 " << size.width << "x" << size.height << " -> " << path;
+        return true;
+    } catch (const cv::Exception &e) {
+        PLOG(AsyncLogger::Severity::kWARNING) << "Recorder: NVENC unavailable (" << e.what() << "), encoding on the CPU";
+    }
+#endif
+    if (!writer.open(path, cv::VideoWriter::fourcc('m', 'p', '4', 'v'), fps, size)) {
+        PLOG(AsyncLogger::Severity::kERROR) << "Recorder: cannot open " << path << ", recording disabled";
+        return false;
+    }
+    PLOG(AsyncLogger::Severity::kINFO) << "Recorder: VideoWriter " << size.width << "x" << size.height << " -> " << path;
+    return true;
+}
+
+bool VideoRecorder::writeDevice(RecordFrame &frame) {
+#ifdef TRACKER_HAVE_NVENC
+    cv::cuda::Stream &stream = nvenc->stream;
+    cv::cuda::GpuMat img = frame.device;
+    if (img.empty()) {
+        nvenc->staging.upload(frame.host, stream);
+        img = nvenc->staging;
+    }
+
+    if (!frame.annotated && !frame.boxes.empty()) {
+        rects.clear();
+        int max_w = kContactDot, max_h = kContactDot;
+        for (const OverlayBox &b : frame.boxes) {
+            rects.push_back({b.box.x, b.box.y, b.box.width, b.box.height,
+                             uint8_t(b.color[0]), uint8_t(b.color[1]), uint8_t(b.color[2]), kBoxThickness});
+            rects.push_back({b.contact.x - kContactDot / 2, b.contact.y - kContactDot / 2, kContactDot, kContactDot,
+                             0, 255, 0, 0});
+            max_w = std::max(max_w, b.box.width);
+            max_h = std::max(max_h, b.box.height);
+        }
+        if (rects.size() > d_rects_capacity) {
+            if (d_rects)
+                cudaFree(d_rects);
+            d_rects = nullptr;
+            d_rects_capacity = 0;
+            if (cudaMalloc(&d_rects, rects.size() * sizeof(OverlayRect)) != cudaSuccess) {
+                cudaGetLastError();
+                d_rects = nullptr;
+                return false;
+            }
+            d_rects_capacity = rects.size();
+        }
+        cudaStream_t s = cv::cuda::StreamAccessor::getStream(stream);
+        cudaMemcpyAsync(d_rects, rects.data(), rects.size() * sizeof(OverlayRect), cudaMemcpyHostToDevice, s);
+        if (drawOverlayRects(img.ptr<uint8_t>(), img.cols, img.rows, img.step, d_rects, (int)rects.size(),
+                             max_w, max_h, s) != cudaSuccess) {
+            cudaGetLastError();
+            return false;
+        }
+
+        // text has no device rasteriser, so each label is drawn into a small strip and uploaded into place
+        nvenc->strips.resize(frame.boxes.size());
+        for (size_t i = 0; i < frame.boxes.size(); i++) {
+            const OverlayBox &b = frame.boxes[i];
+            int baseline = 0;
+            cv::Rect r = labelRect(b, img.size(), baseline);
+            if (r.empty())
+                continue;
+            cv::Mat &strip = nvenc->strips[i];
+            strip.create(r.size(), CV_8UC3);
+            strip.setTo(b.color);
+            cv::putText(strip, b.label, cv::Point(2, r.height - baseline - 1),
+                        cv::FONT_HERSHEY_SIMPLEX, kLabelScale, cv::Scalar(255, 255, 255), 1);
+            cv::cuda::GpuMat roi = img(r);
+            roi.upload(strip, stream);
+        }
+    }
+
+    nvenc->writer->write(img);
+    stream.waitForCompletion();
+    written_count++;
+    return true;
+#else
+    (void)frame;
+    return false;
+#endif
+}
+
+void VideoRecorder::writeHost(RecordFrame &frame) {
+    if (!writer.isOpened())
+        return;
+    cv::Mat img = frame.host;
+    if (img.empty() && !frame.device.empty())
+        frame.device.download(img);
+    if (!frame.annotated)
+        drawHost(img, frame.boxes);
+    writer.write(img);
+    written_count++;
+}
+
+void VideoRecorder::drawHost(cv::Mat &img, const std::vector<OverlayBox> &boxes) {
+    for (const OverlayBox &b : boxes) {
+        cv::rectangle(img, b.box, b.color, kBoxThickness);
+        cv::circle(img, b.contact, 3, cv::Scalar(0, 255, 0), -1);
+        int baseline = 0;
+        cv::Rect r = labelRect(b, img.size(), baseline);
+        if (r.empty())
+            continue;
+        cv::rectangle(img, r, b.color, cv::FILLED);
+        cv::putText(img, b.label, cv::Point(r.x + 2, r.y + r.height - baseline - 1),
+                    cv::FONT_HERSHEY_SIMPLEX, kLabelScale, cv::Scalar(255, 255, 255), 1);
+    }
+}
+
+cv::Rect VideoRecorder::labelRect(const OverlayBox &box, cv::Size frame, int &baseline) {
+    // same placement as the window overlay: above the box, inside it when there is no room
+    cv::Size text = cv::getTextSize(box.label, cv::FONT_HERSHEY_SIMPLEX, kLabelScale, 1, &baseline);
+    int text_y = box.box.y - 5;
+    if (text_y < text.height)
+        text_y = box.box.y + text.height + 5;
+    cv::Rect r(box.box.x, text_y - text.height - 3, text.width + 4, text.height + baseline + 5);
+    return r & cv::Rect(cv::Point(0, 0), frame);
+}
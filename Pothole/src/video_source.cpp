@@ -0,0 +1,132 @@
+#include "video_source.h"
+#include "async_logger.h"
+#include <opencv2/opencv_modules.hpp>
+
+// VideoReaderInitParams (hardware resize) and ColorFormat::BGR output need OpenCV 4.7
+#if defined(HAVE_OPENCV_CUDACODEC) && (CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 7))
+#define TRACKER_HAVE_NVDEC 1
+#include <opencv2/cudacodec.hpp>
+#endif
+
+namespace {
+constexpr size_t kMaxPooledFrames = 32;     // frames held downstream at once stay far below this
+}
+
+struct VideoSource::NvdecReader {
+#ifdef TRACKER_HAVE_NVDEC
+    cv::Ptr<cv::cudacodec::VideoReader> reader;
+    cv::cuda::Stream stream;
+#endif
+};
+
+DecodeBackend parseDecodeBackend(const std::string &name) {
+    if (name == "nvdec")
+        return DecodeBackend::kNvdec;
+    if (name == "cpu")
+        return DecodeBackend::kCpu;
+    return DecodeBackend::kAuto;
+}
+
+VideoSource::VideoSource(const std::string &path, DecodeBackend backend, cv::Size decode_size, int first_frame)
+    : path(path), decode_size(decode_size) {
+    // V4L2 devices and GStreamer pipelines are VideoCapture-only
+    bool nvdecCapable = path.rfind("/dev/video", 0) != 0 && path.find('!') == std::string::npos;
+    if (backend != DecodeBackend::kCpu && nvdecCapable && openNvdec(first_frame))
+        return;
+    if (backend == DecodeBackend::kNvdec) {
+        PLOG(AsyncLogger::Severity::kWARNING) << "NVDEC: unavailable for " << path << ", falling back to VideoCapture";
+    }
+    openCapture(first_frame);
+}
+
+VideoSource::~VideoSource() {
+}
+
+bool VideoSource::isOpened() const {
+    return nvdec != nullptr || cap.isOpened();
+}
+
+bool VideoSource::openNvdec(int first_frame) {
+#ifdef TRACKER_HAVE_NVDEC
+    try {
+        std::unique_ptr<NvdecReader> r(new NvdecReader);
+        cv::cudacodec::VideoReaderInitParams params;
+        params.targetSz = decode_size;      // scaled by the decoder's post-processing, empty keeps the coded size
+#if CV_VERSION_MAJOR > 4 || CV_VERSION_MINOR >= 8
+        params.firstFrameIdx = first_frame > 0 ? first_frame : 0;
+#endif
+        r->reader = cv::cudacodec::createVideoReader(path, {}, params);
+        r->reader->set(cv::cudacodec::ColorFormat::BGR);
+#if CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR < 8
+        // no seek on open before 4.8: decode up to the frame and drop what came before
+        for (int i = 0; i < first_frame && r->reader->grab(r->stream); ++i) {
+        }
+#endif
+
+        cv::cudacodec::FormatInfo info = r->reader->format();
+        source_size = info.displayArea.empty() ? cv::Size(info.width, info.height) : info.displayArea.size();
+        frame_size = info.targetSz.empty() ? source_size : info.targetSz;
+        double value = 0.0;
+        frame_rate = r->reader->get(cv::CAP_PROP_FPS, value) ? value : 0.0;
+        frame_count = r->reader->get(cv::CAP_PROP_FRAME_COUNT, value) ? int(value) : 0;
+        nvdec = std::move(r);
+        return true;
+    } catch (const cv::Exception &e) {
+        PLOG(AsyncLogger::Severity::kERROR) << "NVDEC: cannot open " << path << ": " << e.what();
+    }
+#endif
+    return false;
+}
+
+bool VideoSource::openCapture(int first_frame) {
+    if (!cap.open(path))
+        return false;
+    cap.set(cv::CAP_PROP_BUFFERSIZE, 1);
+    if (first_frame > 0)
+        cap.set(cv::CAP_PROP_POS_FRAMES, first_frame);
+    source_size = cv::Size(int(cap.get(cv::CAP_PROP_FRAME_WIDTH)), int(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+    frame_size = source_size;   // decode_size is an NVDEC feature
+    frame_rate = cap.get(cv::CAP_PROP_FPS);
+    frame_count = int(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    return true;
+}
+
+bool VideoSource::read(VideoFrame &frame) {
+    // drop the caller's references first so its previous frame can be recycled
+    frame.host.release();
+    frame.device.release();
+#ifdef TRACKER_HAVE_NVDEC
+    if (nvdec) {
+        cv::cuda::GpuMat &out = acquireDeviceFrame();
+        if (!nvdec->reader->nextFrame(out, nvdec->stream))
+            return false;
+        // inference consumes the frame on its own non-blocking streams
+        nvdec->stream.waitForCompletion();
+        frame.device = out;
+        return true;
+    }
+#endif
+    return cap.read(frame.host);
+}
+
+bool VideoSource::rewind() {
+    if (nvdec) {
+        // the demuxer can't seek back reliably, reopening is cheap next to a loop of decoding
+        nvdec.reset();
+        return openNvdec(0);
+    }
+    return cap.set(cv::CAP_PROP_POS_FRAMES, 0);
+}
+
+cv::cuda::GpuMat &VideoSource::acquireDeviceFrame() {
+    // a pooled frame is free again once no packet downstream shares its buffer
+    for (cv::cuda::GpuMat &m : pool)
+        if (m.refcount == nullptr || *m.refcount == 1)
+            return m;
+    if (pool.size() >= kMaxPooledFrames) {
+        PLOG_EVERY(AsyncLogger::Severity::kWARNING, 1) << "NVDEC: every pooled frame is still in use, replacing the oldest";
+        pool.erase(pool.begin());
+    }
+    pool.emplace_back();
+    return pool.back();
+}
@@ -0,0 +1,275 @@
+#include "VisionPitch.hpp"
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <time.h>
+#include <opencv2/opencv_modules.hpp>
+#ifdef HAVE_OPENCV_CUDAWARPING
+#include <opencv2/cudawarping.hpp>
+#endif
+
+namespace {
+
+constexpr int kMaxCorners = 300;
+constexpr double kCornerQuality = 0.01;
+constexpr double kCornerSpacing = 8.0;      // pixels at the downscaled width
+constexpr float kMinFlow = 0.5f;            // pixels, below it a track carries no direction
+constexpr int kMinTracks = 30;              // moving tracks needed for an estimate
+constexpr int kRansacIterations = 200;
+constexpr float kMaxAngleSin = 0.07f;       // ~4 degrees between a flow vector and its FOE ray
+constexpr int kFullConfidenceInliers = 80;
+constexpr double kMaxPitch = 0.5;           // rad, anything steeper is a bad solve
+
+double threadCpuMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+// sine of the angle between the flow v at p and the ray from foe through p, -1 when v points inwards
+inline float rayAngleSin(const cv::Point2f &p, const cv::Point2f &v, const cv::Point2f &foe)
+{
+    cv::Point2f r = p - foe;
+    float norm = std::sqrt(r.dot(r) * v.dot(v));
+    if (norm <= 0.f)
+        return 1.f;
+    if (r.dot(v) <= 0.f)
+        return -1.f;
+    return std::abs(r.cross(v)) / norm;
+}
+
+} // namespace
+
+VisionPitch::VisionPitch(const CamIntrinsics &K, double rate_hz, int width)
+    : K(K), width(width > 0 ? width : 320),
+      period(int64_t(1e9 / (rate_hz > 0.0 ? rate_hz : 5.0))),
+      jobs(1, QueuePolicy::kDropOldest), rng(0x9e3779b9)
+{
+    worker = std::thread(&VisionPitch::run, this);
+}
+
+VisionPitch::~VisionPitch()
+{
+    jobs.close();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool VisionPitch::due(std::chrono::steady_clock::time_point t)
+{
+    if (t < next_due)
+        return false;
+    next_due = t + period;
+    return true;
+}
+
+bool VisionPitch::offer(const cv::Mat &bgr, std::chrono::steady_clock::time_point t)
+{
+    if (bgr.empty() || !due(t))
+        return false;
+    // the caller keeps drawing on its frame, so the worker always gets its own downscaled copy
+    cv::Mat small;
+    double s = double(width) / bgr.cols;
+    cv::resize(bgr, small, cv::Size(), s, s, cv::INTER_AREA);
+    submit(std::move(small), s, t);
+    return true;
+}
+
+bool VisionPitch::offer(const cv::cuda::GpuMat &bgr, std::chrono::steady_clock::time_point t)
+{
+    if (bgr.empty() || !due(t))
+        return false;
+    cv::Mat small;
+    double s = double(width) / bgr.cols;
+#ifdef HAVE_OPENCV_CUDAWARPING
+    cv::cuda::GpuMat d_small;
+    cv::cuda::resize(bgr, d_small, cv::Size(), s, s, cv::INTER_AREA);
+    d_small.download(small);
+#else
+    cv::Mat host;
+    bgr.download(host);
+    cv::resize(host, small, cv::Size(), s, s, cv::INTER_AREA);
+#endif
+    submit(std::move(small), s, t);
+    return true;
+}
+
+void VisionPitch::submit(cv::Mat &&small, double scale, std::chrono::steady_clock::time_point t)
+{
+    Job job;
+    job.scale = scale;
+    if (small.channels() == 3)
+        cv::cvtColor(small, job.gray, cv::COLOR_BGR2GRAY);
+    else
+        job.gray = std::move(small);
+    job.t = t;
+    jobs.push(std::move(job));
+}
+
+void VisionPitch::run()
+{
+    Job job;
+    while (jobs.pop(job)) {
+        double start = threadCpuMs();
+        VisionPitchOut out = estimateGray(job.gray, job.scale);
+        out.cpu_ms = threadCpuMs() - start;
+        Metrics::instance().record(Stage::kVisionPitch, int64_t(out.cpu_ms * 1e6));
+        publish(out);
+    }
+}
+
+void VisionPitch::publish(const VisionPitchOut &out)
+{
+    uint64_t v = version.load(std::memory_order_relaxed);
+    version.store(v + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    snap_theta.store(out.theta_vis_rad, std::memory_order_relaxed);
+    snap_conf.store(out.confidence, std::memory_order_relaxed);
+    snap_cpu.store(out.cpu_ms, std::memory_order_relaxed);
+    snap_id.store(out.id, std::memory_order_relaxed);
+    version.store(v + 2, std::memory_order_release);
+
+    estimates++;
+    if (out.confidence > 0.0)
+        confident++;
+    cpu_total.store(cpu_total.load(std::memory_order_relaxed) + out.cpu_ms, std::memory_order_relaxed);
+    cpu_max.store(std::max(cpu_max.load(std::memory_order_relaxed), out.cpu_ms), std::memory_order_relaxed);
+}
+
+VisionPitchOut VisionPitch::latest() const
+{
+    VisionPitchOut out;
+    uint64_t before, after;
+    do {
+        before = version.load(std::memory_order_acquire);
+        out.theta_vis_rad = snap_theta.load(std::memory_order_relaxed);
+        out.confidence = snap_conf.load(std::memory_order_relaxed);
+        out.cpu_ms = snap_cpu.load(std::memory_order_relaxed);
+        out.id = snap_id.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = version.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return out;
+}
+
+VisionPitchStats VisionPitch::stats() const
+{
+    VisionPitchStats s;
+    s.estimates = estimates.load();
+    s.confident = confident.load();
+    s.skipped = jobs.dropped();
+    s.mean_cpu_ms = s.estimates ? cpu_total.load() / s.estimates : 0.0;
+    s.max_cpu_ms = cpu_max.load();
+    return s;
+}
+
+VisionPitchOut VisionPitch::estimate(const cv::Mat &frame)
+{
+    double s = double(width) / frame.cols;
+    cv::Mat small, gray;
+    if (frame.cols != width)
+        cv::resize(frame, small, cv::Size(), s, s, cv::INTER_AREA);
+    else
+        small = frame;
+    if (small.channels() == 3)
+        cv::cvtColor(small, gray, cv::COLOR_BGR2GRAY);
+    else
+        gray = small.data == frame.data ? frame.clone() : small;    // kept as the next reference frame
+    return estimateGray(gray, s);
+}
+
+VisionPitchOut VisionPitch::estimateGray(const cv::Mat &gray, double scale)
+{
+    VisionPitchOut out;
+    out.id = ++seq;
+
+    if (prev_gray.empty() || prev_gray.size() != gray.size() || prev_pts.size() < size_t(kMinTracks)) {
+        prev_gray = gray;
+        cv::goodFeaturesToTrack(gray, prev_pts, kMaxCorners, kCornerQuality, kCornerSpacing);
+        return out;
+    }
+
+    cv::calcOpticalFlowPyrLK(prev_gray, gray, prev_pts, next_pts, status, err, cv::Size(21, 21), 3);
+
+    // static pixels (bonnet, dashboard, a stopped vehicle) carry no direction and are left out
+    flow_pts.clear();
+    flow_vec.clear();
+    for (size_t i = 0; i < prev_pts.size(); i++) {
+        if (!status[i])
+            continue;
+        cv::Point2f d = next_pts[i] - prev_pts[i];
+        if (d.dot(d) < kMinFlow * kMinFlow)
+            continue;
+        flow_pts.push_back(0.5f * (prev_pts[i] + next_pts[i]));
+        flow_vec.push_back(d);
+    }
+
+    // the next pair starts from fresh corners, which keeps every track a single short hop
+    prev_gray = gray;
+    cv::goodFeaturesToTrack(gray, prev_pts, kMaxCorners, kCornerQuality, kCornerSpacing);
+
+    cv::Point2f foe;
+    int inliers = 0;
+    if (int(flow_pts.size()) < kMinTracks || !solveFoe(flow_pts, flow_vec, foe, inliers))
+        return out;
+
+    // the FOE lies on the horizon, which is fy * tan(theta) above the principal point
+    double theta = std::atan2(K.cy * scale - foe.y, K.fy * scale);
+    if (std::abs(theta) > kMaxPitch)
+        return out;
+    out.theta_vis_rad = theta;
+    out.confidence = std::min(1.0, double(inliers) / kFullConfidenceInliers) * double(inliers) / flow_pts.size();
+    return out;
+}
+
+bool VisionPitch::solveFoe(const std::vector<cv::Point2f> &p, const std::vector<cv::Point2f> &v,
+                           cv::Point2f &foe, int &inliers)
+{
+    // every flow line {p + t v} passes through the FOE: n . foe = n . p with n = (v.y, -v.x) / |v|
+    const int n = int(p.size());
+    int best = 0;
+    cv::Point2f best_foe;
+    for (int it = 0; it < kRansacIterations; it++) {
+        int i = rng.uniform(0, n), j = rng.uniform(0, n);
+        if (i == j)
+            continue;
+        float det = v[i].x * v[j].y - v[i].y * v[j].x;
+        if (std::abs(det) < 1e-3f * std::sqrt(v[i].dot(v[i]) * v[j].dot(v[j])))
+            continue;   // near-parallel flow, the intersection is ill-conditioned
+        cv::Point2f d = p[j] - p[i];
+        float t = (d.x * v[j].y - d.y * v[j].x) / det;
+        cv::Point2f cand = p[i] + t * v[i];
+        int count = 0;
+        for (int k = 0; k < n; k++) {
+            float a = rayAngleSin(p[k], v[k], cand);
+            count += a >= 0.f && a < kMaxAngleSin;
+        }
+        if (count > best) {
+            best = count;
+            best_foe = cand;
+        }
+    }
+    if (best < kMinTracks)
+        return false;
+
+    // least-squares refit on the inliers, distances of the FOE from the flow lines
+    double a11 = 0, a12 = 0, a22 = 0, b1 = 0, b2 = 0;
+    for (int k = 0; k < n; k++) {
+        float a = rayAngleSin(p[k], v[k], best_foe);
+        if (a < 0.f || a >= kMaxAngleSin)
+            continue;
+        double len = std::sqrt(double(v[k].dot(v[k])));
+        double nx = v[k].y / len, ny = -v[k].x / len;
+        double c = nx * p[k].x + ny * p[k].y;
+        a11 += nx * nx; a12 += nx * ny; a22 += ny * ny;
+        b1 += nx * c; b2 += ny * c;
+    }
+    double det = a11 * a22 - a12 * a12;
+    if (std::abs(det) < 1e-9)
+        return false;
+    foe.x = float((a22 * b1 - a12 * b2) / det);
+    foe.y = float((a11 * b2 - a12 * b1) / det);
+    inliers = best;
+    return true;
+}
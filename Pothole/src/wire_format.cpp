@@ -0,0 +1,175 @@
+#include "wire_format.h"
+#include "async_logger.h"
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+void putVarint(std::string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out += char((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += char(v);
+}
+
+void putSvarint(std::string& out, int64_t v)
+{
+    putVarint(out, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+}
+
+void putLe(std::string& out, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        out += char((v >> (8 * i)) & 0xff);
+}
+
+void patchLe(std::string& out, size_t at, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+        out[at + i] = char((v >> (8 * i)) & 0xff);
+}
+
+int64_t fixed(double v, double scale)
+{
+    return std::llround(v * scale);
+}
+
+constexpr double kMetres = 100.0;       // 0.01 m, as printed in the JSON
+constexpr double kSquareMetres = 1e4;   // 0.0001 m^2
+constexpr double kDegrees = 100.0;      // 0.01 deg
+constexpr double kScore = 1000.0;       // 0.001
+
+const char* eventName(TrackEventType event)
+{
+    switch (event) {
+    case TrackEventType::kConfirmed: return "confirmed";
+    case TrackEventType::kLive: return "live";
+    case TrackEventType::kEnded: return "ended";
+    default: return "frame";
+    }
+}
+
+} // namespace
+
+WireFormat parseWireFormat(const std::string& name)
+{
+    if (name == "binary")
+        return WireFormat::kBinary;
+    if (name != "json") {
+        PLOG(AsyncLogger::Severity::kWARNING) << "Unknown wire format '" << name << "', using json";
+    }
+    return WireFormat::kJson;
+}
+
+const char* wireContentType(WireFormat format)
+{
+    return format == WireFormat::kBinary ? "application/x-pothole-batch" : "application/json";
+}
+
+BatchEncoder::BatchEncoder(WireFormat format) : format_(format)
+{
+}
+
+void BatchEncoder::begin(std::string& body)
+{
+    body.clear();
+    frames_ = 0;
+    if (format_ == WireFormat::kJson) {
+        body += '[';
+        return;
+    }
+    body += 'P';
+    body += 'H';
+    body += char(kVersion);
+    putLe(body, 0, 2);  // frame count, patched by finish()
+    putLe(body, 0, 4);  // payload bytes, patched by finish()
+}
+
+void BatchEncoder::append(std::string& body, const StreamedFrame& frame)
+{
+    if (format_ == WireFormat::kJson)
+        appendJson(body, frame);
+    else
+        appendBinary(body, frame);
+    previous_ = frame;
+    ++frames_;
+}
+
+void BatchEncoder::finish(std::string& body)
+{
+    if (format_ == WireFormat::kJson) {
+        body += ']';
+        return;
+    }
+    patchLe(body, 3, uint64_t(frames_), 2);
+    patchLe(body, 5, uint64_t(body.size() - kHeaderBytes), 4);
+}
+
+void BatchEncoder::appendJson(std::string& body, const StreamedFrame& frame)
+{
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%s{\"frame\": %d, \"theta_deg\": %.2f, \"detections\": [",
+             frames_ ? ", " : "", frame.frame, frame.thetaDeg);
+    body += buf;
+    for (int i = 0; i < frame.count; ++i) {
+        const StreamedTrack& t = frame.tracks[i];
+        snprintf(buf, sizeof(buf), "{\"id\": %d, \"d\": %.2f, \"x\": %.2f, \"size\": %.4f",
+                 t.id, t.d, t.x, t.size);
+        body += buf;
+        if (t.event != TrackEventType::kFrame) {
+            snprintf(buf, sizeof(buf),
+                     ", \"event\": \"%s\", \"score\": %.3f, \"first_frame\": %d, \"last_frame\": %d, \"hits\": %d",
+                     eventName(t.event), t.score, t.firstFrame, t.lastFrame, t.hits);
+            body += buf;
+        }
+        body += i + 1 < frame.count ? "}, " : "}";
+    }
+    snprintf(buf, sizeof(buf), "], \"timestamp_ms\": %lld}", frame.timestampMs);
+    body += buf;
+}
+
+void BatchEncoder::appendBinary(std::string& body, const StreamedFrame& frame)
+{
+    bool first = frames_ == 0;
+    scratch_.clear();
+    putSvarint(scratch_, first ? frame.frame : int64_t(frame.frame) - previous_.frame);
+    putSvarint(scratch_, first ? frame.timestampMs : frame.timestampMs - previous_.timestampMs);
+    putSvarint(scratch_, fixed(frame.thetaDeg, kDegrees));
+    putVarint(scratch_, uint64_t(frame.count));
+
+    for (int i = 0; i < frame.count; ++i) {
+        const StreamedTrack& t = frame.tracks[i];
+        const StreamedTrack* ref = nullptr;
+        for (int j = 0; !first && j < previous_.count; ++j) {
+            if (previous_.tracks[j].id == t.id) {
+                ref = &previous_.tracks[j];
+                break;
+            }
+        }
+
+        int64_t d = fixed(t.d, kMetres), x = fixed(t.x, kMetres), size = fixed(t.size, kSquareMetres);
+        putVarint(scratch_, (uint64_t(uint32_t(t.id)) << 1) | (ref ? 1u : 0u));
+        if (ref) {
+            // against the quantized reference so rounding errors do not accumulate
+            d -= fixed(ref->d, kMetres);
+            x -= fixed(ref->x, kMetres);
+            size -= fixed(ref->size, kSquareMetres);
+        }
+        putSvarint(scratch_, d);
+        putSvarint(scratch_, x);
+        putSvarint(scratch_, size);
+
+        scratch_ += char(t.event);
+        if (t.event != TrackEventType::kFrame) {
+            putVarint(scratch_, uint64_t(fixed(t.score < 0.f ? 0.f : t.score, kScore)));
+            putSvarint(scratch_, int64_t(frame.frame) - t.firstFrame);
+            putSvarint(scratch_, int64_t(frame.frame) - t.lastFrame);
+            putVarint(scratch_, uint64_t(t.hits < 0 ? 0 : t.hits));
+        }
+    }
+
+    putVarint(body, scratch_.size());
+    body += scratch_;
+}
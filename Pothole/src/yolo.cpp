@@ -10,15 +10,46 @@
 
 #include "yolo.h"
 #include "common.h" 
+#include "preprocess.h"
+#include "postprocess.h"
+#include "host_decode.h"
+#include "metrics.h"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <functional>
+
+namespace {
+
+// the given regions clipped to their frames, the full frame where none (or an empty one) is given;
+// out is reused, it only grows
+template<typename Image>
+void frameRegions(Span<const Image> images, Span<const cv::Rect> regions, std::vector<cv::Rect> &out) {
+    out.resize(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        cv::Rect full(0, 0, images[i].cols, images[i].rows);
+        cv::Rect r = i < regions.size() ? regions[i] & full : cv::Rect();
+        out[i] = r.empty() ? full : r;
+    }
+}
+
+// views of the regions, no copy; the preprocess paths all honour the row pitch
+template<typename Image>
+void cropImages(Span<const Image> images, Span<const cv::Rect> regions, std::vector<Image> &out) {
+    out.resize(images.size());
+    for (size_t i = 0; i < images.size(); i++)
+        out[i] = images[i].empty() ? images[i] : images[i](regions[i]);
+}
+
+} // namespace
 
 YOLO::YOLO(const YAML::Node &config) {
-    std::cout << "YOLO Constructor: Starting..." << std::endl;
+    PLOG(Severity::kVERBOSE) << "YOLO Constructor: Starting...";
     
     onnx_file = config["onnx_file"].as<std::string>();
     engine_file = config["engine_file"].as<std::string>();
     
-    std::cout << "YOLO Constructor: Engine file = " << engine_file << std::endl;
+    PLOG(Severity::kINFO) << "YOLO Constructor: Engine file = " << engine_file;
     
     // Use CLASS_NAMES from common.h instead of reading file
     if (config["labels_file"]) {
@@ -36,7 +67,7 @@ YOLO::YOLO(const YAML::Node &config) {
         }
     }
     
-    std::cout << "YOLO Constructor: Loaded " << class_labels.size() << " class labels" << std::endl;
+    PLOG(Severity::kINFO) << "YOLO Constructor: Loaded " << class_labels.size() << " class labels";
     
     BATCH_SIZE = config["BATCH_SIZE"].as<int>();
     INPUT_CHANNEL = config["INPUT_CHANNEL"].as<int>();
@@ -46,10 +77,79 @@ YOLO::YOLO(const YAML::Node &config) {
     nms_threshold = config["nms_threshold"].as<float>();
     agnostic = config["agnostic"].as<bool>();
     strides = config["strides"].as<std::vector<int>>();
+    if (config["gpu_preprocess"]) {
+        gpu_preprocess = config["gpu_preprocess"].as<bool>();
+    }
+    if (config["num_contexts"]) {
+        NUM_CONTEXTS = config["num_contexts"].as<int>();
+    }
+    if (config["device"]) {
+        device = config["device"].as<int>();
+    }
+    if (config["gpu_postprocess"]) {
+        gpu_postprocess = config["gpu_postprocess"].as<bool>();
+    }
+    if (config["dynamic_min_height"]) {
+        MIN_INPUT_HEIGHT = config["dynamic_min_height"].as<int>();
+    }
+    if (config["dynamic_opt_height"]) {
+        OPT_INPUT_HEIGHT = config["dynamic_opt_height"].as<int>();
+    }
+    if (config["min_batch"]) {
+        MIN_BATCH_SIZE = config["min_batch"].as<int>();
+    }
+    if (config["opt_batch"]) {
+        OPT_BATCH_SIZE = config["opt_batch"].as<int>();
+    }
+    if (config["max_batch"]) {
+        MAX_BATCH_SIZE = config["max_batch"].as<int>();
+    }
+    if (config["onnx_hash"]) {
+        onnx_hash = config["onnx_hash"].as<uint64_t>();
+    }
+    if (config["engine_cache"]) {
+        engine_cache_dir = config["engine_cache"].as<std::string>();
+    }
+    if (config["overwrite_engine"]) {
+        overwrite_engine = config["overwrite_engine"].as<bool>();
+    }
+    if (config["timing_cache"]) {
+        timing_cache_file = config["timing_cache"].as<std::string>();
+    }
+    if (config["workspace_mb"]) {
+        build_workspace = size_t(config["workspace_mb"].as<int>()) << 20;
+    }
+    if (config["int8"]) {
+        build_int8 = config["int8"].as<bool>();
+    }
+    if (config["calibration_source"]) {
+        calibration_source = config["calibration_source"].as<std::string>();
+    }
+    if (config["calibration_cache"]) {
+        calibration_cache_file = config["calibration_cache"].as<std::string>();
+    }
+    if (config["gpu_max_detections"]) {
+        gpu_max_detections = config["gpu_max_detections"].as<int>();
+    }
+    if (config["cuda_graph"]) {
+        use_cuda_graph = config["cuda_graph"].as<bool>();
+        if (use_cuda_graph && NUM_CONTEXTS <= 0) {
+            PLOG(Severity::kWARNING) << "YOLO Constructor: cuda_graph needs num_contexts > 0, ignored";
+        }
+    }
+    NmsConfig nms_config;
+    nms_config.threshold = nms_threshold;
+    nms_config.agnostic = agnostic;
+    if (config["nms_top_k"]) {
+        nms_config.topK = config["nms_top_k"].as<int>();
+    }
+    if (config["nms_method"]) {
+        nms_config.method = parseNmsMethod(config["nms_method"].as<std::string>());
+    }
+    nms_engine = NmsEngine(nms_config);
     
-    std::cout << "YOLO Constructor: Config loaded" << std::endl;
-    std::cout << "  BATCH_SIZE=" << BATCH_SIZE << std::endl;
-    std::cout << "  IMAGE_WIDTH=" << IMAGE_WIDTH << " IMAGE_HEIGHT=" << IMAGE_HEIGHT << std::endl;
+    PLOG(Severity::kINFO) << "YOLO Constructor: Config loaded, BATCH_SIZE=" << BATCH_SIZE << " IMAGE_WIDTH=" << IMAGE_WIDTH
+                          << " IMAGE_HEIGHT=" << IMAGE_HEIGHT << " preprocess=" << (gpu_preprocess ? "GPU" : "CPU");
     
     // Handle anchors
     if (config["anchors"]) {
@@ -65,7 +165,7 @@ YOLO::YOLO(const YAML::Node &config) {
     
     CATEGORY = class_labels.size();
     
-    std::cout << "YOLO Constructor: CATEGORY=" << CATEGORY << std::endl;
+    PLOG(Severity::kINFO) << "YOLO Constructor: CATEGORY=" << CATEGORY;
     
     grids = {
             {3, int(IMAGE_WIDTH / strides[0]), int(IMAGE_HEIGHT / strides[0])},
@@ -83,7 +183,7 @@ YOLO::YOLO(const YAML::Node &config) {
         index+=1;
     }
     
-    std::cout << "YOLO Constructor: num_rows=" << num_rows << std::endl;
+    PLOG(Severity::kVERBOSE) << "YOLO Constructor: num_rows=" << num_rows;
 
     // Use COLORS from common.h
     class_colors.resize(CATEGORY);
@@ -95,71 +195,578 @@ YOLO::YOLO(const YAML::Node &config) {
         }
     }
     
-    std::cout << "YOLO Constructor: About to call LoadEngine()..." << std::endl;
+    PLOG(Severity::kVERBOSE) << "YOLO Constructor: About to call LoadEngine()...";
     
     // This is where it should call Model::LoadEngine()
     LoadEngine();
     
-    std::cout << "YOLO Constructor: LoadEngine() completed!" << std::endl;
+    // anchors per image, read from the engine's output shape: [BATCH, CATEGORY + 4, num_boxes],
+    // the largest input height for a dynamic engine
+    nvinfer1::Dims out_dims = context->getTensorShape(engine->getIOTensorName(1));
+    num_boxes = out_dims.nbDims > 0 ? int(out_dims.d[out_dims.nbDims - 1]) : 0;
+    if (out_dims.nbDims < 2 || out_dims.d[out_dims.nbDims - 2] != CATEGORY + 4) {
+        PLOG(Severity::kWARNING) << "YOLO Constructor: WARNING output shape does not match " << CATEGORY << " classes";
+    }
+    decode_buffer.resize(num_boxes);
+
+    if (gpu_postprocess) {
+        bool ok = allocGpuDetections(sync_detections, BATCH_SIZE, gpu_max_detections);
+        for (InferSlot &slot : slots)
+            ok = ok && allocGpuDetections(slot.detections, BATCH_SIZE, gpu_max_detections);
+        if (!ok) {
+            PLOG(Severity::kWARNING) << "YOLO Constructor: cannot allocate GPU postprocess buffers, using CPU path";
+            gpu_postprocess = false;
+        }
+    }
+    PLOG(Severity::kINFO) << "YOLO Constructor: postprocess=" << (gpu_postprocess ? "GPU" : "CPU") << " num_boxes=" << num_boxes;
+    if (dynamic_input) {
+        PLOG(Severity::kINFO) << "YOLO Constructor: input=" << IMAGE_WIDTH << "x[" << MIN_INPUT_HEIGHT << ".."
+                              << IMAGE_HEIGHT << "], height follows the region aspect";
+    }
+
+    PLOG(Severity::kVERBOSE) << "YOLO Constructor: LoadEngine() completed!";
 }
 
-YOLO::~YOLO() = default;
+YOLO::~YOLO() {
+    BindDevice();
+    if (raw_buffer)
+        cudaFree(raw_buffer);
+    if (host_raw)
+        cudaFreeHost(host_raw);
+    freeGpuDetections(sync_detections);
+}
 
 std::vector<std::vector<DetectRes>> YOLO::InferenceImages(std::vector<cv::Mat> &vec_img) {
-    auto t_start_pre = std::chrono::high_resolution_clock::now();
-    std::vector<float> image_data = prepareImage(vec_img);
-    auto t_end_pre = std::chrono::high_resolution_clock::now();
-    float total_pre = std::chrono::duration<float, std::milli>(t_end_pre - t_start_pre).count();
-    std::cout << "YOLO prepare image take: " << total_pre << " ms." << std::endl;
-    auto t_start = std::chrono::high_resolution_clock::now();
-    auto *output = ModelInference(image_data);
-    auto t_end = std::chrono::high_resolution_clock::now();
-    float total_inf = std::chrono::duration<float, std::milli>(t_end - t_start).count();
-    std::cout << "YOLO inference take: " << total_inf << " ms." << std::endl;
-    auto r_start = std::chrono::high_resolution_clock::now();
-    auto boxes = postProcess(vec_img, output);
-    auto r_end = std::chrono::high_resolution_clock::now();
-    float total_res = std::chrono::duration<float, std::milli>(r_end - r_start).count();
-    std::cout << "YOLO postprocess take: " << total_res << " ms." << std::endl;
-    delete output;
-    return boxes;
+    Infer(vec_img, results);
+    return results.toVectors();
+}
+
+void YOLO::Infer(Span<const cv::Mat> images, DetectionBatch &out, Span<const cv::Rect> regions,
+                 Span<const float> image_data) {
+    BindDevice();
+    images = images.first(BATCH_SIZE);
+    frameRegions(images, regions, infer_regions);
+    cropImages(images, Span<const cv::Rect>(infer_regions), infer_crops);
+    int input_h = inputHeightFor(infer_regions);
+    const float *input = image_data.empty() ? nullptr : image_data.data();
+    size_t input_bytes = image_data.size() * sizeof(float);
+    if (image_data.empty()) {
+        ScopedTimer timer(Stage::kPreprocess);
+        if (!gpu_preprocess || !stageFrames(infer_crops, host_raw, host_raw_size, staged_frames)
+            || !prepareImageGpu(staged_frames, static_cast<float *>(buffers[0]), raw_buffer, raw_buffer_size,
+                                stream, input_h)) {
+            prepareImage(infer_crops, hostInput, input_h);
+            input = hostInput;
+            input_bytes = inputBytes(input_h);
+        }
+    }
+    infer_crops.clear();
+    staged_frames.clear();
+    inferRegions(input, input_bytes, input_h, out);
+}
+
+void YOLO::Infer(Span<const cv::cuda::GpuMat> frames, DetectionBatch &out, Span<const cv::Rect> regions) {
+    BindDevice();
+    frames = frames.first(BATCH_SIZE);
+    if (gpu_preprocess) {
+        frameRegions(frames, regions, infer_regions);
+        cropImages(frames, Span<const cv::Rect>(infer_regions), device_crops);
+        int input_h = inputHeightFor(infer_regions);
+        bool ok;
+        {
+            ScopedTimer timer(Stage::kPreprocess);
+            ok = prepareImageDevice(device_crops, static_cast<float *>(buffers[0]), stream, input_h);
+        }
+        device_crops.clear();
+        if (ok) {
+            inferRegions(nullptr, 0, input_h, out);
+            return;
+        }
+    }
+    downloadFrames(frames, host_frames);
+    Infer(host_frames, out, regions);
+}
+
+void YOLO::inferRegions(const float *input, size_t input_bytes, int input_h, DetectionBatch &out) {
+    sync_input_height = input_h;
+    sync_num_boxes = bindInputHeight(context, input_h);
+    {
+        // synchronous: the host wall time covers the copies and the engine
+        ScopedTimer timer(Stage::kGpuInfer);
+        inferSync(input, input_bytes, hostOutput);
+    }
+    ScopedTimer timer(Stage::kCollect);
+    out.clear();
+    if (gpu_postprocess)
+        collectGpuDetections(infer_regions, sync_detections, input_h, sync_num_boxes, buffers[1], hostOutput, stream, out);
+    else
+        postProcess(infer_regions, hostOutput, input_h, sync_num_boxes, out);
+}
+
+void YOLO::PrepareImages(Span<const cv::Mat> images, std::vector<float> &image_data, Span<const cv::Rect> regions) {
+    // the device path writes into buffers[0], so it has to run next to the inference itself
+    image_data.clear();
+    if (gpu_preprocess)
+        return;
+    ScopedTimer timer(Stage::kPreprocess);
+    images = images.first(BATCH_SIZE);
+    frameRegions(images, regions, prepare_regions);
+    cropImages(images, Span<const cv::Rect>(prepare_regions), prepare_crops);
+    int input_h = inputHeightFor(prepare_regions);
+    image_data.resize(size_t(BATCH_SIZE) * IMAGE_WIDTH * input_h * INPUT_CHANNEL);
+    prepareImage(prepare_crops, image_data.data(), input_h);
+    prepare_crops.clear();
+}
+
+std::vector<float> YOLO::PrepareImages(std::vector<cv::Mat> &vec_img, const std::vector<cv::Rect> &regions) {
+    std::vector<float> image_data;
+    PrepareImages(vec_img, image_data, regions);
+    return image_data;
+}
+
+std::vector<std::vector<DetectRes>> YOLO::InferencePrepared(std::vector<cv::Mat> &vec_img, std::vector<float> &image_data,
+                                                            const std::vector<cv::Rect> &regions) {
+    Infer(vec_img, results, regions, image_data);
+    return results.toVectors();
+}
+
+std::chrono::steady_clock::duration YOLO::Warmup(const cv::Size &frame_size, bool device_frames, int runs) {
+    auto start = std::chrono::steady_clock::now();
+    BindDevice();
+    if (runs <= 0 || frame_size.area() <= 0)
+        return {};
+    std::vector<cv::Mat> frames = {cv::Mat::zeros(frame_size, CV_8UC3)};
+    std::vector<cv::cuda::GpuMat> gpu_frames;
+    if (device_frames)
+        gpu_frames.emplace_back(frame_size, CV_8UC3, cv::Scalar::all(0));
+    // slots are handed out round-robin, so one submit/collect pair at a time visits every context
+    std::vector<float> image_data;
+    DetectionBatch out;
+    int total = runs * std::max(1, NUM_CONTEXTS);
+    for (int i = 0; i < total; ++i) {
+        if (NUM_CONTEXTS > 0) {
+            if (!device_frames)
+                PrepareImages(frames, image_data);
+            uint64_t ticket = device_frames ? Submit(gpu_frames) : Submit(frames, image_data);
+            Collect(ticket, out);
+        } else if (device_frames) {
+            Infer(gpu_frames, out);
+        } else {
+            Infer(frames, out);
+        }
+    }
+    cudaDeviceSynchronize();
+    return std::chrono::steady_clock::now() - start;
+}
+
+uint64_t YOLO::Submit(Span<const cv::Mat> images, Span<const float> image_data, Span<const cv::Rect> regions) {
+    BindDevice();
+    ScopedTimer timer(Stage::kEnqueue);
+    InferSlot *slot = acquireInferSlot();
+    if (slot == nullptr)
+        return 0;
+    images = images.first(BATCH_SIZE);
+    frameRegions(images, regions, slot->imageRegions);
+    cropImages(images, Span<const cv::Rect>(slot->imageRegions), infer_crops);
+    const std::vector<cv::Mat> &crops = infer_crops;
+    slot->inputHeight = inputHeightFor(slot->imageRegions);
+    slot->numBoxes = bindInputHeight(slot->context, slot->inputHeight);
+
+    bool device_preprocess = image_data.empty() && gpu_preprocess;
+    bool graph_mode = use_cuda_graph && slot->graphUsable;
+    if (!image_data.empty())
+        std::copy(image_data.begin(), image_data.begin() + std::min(image_data.size(), inputBytes(slot->inputHeight) / sizeof(float)),
+                  slot->hostInput);
+    else if (device_preprocess) {
+        // async uploads need pinned sources, and graphs replay copies from fixed addresses;
+        // the CPU path takes over when the staging buffer cannot be allocated
+        size_t staged_size = slot->hostRawSize;
+        device_preprocess = stageFrames(crops, slot->hostRaw, slot->hostRawSize, staged_frames);
+        if (slot->hostRawSize != staged_size && slot->graph) {
+            // the captured graph points at the old staging buffer
+            cudaGraphExecDestroy(slot->graph);
+            slot->graph = nullptr;
+        }
+    }
+    if (image_data.empty() && !device_preprocess)
+        prepareImage(crops, slot->hostInput, slot->inputHeight);
+    const std::vector<cv::Mat> &frames = staged_frames;
+
+    // preprocess (or H2D of the host tensor) + enqueue + D2H, on the slot's stream
+    auto enqueue = [&](bool device) -> bool {
+        // stage events only on direct launches, a replayed graph is timed as a whole
+        cudaStreamCaptureStatus capture = cudaStreamCaptureStatusNone;
+        cudaStreamIsCapturing(slot->stream, &capture);
+        slot->stageEvents = capture == cudaStreamCaptureStatusNone;
+        if (device) {
+            if (!prepareImageGpu(frames, static_cast<float *>(slot->buffers[0]),
+                                 slot->rawInput, slot->rawInputSize, slot->stream, slot->inputHeight))
+                return false;
+        } else {
+            cudaMemcpyAsync(slot->buffers[0], slot->hostInput, inputBytes(slot->inputHeight),
+                            cudaMemcpyHostToDevice, slot->stream);
+        }
+        if (slot->stageEvents)
+            cudaEventRecord(slot->inputReady, slot->stream);
+        if (!slot->context->enqueueV3(slot->stream)) {
+            PLOG_EVERY(Severity::kERROR, 1) << "ERROR: Inference failed!";
+            return false;
+        }
+        if (slot->stageEvents)
+            cudaEventRecord(slot->inferred, slot->stream);
+        if (gpu_postprocess)
+            decodeYoloOutput(static_cast<const float *>(slot->buffers[1]), slot->numBoxes, CATEGORY,
+                             obj_threshold, nms_threshold, agnostic, slot->detections, slot->stream);
+        else
+            cudaMemcpyAsync(slot->hostOutput, slot->buffers[1], outputBytes(slot->numBoxes),
+                            cudaMemcpyDeviceToHost, slot->stream);
+        return true;
+    };
+
+    std::vector<cv::Size> &shapes = frame_shapes;
+    shapes.clear();
+    if (device_preprocess)
+        for (const cv::Mat &img : frames)
+            shapes.push_back(img.size());
+    cudaEventRecord(slot->started, slot->stream);
+    slot->stageEvents = false;
+    bool launched = graph_mode && slot->graph != nullptr
+                    && slot->graphDevicePreprocess == device_preprocess && slot->graphShapes == shapes
+                    && slot->graphInputHeight == slot->inputHeight
+                    && cudaGraphLaunch(slot->graph, slot->stream) == cudaSuccess;
+    if (!launched) {
+        if (device_preprocess && !enqueue(true)) {
+            prepareImage(crops, slot->hostInput, slot->inputHeight);
+            device_preprocess = false;
+            shapes.clear();
+            enqueue(false);
+        } else if (!device_preprocess) {
+            enqueue(false);
+        }
+        // the eager run above doubles as the warm-up TensorRT needs before capture
+        if (graph_mode) {
+            bool timed = slot->stageEvents;
+            captureGraph(*slot, device_preprocess, shapes, enqueue);
+            slot->stageEvents = timed;
+        }
+    }
+    cudaEventRecord(slot->done, slot->stream);
+    infer_crops.clear();
+    staged_frames.clear();
+    return slot->ticket;
+}
+
+uint64_t YOLO::Submit(Span<const cv::cuda::GpuMat> frames, Span<const cv::Rect> regions) {
+    BindDevice();
+    frames = frames.first(BATCH_SIZE);
+    if (!gpu_preprocess) {
+        downloadFrames(frames, host_frames);
+        return Submit(host_frames, {}, regions);
+    }
+    ScopedTimer timer(Stage::kEnqueue);
+    InferSlot *slot = acquireInferSlot();
+    if (slot == nullptr)
+        return 0;
+    frameRegions(frames, regions, slot->imageRegions);
+    slot->deviceImages.assign(frames.begin(), frames.end());
+    cropImages(frames, Span<const cv::Rect>(slot->imageRegions), device_crops);
+    const std::vector<cv::cuda::GpuMat> &crops = device_crops;
+    slot->inputHeight = inputHeightFor(slot->imageRegions);
+    slot->numBoxes = bindInputHeight(slot->context, slot->inputHeight);
+
+    // decoder frames rotate through a pool, so their addresses change and a captured graph
+    // would read a stale frame; device frames are always launched directly
+    cudaEventRecord(slot->started, slot->stream);
+    slot->stageEvents = true;
+    bool ok = prepareImageDevice(crops, static_cast<float *>(slot->buffers[0]), slot->stream, slot->inputHeight);
+    if (!ok) {
+        downloadFrames(crops, host_frames);
+        prepareImage(host_frames, slot->hostInput, slot->inputHeight);
+        cudaMemcpyAsync(slot->buffers[0], slot->hostInput, inputBytes(slot->inputHeight),
+                        cudaMemcpyHostToDevice, slot->stream);
+    }
+    cudaEventRecord(slot->inputReady, slot->stream);
+    if (!slot->context->enqueueV3(slot->stream)) {
+        PLOG_EVERY(Severity::kERROR, 1) << "ERROR: Inference failed!";
+    }
+    cudaEventRecord(slot->inferred, slot->stream);
+    if (gpu_postprocess)
+        decodeYoloOutput(static_cast<const float *>(slot->buffers[1]), slot->numBoxes, CATEGORY,
+                         obj_threshold, nms_threshold, agnostic, slot->detections, slot->stream);
+    else
+        cudaMemcpyAsync(slot->hostOutput, slot->buffers[1], outputBytes(slot->numBoxes),
+                        cudaMemcpyDeviceToHost, slot->stream);
+    cudaEventRecord(slot->done, slot->stream);
+    device_crops.clear();
+    return slot->ticket;
+}
+
+std::vector<std::vector<DetectRes>> YOLO::InferenceDevice(const std::vector<cv::cuda::GpuMat> &frames,
+                                                          const std::vector<cv::Rect> &regions) {
+    Infer(frames, results, regions);
+    return results.toVectors();
+}
+
+int YOLO::inputHeightFor(Span<const cv::Rect> regions) const {
+    if (!dynamic_input)
+        return IMAGE_HEIGHT;
+    // just tall enough for the widest-limited letterbox of every region, on the coarsest stride
+    int stride = strides.empty() ? 32 : *std::max_element(strides.begin(), strides.end());
+    int height = MIN_INPUT_HEIGHT;
+    for (const cv::Rect &r : regions) {
+        if (r.empty())
+            continue;
+        float ratio = std::min(float(IMAGE_WIDTH) / float(r.width), float(IMAGE_HEIGHT) / float(r.height));
+        height = std::max(height, int(std::ceil(r.height * ratio / stride)) * stride);
+    }
+    return std::min(height, IMAGE_HEIGHT);
+}
+
+int YOLO::bindInputHeight(nvinfer1::IExecutionContext *ctx, int input_h) {
+    if (!dynamic_input)
+        return num_boxes;
+    ctx->setInputShape(engine->getIOTensorName(0), nvinfer1::Dims4{BATCH_SIZE, INPUT_CHANNEL, input_h, IMAGE_WIDTH});
+    nvinfer1::Dims out_dims = ctx->getTensorShape(engine->getIOTensorName(1));
+    return out_dims.nbDims > 0 ? int(out_dims.d[out_dims.nbDims - 1]) : 0;
+}
+
+size_t YOLO::inputBytes(int input_h) const {
+    return dynamic_input ? size_t(BATCH_SIZE) * INPUT_CHANNEL * IMAGE_WIDTH * input_h * sizeof(float)
+                         : size_t(bufferSize[0]);
+}
+
+size_t YOLO::outputBytes(int boxes) const {
+    return dynamic_input ? size_t(BATCH_SIZE) * (CATEGORY + 4) * boxes * sizeof(float) : size_t(bufferSize[1]);
+}
+
+bool YOLO::stageFrames(Span<const cv::Mat> vec_img, uint8_t *&pinned, size_t &pinned_size,
+                       std::vector<cv::Mat> &staged) {
+    size_t need = 0;
+    for (const cv::Mat &img : vec_img)
+        if (img.data && img.type() == CV_8UC3)
+            need += img.total() * img.elemSize();
+    if (need > pinned_size) {
+        if (pinned)
+            cudaFreeHost(pinned);
+        pinned = nullptr;
+        pinned_size = 0;
+        if (cudaHostAlloc((void **)&pinned, need, cudaHostAllocDefault) != cudaSuccess) {
+            cudaGetLastError();
+            pinned = nullptr;
+            return false;
+        }
+        pinned_size = need;
+    }
+
+    staged.resize(vec_img.size());
+    size_t offset = 0;
+    for (size_t i = 0; i < vec_img.size(); i++) {
+        const cv::Mat &img = vec_img[i];
+        if (!img.data || img.type() != CV_8UC3) {
+            staged[i] = cv::Mat();
+            continue;
+        }
+        // a header over the staging buffer, the copy never reallocates it
+        staged[i] = cv::Mat(img.rows, img.cols, CV_8UC3, pinned + offset);
+        img.copyTo(staged[i]);
+        offset += img.total() * img.elemSize();
+    }
+    return true;
+}
+
+void YOLO::captureGraph(InferSlot &slot, bool device_preprocess, const std::vector<cv::Size> &shapes,
+                        const std::function<bool(bool)> &enqueue) {
+    if (slot.graph) {
+        cudaGraphExecDestroy(slot.graph);
+        slot.graph = nullptr;
+    }
+    cudaGraph_t graph = nullptr;
+    bool ok = cudaStreamBeginCapture(slot.stream, cudaStreamCaptureModeThreadLocal) == cudaSuccess;
+    if (ok) {
+        bool enqueued = enqueue(device_preprocess);
+        ok = cudaStreamEndCapture(slot.stream, &graph) == cudaSuccess && enqueued && graph != nullptr;
+    }
+    if (ok)
+        ok = cudaGraphInstantiateWithFlags(&slot.graph, graph, 0) == cudaSuccess;
+    if (graph)
+        cudaGraphDestroy(graph);
+
+    if (!ok) {
+        cudaGetLastError();     // clear the sticky capture error
+        slot.graph = nullptr;
+        slot.graphUsable = false;
+        PLOG(Severity::kWARNING) << "CUDA graph capture failed, context falls back to direct launches";
+        return;
+    }
+    slot.graphDevicePreprocess = device_preprocess;
+    slot.graphShapes = shapes;
+    slot.graphInputHeight = slot.inputHeight;
+}
+
+std::vector<std::vector<DetectRes>> YOLO::Collect(uint64_t ticket) {
+    Collect(ticket, results);
+    return results.toVectors();
+}
+
+void YOLO::Collect(uint64_t ticket, DetectionBatch &out) {
+    BindDevice();
+    out.clear();
+    InferSlot *slot = findInferSlot(ticket);
+    if (slot == nullptr) {
+        PLOG_EVERY(Severity::kERROR, 1) << "Collect: unknown ticket " << ticket;
+        return;
+    }
+    ScopedTimer timer(Stage::kCollect);
+    cudaEventSynchronize(slot->done);
+    recordGpuTimes(*slot);
+    if (gpu_postprocess)
+        collectGpuDetections(slot->imageRegions, slot->detections, slot->inputHeight, slot->numBoxes,
+                             slot->buffers[1], slot->hostOutput, slot->stream, out);
+    else
+        postProcess(slot->imageRegions, slot->hostOutput, slot->inputHeight, slot->numBoxes, out);
+    slot->imageRegions.clear();
+    slot->deviceImages.clear();
+    slot->ticket = 0;
+}
+
+void YOLO::recordGpuTimes(const InferSlot &slot) {
+    auto elapsed = [](cudaEvent_t from, cudaEvent_t to) -> int64_t {
+        float ms = 0.f;
+        return cudaEventElapsedTime(&ms, from, to) == cudaSuccess ? int64_t(ms * 1e6) : -1;
+    };
+    Metrics &metrics = Metrics::instance();
+    if (!slot.stageEvents) {
+        int64_t total = elapsed(slot.started, slot.done);
+        if (total >= 0)
+            metrics.record(Stage::kGpuInfer, total);
+        return;
+    }
+    int64_t input = elapsed(slot.started, slot.inputReady);
+    int64_t infer = elapsed(slot.inputReady, slot.inferred);
+    int64_t output = elapsed(slot.inferred, slot.done);
+    if (input >= 0 && infer >= 0 && output >= 0) {
+        metrics.record(Stage::kGpuInput, input);
+        metrics.record(Stage::kGpuInfer, infer);
+        metrics.record(Stage::kGpuOutput, output);
+    } else {
+        cudaGetLastError();
+    }
 }
 
 std::vector<float> YOLO::prepareImage(std::vector<cv::Mat> &vec_img) {
-    std::vector<float> result(BATCH_SIZE * IMAGE_WIDTH * IMAGE_HEIGHT * INPUT_CHANNEL);
-    float *data = result.data();
+    std::vector<cv::Rect> rois;
+    frameRegions<cv::Mat>(vec_img, {}, rois);
+    return prepareImage(vec_img, inputHeightFor(rois));
+}
+
+std::vector<float> YOLO::prepareImage(const std::vector<cv::Mat> &vec_img, int input_h) {
+    std::vector<float> result(BATCH_SIZE * IMAGE_WIDTH * input_h * INPUT_CHANNEL);
+    prepareImage(vec_img, result.data(), input_h);
+    return result;
+}
+
+void YOLO::prepareImage(Span<const cv::Mat> vec_img, float *data, int input_h) {
     int index = 0;
     for (const cv::Mat &src_img : vec_img)
     {
         if (!src_img.data)
             continue;
-        float ratio = float(IMAGE_WIDTH) / float(src_img.cols) < float(IMAGE_HEIGHT) / float(src_img.rows) ? float(IMAGE_WIDTH) / float(src_img.cols) : float(IMAGE_HEIGHT) / float(src_img.rows);
-        cv::Mat flt_img = cv::Mat::zeros(cv::Size(IMAGE_WIDTH, IMAGE_HEIGHT), CV_8UC3);
-        cv::Mat rsz_img;
-        cv::resize(src_img, rsz_img, cv::Size(), ratio, ratio);
-        rsz_img.copyTo(flt_img(cv::Rect(0, 0, rsz_img.cols, rsz_img.rows)));
-        flt_img.convertTo(flt_img, CV_32FC3, 1.0 / 255);
-
-        //HWC TO CHW
-        int channelLength = IMAGE_WIDTH * IMAGE_HEIGHT;
-        std::vector<cv::Mat> split_img = {
-                cv::Mat(IMAGE_WIDTH, IMAGE_HEIGHT, CV_32FC1, data + channelLength * (index + 2)),
-                cv::Mat(IMAGE_WIDTH, IMAGE_HEIGHT, CV_32FC1, data + channelLength * (index + 1)),
-                cv::Mat(IMAGE_WIDTH, IMAGE_HEIGHT, CV_32FC1, data + channelLength * index)
-        };
+        letterboxBgrToTensorHost(src_img, data + IMAGE_WIDTH * input_h * index, IMAGE_WIDTH, input_h);
         index += 3;
-        cv::split(flt_img, split_img);
     }
-    return result;
+    // skipped (empty) images leave the tail of the batch black
+    int total = BATCH_SIZE * IMAGE_WIDTH * input_h * INPUT_CHANNEL;
+    std::fill(data + std::min(total, IMAGE_WIDTH * input_h * index), data + total, 0.f);
+}
+
+bool YOLO::prepareImageGpu(Span<const cv::Mat> vec_img, float *input,
+                           void *&raw, size_t &raw_size, cudaStream_t s, int input_h) {
+    // upload the raw 8-bit frames once and letterbox them on the device
+    size_t need = 0;
+    for (const cv::Mat &src_img : vec_img)
+        if (src_img.data)
+            need = std::max(need, size_t(src_img.cols) * src_img.rows * 3);
+    if (need > raw_size) {
+        if (raw)
+            cudaFree(raw);
+        if (cudaMalloc(&raw, need) != cudaSuccess) {
+            PLOG(Severity::kWARNING) << "GPU preprocess: cannot allocate " << need << " bytes, using CPU path";
+            raw = nullptr;
+            raw_size = 0;
+            gpu_preprocess = false;
+            return false;
+        }
+        raw_size = need;
+    }
+
+    int imageLength = INPUT_CHANNEL * IMAGE_WIDTH * input_h;
+    for (int b = 0; b < BATCH_SIZE; b++) {
+        float *dst = input + imageLength * b;
+        if (b >= (int)vec_img.size() || !vec_img[b].data || vec_img[b].type() != CV_8UC3) {
+            cudaMemsetAsync(dst, 0, imageLength * sizeof(float), s);
+            continue;
+        }
+        const cv::Mat &src_img = vec_img[b];
+        // vec_img is pinned (stageFrames), so the upload is truly async; frames of one batch
+        // share the raw buffer, so each upload waits for the previous kernel
+        cudaMemcpy2DAsync(raw, src_img.cols * 3, src_img.data, src_img.step,
+                          src_img.cols * 3, src_img.rows, cudaMemcpyHostToDevice, s);
+        cudaError_t err = letterboxBgrToTensor(static_cast<const uint8_t *>(raw),
+                                               src_img.cols, src_img.rows, src_img.cols * 3,
+                                               dst, IMAGE_WIDTH, input_h, s);
+        if (err != cudaSuccess) {
+            PLOG(Severity::kWARNING) << "GPU preprocess ERROR: " << cudaGetErrorString(err) << ", using CPU path";
+            gpu_preprocess = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool YOLO::prepareImageDevice(Span<const cv::cuda::GpuMat> frames, float *input, cudaStream_t s,
+                              int input_h) {
+    int imageLength = INPUT_CHANNEL * IMAGE_WIDTH * input_h;
+    for (int b = 0; b < BATCH_SIZE; b++) {
+        float *dst = input + imageLength * b;
+        if (b >= (int)frames.size() || frames[b].empty() || frames[b].type() != CV_8UC3) {
+            cudaMemsetAsync(dst, 0, imageLength * sizeof(float), s);
+            continue;
+        }
+        const cv::cuda::GpuMat &src = frames[b];
+        cudaError_t err = letterboxBgrToTensor(src.ptr<uint8_t>(), src.cols, src.rows, src.step,
+                                               dst, IMAGE_WIDTH, input_h, s);
+        if (err != cudaSuccess) {
+            PLOG(Severity::kWARNING) << "GPU preprocess ERROR: " << cudaGetErrorString(err) << ", using CPU path";
+            gpu_preprocess = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+void YOLO::downloadFrames(Span<const cv::cuda::GpuMat> frames, std::vector<cv::Mat> &host) {
+    // same-sized frames download into the previous batch's host buffers
+    host.resize(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (frames[i].empty())
+            host[i].release();
+        else
+            frames[i].download(host[i]);
+    }
 }
 
 float *YOLO::ModelInference(std::vector<float> image_data) {
+    // Model's interface: the caller delete[]s the output; the YOLO paths use inferSync
     auto *out = new float[outSize * BATCH_SIZE];
-    if (image_data.empty()) {
-        std::cout << "prepare images ERROR!" << std::endl;
+    if (image_data.empty() && !gpu_preprocess) {
+        PLOG_EVERY(Severity::kERROR, 1) << "prepare images ERROR!";
         return out;
     }
-    
+    inferSync(image_data.empty() ? nullptr : image_data.data(), image_data.size() * sizeof(float), out);
+    return out;
+}
+
+bool YOLO::inferSync(const float *input, size_t input_bytes, float *output) {
     // Set tensor addresses (TensorRT 10 API)
     const char* inputName = engine->getIOTensorName(0);
     const char* outputName = engine->getIOTensorName(1);
@@ -167,103 +774,98 @@ float *YOLO::ModelInference(std::vector<float> image_data) {
     context->setTensorAddress(inputName, buffers[0]);
     context->setTensorAddress(outputName, buffers[1]);
     
-    // DMA the input to the GPU
-    cudaMemcpyAsync(buffers[0], image_data.data(), bufferSize[0], cudaMemcpyHostToDevice, stream);
+    // DMA the input to the GPU (already in buffers[0] when preprocessed on the device)
+    if (input)
+        cudaMemcpyAsync(buffers[0], input, std::min(input_bytes, inputBytes(sync_input_height)),
+                        cudaMemcpyHostToDevice, stream);
 
     // Do inference (TensorRT 10 uses enqueueV3)
     bool success = context->enqueueV3(stream);
     if (!success) {
-        std::cout << "ERROR: Inference failed!" << std::endl;
+        PLOG_EVERY(Severity::kERROR, 1) << "ERROR: Inference failed!";
     }
     
-    // DMA output back
-    cudaMemcpyAsync(out, buffers[1], bufferSize[1], cudaMemcpyDeviceToHost, stream);
+    // DMA output back (only the compacted detections when decoding on the device)
+    if (gpu_postprocess)
+        decodeYoloOutput(static_cast<const float *>(buffers[1]), sync_num_boxes, CATEGORY,
+                         obj_threshold, nms_threshold, agnostic, sync_detections, stream);
+    else
+        cudaMemcpyAsync(output, buffers[1], outputBytes(sync_num_boxes), cudaMemcpyDeviceToHost, stream);
     cudaStreamSynchronize(stream);
-    
-    return out;     
+    return success;
 }
 
 
-std::vector<std::vector<DetectRes>> YOLO::postProcess(const std::vector<cv::Mat> &vec_Mat, float *output) {
-    std::vector<std::vector<DetectRes>> vec_result;
-    int index = 0;
+void YOLO::postProcess(Span<const cv::Rect> regions, const float *output, int input_h, int boxes, DetectionBatch &out) {
+    for (size_t index = 0; index < regions.size(); index++)
+        postProcessImage(regions[index], output + index * imageOutputFloats(boxes), input_h, boxes, out);
+}
+
+void YOLO::postProcessImage(const cv::Rect &region, const float *image, int input_h, int boxes, DetectionBatch &out) {
+    float ratio = float(region.width) / float(IMAGE_WIDTH) > float(region.height) / float(input_h) 
+                  ? float(region.width) / float(IMAGE_WIDTH) 
+                  : float(region.height) / float(input_h);
     
-    for (const cv::Mat &src_img : vec_Mat) {
-        std::vector<DetectRes> result;
-        float ratio = float(src_img.cols) / float(IMAGE_WIDTH) > float(src_img.rows) / float(IMAGE_HEIGHT) 
-                      ? float(src_img.cols) / float(IMAGE_WIDTH) 
-                      : float(src_img.rows) / float(IMAGE_HEIGHT);
-        
-        float *out = output + index * outSize;
-        
-        // YOLOv11 format: [num_classes + 4, num_boxes]
-        // For 1 class: [5, 8400] -> [x, y, w, h, score]
-        int num_boxes = 8400;  // Standard for 640x640
-        int num_elements = CATEGORY + 4;  // 4 (bbox) + 1 (class)
-        
-        std::cout << "PostProcess: Processing " << num_boxes << " boxes" << std::endl;
-        
-        for (int i = 0; i < num_boxes; i++) {
-            // YOLOv11: data is channel-first [C, N]
-            // Channel 0-3: bbox (x, y, w, h)
-            // Channel 4+: class scores
-            
-            float x = out[0 * num_boxes + i];  // x channel
-            float y = out[1 * num_boxes + i];  // y channel
-            float w = out[2 * num_boxes + i];  // w channel
-            float h = out[3 * num_boxes + i];  // h channel
-            
-            // For single class, score is at channel 4
-            float score = out[4 * num_boxes + i];
-            
-            // Apply sigmoid to score if needed (usually already applied in ONNX)
-            // score = 1.0f / (1.0f + exp(-score));
-            
-            if (score < obj_threshold)
-                continue;
-            
-            DetectRes box;
-            box.prob = score;
-            box.classes = 0;  // Single class: pothole
-            box.x = x * ratio;
-            box.y = y * ratio;
-            box.w = w * ratio;
-            box.h = h * ratio;
-            
-            result.push_back(box);
-        }
-        
-        std::cout << "PostProcess: Found " << result.size() << " detections before NMS" << std::endl;
-        
-        NmsDetect(result);
-        
-        std::cout << "PostProcess: " << result.size() << " detections after NMS" << std::endl;
-        
-        vec_result.push_back(result);
-        index++;
+    // YOLOv11 format: [num_classes + 4, num_boxes], channel-first
+    // Channel 0-3: bbox (x, y, w, h), channel 4+: class scores
+    int count = decodeYoloOutputHost(image, boxes, CATEGORY, obj_threshold, ratio,
+                                     decode_buffer.data(), (int)decode_buffer.size());
+    nms_buffer.assign(decode_buffer.begin(), decode_buffer.begin() + count);
+    // back from the region to frame coordinates
+    for (DetectRes &box : nms_buffer) {
+        box.x += region.x;
+        box.y += region.y;
     }
-    return vec_result;
+    
+    Metrics::instance().add(Counter::kCandidates, nms_buffer.size());
+    NmsDetect(nms_buffer);
+    Metrics::instance().add(Counter::kDetections, nms_buffer.size());
+    
+    out.boxes.insert(out.boxes.end(), nms_buffer.begin(), nms_buffer.end());
+    out.endImage();
 }
 
 
-void YOLO::NmsDetect(std::vector<DetectRes> &detections) {
-    sort(detections.begin(), detections.end(), [=](const DetectRes &left, const DetectRes &right) {
-        return left.prob > right.prob;
-    });
+void YOLO::collectGpuDetections(Span<const cv::Rect> regions, const GpuDetections &det, int input_h, int boxes_per_image,
+                                const void *device_output, float *host_output, cudaStream_t s, DetectionBatch &out) {
+    for (size_t index = 0; index < regions.size(); index++) {
+        const cv::Rect &region = regions[index];
+        if (det.hostCandidateCount[index] > kGpuMaxCandidates) {
+            // the device kept the first kGpuMaxCandidates to arrive, not the best: redo this image
+            // from the raw output, which stays on the device until the slot is reused
+            Metrics::instance().add(Counter::kCandidateOverflow);
+            size_t floats = imageOutputFloats(boxes_per_image);
+            float *image = host_output + index * floats;
+            cudaMemcpyAsync(image, static_cast<const float *>(device_output) + index * floats, floats * sizeof(float),
+                            cudaMemcpyDeviceToHost, s);
+            cudaStreamSynchronize(s);
+            postProcessImage(region, image, input_h, boxes_per_image, out);
+            continue;
+        }
+        float ratio = float(region.width) / float(IMAGE_WIDTH) > float(region.height) / float(input_h)
+                      ? float(region.width) / float(IMAGE_WIDTH)
+                      : float(region.height) / float(input_h);
 
-    for (int i = 0; i < (int)detections.size(); i++)
-        for (int j = i + 1; j < (int)detections.size(); j++)
-        {
-            if (detections[i].classes == detections[j].classes or agnostic)
-            {
-                float iou = IOUCalculate(detections[i], detections[j]);
-                if (iou > nms_threshold)
-                    detections[j].prob = 0;
-            }
+        int count = std::min(det.hostCount[index], det.maxDetections);
+        const DeviceDetection *boxes = det.hostDetections + index * det.maxDetections;
+        for (int i = 0; i < count; i++) {
+            DetectRes box;
+            box.classes = boxes[i].classes;
+            box.prob = boxes[i].prob;
+            box.x = boxes[i].x * ratio + region.x;
+            box.y = boxes[i].y * ratio + region.y;
+            box.w = boxes[i].w * ratio;
+            box.h = boxes[i].h * ratio;
+            out.boxes.push_back(box);
         }
 
-    detections.erase(std::remove_if(detections.begin(), detections.end(), [](const DetectRes &det)
-    { return det.prob == 0; }), detections.end());
+        Metrics::instance().add(Counter::kDetections, count);
+        out.endImage();
+    }
+}
+
+void YOLO::NmsDetect(std::vector<DetectRes> &detections) {
+    nms_engine.run(detections);
 }
 
 float YOLO::IOUCalculate(const DetectRes &det_a, const DetectRes &det_b) {
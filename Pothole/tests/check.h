@@ -0,0 +1,45 @@
+/**
+ * @desc:   assertions of the unit tests, kept in Release builds (unlike assert). A failed check
+ *          prints its location and the test exits non-zero once its cases have run.
+ */
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+namespace check {
+
+inline int &failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline int result(const char *name)
+{
+    if (failures() == 0)
+        std::printf("%s: passed\n", name);
+    else
+        std::printf("%s: %d check(s) failed\n", name, failures());
+    return failures() == 0 ? 0 : 1;
+}
+
+} // namespace check
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);    \
+            ++check::failures();                                                    \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tolerance)                                                 \
+    do {                                                                            \
+        double check_a = (a), check_b = (b);                                        \
+        if (!(std::fabs(check_a - check_b) <= (tolerance))) {                       \
+            std::printf("%s:%d: CHECK_NEAR(%s, %s) failed: %g vs %g\n", __FILE__, __LINE__, #a, #b, \
+                        check_a, check_b);                                          \
+            ++check::failures();                                                    \
+        }                                                                           \
+    } while (0)
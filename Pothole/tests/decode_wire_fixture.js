@@ -0,0 +1,50 @@
+/**
+ * Decodes the binary batch fixture written by the C++ encoder (test_wire_format.cpp) with the
+ * server's decoder and compares it to the frames the encoder was given, in the JSON shape.
+ * Usage: node decode_wire_fixture.js <server/services/wireFormat.js> <wire_batch_v2.bin>
+ */
+const assert = require('assert');
+const fs = require('fs');
+const path = require('path');
+
+const [wireFormatPath, fixturePath] = process.argv.slice(2);
+const { decodeBatch } = require(path.resolve(wireFormatPath));
+
+const expected = [
+  {
+    frame: 120,
+    theta_deg: 1.25,
+    detections: [
+      { id: 3, d: 12.34, x: -0.56, size: 0.0789 },
+      { id: 7, d: 25.5, x: 1.2, size: 0.15, event: 'confirmed', score: 0.875, first_frame: 118, last_frame: 120, hits: 3 }
+    ],
+    timestamp_ms: 1718000000123
+  },
+  {
+    frame: 121,
+    theta_deg: 1.2,
+    detections: [
+      { id: 3, d: 11.9, x: -0.6, size: 0.0801 },
+      { id: 7, d: 25, x: 1.18, size: 0.15, event: 'live', score: 0.9, first_frame: 118, last_frame: 121, hits: 4 },
+      { id: 12, d: 40, x: 3.5, size: 0.2 }
+    ],
+    timestamp_ms: 1718000000156
+  },
+  {
+    frame: 124,
+    theta_deg: -0.35,
+    detections: [
+      { id: 3, d: 10, x: -0.75, size: 0.08, event: 'ended', score: 0.7, first_frame: 110, last_frame: 122, hits: 9 },
+      { id: 12, d: 38.76, x: 3.49, size: 0.2 }
+    ],
+    timestamp_ms: 1718000000256
+  }
+];
+
+const fixture = fs.readFileSync(fixturePath);
+assert.deepStrictEqual(decodeBatch(fixture), expected);
+
+// a cut body is rejected, not decoded short
+assert.throws(() => decodeBatch(fixture.subarray(0, fixture.length - 1)), /Truncated/);
+
+console.log('decode_wire_fixture: passed');
@@ -0,0 +1,76 @@
+/**
+ * @desc:   LapJV against KuhnMunkres on seeded random cost matrices: square, wide and tall, with
+ *          and without ties. Both must assign min(rows, cols) distinct pairs at the same total cost.
+ */
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+#include "check.h"
+#include "kuhn_munkres.h"
+#include "lapjv.h"
+
+namespace {
+
+using Assignment = std::vector<std::pair<int, int> >;
+
+std::vector<float> randomCost(int rows, int cols, std::mt19937 &rng, bool ties)
+{
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::uniform_int_distribution<int> level(0, 4);
+    std::vector<float> cost(size_t(rows) * cols);
+    for (float &c : cost)
+        c = ties ? level(rng) * 0.25f : unit(rng);
+    return cost;
+}
+
+// every pair in range, no row or column twice, and as many pairs as the shorter side
+bool complete(const Assignment &pairs, int rows, int cols)
+{
+    std::vector<char> rowUsed(rows, 0), colUsed(cols, 0);
+    for (const auto &p : pairs) {
+        if (p.first < 0 || p.first >= rows || p.second < 0 || p.second >= cols)
+            return false;
+        if (rowUsed[p.first]++ || colUsed[p.second]++)
+            return false;
+    }
+    return int(pairs.size()) == std::min(rows, cols);
+}
+
+double totalCost(const std::vector<float> &cost, int cols, const Assignment &pairs)
+{
+    double total = 0.0;
+    for (const auto &p : pairs)
+        total += cost[size_t(p.first) * cols + p.second];
+    return total;
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(20240611);
+    kuhn_munkres::KuhnMunkres munkres;
+    lapjv::LapJV jv;    // reused across sizes, like SORT does
+    Assignment expected, actual;
+    const int shapes[][2] = {{1, 1}, {1, 7}, {7, 1}, {5, 5}, {12, 12}, {8, 20}, {20, 8}, {33, 40}, {64, 64}};
+    for (const auto &shape : shapes) {
+        int rows = shape[0], cols = shape[1];
+        for (int ties = 0; ties < 2; ++ties)
+            for (int trial = 0; trial < 20; ++trial) {
+                std::vector<float> cost = randomCost(rows, cols, rng, ties != 0);
+                munkres.compute(cost.data(), rows, cols, expected);
+                jv.compute(cost.data(), rows, cols, actual);
+                CHECK(complete(expected, rows, cols));
+                CHECK(complete(actual, rows, cols));
+                CHECK_NEAR(totalCost(cost, cols, actual), totalCost(cost, cols, expected), 1e-4);
+            }
+    }
+
+    // empty problems assign nothing
+    jv.compute(nullptr, 0, 5, actual);
+    CHECK(actual.empty());
+    jv.compute(nullptr, 5, 0, actual);
+    CHECK(actual.empty());
+    return check::result("test_assignment");
+}
@@ -0,0 +1,144 @@
+/**
+ * @desc:   BatchScheduler: batches take the oldest frames across streams up to max_batch slots,
+ *          each stream keeps its order, drop-oldest evicts (and destroys) the oldest frames of the
+ *          full stream only, detached and finished streams are not waited for.
+ */
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "batch_scheduler.h"
+#include "check.h"
+
+namespace {
+
+struct Frame {
+    int stream = 0;
+    int seq = 0;
+    std::shared_ptr<int> token;   // shared with the test, to see evicted frames destroyed
+};
+
+using Scheduler = BatchScheduler<Frame>;
+using std::chrono::milliseconds;
+
+void push(Scheduler &scheduler, int stream, int seq, bool needs_slot = true, std::shared_ptr<int> token = nullptr)
+{
+    scheduler.push(stream, Frame{stream, seq, std::move(token)}, needs_slot);
+    std::this_thread::sleep_for(std::chrono::microseconds(50));     // distinct arrival times
+}
+
+void oldestFirst()
+{
+    Scheduler scheduler(2, 8, QueuePolicy::kBlock, 3, milliseconds(0));
+    push(scheduler, 0, 0);
+    push(scheduler, 1, 0);
+    push(scheduler, 0, 1, false);   // rides along without a slot
+    push(scheduler, 0, 2);
+    push(scheduler, 1, 1);
+    push(scheduler, 1, 2);
+
+    std::vector<Frame> batch;
+    CHECK(scheduler.popBatch(batch));
+    CHECK(batch.size() == 4);       // three slots plus the slot-free frame between them
+    const int order[][2] = {{0, 0}, {1, 0}, {0, 1}, {0, 2}};
+    for (size_t i = 0; i < batch.size() && i < 4; ++i)
+        CHECK(batch[i].stream == order[i][0] && batch[i].seq == order[i][1]);
+
+    CHECK(scheduler.popBatch(batch));
+    CHECK(batch.size() == 2 && batch[0].seq == 1 && batch[1].seq == 2);
+    CHECK(scheduler.size() == 0);
+    CHECK_NEAR(scheduler.meanBatch(), 2.5, 1e-9);
+}
+
+void dropOldest()
+{
+    Scheduler scheduler(2, 2, QueuePolicy::kDropOldest, 8, milliseconds(0));
+    auto token = std::make_shared<int>(0);
+    for (int seq = 0; seq < 5; ++seq)
+        push(scheduler, 0, seq, true, token);
+    push(scheduler, 1, 0, true, token);
+    CHECK(scheduler.dropped() == 3);
+    CHECK(scheduler.size() == 3);
+    CHECK(token.use_count() == 1 + 3);  // the evicted frames are gone, not parked
+
+    std::vector<Frame> batch;
+    CHECK(scheduler.popBatch(batch));
+    CHECK(batch.size() == 3);
+    if (batch.size() == 3) {
+        CHECK(batch[0].stream == 0 && batch[0].seq == 3);
+        CHECK(batch[1].stream == 0 && batch[1].seq == 4);
+        CHECK(batch[2].stream == 1 && batch[2].seq == 0);
+    }
+}
+
+void deadlineAndDetach()
+{
+    // an attached empty stream holds the batch back until the deadline
+    Scheduler scheduler(2, 4, QueuePolicy::kBlock, 4, milliseconds(30));
+    std::vector<Frame> batch;
+    push(scheduler, 0, 0);
+    auto start = std::chrono::steady_clock::now();
+    CHECK(scheduler.popBatch(batch));
+    CHECK(batch.size() == 1);
+    CHECK(std::chrono::steady_clock::now() - start >= milliseconds(25));
+
+    // a detached one doesn't, and its frames still leave after attach
+    scheduler.detach(1);
+    push(scheduler, 0, 1);
+    start = std::chrono::steady_clock::now();
+    CHECK(scheduler.popBatch(batch));
+    CHECK(batch.size() == 1 && std::chrono::steady_clock::now() - start < milliseconds(25));
+    scheduler.attach(1);
+    push(scheduler, 1, 0);
+    CHECK(scheduler.popBatch(batch));
+    CHECK(batch.size() == 1 && batch[0].stream == 1);
+
+    scheduler.finish(0);
+    scheduler.finish(1);
+    CHECK(!scheduler.popBatch(batch));
+}
+
+void concurrentProducers()
+{
+    constexpr int kStreams = 3, kFrames = 2000;
+    Scheduler scheduler(kStreams, 4, QueuePolicy::kBlock, 4, milliseconds(1));
+    std::vector<std::thread> producers;
+    for (int s = 0; s < kStreams; ++s)
+        producers.emplace_back([&scheduler, s] {
+            for (int seq = 0; seq < kFrames; ++seq)
+                scheduler.push(s, Frame{s, seq, nullptr}, seq % 3 != 0);
+            scheduler.finish(s);
+        });
+
+    std::vector<int> next(kStreams, 0);
+    std::vector<Frame> batch;
+    bool ordered = true, bounded = true;
+    while (scheduler.popBatch(batch)) {
+        int slots = 0;
+        for (const Frame &frame : batch) {
+            ordered = ordered && frame.seq == next[frame.stream];
+            next[frame.stream] = frame.seq + 1;
+            slots += frame.seq % 3 != 0 ? 1 : 0;
+        }
+        bounded = bounded && slots <= 4;
+    }
+    for (std::thread &t : producers)
+        t.join();
+    CHECK(ordered);
+    CHECK(bounded);
+    for (int s = 0; s < kStreams; ++s)
+        CHECK(next[s] == kFrames);      // blocking lanes lose nothing
+    CHECK(scheduler.dropped() == 0);
+}
+
+} // namespace
+
+int main()
+{
+    oldestFirst();
+    dropOldest();
+    deadlineAndDetach();
+    concurrentProducers();
+    return check::result("test_batch_scheduler");
+}
@@ -0,0 +1,113 @@
+/**
+ * @desc:   ConstantVelocityKalman<7, 4> against one cv::KalmanFilter per slot with the same model
+ *          (SORT's [cx, cy, s, r, vcx, vcy, vs]): states and covariances must agree through
+ *          predictions, measurement updates and coasted frames that skip the update.
+ */
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <opencv2/video/tracking.hpp>
+#include "check.h"
+#include "kalman_filter.h"
+
+namespace {
+
+constexpr int kDimX = 7, kDimZ = 4;
+constexpr int kSlots = 6;
+constexpr int kSteps = 60;
+
+const std::array<float, kDimX> kQ = {1, 1, 1, 1, 1e-2f, 1e-2f, 1e-4f};
+const std::array<float, kDimZ> kR = {1, 1, 10, 10};
+const std::array<float, kDimX> kP0 = {10, 10, 10, 10, 1e4f, 1e4f, 1e4f};
+
+cv::KalmanFilter referenceFilter(const float *z0)
+{
+    cv::KalmanFilter kf(kDimX, kDimZ, 0, CV_32F);
+    kf.transitionMatrix = cv::Mat::eye(kDimX, kDimX, CV_32F);
+    for (int k = 0; k < kDimX - kDimZ; ++k)
+        kf.transitionMatrix.at<float>(k, kDimZ + k) = 1.f;
+    kf.measurementMatrix = cv::Mat::eye(kDimZ, kDimX, CV_32F);
+    kf.processNoiseCov = cv::Mat::zeros(kDimX, kDimX, CV_32F);
+    kf.errorCovPost = cv::Mat::zeros(kDimX, kDimX, CV_32F);
+    for (int i = 0; i < kDimX; ++i) {
+        kf.processNoiseCov.at<float>(i, i) = kQ[i];
+        kf.errorCovPost.at<float>(i, i) = kP0[i];
+    }
+    kf.measurementNoiseCov = cv::Mat::zeros(kDimZ, kDimZ, CV_32F);
+    for (int i = 0; i < kDimZ; ++i)
+        kf.measurementNoiseCov.at<float>(i, i) = kR[i];
+    kf.statePost = cv::Mat::zeros(kDimX, 1, CV_32F);
+    for (int i = 0; i < kDimZ; ++i)
+        kf.statePost.at<float>(i) = z0[i];
+    return kf;
+}
+
+// float round-off of two different operation orders, relative to the magnitude
+bool close(float actual, float expected)
+{
+    return std::fabs(actual - expected) <= 1e-3f * (1.f + std::fabs(expected));
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> position(50.f, 600.f), area(400.f, 20000.f), ratio(0.5f, 2.f);
+    std::uniform_real_distribution<float> speed(-4.f, 4.f), noise(-1.5f, 1.5f);
+    std::bernoulli_distribution coast(0.25);
+
+    sort::ConstantVelocityKalman<kDimX, kDimZ> batched(kSlots, kQ, kR, kP0);
+    std::vector<cv::KalmanFilter> reference;
+    std::vector<std::array<float, kDimZ> > truth(kSlots), velocity(kSlots);
+    for (int slot = 0; slot < kSlots; ++slot) {
+        truth[slot] = {position(rng), position(rng), area(rng), ratio(rng)};
+        velocity[slot] = {speed(rng), speed(rng), 10.f * speed(rng), 0.f};
+        batched.init(slot, truth[slot].data());
+        reference.push_back(referenceFilter(truth[slot].data()));
+    }
+
+    std::vector<uint8_t> mask(kSlots);
+    cv::Mat measurement(kDimZ, 1, CV_32F);
+    int mismatches = 0;
+    for (int step = 0; step < kSteps; ++step) {
+        batched.predictAll(kSlots);
+        for (int slot = 0; slot < kSlots; ++slot) {
+            reference[slot].predict();
+            mask[slot] = coast(rng) ? 0 : 1;
+            std::array<float, kDimZ> z;
+            for (int i = 0; i < kDimZ; ++i) {
+                truth[slot][i] += velocity[slot][i];
+                z[i] = truth[slot][i] + noise(rng);
+            }
+            batched.setMeasurement(slot, z.data());
+            if (mask[slot]) {
+                for (int i = 0; i < kDimZ; ++i)
+                    measurement.at<float>(i) = z[i];
+                reference[slot].correct(measurement);
+            }
+        }
+        batched.correctAll(mask.data(), kSlots);
+
+        for (int slot = 0; slot < kSlots; ++slot) {
+            const cv::KalmanFilter &kf = reference[slot];
+            for (int i = 0; i < kDimX; ++i) {
+                mismatches += close(batched.state(i)[slot], kf.statePost.at<float>(i)) ? 0 : 1;
+                for (int j = 0; j < kDimX; ++j)
+                    mismatches += close(batched.covariance(i, j, slot), kf.errorCovPost.at<float>(i, j)) ? 0 : 1;
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+
+    // a restarted slot starts over at its measurement with zero velocity and P(0)
+    const float z0[kDimZ] = {100.f, 200.f, 900.f, 1.f};
+    batched.init(2, z0);
+    for (int i = 0; i < kDimX; ++i) {
+        CHECK_NEAR(batched.state(i)[2], i < kDimZ ? z0[i] : 0.f, 0.0);
+        CHECK_NEAR(batched.covariance(i, i, 2), kP0[i], 0.0);
+    }
+    return check::result("test_kalman");
+}
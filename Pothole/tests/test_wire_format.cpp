@@ -0,0 +1,110 @@
+/**
+ * @desc:   the binary batch encoder against the checked-in fixture that the Node decoder test
+ *          (decode_wire_fixture.js) reads, so a change of the byte layout breaks both sides' tests.
+ *          After a deliberate format change, rewrite the fixture with
+ *              ./test_wire_format <tests/fixtures> --write
+ *          and update the expected frames of decode_wire_fixture.js.
+ */
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "wire_format.h"
+
+namespace {
+
+StreamedTrack track(int id, float d, float x, float size)
+{
+    StreamedTrack t;
+    t.id = id;
+    t.d = d;
+    t.x = x;
+    t.size = size;
+    return t;
+}
+
+StreamedTrack event(StreamedTrack t, TrackEventType type, float score, int first, int last, int hits)
+{
+    t.event = type;
+    t.score = score;
+    t.firstFrame = first;
+    t.lastFrame = last;
+    t.hits = hits;
+    return t;
+}
+
+// three frames: absolute values, then deltas against tracks of the previous frame, a new track,
+// negative offsets and pitch, and one of each event
+std::vector<StreamedFrame> scene()
+{
+    std::vector<StreamedFrame> frames(3);
+    frames[0].frame = 120;
+    frames[0].thetaDeg = 1.25;
+    frames[0].timestampMs = 1718000000123LL;
+    frames[0].count = 2;
+    frames[0].tracks[0] = track(3, 12.34f, -0.56f, 0.0789f);
+    frames[0].tracks[1] = event(track(7, 25.5f, 1.2f, 0.15f), TrackEventType::kConfirmed, 0.875f, 118, 120, 3);
+
+    frames[1].frame = 121;
+    frames[1].thetaDeg = 1.2;
+    frames[1].timestampMs = 1718000000156LL;
+    frames[1].count = 3;
+    frames[1].tracks[0] = track(3, 11.9f, -0.6f, 0.0801f);
+    frames[1].tracks[1] = event(track(7, 25.0f, 1.18f, 0.15f), TrackEventType::kLive, 0.9f, 118, 121, 4);
+    frames[1].tracks[2] = track(12, 40.0f, 3.5f, 0.2f);
+
+    frames[2].frame = 124;
+    frames[2].thetaDeg = -0.35;
+    frames[2].timestampMs = 1718000000256LL;
+    frames[2].count = 2;
+    frames[2].tracks[0] = event(track(3, 10.0f, -0.75f, 0.08f), TrackEventType::kEnded, 0.7f, 110, 122, 9);
+    frames[2].tracks[1] = track(12, 38.76f, 3.49f, 0.2f);
+    return frames;
+}
+
+std::string encode(BatchEncoder &encoder, const std::vector<StreamedFrame> &frames)
+{
+    std::string body;
+    encoder.begin(body);
+    for (const StreamedFrame &frame : frames)
+        encoder.append(body, frame);
+    encoder.finish(body);
+    return body;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string path = std::string(argc > 1 ? argv[1] : "fixtures") + "/wire_batch_v2.bin";
+    BatchEncoder encoder(WireFormat::kBinary);
+    std::string body = encode(encoder, scene());
+
+    if (argc > 2 && std::strcmp(argv[2], "--write") == 0) {
+        std::ofstream out(path, std::ios::binary);
+        out.write(body.data(), std::streamsize(body.size()));
+        CHECK(out.good());
+        std::printf("wrote %zu bytes to %s\n", body.size(), path.c_str());
+        return check::result("test_wire_format");
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    CHECK(in.good());
+    std::string fixture((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(body == fixture);
+
+    // header: magic, version, frame count and payload length
+    CHECK(body.size() > BatchEncoder::kHeaderBytes);
+    CHECK(body[0] == 'P' && body[1] == 'H' && uint8_t(body[2]) == BatchEncoder::kVersion);
+    CHECK(uint8_t(body[3]) == 3 && body[4] == 0);
+    size_t payload = size_t(uint8_t(body[5])) | size_t(uint8_t(body[6])) << 8 | size_t(uint8_t(body[7])) << 16
+                   | size_t(uint8_t(body[8])) << 24;
+    CHECK(payload == body.size() - BatchEncoder::kHeaderBytes);
+
+    // no delta reaches back into the previous batch
+    CHECK(encode(encoder, scene()) == body);
+    return check::result("test_wire_format");
+}
@@ -6,6 +6,7 @@ const distanceCalculator = require('./services/distanceCalculator');
 const coordinateCalculator = require('./services/coordinateCalculator');
 const notificationManager = require('./services/notificationManager');
 const potholeStorage = require('./services/potholeStorage');
+const wireFormat = require('./services/wireFormat');
 
 const app = express();
 const PORT = process.env.PORT || 5001;
@@ -13,6 +14,7 @@ const PORT = process.env.PORT || 5001;
 // Middleware
 app.use(cors());
 app.use(express.json());
+app.use(express.raw({ type: wireFormat.CONTENT_TYPE }));
 
 // Create HTTP server
 const server = http.createServer(app);
@@ -47,113 +49,138 @@ function broadcast(data) {
   });
 }
 
-// POST /webhook - Receives pothole detection data from C++ model
-app.post('/webhook', (req, res) => {
-  try {
-    const detectionData = req.body;
-    console.log('Received pothole detection:', detectionData);
+// Process one frame of detections, returns the webhook response body
+function processDetection(detectionData) {
+  console.log('Received pothole detection:', detectionData);
+
+  // Process detection data
+  const notification = notificationManager.createNotification(detectionData);
+  
+  // Calculate pothole coordinates if vehicle coordinates are provided
+  let potholeCoords = null;
+  if (detectionData.vehicleCoordinates && notification.pothole) {
+    const vehicleCoord = detectionData.vehicleCoordinates;
+    const nextCoord = detectionData.nextRouteCoordinate || vehicleCoord;
+    const distanceMeters = notification.pothole.distance_m || 0;
+    const lateralMeters = notification.pothole.lateral_m || 0;
+    
+    // Calculate pothole coordinates
+    potholeCoords = coordinateCalculator.calculatePotholeCoordinates(
+      vehicleCoord,
+      nextCoord,
+      distanceMeters,
+      lateralMeters
+    );
+    
+    if (potholeCoords) {
+      notification.pothole.coordinates = potholeCoords;
+      notificationManager.setPotholeCoordinates(notification.id, potholeCoords);
+      console.log('Calculated pothole coordinates:', potholeCoords);
+    }
+  }
 
-    // Process detection data
-    const notification = notificationManager.createNotification(detectionData);
+  // Per-track events: "confirmed" and "live" only alert clients, the "ended" summary carries the
+  // closest approach of the track and is what gets stored. Legacy per-frame payloads are stored as before.
+  const event = notification.pothole.event;
+  const persist = !event || event === 'ended';
+
+  // Check if pothole already exists at this location (only if we have coordinates)
+  if (potholeCoords && persist) {
+    const existingPothole = potholeStorage.findExistingPothole(potholeCoords);
     
-    // Calculate pothole coordinates if vehicle coordinates are provided
-    let potholeCoords = null;
-    if (detectionData.vehicleCoordinates && notification.pothole) {
-      const vehicleCoord = detectionData.vehicleCoordinates;
-      const nextCoord = detectionData.nextRouteCoordinate || vehicleCoord;
-      const distanceMeters = notification.pothole.distance_m || 0;
-      const lateralMeters = notification.pothole.lateral_m || 0;
-      
-      // Calculate pothole coordinates
-      potholeCoords = coordinateCalculator.calculatePotholeCoordinates(
-        vehicleCoord,
-        nextCoord,
-        distanceMeters,
-        lateralMeters
+    if (existingPothole) {
+      // Pothole already exists - check if we should increment count
+      // Only increment if detection is more than 2 cm away (not the same detection)
+      const distance = distanceCalculator.calculateDistance(
+        potholeCoords,
+        existingPothole.coordinates
       );
       
-      if (potholeCoords) {
-        notification.pothole.coordinates = potholeCoords;
-        notificationManager.setPotholeCoordinates(notification.id, potholeCoords);
-        console.log('Calculated pothole coordinates:', potholeCoords);
+      let updated = existingPothole;
+      let countIncremented = false;
+      
+      if (distance > potholeStorage.TOO_CLOSE_THRESHOLD_METERS) {
+        // More than 2 cm away - increment count (new detection of same pothole)
+        console.log(`Pothole exists at distance ${distance.toFixed(4)}m, incrementing detection count`);
+        updated = potholeStorage.incrementDetectionCount(existingPothole.id, potholeCoords);
+        countIncremented = true;
+      } else {
+        // Within 2 cm - same detection, don't increment
+        console.log(`Pothole detection too close (${distance.toFixed(4)}m <= ${potholeStorage.TOO_CLOSE_THRESHOLD_METERS}m), not incrementing count`);
       }
-    }
-
-    // Check if pothole already exists at this location (only if we have coordinates)
-    if (potholeCoords) {
-      const existingPothole = potholeStorage.findExistingPothole(potholeCoords);
       
-      if (existingPothole) {
-        // Pothole already exists - check if we should increment count
-        // Only increment if detection is more than 2 cm away (not the same detection)
-        const distance = distanceCalculator.calculateDistance(
-          potholeCoords,
-          existingPothole.coordinates
-        );
-        
-        let updated = existingPothole;
-        let countIncremented = false;
-        
-        if (distance > potholeStorage.TOO_CLOSE_THRESHOLD_METERS) {
-          // More than 2 cm away - increment count (new detection of same pothole)
-          console.log(`Pothole exists at distance ${distance.toFixed(4)}m, incrementing detection count`);
-          updated = potholeStorage.incrementDetectionCount(existingPothole.id, potholeCoords);
-          countIncremented = true;
-        } else {
-          // Within 2 cm - same detection, don't increment
-          console.log(`Pothole detection too close (${distance.toFixed(4)}m <= ${potholeStorage.TOO_CLOSE_THRESHOLD_METERS}m), not incrementing count`);
-        }
-        
-        // Broadcast existing pothole alert (not a new detection)
-        broadcast({
-          type: 'existing_pothole_alert',
-          data: {
-            ...notification,
-            pothole: {
-              ...notification.pothole,
-              coordinates: existingPothole.coordinates,
-              existing: true,
-              detection_count: updated.detection_count,
-              count_incremented: countIncremented
-            }
+      // Broadcast existing pothole alert (not a new detection)
+      broadcast({
+        type: 'existing_pothole_alert',
+        data: {
+          ...notification,
+          pothole: {
+            ...notification.pothole,
+            coordinates: existingPothole.coordinates,
+            existing: true,
+            detection_count: updated.detection_count,
+            count_incremented: countIncremented
           }
-        });
-
-        return res.status(200).json({ 
-          success: true, 
-          isDuplicate: true,
-          existingPotholeId: existingPothole.id,
-          detectionCount: updated.detection_count,
-          countIncremented: countIncremented,
-          distance: distance
-        });
-      } else {
-        // New pothole - save to persistent storage
-        const saveResult = potholeStorage.addPothole({
-          coordinates: potholeCoords,
-          distance_m: notification.pothole.distance_m,
-          lateral_m: notification.pothole.lateral_m,
-          size: notification.pothole.size,
-          track_id: notification.pothole.track_id
-        });
-
-        if (saveResult.success) {
-          console.log('New pothole saved to persistent storage:', saveResult.pothole.id);
         }
+      });
+
+      return ({ 
+        success: true, 
+        isDuplicate: true,
+        existingPotholeId: existingPothole.id,
+        detectionCount: updated.detection_count,
+        countIncremented: countIncremented,
+        distance: distance
+      });
+    } else {
+      // New pothole - save to persistent storage
+      const saveResult = potholeStorage.addPothole({
+        coordinates: potholeCoords,
+        distance_m: notification.pothole.distance_m,
+        lateral_m: notification.pothole.lateral_m,
+        size: notification.pothole.size,
+        track_id: notification.pothole.track_id
+      });
+
+      if (saveResult.success) {
+        console.log('New pothole saved to persistent storage:', saveResult.pothole.id);
       }
     }
-    
-    // Broadcast new pothole detection to all connected clients
-    broadcast({
-      type: 'pothole_detected',
-      data: notification
-    });
+  }
+  
+  // Broadcast new pothole detection to all connected clients
+  broadcast({
+    type: 'pothole_detected',
+    data: notification
+  });
 
-    res.status(200).json({ 
-      success: true, 
-      notificationId: notification.id,
-      isDuplicate: false
-    });
+  return {
+    success: true,
+    notificationId: notification.id,
+    isDuplicate: false
+  };
+}
+
+// POST /webhook - Receives pothole detection data from C++ model.
+// The publisher coalesces frames, so the body is either one frame object or an array of them,
+// as JSON or as a binary batch selected by the Content-Type.
+app.post('/webhook', (req, res) => {
+  let body = req.body;
+  if (Buffer.isBuffer(body)) {
+    try {
+      body = wireFormat.decodeBatch(body);
+    } catch (error) {
+      console.error('Malformed binary batch:', error.message);
+      return res.status(400).json({ success: false, error: error.message });
+    }
+  }
+
+  try {
+    if (Array.isArray(body)) {
+      const results = body.map(processDetection);
+      return res.status(200).json({ success: true, results });
+    }
+    res.status(200).json(processDetection(body));
   } catch (error) {
     console.error('Error processing webhook:', error);
     res.status(500).json({ success: false, error: error.message });
@@ -20,7 +20,13 @@ function createNotification(detectionData) {
       distance_m: firstDetection.d,
       lateral_m: firstDetection.x,
       size: firstDetection.size || 0, // Will be calculated if not provided
-      coordinates: detectionData.coordinates || null // Should be provided by C++ model
+      coordinates: detectionData.coordinates || null, // Should be provided by C++ model
+      // track lifecycle summary, set when the C++ model publishes per-track events
+      event: firstDetection.event || null,
+      score: firstDetection.score || null,
+      first_frame: firstDetection.first_frame ?? null,
+      last_frame: firstDetection.last_frame ?? null,
+      hits: firstDetection.hits || null
     };
   } else {
     // Single detection format
@@ -0,0 +1,122 @@
+/**
+ * Binary detection batch decoder
+ * Decodes `application/x-pothole-batch` bodies from the C++ publisher into the same
+ * frame objects the JSON format carries. Layout is documented in Pothole/includes/wire_format.h
+ */
+
+const CONTENT_TYPE = 'application/x-pothole-batch';
+const VERSION = 2; // 1 had no track event fields
+const EVENTS = ['frame', 'confirmed', 'live', 'ended'];
+const HEADER_BYTES = 9;
+
+const METRES = 100; // 0.01 m
+const SQUARE_METRES = 1e4; // 0.0001 m^2
+const DEGREES = 100; // 0.01 deg
+const SCORE = 1000; // 0.001
+
+class Reader {
+  constructor(buf, offset, end) {
+    this.buf = buf;
+    this.pos = offset;
+    this.end = end;
+  }
+
+  varint() {
+    let result = 0;
+    let scale = 1;
+    for (;;) {
+      if (this.pos >= this.end) throw new Error('Truncated varint');
+      const byte = this.buf[this.pos++];
+      result += (byte & 0x7f) * scale;
+      if (byte < 0x80) return result;
+      scale *= 128;
+      if (scale > Number.MAX_SAFE_INTEGER) throw new Error('Varint too long');
+    }
+  }
+
+  byte() {
+    if (this.pos >= this.end) throw new Error('Truncated byte');
+    return this.buf[this.pos++];
+  }
+
+  svarint() {
+    const v = this.varint();
+    // zigzag, without 32-bit bitwise ops so millisecond timestamps survive
+    return v % 2 === 0 ? v / 2 : -(v + 1) / 2;
+  }
+}
+
+function decodeBatch(buf) {
+  if (buf.length < HEADER_BYTES || buf[0] !== 0x50 || buf[1] !== 0x48) {
+    throw new Error('Not a pothole batch');
+  }
+  const version = buf[2];
+  if (version < 1 || version > VERSION) {
+    throw new Error(`Unsupported batch version ${version}`);
+  }
+  const frameCount = buf.readUInt16LE(3);
+  const payloadBytes = buf.readUInt32LE(5);
+  const end = HEADER_BYTES + payloadBytes;
+  if (end > buf.length) throw new Error('Truncated batch');
+
+  const reader = new Reader(buf, HEADER_BYTES, end);
+  const frames = [];
+  let previous = null;
+  let previousTracks = new Map(); // id -> fixed-point { d, x, size }
+
+  for (let f = 0; f < frameCount; f++) {
+    const bodyBytes = reader.varint();
+    const frameEnd = reader.pos + bodyBytes;
+    if (frameEnd > end) throw new Error('Truncated frame');
+
+    const frameDelta = reader.svarint();
+    const timestampDelta = reader.svarint();
+    const frame = previous ? previous.frame + frameDelta : frameDelta;
+    const timestampMs = previous ? previous.timestamp_ms + timestampDelta : timestampDelta;
+    const thetaDeg = reader.svarint() / DEGREES;
+    const trackCount = reader.varint();
+
+    const tracks = new Map();
+    const detections = [];
+    for (let t = 0; t < trackCount; t++) {
+      const tag = reader.varint();
+      const id = Math.floor(tag / 2);
+      let d = reader.svarint();
+      let x = reader.svarint();
+      let size = reader.svarint();
+      if (tag % 2 === 1) {
+        const ref = previousTracks.get(id);
+        if (!ref) throw new Error(`Delta against unknown track ${id}`);
+        d += ref.d;
+        x += ref.x;
+        size += ref.size;
+      }
+      tracks.set(id, { d, x, size });
+      const detection = { id, d: d / METRES, x: x / METRES, size: size / SQUARE_METRES };
+
+      const event = version >= 2 ? reader.byte() : 0;
+      if (event !== 0) {
+        detection.event = EVENTS[event] || 'unknown';
+        detection.score = reader.varint() / SCORE;
+        detection.first_frame = frame - reader.svarint();
+        detection.last_frame = frame - reader.svarint();
+        detection.hits = reader.varint();
+      }
+      detections.push(detection);
+    }
+
+    if (reader.pos > frameEnd) throw new Error('Frame overruns its length');
+    // skip anything a newer encoder appended to the frame
+    reader.pos = frameEnd;
+
+    previous = { frame, theta_deg: thetaDeg, detections, timestamp_ms: timestampMs };
+    previousTracks = tracks;
+    frames.push(previous);
+  }
+  return frames;
+}
+
+module.exports = {
+  CONTENT_TYPE,
+  decodeBatch
+};